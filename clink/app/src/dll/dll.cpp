@@ -7,6 +7,7 @@
 #include "utils/seh_scope.h"
 #include "utils/usage.h"
 
+#include <core/async_globber.h>
 #include <core/base.h>
 #include <core/globber.h>
 #include <core/log.h>
@@ -73,6 +74,7 @@ static void shutdown_clink()
 
     shutdown_task_manager(true/*final*/);
     shutdown_recognizer();
+    shutdown_async_globber();
 
     if (logger* logger = logger::get())
         delete logger;
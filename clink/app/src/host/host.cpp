@@ -18,6 +18,7 @@
 #include <core/debugheap.h>
 #include <core/callstack.h>
 #include <core/assert_improved.h>
+#include <lib/dir_history_db.h>
 #include <lib/doskey.h>
 #include <lib/match_generator.h>
 #include <lib/line_editor.h>
@@ -111,10 +112,20 @@ static setting_enum g_directories_dupe_mode(
     "default) always adds the current directory to the directory history.  A value\n"
     "of 'erase_prev' will erase any previous entries for the current directory and\n"
     "then add it to the directory history.\n"
-    "Note that directory history is not saved between sessions.",
+    "Note that directory history is not saved between sessions unless the\n"
+    "'directories.save' setting is enabled.",
     "add,erase_prev",
     0);
 
+static setting_bool g_save_dir_history(
+    "directories.save",
+    "Save directory history between sessions",
+    "When enabled, visited directories are saved between sessions and ranked by\n"
+    "frecency (how often and how recently each directory has been visited).  The\n"
+    "directories popup then lists the highest ranked directories, with the\n"
+    "highest ranked at the bottom.",
+    false);
+
 static setting_str g_exclude_from_history_cmds(
     "history.dont_add_to_history_cmds",
     "Commands not automatically added to the history",
@@ -235,7 +246,32 @@ dir_history_entry::dir_history_entry(const char* s)
 
 //------------------------------------------------------------------------------
 const int32 c_max_dir_history = 100;
+const int32 c_max_dir_popup = 1000;
 static std::list<dir_history_entry> s_dir_history;
+static std::list<dir_history_entry> s_dir_popup;    // Ranked directories last copied for the popup.
+static bool s_dir_popup_ranked = false;
+static str_moveable s_last_visited_dir;
+
+//------------------------------------------------------------------------------
+static dir_history_database* get_dir_history_db()
+{
+    dir_history_database* db = dir_history_database::get();
+    if (!g_save_dir_history.get())
+    {
+        delete db;
+        return nullptr;
+    }
+
+    if (!db)
+    {
+        dbg_ignore_scope(snapshot, "Directory history");
+        str<> path;
+        app_context::get()->get_state_dir(path);
+        path::append(path, "clink_dir_history");
+        db = new dir_history_database(path.c_str());
+    }
+    return db;
+}
 
 //------------------------------------------------------------------------------
 static void update_dir_history()
@@ -276,6 +312,15 @@ static void update_dir_history()
     // Trim overflow from head.
     while (s_dir_history.size() > c_max_dir_history)
         s_dir_history.pop_front();
+
+    // Record a visit in the saved directory history when the directory has
+    // changed since the previous prompt.
+    if (!s_last_visited_dir.iequals(cwd.c_str()))
+    {
+        s_last_visited_dir = cwd.c_str();
+        if (dir_history_database* db = get_dir_history_db())
+            db->add(cwd.c_str());
+    }
 }
 
 //------------------------------------------------------------------------------
@@ -295,6 +340,25 @@ static void prev_dir_history(str_base& inout)
 //------------------------------------------------------------------------------
 bool host_remove_dir_history(int32 index)
 {
+    if (s_dir_popup_ranked)
+    {
+        for (auto iter = s_dir_popup.begin(); iter != s_dir_popup.end(); ++iter, --index)
+        {
+            if (index == 0)
+            {
+                dir_history_database* db = dir_history_database::get();
+                if (db)
+                    db->remove(iter->get());
+                s_dir_history.remove_if([&] (const dir_history_entry& entry) {
+                    return _stricmp(entry.get(), iter->get()) == 0;
+                });
+                s_dir_popup.erase(iter);
+                return true;
+            }
+        }
+        return false;
+    }
+
     for (auto iter = s_dir_history.begin(); iter != s_dir_history.end(); ++iter, --index)
     {
         if (index == 0)
@@ -482,6 +546,7 @@ host::~host()
     delete m_suggester;
     delete m_lua;
     delete m_printer;
+    delete dir_history_database::get();
 
     set_lua_terminal(nullptr, nullptr);
     terminal_destroy(m_terminal);
@@ -701,6 +766,33 @@ bool host::call_lua_rl_global_function(const char* func_name, const line_state*
 //------------------------------------------------------------------------------
 const char** host::copy_dir_history(int32* total)
 {
+    s_dir_popup.clear();
+    s_dir_popup_ranked = false;
+
+    // Prefer the saved directory history, highest ranked last.
+    if (dir_history_database* db = get_dir_history_db())
+    {
+        db->load();
+
+        std::vector<dir_history_db::entry> top;
+        db->find_top(c_max_dir_popup, top);
+        if (!top.empty())
+        {
+            dbg_ignore_scope(snapshot, "Directory history");
+            for (auto it = top.rbegin(); it != top.rend(); ++it)
+                s_dir_popup.emplace_back(it->dir);
+
+            const char** history = (const char**)malloc(sizeof(*history) * s_dir_popup.size());
+            int32 i = 0;
+            for (auto const& it : s_dir_popup)
+                history[i++] = it.get();
+
+            s_dir_popup_ranked = true;
+            *total = i;
+            return history;
+        }
+    }
+
     if (!s_dir_history.size())
         return nullptr;
 
@@ -796,15 +888,16 @@ bool host::edit_line(const char* prompt, const char* rprompt, str_base& out, boo
     os::cwd_restorer cwd;
 
     // Load Clink's settings.  The load function handles deferred load for
-    // settings declared in scripts.
+    // settings declared in scripts.  Reloading skips the work when the
+    // settings files haven't changed since the last prompt.
     str<288> settings_file;
     str<288> default_settings_file;
     str<288> state_dir;
     app->get_settings_path(settings_file);
     app->get_default_settings_file(default_settings_file);
     app->get_state_dir(state_dir);
-    settings::load(settings_file.c_str(), default_settings_file.c_str());
-    reset_keyseq_to_name_map();
+    if (settings::reload(settings_file.c_str(), default_settings_file.c_str()))
+        reset_keyseq_to_name_map();
 
     // Set up the string comparison mode.
     static_assert(str_compare_scope::exact == 0, "g_ignore_case values must match str_compare_scope values");
@@ -5,6 +5,7 @@
 #include "dll/dll.h"
 #include "loader/loader.h"
 
+#include <core/async_globber.h>
 #include <core/os.h>
 #include <core/str_compare.h>
 #include <core/settings.h>
@@ -222,6 +223,7 @@ static int32 editline()
     line_editor_destroy(editor);
 
     shutdown_recognizer();
+    shutdown_async_globber();
     shutdown_task_manager(true/*final*/);
 
     return 0;
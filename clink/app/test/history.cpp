@@ -11,11 +11,15 @@
 #include <core/os.h>
 #include <core/settings.h>
 #include <core/str.h>
+#include <core/str_compare.h>
+#include <core/str_hash.h>
 #include <lib/history_db.h>
 #include <utils/app_context.h>
 
 #include <initializer_list>
 
+#include <psapi.h>
+
 extern "C" {
 #include <readline/history.h>
 };
@@ -70,11 +74,36 @@ struct test_history_db
         return m_master_ctag.size();
     }
 
+    uint32 scan_master(bool mapped) const
+    {
+        return scan_bank(bank_master, mapped);
+    }
+
+    bool is_indexed() const
+    {
+        return m_index_valid;
+    }
+
+    size_t get_indexed_count() const
+    {
+        return m_line_hashes.size();
+    }
+
     void set_min_compact_threshold(size_t threshold)
     {
         m_min_compact_threshold = threshold;
     }
 
+    void set_before_compact_write(void (*func)())
+    {
+        m_before_compact_write = func;
+    }
+
+    void wait_for_compact()
+    {
+        finish_compact(true/*wait*/);
+    }
+
     bool remove_by_index(int32 index)
     {
         return remove(m_index_map[index]);
@@ -102,6 +131,15 @@ static void strip_lf(char* line)
     }
 }
 
+//------------------------------------------------------------------------------
+// Deleting a line in place appends a tombstone for it.
+static uint32 tombstone_size(uint32 offset)
+{
+    str<> tombstone;
+    tombstone.format("|\tdel=%u\n", offset);
+    return tombstone.length();
+}
+
 //------------------------------------------------------------------------------
 int32 count_files()
 {
@@ -215,7 +253,8 @@ TEST_CASE("history db")
             REQUIRE(os::get_file_size(master_path) == 0 + history.get_master_tag_size());
         }
 
-        REQUIRE(count_files() == 1);
+        // Adding to the master bank created its sidecar.
+        REQUIRE(count_files() == 2);
     }
 
     SECTION("Sessioned")
@@ -280,7 +319,9 @@ TEST_CASE("history db")
             REQUIRE(os::get_file_size(removals_path) == 3 + history.get_master_tag_size());
             REQUIRE(os::get_file_size(master_path) == line_bytes);
 
-            line_bytes += session_bytes; // because reap()
+            // Because reap() appends the session and deletes the previous line
+            // in place.
+            line_bytes += session_bytes + tombstone_size(history.get_master_tag_size());
         }
 
         REQUIRE(count_files() == 1);
@@ -602,7 +643,10 @@ TEST_CASE("history limit")
                              strlen(history_lines[3-1]) + 1 +
                              strlen(history_lines[4-1]) + 1 +
                              strlen(history_lines[5-1]) + 1);
-        REQUIRE(os::get_file_size(master_path) == line_bytes + history.get_master_tag_size());
+        const uint32 tag_size = history.get_master_tag_size();
+        line_bytes += (tombstone_size(tag_size) +
+                       tombstone_size(uint32(tag_size + strlen(history_lines[1-1]) + 1)));
+        REQUIRE(os::get_file_size(master_path) == line_bytes + tag_size);
     }
 
     SECTION("Not compacted")
@@ -620,7 +664,14 @@ TEST_CASE("history limit")
                              strlen(history_lines[4-1]) + 1 +
                              strlen(history_lines[5-1]) + 1 +
                              strlen(history_lines[5-1]) + 1);
-        REQUIRE(os::get_file_size(master_path) == line_bytes + history.get_master_tag_size());
+        const uint32 tag_size = history.get_master_tag_size();
+        line_bytes += (tombstone_size(tag_size) +
+                       tombstone_size(uint32(tag_size + strlen(history_lines[1-1]) + 1)) +
+                       tombstone_size(uint32(tag_size + strlen(history_lines[1-1]) + 1 +
+                                                        strlen(history_lines[2-1]) + 1 +
+                                                        strlen(history_lines[3-1]) + 1 +
+                                                        strlen(history_lines[4-1]) + 1)));
+        REQUIRE(os::get_file_size(master_path) == line_bytes + tag_size);
     }
 
     SECTION("Compacted")
@@ -629,6 +680,11 @@ TEST_CASE("history limit")
         history.add(history_lines[5-1]);
         history.load_rl_history();
 
+        // Compacting happens in the background, and the next load picks up
+        // the result.
+        history.wait_for_compact();
+        history.load_rl_history();
+
         REQUIRE(history.get_master_length() == 3);
         REQUIRE(history.get_master_deleted_count() == 0);
         REQUIRE(strcmp(ctag.get(), history.get_master_tag()) != 0);
@@ -654,6 +710,7 @@ TEST_CASE("history limit")
                                  strlen(history_lines[4-1]) + 1 +
                                  strlen(history_lines[5-1]) + 1 +
                                  strlen(history_lines[2-1]) + 1);
+            line_bytes += tombstone_size(history.get_master_tag_size());
             REQUIRE(os::get_file_size(master_path) == line_bytes + history.get_master_tag_size());
         }
     }
@@ -743,6 +800,7 @@ TEST_CASE("history removals ctag")
     const char* session_path = "clink_history_493";
     const char* removals_path = "clink_history_493.removals";
     const char* alive_path = "clink_history_493~";
+    const char* sidecar_path = "clink_history.idx";
 
     // Start with an empty state dir.
     const char* empty_fs[] = { nullptr };
@@ -785,10 +843,10 @@ TEST_CASE("history removals ctag")
             for(const char* line : history_lines)
                 history.add(line);
 
-            expect_files({master_path, session_path, removals_path, alive_path});
+            expect_files({master_path, sidecar_path, session_path, removals_path, alive_path});
         }
 
-        expect_files({master_path});
+        expect_files({master_path, sidecar_path});
 
         {
             test_history_db history;
@@ -811,7 +869,7 @@ TEST_CASE("history removals ctag")
             REQUIRE(!history.remove_by_index(1));
         }
 
-        expect_files({master_path});
+        expect_files({master_path, sidecar_path});
     }
 
     SECTION("Compact translates")
@@ -833,7 +891,7 @@ TEST_CASE("history removals ctag")
             for(const char* line : history_lines)
                 REQUIRE(history.add(line));
 
-            expect_files({master_path, session_path, removals_path, alive_path});
+            expect_files({master_path, sidecar_path, session_path, removals_path, alive_path});
         }
 
         // Queue a deferred deletion (in the .removals file).
@@ -897,10 +955,10 @@ TEST_CASE("history removals ctag")
                 fclose(file);
             }
 
-            expect_files({master_path, session_path, removals_path, alive_path});
+            expect_files({master_path, sidecar_path, session_path, removals_path, alive_path});
         }
 
-        expect_files({master_path});
+        expect_files({master_path, sidecar_path});
 
         // Verify the final history file content.
         {
@@ -926,3 +984,918 @@ TEST_CASE("history removals ctag")
         }
     }
 }
+
+//------------------------------------------------------------------------------
+TEST_CASE("history index")
+{
+    const char* master_path = "clink_history";
+
+    // Start with an empty state dir.
+    const char* empty_fs[] = { nullptr };
+    fs_fixture fs(empty_fs);
+
+    // This sets the state id to something explicit.
+    static const char* env_desc[] = {
+        "=clink.id", "493",
+        nullptr
+    };
+    env_fixture env(env_desc);
+
+    app_context::desc context_desc;
+    context_desc.inherit_id = true;
+    str_base(context_desc.state_dir).copy(fs.get_root());
+    app_context context(context_desc);
+
+    settings::find("history.shared")->set("true");
+    settings::find("history.max_lines")->set();
+    settings::find("history.dupe_mode")->set("erase_prev");
+
+    static const char* history_lines[] = {
+        "aaa",
+        "bbb",
+        "ccc",
+    };
+
+    test_history_db history;
+    for (const char* line : history_lines)
+        REQUIRE(history.add(line));
+    history.load_rl_history(false);
+
+    REQUIRE(history.is_indexed());
+    REQUIRE(history.get_indexed_count() == sizeof_array(history_lines));
+
+    SECTION("Find")
+    {
+        REQUIRE(history.find("bbb"));
+        REQUIRE(!history.find("bb"));
+        REQUIRE(!history.find("bbbb"));
+    }
+
+    SECTION("Erase prev")
+    {
+        REQUIRE(history.add("aaa"));
+        REQUIRE(history.get_indexed_count() == 3);
+        REQUIRE(history.remove("aaa") == 1);
+        REQUIRE(history.get_indexed_count() == 2);
+        REQUIRE(!history.find("aaa"));
+    }
+
+    SECTION("Ignore")
+    {
+        settings::find("history.dupe_mode")->set("ignore");
+
+        const int32 size = os::get_file_size(master_path);
+        REQUIRE(history.add("ccc"));
+        REQUIRE(os::get_file_size(master_path) == size);
+    }
+
+    SECTION("Appended elsewhere")
+    {
+        // Lines appended by another session aren't in the index, but they
+        // must still be found by scanning the tail of the bank.
+        {
+            test_history_db other;
+            REQUIRE(other.add("ddd"));
+        }
+
+        REQUIRE(history.get_indexed_count() == 3);
+        REQUIRE(history.find("ddd"));
+        REQUIRE(history.remove("ddd") == 1);
+        REQUIRE(!history.find("ddd"));
+    }
+
+    SECTION("Compacted elsewhere")
+    {
+        // Compacting changes the ctag, so the stale index must be bypassed.
+        {
+            test_history_db other;
+            other.compact(true/*force*/);
+        }
+
+        REQUIRE(history.find("ccc"));
+        REQUIRE(!history.find("ddd"));
+    }
+}
+
+//------------------------------------------------------------------------------
+TEST_CASE("history sidecar")
+{
+    const char* master_path = "clink_history";
+    const char* sidecar_path = "clink_history.idx";
+    const int32 record_size = 12;
+    const int32 footer_size = 80;
+
+    // Start with an empty state dir.
+    const char* empty_fs[] = { nullptr };
+    fs_fixture fs(empty_fs);
+
+    // This sets the state id to something explicit.
+    static const char* env_desc[] = {
+        "=clink.id", "493",
+        nullptr
+    };
+    env_fixture env(env_desc);
+
+    app_context::desc context_desc;
+    context_desc.inherit_id = true;
+    str_base(context_desc.state_dir).copy(fs.get_root());
+    app_context context(context_desc);
+
+    settings::find("history.shared")->set("true");
+    settings::find("history.max_lines")->set();
+    settings::find("history.dupe_mode")->set("add");
+
+    // Adding to the master bank creates the sidecar; loading doesn't touch it.
+    test_history_db history;
+    REQUIRE(os::get_path_type(sidecar_path) == os::path_type_invalid);
+    REQUIRE(history.add("aaa"));
+    REQUIRE(history.add("bbb"));
+    REQUIRE(history.add("ccc"));
+    REQUIRE(os::get_file_size(sidecar_path) == 3 * record_size + footer_size);
+    history.load_rl_history(false);
+    REQUIRE(os::get_file_size(sidecar_path) == 3 * record_size + footer_size);
+
+    SECTION("Added")
+    {
+        REQUIRE(history.add("ddd"));
+        REQUIRE(os::get_file_size(sidecar_path) == 4 * record_size + footer_size);
+
+        test_history_db other;
+        REQUIRE(!other.is_indexed());
+        REQUIRE(other.find("ddd"));
+        REQUIRE(!other.find("dd"));
+    }
+
+    SECTION("Used")
+    {
+        // Sessions that haven't loaded history find lines through the
+        // sidecar, so pointing the record for "bbb" at the ctag line hides it
+        // from them.
+        FILE* file = fopen(sidecar_path, "r+b");
+        REQUIRE(file != nullptr);
+        const uint32 hash = str_hash("bbb");
+        for (int32 i = 0; i < 3; ++i)
+        {
+            uint32 record[3];
+            fseek(file, i * record_size, SEEK_SET);
+            REQUIRE(fread(record, sizeof(record), 1, file) == 1);
+            if (record[1] == hash)
+            {
+                const uint32 offset = 0;
+                fseek(file, i * record_size, SEEK_SET);
+                fwrite(&offset, sizeof(offset), 1, file);
+            }
+        }
+        fclose(file);
+
+        test_history_db other;
+        REQUIRE(other.find("aaa"));
+        REQUIRE(!other.find("bbb"));
+    }
+
+    SECTION("Appended elsewhere")
+    {
+        // Versions of Clink that don't know about the sidecar append lines
+        // without extending it.
+        FILE* file = fopen(master_path, "ab");
+        REQUIRE(file != nullptr);
+        fputs("eee\n", file);
+        fclose(file);
+
+        {
+            test_history_db other;
+            REQUIRE(other.find("bbb"));
+            REQUIRE(other.find("eee"));
+        }
+
+        // A sidecar that fell behind isn't used for those lines, and the
+        // next add rebuilds it.
+        REQUIRE(os::get_file_size(sidecar_path) == 3 * record_size + footer_size);
+        REQUIRE(history.add("fff"));
+        REQUIRE(os::get_file_size(sidecar_path) == 5 * record_size + footer_size);
+    }
+
+    SECTION("Sorted")
+    {
+        str<> line;
+        for (int32 i = 0; i < 300; ++i)
+        {
+            line.format("line %d", i);
+            REQUIRE(history.add(line.c_str()));
+        }
+
+        // Too many unsorted records get merged into the sorted records.
+        FILE* file = fopen(sidecar_path, "rb");
+        REQUIRE(file != nullptr);
+        uint32 footer[4];
+        fseek(file, -footer_size, SEEK_END);
+        REQUIRE(fread(footer, sizeof(footer), 1, file) == 1);
+        const uint32 count = footer[1];
+        const uint32 sorted = footer[3];
+        REQUIRE(count == 303);
+        REQUIRE(sorted > 0);
+        REQUIRE(count - sorted <= 256);
+
+        std::vector<uint32> records(count * 3);
+        fseek(file, 0, SEEK_SET);
+        REQUIRE(fread(records.data(), record_size, count, file) == count);
+        fclose(file);
+        for (uint32 i = 1; i < sorted; ++i)
+            REQUIRE(records[(i - 1) * 3 + 1] <= records[i * 3 + 1]);
+
+        test_history_db other;
+        REQUIRE(other.find("bbb"));
+        REQUIRE(other.find("line 0"));
+        REQUIRE(other.find("line 299"));
+        REQUIRE(!other.find("line 300"));
+    }
+
+    SECTION("Compacted")
+    {
+        REQUIRE(history.remove("bbb") == 1);
+        REQUIRE(history.compact(true/*force*/));
+        REQUIRE(os::get_file_size(sidecar_path) == 2 * record_size + footer_size);
+
+        test_history_db other;
+        REQUIRE(other.find("ccc"));
+        REQUIRE(!other.find("bbb"));
+    }
+
+    SECTION("Cleared")
+    {
+        history.clear();
+        REQUIRE(os::get_file_size(sidecar_path) == footer_size);
+        REQUIRE(history.add("ggg"));
+        REQUIRE(os::get_file_size(sidecar_path) == record_size + footer_size);
+    }
+}
+
+//------------------------------------------------------------------------------
+static void require_rl_history(const std::initializer_list<const char*>& lines)
+{
+    REQUIRE(history_length == int32(lines.size()), [&] () {
+        printf("expected %zu entries, actual %d\n", lines.size(), history_length);
+    });
+
+    int32 i = 0;
+    for (const char* line : lines)
+    {
+        const HIST_ENTRY* entry = history_get(history_base + i++);
+        REQUIRE(entry && strcmp(entry->line, line) == 0, [&] () {
+            printf("entry %d\nexpected '%s'\nactual   '%s'\n", i - 1, line, entry ? entry->line : "");
+        });
+    }
+}
+
+//------------------------------------------------------------------------------
+static void mark_rl_entry(int32 index)
+{
+    // A full load replaces every entry with the line from the file, so a
+    // marked entry surviving a reload shows the reload was incremental.
+    free_history_entry(replace_history_entry(index, "marked", nullptr));
+}
+
+//------------------------------------------------------------------------------
+TEST_CASE("history reload")
+{
+    const char* master_path = "clink_history";
+
+    // Start with an empty state dir.
+    const char* empty_fs[] = { nullptr };
+    fs_fixture fs(empty_fs);
+
+    // This sets the state id to something explicit.
+    static const char* env_desc[] = {
+        "=clink.id", "493",
+        nullptr
+    };
+    env_fixture env(env_desc);
+
+    app_context::desc context_desc;
+    context_desc.inherit_id = true;
+    str_base(context_desc.state_dir).copy(fs.get_root());
+    app_context context(context_desc);
+
+    settings::find("history.max_lines")->set();
+    settings::find("history.dupe_mode")->set("erase_prev");
+
+    static const char* history_lines[] = {
+        "aaa",
+        "bbb",
+        "ccc",
+    };
+
+    SECTION("Shared")
+    {
+        settings::find("history.shared")->set("true");
+
+        test_history_db history;
+        for (const char* line : history_lines)
+            REQUIRE(history.add(line));
+        history.load_rl_history();
+        require_rl_history({ "aaa", "bbb", "ccc" });
+        mark_rl_entry(0);
+
+        SECTION("Unchanged")
+        {
+            history.load_rl_history();
+            require_rl_history({ "marked", "bbb", "ccc" });
+        }
+
+        SECTION("Appended elsewhere")
+        {
+            {
+                test_history_db other;
+                REQUIRE(other.add("ddd"));
+            }
+
+            history.load_rl_history();
+            require_rl_history({ "marked", "bbb", "ccc", "ddd" });
+            REQUIRE(history.get_master_length() == 4);
+            REQUIRE(history.find("ddd"));
+        }
+
+        SECTION("Removed elsewhere")
+        {
+            {
+                test_history_db other;
+                REQUIRE(other.remove("bbb") == 1);
+            }
+
+            history.load_rl_history();
+            require_rl_history({ "marked", "ccc" });
+            REQUIRE(history.get_master_length() == 2);
+            REQUIRE(history.get_master_deleted_count() == 1);
+        }
+
+        SECTION("Removed in place elsewhere")
+        {
+            // Versions of Clink that don't append tombstones only mark the
+            // line as deleted, which doesn't change the size of the bank.
+            Sleep(50);
+            FILE* file = fopen(master_path, "r+b");
+            REQUIRE(file != nullptr);
+            fseek(file, history.get_master_tag_size() + 4, SEEK_SET);
+            fputc('|', file);
+            fclose(file);
+
+            history.load_rl_history();
+            require_rl_history({ "marked", "ccc" });
+            REQUIRE(history.get_master_length() == 2);
+        }
+
+        SECTION("Erase prev")
+        {
+            REQUIRE(history.add("bbb"));
+
+            history.load_rl_history();
+            require_rl_history({ "marked", "ccc", "bbb" });
+            REQUIRE(history.get_master_length() == 3);
+            REQUIRE(history.get_master_deleted_count() == 1);
+        }
+
+        SECTION("Limited")
+        {
+            settings::find("history.max_lines")->set("2");
+            history.set_min_compact_threshold(5);
+
+            REQUIRE(history.add("ddd"));
+            history.load_rl_history();
+            require_rl_history({ "ccc", "ddd" });
+
+            // Pruning keeps the list in sync, so reloading stays incremental.
+            mark_rl_entry(0);
+            history.load_rl_history();
+            require_rl_history({ "marked", "ddd" });
+        }
+
+        SECTION("Compacted elsewhere")
+        {
+            {
+                test_history_db other;
+                other.compact(true/*force*/);
+            }
+
+            history.load_rl_history();
+            require_rl_history({ "aaa", "bbb", "ccc" });
+        }
+
+        SECTION("Changed in memory")
+        {
+            add_history("zzz");
+
+            history.load_rl_history();
+            require_rl_history({ "aaa", "bbb", "ccc" });
+        }
+    }
+
+    SECTION("Sessioned")
+    {
+        settings::find("history.shared")->set("false");
+
+        // Reaping moves the lines into the master bank.
+        {
+            test_history_db history;
+            for (const char* line : history_lines)
+                REQUIRE(history.add(line));
+        }
+
+        test_history_db history;
+        REQUIRE(history.add("xxx"));
+        history.load_rl_history();
+        require_rl_history({ "aaa", "bbb", "ccc", "xxx" });
+        REQUIRE(history.get_master_length() == 3);
+        mark_rl_entry(0);
+
+        SECTION("Deferred removal")
+        {
+            REQUIRE(history.add("bbb"));
+
+            history.load_rl_history();
+            require_rl_history({ "marked", "ccc", "xxx", "bbb" });
+            REQUIRE(history.get_master_length() == 2);
+        }
+
+        SECTION("Appended to master")
+        {
+            // Like reaping another session; new master lines precede the
+            // session's lines.
+            FILE* file = fopen(master_path, "ab");
+            REQUIRE(file != nullptr);
+            fputs("ddd\n", file);
+            fclose(file);
+
+            REQUIRE(history.add("yyy"));
+
+            history.load_rl_history();
+            require_rl_history({ "marked", "bbb", "ccc", "ddd", "xxx", "yyy" });
+            REQUIRE(history.get_master_length() == 4);
+            const char* suggestion = history.find_suggestion("d", false);
+            REQUIRE(suggestion && strcmp(suggestion, "ddd") == 0);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+TEST_CASE("history compact meanwhile")
+{
+    const char* master_path = "clink_history";
+
+    // Start with an empty state dir.
+    const char* empty_fs[] = { nullptr };
+    fs_fixture fs(empty_fs);
+
+    // This sets the state id to something explicit.
+    static const char* env_desc[] = {
+        "=clink.id", "493",
+        nullptr
+    };
+    env_fixture env(env_desc);
+
+    app_context::desc context_desc;
+    context_desc.inherit_id = true;
+    str_base(context_desc.state_dir).copy(fs.get_root());
+    app_context context(context_desc);
+
+    settings::find("history.shared")->set("true");
+    settings::find("history.max_lines")->set();
+    settings::find("history.dupe_mode")->set("add");
+
+    test_history_db history;
+    REQUIRE(history.add("aaa"));
+    REQUIRE(history.add("bbb"));
+    REQUIRE(history.add("ccc"));
+    REQUIRE(history.remove("bbb") == 1);
+    history.load_rl_history(false);
+
+    // The hook runs after the compacted bank is built, and before it's
+    // written.  Other sessions can change the bank in between.
+    SECTION("Appended")
+    {
+        history.set_before_compact_write([] () {
+            test_history_db other;
+            REQUIRE(other.add("ddd"));
+        });
+        REQUIRE(history.compact(true/*force*/));
+
+        history.load_rl_history(false);
+        require_rl_history({ "aaa", "ccc", "ddd" });
+        REQUIRE(history.get_master_deleted_count() == 0);
+        REQUIRE(history.find("ddd"));
+        REQUIRE(os::get_file_size(master_path) == history.get_master_tag_size() + 12);
+    }
+
+    SECTION("Removed")
+    {
+        history.set_before_compact_write([] () {
+            test_history_db other;
+            REQUIRE(other.remove("ccc") == 1);
+        });
+        REQUIRE(history.compact(true/*force*/));
+
+        history.load_rl_history(false);
+        require_rl_history({ "aaa" });
+        REQUIRE(history.get_master_deleted_count() == 1);
+        REQUIRE(!history.find("ccc"));
+    }
+
+    SECTION("Compacted")
+    {
+        history.set_before_compact_write([] () {
+            test_history_db other;
+            REQUIRE(other.compact(true/*force*/));
+        });
+        REQUIRE(!history.compact(true/*force*/));
+
+        history.load_rl_history(false);
+        require_rl_history({ "aaa", "ccc" });
+        REQUIRE(history.get_master_deleted_count() == 0);
+    }
+}
+
+//------------------------------------------------------------------------------
+TEST_CASE("history mapped load")
+{
+    const char* master_path = "clink_history";
+
+    // Start with an empty state dir.
+    const char* empty_fs[] = { nullptr };
+    fs_fixture fs(empty_fs);
+
+    // This sets the state id to something explicit.
+    static const char* env_desc[] = {
+        "=clink.id", "493",
+        nullptr
+    };
+    env_fixture env(env_desc);
+
+    app_context::desc context_desc;
+    context_desc.inherit_id = true;
+    str_base(context_desc.state_dir).copy(fs.get_root());
+    app_context context(context_desc);
+
+    settings::find("history.shared")->set("true");
+    settings::find("history.max_lines")->set();
+    settings::find("history.dupe_mode")->set("add");
+
+    // Timestamps, deleted lines, a deleted line with a timestamp, CRLF, a
+    // blank line, and no line ending at the end of the file.
+    FILE* file = fopen(master_path, "wb");
+    REQUIRE(file != nullptr);
+    fputs("|CTAG_mapped\n"
+          "aaa\n"
+          "|\ttime=1000\n"
+          "bbb\n"
+          "|deleted\n"
+          "|\ttime=2000\n"
+          "|ccc\n"
+          "ddd\r\n"
+          "\n"
+          "eee", file);
+    fclose(file);
+
+    auto require_loaded = [&] (test_history_db& history)
+    {
+        require_rl_history({ "aaa", "bbb", "ddd", "eee" });
+        REQUIRE(history.get_master_length() == 4);
+        REQUIRE(history.get_master_deleted_count() == 2);
+        REQUIRE(history.find("ddd"));
+
+        const HIST_ENTRY* entry = history_get(history_base + 1);
+        REQUIRE(entry->timestamp && strcmp(entry->timestamp, "1000") == 0);
+        REQUIRE(!history_get(history_base + 0)->timestamp);
+        REQUIRE(!history_get(history_base + 2)->timestamp);
+    };
+
+    test_history_db history;
+    history.load_rl_history(false);
+    require_loaded(history);
+
+    // Loaded entries can be replaced and removed like any others.
+    mark_rl_entry(0);
+    free_history_entry(remove_history(1));
+    require_rl_history({ "marked", "ddd", "eee" });
+
+    // The list no longer matches the bank, so this is a full load.
+    history.load_rl_history(false);
+    require_loaded(history);
+}
+
+//------------------------------------------------------------------------------
+TEST_CASE("history suggestions")
+{
+    // Start with an empty state dir.
+    const char* empty_fs[] = { nullptr };
+    fs_fixture fs(empty_fs);
+
+    // This sets the state id to something explicit.
+    static const char* env_desc[] = {
+        "=clink.id", "493",
+        nullptr
+    };
+    env_fixture env(env_desc);
+
+    app_context::desc context_desc;
+    context_desc.inherit_id = true;
+    str_base(context_desc.state_dir).copy(fs.get_root());
+    app_context context(context_desc);
+
+    settings::find("history.shared")->set("true");
+    settings::find("history.max_lines")->set();
+    settings::find("history.dupe_mode")->set("add");
+
+    static const char* history_lines[] = {
+        "git status",
+        "cd foo",
+        "dir /w",
+        "git commit -m x",
+        "git status",
+        "Git Stash",
+        "cd foo",
+    };
+
+    test_history_db history;
+    for (const char* line : history_lines)
+        REQUIRE(history.add(line));
+    history.load_rl_history(false);
+
+    str_compare_scope _(str_compare_scope::exact, false);
+
+    auto suggest = [&] (const char* line, bool match_prev_cmd=false) {
+        const char* suggestion = history.find_suggestion(line, match_prev_cmd);
+        return suggestion ? suggestion : "";
+    };
+
+    SECTION("Prefix")
+    {
+        REQUIRE(strcmp(suggest("git"), "git status") == 0);
+        REQUIRE(strcmp(suggest("git c"), "git commit -m x") == 0);
+        REQUIRE(strcmp(suggest("d"), "dir /w") == 0);
+        REQUIRE(strcmp(suggest("git status"), "") == 0);
+        REQUIRE(strcmp(suggest("xyz"), "") == 0);
+        REQUIRE(strcmp(suggest(""), "") == 0);
+    }
+
+    SECTION("Caseless")
+    {
+        str_compare_scope caseless(str_compare_scope::caseless, false);
+        REQUIRE(strcmp(suggest("git"), "Git Stash") == 0);
+        REQUIRE(strcmp(suggest("GIT S"), "Git Stash") == 0);
+        REQUIRE(strcmp(suggest("CD"), "cd foo") == 0);
+    }
+
+    SECTION("Match prev cmd")
+    {
+        REQUIRE(strcmp(suggest("d", true), "dir /w") == 0);
+        REQUIRE(strcmp(suggest("g", true), "") == 0);
+    }
+
+    SECTION("Added")
+    {
+        add_history("git checkout main");
+        REQUIRE(strcmp(suggest("git"), "git checkout main") == 0);
+        REQUIRE(strcmp(suggest("d", true), "") == 0);
+    }
+
+    SECTION("Removed")
+    {
+        // Readline calls the history hook before removing the entry.
+        REQUIRE(history.remove(3, history_lines[3]));
+        free_history_entry(remove_history(3));
+
+        REQUIRE(strcmp(suggest("git c"), "") == 0);
+        REQUIRE(strcmp(suggest("git"), "git status") == 0);
+        REQUIRE(strcmp(suggest("d", true), "dir /w") == 0);
+    }
+
+    SECTION("Removed then added")
+    {
+        REQUIRE(history.remove(3, history_lines[3]));
+        free_history_entry(remove_history(3));
+        REQUIRE(history.remove(0, history_lines[0]));
+        free_history_entry(remove_history(0));
+
+        add_history("git checkout main");
+        REQUIRE(strcmp(suggest("git"), "git checkout main") == 0);
+        REQUIRE(strcmp(suggest("git s"), "git status") == 0);
+        REQUIRE(strcmp(suggest("git c"), "git checkout main") == 0);
+
+        add_history("cd foo");
+        REQUIRE(strcmp(suggest("d", true), "dir /w") == 0);
+    }
+}
+
+//------------------------------------------------------------------------------
+BENCHMARK_CASE("history add")
+{
+    const char* master_path = "clink_history";
+
+    // Start with an empty state dir.
+    const char* empty_fs[] = { nullptr };
+    fs_fixture fs(empty_fs);
+
+    // This sets the state id to something explicit.
+    static const char* env_desc[] = {
+        "=clink.id", "493",
+        nullptr
+    };
+    env_fixture env(env_desc);
+
+    app_context::desc context_desc;
+    context_desc.inherit_id = true;
+    str_base(context_desc.state_dir).copy(fs.get_root());
+    app_context context(context_desc);
+
+    settings::find("history.shared")->set("true");
+    settings::find("history.max_lines")->set("0");
+    settings::find("history.dupe_mode")->set("erase_prev");
+
+    for (int32 count : { 1000, 10000, 100000 })
+    {
+        // Writing the master bank directly is much faster than adding lines
+        // one at a time.
+        auto make_master = [&] ()
+        {
+            FILE* file = fopen(master_path, "wb");
+            REQUIRE(file != nullptr);
+            fputs("|CTAG_benchmark\n", file);
+            for (int32 i = 0; i < count; ++i)
+                fprintf(file, "echo history line %d\n", i);
+            fclose(file);
+        };
+
+        // Each add erases a previous duplicate, like pressing Enter on a
+        // command recalled from history.
+        const int32 adds = 100;
+        auto time_adds = [&] (test_history_db& history)
+        {
+            str<> line;
+            os::high_resolution_clock clock;
+            for (int32 i = 0; i < adds; ++i)
+            {
+                line.format("echo history line %d", (i * 7919) % count);
+                REQUIRE(history.add(line.c_str()));
+            }
+            return clock.elapsed() * 1000 / adds;
+        };
+
+        double scan_ms;
+        make_master();
+        {
+            test_history_db history;
+            REQUIRE(!history.is_indexed());
+            scan_ms = time_adds(history);
+        }
+
+        double index_ms;
+        make_master();
+        {
+            test_history_db history;
+            history.load_rl_history(false);
+            REQUIRE(history.is_indexed());
+            index_ms = time_adds(history);
+        }
+
+        printf("\n    %6d lines:  scan %8.3f ms/add, indexed %8.3f ms/add", count, scan_ms, index_ms);
+    }
+    puts("");
+}
+
+//------------------------------------------------------------------------------
+BENCHMARK_CASE("history reload")
+{
+    const char* master_path = "clink_history";
+
+    // Start with an empty state dir.
+    const char* empty_fs[] = { nullptr };
+    fs_fixture fs(empty_fs);
+
+    // This sets the state id to something explicit.
+    static const char* env_desc[] = {
+        "=clink.id", "493",
+        nullptr
+    };
+    env_fixture env(env_desc);
+
+    app_context::desc context_desc;
+    context_desc.inherit_id = true;
+    str_base(context_desc.state_dir).copy(fs.get_root());
+    app_context context(context_desc);
+
+    settings::find("history.shared")->set("true");
+    settings::find("history.max_lines")->set("0");
+    settings::find("history.dupe_mode")->set("erase_prev");
+
+    for (int32 count : { 1000, 10000, 100000 })
+    {
+        FILE* file = fopen(master_path, "wb");
+        REQUIRE(file != nullptr);
+        fputs("|CTAG_benchmark\n", file);
+        for (int32 i = 0; i < count; ++i)
+            fprintf(file, "echo history line %d\n", i);
+        fclose(file);
+
+        test_history_db history;
+
+        os::high_resolution_clock full_clock;
+        history.load_rl_history();
+        const double full_ms = full_clock.elapsed() * 1000;
+
+        // Each prompt after the first only sees the line the previous prompt
+        // added, which erased a previous duplicate.
+        const int32 prompts = 20;
+        double reload_ms = 0;
+        str<> line;
+        for (int32 i = 0; i < prompts; ++i)
+        {
+            line.format("echo history line %d", (i * 7919) % count);
+            REQUIRE(history.add(line.c_str()));
+
+            os::high_resolution_clock clock;
+            history.load_rl_history();
+            reload_ms += clock.elapsed() * 1000;
+        }
+        REQUIRE(history_length == count);
+
+        printf("\n    %6d lines:  full load %8.3f ms, reload %8.3f ms", count, full_ms, reload_ms / prompts);
+    }
+    puts("");
+}
+
+//------------------------------------------------------------------------------
+static size_t get_private_bytes()
+{
+    static BOOL (WINAPI *func)(HANDLE, PPROCESS_MEMORY_COUNTERS, DWORD) = nullptr;
+    if (func == nullptr)
+        if (HMODULE psapi = LoadLibrary("psapi.dll"))
+            *(FARPROC*)&func = GetProcAddress(psapi, "GetProcessMemoryInfo");
+
+    PROCESS_MEMORY_COUNTERS counters = { sizeof(counters) };
+    if (!func || !func(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+
+    return counters.PagefileUsage;
+}
+
+//------------------------------------------------------------------------------
+BENCHMARK_CASE("history mapped load")
+{
+    const char* master_path = "clink_history";
+
+    // Start with an empty state dir.
+    const char* empty_fs[] = { nullptr };
+    fs_fixture fs(empty_fs);
+
+    // This sets the state id to something explicit.
+    static const char* env_desc[] = {
+        "=clink.id", "493",
+        nullptr
+    };
+    env_fixture env(env_desc);
+
+    app_context::desc context_desc;
+    context_desc.inherit_id = true;
+    str_base(context_desc.state_dir).copy(fs.get_root());
+    app_context context(context_desc);
+
+    settings::find("history.shared")->set("true");
+    settings::find("history.max_lines")->set("0");
+    settings::find("history.dupe_mode")->set("erase_prev");
+
+    for (int32 count : { 1000, 10000, 100000 })
+    {
+        FILE* file = fopen(master_path, "wb");
+        REQUIRE(file != nullptr);
+        fputs("|CTAG_benchmark\n", file);
+        for (int32 i = 0; i < count; ++i)
+            fprintf(file, "|\ttime=%d\necho history line %d\n", 1700000000 + i, i);
+        fclose(file);
+
+        test_history_db history;
+
+        // Read the same bank with each iterator, then load it; the difference
+        // between the scans and the load is the cost of copying lines into
+        // Readline's history list.
+        double ms[3];
+        size_t kb[3];
+        for (int32 pass = 0; pass < 3; ++pass)
+        {
+            const size_t before = get_private_bytes();
+
+            os::high_resolution_clock clock;
+            if (pass < 2)
+                REQUIRE(history.scan_master(pass == 1) == uint32(count));
+            else
+                history.load_rl_history(false);
+            ms[pass] = clock.elapsed() * 1000;
+
+            const size_t after = get_private_bytes();
+            kb[pass] = ((after > before) ? after - before : 0) / 1024;
+        }
+        REQUIRE(history_length == count);
+
+        printf("\n    %6d lines:  buffered %8.3f ms %6zu KB,  mapped %8.3f ms %6zu KB,  load %8.3f ms %6zu KB",
+               count, ms[0], kb[0], ms[1], kb[1], ms[2], kb[2]);
+    }
+    puts("");
+}
@@ -0,0 +1,55 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#pragma once
+
+#include "globber.h"
+#include "str.h"
+
+#include <memory>
+#include <vector>
+
+//------------------------------------------------------------------------------
+// Enumerates files on a worker thread and hands them over in batches.
+//
+// Enumerating a large directory (especially on a network share) can take a
+// long time, and each FindNextFile can block.  The worker runs the globber and
+// queues what it finds, so the caller can consume the first batch right away,
+// check for cancelation between batches, and abandon the enumeration without
+// waiting for a blocked call to return.
+//
+// All async_globbers share one worker thread, which runs the enumerations one
+// at a time in the order they were started.
+class async_globber : public no_copy
+{
+    friend struct glob_worker;
+
+public:
+    struct entry
+    {
+        str_moveable        name;
+        globber::extrainfo  info;
+    };
+
+                        async_globber(const char* pattern);
+                        ~async_globber();
+    void                files(bool state);
+    void                directories(bool state);
+    void                suffix_dirs(bool state);
+    void                hidden(bool state);
+    void                system(bool state);
+    void                dots(bool state);
+    bool                start();
+    bool                next_batch(std::vector<entry>& out, uint32 timeout);
+    void                cancel();
+    bool                is_done() const;
+
+private:
+    struct shared_state;
+    static void         proc(shared_state& state);
+    std::shared_ptr<shared_state> m_state;
+    bool                m_started = false;
+};
+
+//------------------------------------------------------------------------------
+void shutdown_async_globber();
@@ -244,4 +244,30 @@ bool match_wild(const str_impl<T>& pattern, const str_impl<T>& file, bool dot_pr
     return match_wild(pattern_iter, file_iter, dot_prefix, match_everything);
 }
 
+//------------------------------------------------------------------------------
+// A pattern prepared for matching against many files.  Compiling extracts the
+// leading and trailing literal runs and the rarest literal in between, so most
+// files that can't match are rejected with a few byte compares or a memchr.
+// Anything the prefilter can't rule out is handed to match_wild_impl, so the
+// results are always identical to match_wild().
+//
+// The matcher doesn't copy the pattern; it must outlive the matcher.
+class wild_matcher
+{
+public:
+                    wild_matcher(const char* pattern=nullptr, int32 len=-1);
+    void            set(const char* pattern, int32 len=-1);
+    const char*     get_pattern() const { return m_pattern; }
+    uint32          length() const { return m_len; }
+    bool            match(const char* file, int32 len=-1, bool dot_prefix=false, star_matches_everything match_everything=no) const;
+
+private:
+    bool            prefilter(const char* file, uint32 len, bool dot_prefix, int32 mode) const;
+    const char*     m_pattern;
+    uint32          m_len;
+    uint32          m_prefix_len;
+    uint32          m_suffix_len;
+    char            m_rare;
+};
+
 }; // namespace path
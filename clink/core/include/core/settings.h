@@ -51,6 +51,7 @@ struct setting_name_value
 setting_iter        first();
 setting*            find(const char* name);
 bool                load(const char* file, const char* default_file=nullptr);
+bool                reload(const char* file, const char* default_file=nullptr);
 bool                save(const char* file);
 
 bool                parse_ini(const char* file, std::vector<setting_name_value>& out);
@@ -77,8 +78,6 @@ void                TEST_set_ever_loaded();
 //------------------------------------------------------------------------------
 class setting
 {
-    friend void load_custom_defaults(const char* file);
-
 public:
     enum type_e : uint8 {
         type_unknown,
@@ -106,6 +105,8 @@ public:
     void            set_source(char const* source);
     const char*     get_source() const;
 
+    static uint32   get_change_count() { return s_change_count; }
+
 protected:
                     setting(const char* name, const char* short_desc, const char* long_desc, type_e type);
     const char*     get_custom_default() const;
@@ -124,6 +125,7 @@ protected:
     };
 
     static const char* get_loaded_value(const char* name);
+    static uint32   s_change_count;     // Incremented whenever any setting is set.
 };
 
 //------------------------------------------------------------------------------
@@ -184,6 +186,7 @@ template <typename T> setting_impl<T>::setting_impl(
 //------------------------------------------------------------------------------
 template <typename T> void setting_impl<T>::set()
 {
+    ++s_change_count;
     const char* custom_default = get_custom_default();
     if (!custom_default || !parse(custom_default, m_store))
         m_store.value = T(m_default);
@@ -193,6 +196,7 @@ template <typename T> void setting_impl<T>::set()
 //------------------------------------------------------------------------------
 template <typename T> bool setting_impl<T>::set(const char* value)
 {
+    ++s_change_count;
     if (!parse(value, m_store))
         return false;
     m_save = true;
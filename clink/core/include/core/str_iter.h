@@ -19,6 +19,7 @@ public:
     void            truncate(uint32 len);
     int32           peek();
     int32           next();
+    uint32          skip_printable_ascii();
     bool            more() const;
     uint32          length() const;
 
@@ -0,0 +1,265 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+#include "async_globber.h"
+
+#include <assert.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+//------------------------------------------------------------------------------
+static const size_t c_first_batch = 64;
+static const size_t c_max_batch = 1024;
+static const uint32 c_flush_ms = 20;
+
+//------------------------------------------------------------------------------
+// The worker thread holds a strong ref while it runs the enumeration, so
+// abandoning an enumeration never has to wait for the worker to notice.
+struct async_globber::shared_state
+{
+                        shared_state(const char* pattern) : pattern(pattern) {}
+    str_moveable        pattern;
+    bool                files = true;
+    bool                directories = true;
+    bool                dir_suffix = true;
+    bool                hidden = false;
+    bool                system = false;
+    bool                dots = false;
+
+    std::mutex          mutex;
+    std::condition_variable ready;
+    std::vector<entry>  queue;
+    bool                done = false;
+    std::atomic<bool>   canceled { false };
+};
+
+//------------------------------------------------------------------------------
+// The worker thread runs queued enumerations one at a time.  A canceled
+// enumeration stops once the call it's blocked in returns, so a later one can
+// wait behind it, but the caller never does.  The thread holds a strong ref to
+// the worker, so shutting down doesn't wait for a blocked call either.
+struct glob_worker
+{
+    static bool         queue(const std::shared_ptr<async_globber::shared_state>& state);
+    static void         shutdown();
+
+private:
+    static void         proc(std::shared_ptr<glob_worker> worker);
+    std::mutex          mutex;
+    std::condition_variable wake;
+    std::deque<std::shared_ptr<async_globber::shared_state>> jobs;
+    bool                zombie = false;
+
+    static std::shared_ptr<glob_worker> s_worker; // Only used by the main thread.
+};
+
+//------------------------------------------------------------------------------
+std::shared_ptr<glob_worker> glob_worker::s_worker;
+
+//------------------------------------------------------------------------------
+bool glob_worker::queue(const std::shared_ptr<async_globber::shared_state>& state)
+{
+    if (!s_worker)
+    {
+        auto worker = std::make_shared<glob_worker>();
+        try
+        {
+            std::thread(&proc, worker).detach();
+        }
+        catch (...)
+        {
+            return false;
+        }
+        s_worker = std::move(worker);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(s_worker->mutex);
+        s_worker->jobs.emplace_back(state);
+    }
+    s_worker->wake.notify_one();
+    return true;
+}
+
+//------------------------------------------------------------------------------
+void glob_worker::shutdown()
+{
+    if (!s_worker)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(s_worker->mutex);
+        s_worker->zombie = true;
+    }
+    s_worker->wake.notify_one();
+    s_worker.reset();
+}
+
+//------------------------------------------------------------------------------
+void glob_worker::proc(std::shared_ptr<glob_worker> worker)
+{
+    while (true)
+    {
+        std::shared_ptr<async_globber::shared_state> state;
+        {
+            std::unique_lock<std::mutex> lock(worker->mutex);
+            worker->wake.wait(lock, [&] () {
+                return worker->zombie || !worker->jobs.empty();
+            });
+            if (worker->zombie)
+                break;
+            state = std::move(worker->jobs.front());
+            worker->jobs.pop_front();
+        }
+
+        async_globber::proc(*state);
+    }
+
+    // Don't leave anyone waiting for enumerations that never ran.
+    for (const auto& state : worker->jobs)
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->done = true;
+        state->ready.notify_all();
+    }
+}
+
+//------------------------------------------------------------------------------
+void shutdown_async_globber()
+{
+    glob_worker::shutdown();
+}
+
+//------------------------------------------------------------------------------
+async_globber::async_globber(const char* pattern)
+: m_state(std::make_shared<shared_state>(pattern))
+{
+}
+
+//------------------------------------------------------------------------------
+async_globber::~async_globber()
+{
+    cancel();
+}
+
+//------------------------------------------------------------------------------
+void async_globber::files(bool state)       { assert(!m_started); m_state->files = state; }
+void async_globber::directories(bool state) { assert(!m_started); m_state->directories = state; }
+void async_globber::suffix_dirs(bool state) { assert(!m_started); m_state->dir_suffix = state; }
+void async_globber::hidden(bool state)      { assert(!m_started); m_state->hidden = state; }
+void async_globber::system(bool state)      { assert(!m_started); m_state->system = state; }
+void async_globber::dots(bool state)        { assert(!m_started); m_state->dots = state; }
+
+//------------------------------------------------------------------------------
+bool async_globber::start()
+{
+    assert(!m_started);
+    m_started = true;
+
+    if (!glob_worker::queue(m_state))
+    {
+        std::lock_guard<std::mutex> lock(m_state->mutex);
+        m_state->done = true;
+        return false;
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Moves everything found so far into out, waiting up to timeout milliseconds
+// for something to arrive.  Returns false once the enumeration has finished
+// and everything has been handed over; out may be empty even when it returns
+// true, if the timeout elapsed first.
+bool async_globber::next_batch(std::vector<entry>& out, uint32 timeout)
+{
+    out.clear();
+
+    std::unique_lock<std::mutex> lock(m_state->mutex);
+    if (m_state->queue.empty() && !m_state->done && timeout)
+    {
+        m_state->ready.wait_for(lock, std::chrono::milliseconds(timeout), [this] () {
+            return !m_state->queue.empty() || m_state->done;
+        });
+    }
+
+    out.swap(m_state->queue);
+    return !out.empty() || !m_state->done;
+}
+
+//------------------------------------------------------------------------------
+void async_globber::cancel()
+{
+    m_state->canceled = true;
+
+    std::lock_guard<std::mutex> lock(m_state->mutex);
+    m_state->done = true;
+    m_state->queue.clear();
+}
+
+//------------------------------------------------------------------------------
+bool async_globber::is_done() const
+{
+    std::lock_guard<std::mutex> lock(m_state->mutex);
+    return m_state->done && m_state->queue.empty();
+}
+
+//------------------------------------------------------------------------------
+void async_globber::proc(shared_state& state)
+{
+    if (state.canceled)
+        return;
+
+    // Constructing the globber calls FindFirstFile, which can block as well.
+    globber globber(state.pattern.c_str());
+    globber.files(state.files);
+    globber.directories(state.directories);
+    globber.suffix_dirs(state.dir_suffix);
+    globber.hidden(state.hidden);
+    globber.system(state.system);
+    if (state.dots)
+        globber.dots(true); // Else keep what the globber inferred from the pattern.
+
+    // Start with a small batch so the first results show up quickly, then
+    // grow the batches to reduce contention.
+    std::vector<entry> batch;
+    size_t batch_size = c_first_batch;
+    DWORD last_flush = GetTickCount();
+
+    // Canceling already finished the enumeration as far as the caller knows.
+    auto flush = [&] (bool done) {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        if (!state.canceled)
+        {
+            if (state.queue.empty())
+                state.queue.swap(batch);
+            else
+                for (auto& e : batch)
+                    state.queue.emplace_back(std::move(e));
+            state.done = done;
+            state.ready.notify_all();
+        }
+        batch.clear();
+        batch_size = min<size_t>(batch_size * 2, c_max_batch);
+        last_flush = GetTickCount();
+    };
+
+    while (!state.canceled)
+    {
+        entry e;
+        if (!globber.next(e.name, false, &e.info))
+            break;
+
+        batch.emplace_back(std::move(e));
+        if (batch.size() >= batch_size || GetTickCount() - last_flush >= c_flush_ms)
+            flush(false);
+    }
+
+    globber.close();
+    flush(true);
+}
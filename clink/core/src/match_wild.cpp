@@ -0,0 +1,203 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+#include "match_wild.h"
+
+#include <string.h>
+
+namespace path
+{
+
+//------------------------------------------------------------------------------
+// ASCII characters in file names, roughly from most to least common.  Anything
+// not listed is considered rarer than everything listed.
+static const char c_common_chars[] = "e.ts_arionlcdmphu-gbfyw0k12v3x";
+
+//------------------------------------------------------------------------------
+static bool is_literal(uint8 c)
+{
+    return c && c < 0x80 && c != '*' && c != '?' && !is_separator(c);
+}
+
+//------------------------------------------------------------------------------
+// Same as match_char_impl() for ASCII characters that aren't separators.
+static uint8 fold(uint8 c, int32 mode)
+{
+    if (mode > 0 && c >= 'A' && c <= 'Z')
+        c += 'a' - 'A';
+    if (mode > 1 && c == '-')
+        c = '_';
+    return c;
+}
+
+//------------------------------------------------------------------------------
+static uint32 get_rank(uint8 c)
+{
+    const char* common = strchr(c_common_chars, fold(c, 1));
+    return common ? uint32(common - c_common_chars) : uint32(sizeof(c_common_chars));
+}
+
+//------------------------------------------------------------------------------
+static bool has_non_ascii(const char* s, uint32 len)
+{
+    for (const char* end = s + len; s < end; ++s)
+        if (uint8(*s) >= 0x80)
+            return true;
+    return false;
+}
+
+//------------------------------------------------------------------------------
+// Returns false only if the file definitely doesn't match the literal.  Once a
+// non-ASCII character shows up, case folding and accent folding can make
+// anything match, and byte offsets no longer line up with characters.
+static bool maybe_equal(const char* literal, const char* file, uint32 len, int32 mode, bool forward)
+{
+    for (uint32 i = 0; i < len; ++i)
+    {
+        const uint32 j = forward ? i : len - i - 1;
+        if (uint8(file[j]) >= 0x80)
+            return true;
+        if (fold(literal[j], mode) != fold(file[j], mode))
+            return false;
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+static bool maybe_contains(const char* file, uint32 len, char c, int32 mode)
+{
+    char other = c;
+    if (mode > 0 && c >= 'a' && c <= 'z')
+        other = c - ('a' - 'A');
+    else if (mode > 0 && c >= 'A' && c <= 'Z')
+        other = c + ('a' - 'A');
+    else if (mode > 1 && (c == '-' || c == '_'))
+        other = (c == '-') ? '_' : '-';
+
+    if (memchr(file, c, len))
+        return true;
+    if (other != c && memchr(file, other, len))
+        return true;
+    return false;
+}
+
+
+
+//------------------------------------------------------------------------------
+wild_matcher::wild_matcher(const char* pattern, int32 len)
+{
+    set(pattern, len);
+}
+
+//------------------------------------------------------------------------------
+void wild_matcher::set(const char* pattern, int32 len)
+{
+    m_pattern = pattern ? pattern : "";
+    m_len = (len < 0) ? uint32(strlen(m_pattern)) : uint32(len);
+    m_prefix_len = 0;
+    m_suffix_len = 0;
+    m_rare = 0;
+
+    while (m_prefix_len < m_len && is_literal(m_pattern[m_prefix_len]))
+        ++m_prefix_len;
+
+    // Without a wildcard, the prefix already covers the first component, and
+    // anything past a separator is better left to the full matcher.
+    const char* wild = nullptr;
+    for (uint32 i = m_prefix_len; i < m_len; ++i)
+        if (m_pattern[i] == '*' || m_pattern[i] == '?')
+            wild = m_pattern + i;
+    if (!wild)
+        return;
+
+    const char* const end = m_pattern + m_len;
+    while (m_suffix_len < uint32(end - wild - 1) && is_literal(end[-int32(m_suffix_len) - 1]))
+        ++m_suffix_len;
+    if (m_suffix_len != uint32(end - wild - 1))
+        m_suffix_len = 0;
+
+    uint32 rare_rank = 0;
+    for (const char* p = m_pattern + m_prefix_len; p < end - m_suffix_len; ++p)
+    {
+        if (!is_literal(*p))
+            continue;
+        const uint32 rank = get_rank(*p);
+        if (!m_rare || rank > rare_rank)
+        {
+            m_rare = *p;
+            rare_rank = rank;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+bool wild_matcher::match(const char* file, int32 len, bool dot_prefix, star_matches_everything match_everything) const
+{
+    const uint32 file_len = (len < 0) ? uint32(strlen(file)) : uint32(len);
+
+    int32 mode;
+    switch (str_compare_scope::current())
+    {
+    case str_compare_scope::relaxed:    mode = 2; break;
+    case str_compare_scope::caseless:   mode = 1; break;
+    default:                            mode = 0; break;
+    }
+
+    if (!prefilter(file, file_len, dot_prefix, mode))
+        return false;
+
+    str_iter pattern_iter(m_pattern, m_len);
+    str_iter file_iter(file, file_len);
+    const bool fuzzy_accents = str_compare_scope::current_fuzzy_accents();
+    switch (mode)
+    {
+    case 2:
+        if (fuzzy_accents)  return match_wild_impl<char, 2, true>(pattern_iter, file_iter, dot_prefix, match_everything);
+        else                return match_wild_impl<char, 2, false>(pattern_iter, file_iter, dot_prefix, match_everything);
+    case 1:
+        if (fuzzy_accents)  return match_wild_impl<char, 1, true>(pattern_iter, file_iter, dot_prefix, match_everything);
+        else                return match_wild_impl<char, 1, false>(pattern_iter, file_iter, dot_prefix, match_everything);
+    default:
+        if (fuzzy_accents)  return match_wild_impl<char, 0, true>(pattern_iter, file_iter, dot_prefix, match_everything);
+        else                return match_wild_impl<char, 0, false>(pattern_iter, file_iter, dot_prefix, match_everything);
+    }
+}
+
+//------------------------------------------------------------------------------
+// Returns false if the file can't possibly match.  Each literal character in
+// the pattern consumes exactly one character from the file, regardless of the
+// wildcards around it, which is what makes these checks safe.
+bool wild_matcher::prefilter(const char* file, uint32 len, bool dot_prefix, int32 mode) const
+{
+    // match_wild_impl() skips leading periods when the pattern doesn't start
+    // with one.  If it doesn't skip them then the first literal can't match a
+    // period anyway, so skipping them unconditionally is safe.
+    if (m_prefix_len && dot_prefix && m_pattern[0] != '.')
+    {
+        while (len && *file == '.')
+        {
+            ++file;
+            --len;
+        }
+    }
+
+    if (len < m_prefix_len + m_suffix_len)
+        return false;
+    if (!maybe_equal(m_pattern, file, m_prefix_len, mode, true))
+        return false;
+    if (!maybe_equal(m_pattern + m_len - m_suffix_len, file + len - m_suffix_len, m_suffix_len, mode, false))
+        return false;
+
+    if (m_rare)
+    {
+        const char* const middle = file + m_prefix_len;
+        const uint32 middle_len = len - m_prefix_len - m_suffix_len;
+        if (!maybe_contains(middle, middle_len, m_rare, mode) && !has_non_ascii(file, len))
+            return false;
+    }
+
+    return true;
+}
+
+}; // namespace path
@@ -6,6 +6,7 @@
 #include "str.h"
 #include "str_tokeniser.h"
 #include "str_compare.h"
+#include "str_hash.h"
 #include "path.h"
 #include "os.h"
 
@@ -86,35 +87,93 @@ setting* setting_iter::next()
 
 
 //------------------------------------------------------------------------------
-static bool load_internal(FILE* in, std::function<void(const char* name, const char* value, const char* comment)> load_setting)
+// Identifies the content of a settings file, so that reload() can tell whether
+// the file needs to be parsed again.
+struct file_fingerprint
 {
-    dbg_ignore_scope(snapshot, "Settings");
+    bool            same_stat(const file_fingerprint& other) const;
+    bool            exists = false;
+    uint64          size = 0;
+    FILETIME        modified = {};
+    uint32          hash = 0;
+};
+
+//------------------------------------------------------------------------------
+bool file_fingerprint::same_stat(const file_fingerprint& other) const
+{
+    return (exists == other.exists &&
+            size == other.size &&
+            CompareFileTime(&modified, &other.modified) == 0);
+}
+
+//------------------------------------------------------------------------------
+static void stat_file(const char* file, file_fingerprint& out)
+{
+    out = file_fingerprint();
+    if (!file || !*file)
+        return;
+
+    wstr<288> wfile(file);
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExW(wfile.c_str(), GetFileExInfoStandard, &data))
+        return;
+    if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+        return;
+
+    out.exists = true;
+    out.size = (uint64(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+    out.modified = data.ftLastWriteTime;
+}
+
+//------------------------------------------------------------------------------
+// Buffers the file.  Returns false if the file can't be opened.  If print is
+// not null, it receives the file's fingerprint.
+static bool read_file(const char* file, str_base& buffer, file_fingerprint* print=nullptr)
+{
+    buffer.clear();
+    if (print)
+        stat_file(file, *print);
+
+    if (!file || !*file)
+        return false;
+
+    FILE* in = fopen(file, "rb");
+    if (in == nullptr)
+        return false;
 
-    // Buffer the file.
     fseek(in, 0, SEEK_END);
     int32 size = ftell(in);
     fseek(in, 0, SEEK_SET);
 
-    if (size == 0)
+    if (size > 0)
     {
-        fclose(in);
-        return false;
+        buffer.reserve(size);
+
+        char* data = buffer.data();
+        size = int32(fread(data, 1, size, in));
+        data[size] = '\0';
     }
+    fclose(in);
 
-    str<4096> buffer;
-    buffer.reserve(size);
+    if (print)
+        print->hash = str_hash(buffer.c_str());
+    return true;
+}
 
-    char* data = buffer.data();
-    fread(data, size, 1, in);
-    fclose(in);
-    data[size] = '\0';
+//------------------------------------------------------------------------------
+static bool load_internal(const char* data, std::function<void(const char* name, const char* value, const char* comment)> load_setting)
+{
+    dbg_ignore_scope(snapshot, "Settings");
+
+    if (!*data)
+        return false;
 
     // Check for `clink set` output format:
     // No blank lines, no # lines, no = signs.
     str<256> line;
     bool maybe_clink_set = true;
     {
-        str_tokeniser lines(buffer.c_str(), "\n\r");
+        str_tokeniser lines(data, "\n\r");
         while (lines.next(line))
         {
             const char* p = line.c_str();
@@ -129,7 +188,7 @@ static bool load_internal(FILE* in, std::function<void(const char* name, const c
     // Split at new lines.
     bool was_comment = false;
     str<> comment;
-    str_tokeniser lines(buffer.c_str(), "\n\r");
+    str_tokeniser lines(data, "\n\r");
     while (lines.next(line))
     {
         char* line_data = line.data();
@@ -300,27 +359,16 @@ static bool parse_ini(FILE* in, std::vector<settings::setting_name_value>& out)
 }
 
 //------------------------------------------------------------------------------
-// Mingw can't handle 'static' here, due to 'friend'.
-/*static*/ void load_custom_defaults(const char* file)
+static void load_custom_defaults(const char* data, loaded_settings_map& map)
 {
-    auto& map = get_custom_default_map();
     map.clear();
 
-    if (!file || !*file)
-        return;
-
-    FILE* in = fopen(file, "rb");
-    if (in == nullptr)
-        return;
-
-    load_internal(in, [&map](const char* name, const char* value, const char* comment)
+    load_internal(data, [&map](const char* name, const char* value, const char* comment)
     {
         loaded_setting custom_default;
         custom_default.value = value;
         map.emplace(name, std::move(custom_default));
     });
-
-    fclose(in);
 }
 
 
@@ -518,6 +566,60 @@ bool migrate_setting(const char* name, const char* value, std::vector<setting_na
 //------------------------------------------------------------------------------
 static bool save_internal(const char* file, bool migrating);
 
+//------------------------------------------------------------------------------
+struct cmp_string_caseless
+{
+    bool operator()(const std::string& a, const std::string& b) const
+    {
+        return stricmp(a.c_str(), b.c_str()) < 0;
+    }
+};
+
+// Names and values as they appear in the settings file.  Keyed caselessly,
+// like settings themselves.
+typedef std::map<std::string, loaded_setting, cmp_string_caseless> file_values_map;
+
+//------------------------------------------------------------------------------
+// Remembers what the last load saw, so that reload() can skip the work when
+// nothing changed, or apply only the settings that changed.
+struct reload_state
+{
+    bool                valid = false;
+    str_moveable        file;
+    str_moveable        default_file;
+    file_fingerprint    file_print;
+    file_fingerprint    default_print;
+    file_values_map     file_values;
+    uint32              change_count = 0;
+};
+
+static reload_state* g_reload_state = nullptr;
+
+static auto& get_reload_state()
+{
+    if (!g_reload_state)
+        g_reload_state = new reload_state;
+    return *g_reload_state;
+}
+
+//------------------------------------------------------------------------------
+// Returns false if the name was already added, since then the file can't be
+// applied incrementally.
+static bool add_file_value(file_values_map& values, const char* name, const char* value, const char* comment)
+{
+    loaded_setting loaded;
+    loaded.value = value;
+    loaded.comment = comment;
+    return values.emplace(name, std::move(loaded)).second;
+}
+
+//------------------------------------------------------------------------------
+static void invalidate_reload_state()
+{
+    if (g_reload_state)
+        g_reload_state->valid = false;
+}
+
 //------------------------------------------------------------------------------
 bool load(const char* file, const char* default_file)
 {
@@ -540,7 +642,12 @@ bool load(const char* file, const char* default_file)
             *g_last_default_file = default_file;
     }
 
-    load_custom_defaults(default_file);
+    invalidate_reload_state();
+
+    str<4096> buffer;
+    file_fingerprint default_print;
+    read_file(default_file, buffer, &default_print);
+    load_custom_defaults(buffer.c_str(), get_custom_default_map());
     get_loaded_map().clear();
 
     // Reset settings to default.
@@ -554,21 +661,23 @@ bool load(const char* file, const char* default_file)
     str<> old_file;
     bool migrating = false;
 
-    // Open the file.
-    FILE* in = fopen(file, "rb");
-    if (in == nullptr)
+    // Read the file.
+    file_fingerprint file_print;
+    if (!read_file(file, buffer, &file_print))
     {
         // If there's no (new name) settings file, try to migrate from the old
         // name settings file.
         path::get_directory(file, old_file);
         path::append(old_file, "settings");
-        in = fopen(old_file.c_str(), "rb");
-        if (in == nullptr)
-            return true;
-        migrating = true;
+        if (!read_file(old_file.c_str(), buffer))
+            buffer.clear();
+        else
+            migrating = true;
     }
 
-    load_internal(in, [migrating](const char* name, const char* value, const char* comment)
+    file_values_map values;
+    bool incremental = !migrating;
+    load_internal(buffer.c_str(), [migrating, &values, &incremental](const char* name, const char* value, const char* comment)
     {
         // Migrate old setting.
         if (migrating)
@@ -584,6 +693,9 @@ bool load(const char* file, const char* default_file)
 
         // Find the setting and set its value.
         set_setting(name, value, comment);
+
+        if (incremental)
+            incremental = add_file_value(values, name, value, comment);
     });
 
     // When migrating, ensure the new settings file is created so that the old
@@ -592,6 +704,158 @@ bool load(const char* file, const char* default_file)
     if (migrating)
         save_internal(file, migrating);
 
+    if (incremental)
+    {
+        auto& state = get_reload_state();
+        state.file = file;
+        state.default_file = default_file ? default_file : "";
+        state.file_print = file_print;
+        state.default_print = default_print;
+        state.file_values.swap(values);
+        state.change_count = setting::get_change_count();
+        state.valid = true;
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Like load(), except that when the files are unchanged since the last load it
+// does nothing, and when they changed it applies only the settings whose values
+// changed.  It falls back to a full load when settings were changed in memory
+// since the last load.  Returns true if any settings may have changed.
+bool reload(const char* file, const char* default_file)
+{
+    auto& state = get_reload_state();
+    if (!state.valid ||
+        !file ||
+        !state.file.equals(file) ||
+        !state.default_file.equals(default_file ? default_file : "") ||
+        state.change_count != setting::get_change_count())
+    {
+        load(file, default_file);
+        return true;
+    }
+
+    // Only read the files if their size or timestamp changed.
+    file_fingerprint file_print;
+    file_fingerprint default_print;
+    stat_file(file, file_print);
+    stat_file(default_file, default_print);
+
+    const bool file_touched = !file_print.same_stat(state.file_print);
+    const bool default_touched = !default_print.same_stat(state.default_print);
+    if (!file_touched && !default_touched)
+        return false;
+
+    str<4096> file_buffer;
+    str<4096> default_buffer;
+    if (file_touched && !read_file(file, file_buffer, &file_print))
+    {
+        // Let load() decide whether to migrate from the old settings file.
+        load(file, default_file);
+        return true;
+    }
+    if (default_touched)
+        read_file(default_file, default_buffer, &default_print);
+
+    // A file that was touched but whose content is the same needs no work.
+    const bool file_changed = (file_touched && file_print.hash != state.file_print.hash);
+    const bool default_changed = (default_touched && (default_print.exists != state.default_print.exists ||
+                                                      default_print.hash != state.default_print.hash));
+    if (!file_touched)
+        file_print = state.file_print;
+    if (!default_touched)
+        default_print = state.default_print;
+    state.file_print = file_print;
+    state.default_print = default_print;
+
+    if (!file_changed && !default_changed)
+        return false;
+
+    // Parse before applying anything, so it can still fall back to a full load.
+    file_values_map values;
+    if (file_changed)
+    {
+        bool incremental = true;
+        load_internal(file_buffer.c_str(), [&values, &incremental](const char* name, const char* value, const char* comment)
+        {
+            if (incremental)
+                incremental = add_file_value(values, name, value, comment);
+        });
+
+        if (!incremental)
+        {
+            load(file, default_file);
+            return true;
+        }
+    }
+    const file_values_map& new_values = file_changed ? values : state.file_values;
+
+    // Reset settings whose custom defaults changed, and then reapply their
+    // values from the settings file, if any.
+    if (default_changed)
+    {
+        loaded_settings_map defaults;
+        load_custom_defaults(default_buffer.c_str(), defaults);
+
+        std::vector<std::string> names;
+        auto& old_defaults = get_custom_default_map();
+        for (const auto& d : old_defaults)
+        {
+            const auto& iter = defaults.find(d.first);
+            if (iter == defaults.end() || iter->second.value != d.second.value)
+                names.emplace_back(d.first);
+        }
+        for (const auto& d : defaults)
+        {
+            if (old_defaults.find(d.first) == old_defaults.end())
+                names.emplace_back(d.first);
+        }
+
+        old_defaults.swap(defaults);
+
+        for (const auto& name : names)
+        {
+            setting* s = settings::find(name.c_str());
+            if (!s)
+                continue;
+            s->set();
+            const auto& iter = new_values.find(name);
+            if (iter != new_values.end())
+                s->set(iter->second.value.c_str());
+        }
+    }
+
+    // Apply settings that were removed, added, or changed in the settings
+    // file.  Clearing before setting makes the result the same as a full
+    // load, even when the new value fails to parse.
+    if (file_changed)
+    {
+        for (const auto& old : state.file_values)
+        {
+            if (values.find(old.first) == values.end())
+                clear_setting(old.first.c_str());
+        }
+
+        for (const auto& v : values)
+        {
+            const auto& old = state.file_values.find(v.first);
+            if (old != state.file_values.end())
+            {
+                if (old->first == v.first &&
+                    old->second.value == v.second.value &&
+                    old->second.comment == v.second.comment)
+                    continue;
+                clear_setting(old->first.c_str());
+            }
+            set_setting(v.first.c_str(), v.second.value.c_str(), v.second.comment.c_str());
+        }
+
+        state.file_values.swap(values);
+    }
+
+    state.change_count = setting::get_change_count();
     return true;
 }
 
@@ -773,9 +1037,13 @@ bool sandboxed_set_setting(const char* name, const char* value)
     rollback<loaded_settings_map*> rb_loaded(g_loaded_settings, &tmp_loaded_map);
 
     // Load settings.
-    return (load(file, default_file) &&
-            set_setting(name, value) &&
-            save(file));
+    const bool ok = (load(file, default_file) &&
+                     set_setting(name, value) &&
+                     save(file));
+
+    // The values are rolled back, so the next reload must be a full load.
+    invalidate_reload_state();
+    return ok;
 }
 
 //------------------------------------------------------------------------------
@@ -794,26 +1062,28 @@ bool sandboxed_overlay(const std::vector<setting_name_value>& overlay)
     rollback_settings_values rb_settings;
     rollback<loaded_settings_map*> rb_loaded(g_loaded_settings, &tmp_loaded_map);
 
-    if (!load(file, default_file))
-        return false;
-
-    for (const auto& o : overlay)
+    bool ok = load(file, default_file);
+    if (ok)
     {
-        switch (o.section)
+        for (const auto& o : overlay)
         {
-        case section::set:
-            set_setting(o.name.c_str(), o.value.c_str());
-            break;
-        case section::clear:
-            clear_setting(o.name.c_str());
-            break;
+            switch (o.section)
+            {
+            case section::set:
+                set_setting(o.name.c_str(), o.value.c_str());
+                break;
+            case section::clear:
+                clear_setting(o.name.c_str());
+                break;
+            }
         }
-    }
 
-    if (!save(file))
-        return false;
+        ok = save(file);
+    }
 
-    return true;
+    // The values are rolled back, so the next reload must be a full load.
+    invalidate_reload_state();
+    return ok;
 }
 
 //------------------------------------------------------------------------------
@@ -1253,6 +1523,9 @@ nope:
 
 
 
+//------------------------------------------------------------------------------
+uint32 setting::s_change_count = 0;
+
 //------------------------------------------------------------------------------
 setting::setting(
     const char* name,
@@ -1585,6 +1858,7 @@ bool setting_color::parse(const char* value, store<const char*>& out)
 //------------------------------------------------------------------------------
 void setting_color::set()
 {
+    ++s_change_count;
     const char* custom_default = get_custom_default();
     if (!custom_default || !parse(custom_default, m_store))
         parse(static_cast<const char*>(m_default), m_store);
@@ -4,6 +4,64 @@
 #include "pch.h"
 #include "str_iter.h"
 
+#if defined(ARCHITECTURE_x64) || defined(ARCHITECTURE_x86)
+#include <intrin.h>
+#include <emmintrin.h>
+#define USE_SSE2
+#endif
+
+//------------------------------------------------------------------------------
+// Returns how many bytes at the start of [s, end) are printable ASCII (0x20
+// through 0x7e).  If end is nullptr, the string is nul terminated.
+static uint32 printable_ascii_run(const char* s, const char* end)
+{
+    const char* p = s;
+
+#ifdef USE_SSE2
+    // Bytes >= 0x80 are negative as signed chars, so one signed compare
+    // catches both C0 controls and non-ASCII bytes.
+    const __m128i space = _mm_set1_epi8(0x20);
+    const __m128i del = _mm_set1_epi8(0x7f);
+    auto stops = [&] (__m128i chunk) {
+        const __m128i stop = _mm_or_si128(_mm_cmplt_epi8(chunk, space), _mm_cmpeq_epi8(chunk, del));
+        return uint32(_mm_movemask_epi8(stop));
+    };
+
+    unsigned long bit;
+    if (end)
+    {
+        while (end - p >= 16)
+        {
+            if (const uint32 mask = stops(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))))
+            {
+                _BitScanForward(&bit, mask);
+                return uint32(p - s) + bit;
+            }
+            p += 16;
+        }
+    }
+    else
+    {
+        // Aligned loads never cross a page boundary, so reading past the NUL
+        // is safe.  Ignore any bytes before s in the first block.
+        const uint32 skew = uint32(uintptr_t(p) & 15);
+        p -= skew;
+        uint32 mask = stops(_mm_load_si128(reinterpret_cast<const __m128i*>(p))) & (0xffff << skew);
+        while (!mask)
+        {
+            p += 16;
+            mask = stops(_mm_load_si128(reinterpret_cast<const __m128i*>(p)));
+        }
+        _BitScanForward(&bit, mask);
+        return uint32(p - s) + bit;
+    }
+#endif
+
+    while ((!end || p < end) && uint8(*p) >= 0x20 && uint8(*p) < 0x7f)
+        ++p;
+    return uint32(p - s);
+}
+
 //------------------------------------------------------------------------------
 template <>
 int32 str_iter_impl<char>::next()
@@ -11,6 +69,9 @@ int32 str_iter_impl<char>::next()
     if (!more())
         return 0;
 
+    if (uint8(*m_ptr) < 0x80)
+        return *m_ptr++;
+
     int32 ax = 0;
     int32 encode_length = 0;
     while (int32 c = uint8(*m_ptr++))
@@ -62,6 +123,26 @@ int32 str_iter_impl<wchar_t>::next()
     return 0;
 }
 
+//------------------------------------------------------------------------------
+// Advances past printable ASCII characters and returns how many were skipped.
+template <>
+uint32 str_iter_impl<char>::skip_printable_ascii()
+{
+    const uint32 n = printable_ascii_run(m_ptr, (m_ptr <= m_end) ? m_end : nullptr);
+    m_ptr += n;
+    return n;
+}
+
+//------------------------------------------------------------------------------
+template <>
+uint32 str_iter_impl<wchar_t>::skip_printable_ascii()
+{
+    const wchar_t* const start = m_ptr;
+    while (more() && *m_ptr >= 0x20 && *m_ptr < 0x7f)
+        ++m_ptr;
+    return uint32(m_ptr - start);
+}
+
 //------------------------------------------------------------------------------
 template <>
 uint32 str_iter_impl<char>::length() const
@@ -0,0 +1,132 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+#include "fs_fixture.h"
+
+#include <core/async_globber.h>
+#include <core/globber.h>
+#include <core/str.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+//------------------------------------------------------------------------------
+static void collect(async_globber& globber, std::vector<std::string>& out)
+{
+    out.clear();
+    std::vector<async_globber::entry> batch;
+    while (globber.next_batch(batch, 1000))
+        for (const auto& entry : batch)
+            out.emplace_back(entry.name.c_str());
+    std::sort(out.begin(), out.end());
+}
+
+//------------------------------------------------------------------------------
+static void collect(globber& globber, std::vector<std::string>& out)
+{
+    out.clear();
+    str<> file;
+    while (globber.next(file, false))
+        out.emplace_back(file.c_str());
+    std::sort(out.begin(), out.end());
+}
+
+
+
+//------------------------------------------------------------------------------
+TEST_CASE("Async globber")
+{
+    fs_fixture fs;
+
+    SECTION("Same as globber")
+    {
+        std::vector<std::string> expected;
+        globber sync("*");
+        collect(sync, expected);
+        REQUIRE(expected.size() == 6);
+
+        std::vector<std::string> actual;
+        async_globber async("*");
+        REQUIRE(async.start());
+        collect(async, actual);
+        REQUIRE(actual == expected);
+        REQUIRE(async.is_done());
+    }
+
+    SECTION("Flags")
+    {
+        std::vector<std::string> expected;
+        globber sync("dir1/*");
+        sync.directories(false);
+        collect(sync, expected);
+        REQUIRE(expected.size() == 3);
+
+        std::vector<std::string> actual;
+        async_globber async("dir1/*");
+        async.directories(false);
+        REQUIRE(async.start());
+        collect(async, actual);
+        REQUIRE(actual == expected);
+    }
+
+    SECTION("No match")
+    {
+        std::vector<std::string> actual;
+        async_globber async("nothing*");
+        REQUIRE(async.start());
+        collect(async, actual);
+        REQUIRE(actual.empty());
+    }
+
+    SECTION("Shared worker")
+    {
+        std::vector<std::string> expected;
+        globber sync("*");
+        collect(sync, expected);
+
+        // Enumerations queue up for the worker and each still gets all of
+        // its results, including after one is canceled.
+        async_globber first("*");
+        async_globber canceled("*");
+        async_globber last("*");
+        REQUIRE(first.start());
+        REQUIRE(canceled.start());
+        REQUIRE(last.start());
+        canceled.cancel();
+
+        std::vector<std::string> actual;
+        collect(last, actual);
+        REQUIRE(actual == expected);
+        collect(first, actual);
+        REQUIRE(actual == expected);
+
+        for (int32 i = 0; i < 10; ++i)
+        {
+            async_globber again("*");
+            REQUIRE(again.start());
+            collect(again, actual);
+            REQUIRE(actual == expected);
+        }
+    }
+
+    SECTION("Cancel")
+    {
+        async_globber async("*");
+        REQUIRE(async.start());
+        async.cancel();
+
+        // Nothing is handed over after canceling.
+        std::vector<std::string> actual;
+        collect(async, actual);
+        REQUIRE(actual.empty());
+        REQUIRE(async.is_done());
+
+        // Canceling before starting finishes immediately.
+        async_globber unstarted("*");
+        unstarted.cancel();
+        std::vector<async_globber::entry> batch;
+        REQUIRE(!unstarted.next_batch(batch, 0));
+    }
+}
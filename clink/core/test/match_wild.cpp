@@ -96,3 +96,102 @@ TEST_CASE("path::match_wild()")
         REQUIRE(!path::match_wild("*st*", "origin/master", false, path::star_matches_everything::at_end));
     }
 }
+
+//------------------------------------------------------------------------------
+TEST_CASE("path::wild_matcher")
+{
+    struct testcase
+    {
+        const char* pattern;
+        const char* file;
+        bool dot_prefix;
+        path::star_matches_everything match_everything;
+    };
+
+    static const testcase c_tests[] =
+    {
+        // Same as the path::match_wild() tests.
+        { "a*/ghi", "abc/def/ghi" },
+        { "*foo*", "food" },
+        { "*foo*", "qfood" },
+        { "*foo*", "qfoo" },
+        { "*foo*bar", "foobar" },
+        { "*foo*bar", "foodbar" },
+        { "*foo*bar", "foodbard" },
+        { "*foo*bar", "build.foobar" },
+        { "*foo*bar", "build.foo123bar" },
+        { "*foo*bar", "build.foo123bard" },
+        { "*foo*bar", "build.fo123bar" },
+        { "build*.log", "build.foo.bar.log" },
+        { "build*.log", "wmbuild.foo.bar.log" },
+        { "wmbuild*.log", "wmbuild.foo.bar.log" },
+        { "*r*p", "error.cpp" },
+        { "bu*", "build", true },
+        { "bu*", ".build", true },
+        { "bu*", ".build", false },
+        { "bu*", "..build", true },
+        { ".bu*", "build", true },
+        { ".bu*", ".build", true },
+        { ".bu*", "..build", true },
+        { "abc/bu*", "abc/build", true },
+        { "abc/bu*", ".build", true },
+        { "abc/bu*", "abc/.build", true },
+        { "abc/bu*", "abc/.build", false },
+        { "abc/def/ghi", "abc/def/ghi" },
+        { "a*/d?f/*i", "abc/def/ghi" },
+        { "abc/def", "abc/def/build" },
+        { "abc/def/?i*", "abc/def/build" },
+        { "abc/def/??i*", "abc/def/build" },
+        { "abc/def/ghi", "abc\\def\\ghi" },
+        { "a*/*/ghi", "abc/def/ghi" },
+        { "abc/*", "abc/def/ghi" },
+        { "abc/*", "abc/def" },
+        { "ori*", "origin/master", false, path::no },
+        { "ori*", "origin/master", false, path::yes },
+        { "ori*", "origin/master", false, path::at_end },
+        { "or*st*", "origin/master", false, path::yes },
+        { "or*st*", "origin/master", false, path::at_end },
+        { "*st*", "origin/master", false, path::yes },
+        // Cases that exercise the prefilter.
+        { "ABC*", "abcdef" },
+        { "*DEF", "abcdef" },
+        { "a-b*", "A_B.txt" },
+        { "*q*", "abc" },
+        { "*Q*", "abq" },
+        { "*_*", "a-b" },
+        { "a?", "a" },
+        { "ab*cd", "abc" },
+        { "e*", "\xc3\xa9t\xc3\xa9" },
+        { "*e", "caf\xc3\xa9" },
+        { "*z*", "\xc3\xa9z" },
+        { "", "" },
+        { "", "a" },
+    };
+
+    static const int32 c_modes[] = { str_compare_scope::exact, str_compare_scope::caseless, str_compare_scope::relaxed };
+
+    for (int32 mode : c_modes)
+    {
+        for (int32 fuzzy = 0; fuzzy < 2; ++fuzzy)
+        {
+            str_compare_scope _(mode, !!fuzzy);
+            for (const auto& t : c_tests)
+            {
+                const path::wild_matcher matcher(t.pattern);
+                const bool expected = path::match_wild(t.pattern, t.file, t.dot_prefix, t.match_everything);
+                const bool actual = matcher.match(t.file, -1, t.dot_prefix, t.match_everything);
+                REQUIRE(actual == expected, [&] () {
+                    printf("pattern '%s', file '%s', mode %d, fuzzy %d, expected %d", t.pattern, t.file, mode, fuzzy, expected);
+                });
+            }
+        }
+    }
+
+    SECTION("Length")
+    {
+        const path::wild_matcher matcher("*.txt");
+        REQUIRE(matcher.match("abc.txt\\", 7));
+        REQUIRE(!matcher.match("abc.txt\\"));
+        REQUIRE(!matcher.match("abc.txt", 6));
+    }
+}
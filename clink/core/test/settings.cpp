@@ -2,10 +2,13 @@
 // License: http://opensource.org/licenses/MIT
 
 #include "pch.h"
+#include "fs_fixture.h"
 
 #include <core/base.h>
 #include <core/settings.h>
 
+#include <vector>
+
 //------------------------------------------------------------------------------
 TEST_CASE("settings : basic")
 {
@@ -204,3 +207,106 @@ TEST_CASE("settings : color")
     test.get_descriptive(tmp);
     REQUIRE(tmp.equals("bright yellow"));
 }
+
+//------------------------------------------------------------------------------
+static void write_file(const char* name, const char* content)
+{
+    FILE* f = fopen(name, "wt");
+    REQUIRE(f != nullptr);
+    fputs(content, f);
+    fclose(f);
+}
+
+//------------------------------------------------------------------------------
+static void get_values(std::vector<str_moveable>& out)
+{
+    out.clear();
+    str<> value;
+    for (auto iter = settings::first(); auto* s = iter.next();)
+    {
+        s->get(value);
+        str_moveable tmp;
+        tmp << s->get_name() << "=" << value;
+        out.emplace_back(std::move(tmp));
+    }
+}
+
+//------------------------------------------------------------------------------
+TEST_CASE("settings : reload")
+{
+    fs_fixture fs;
+
+    setting_int one("test.one", "", 1);
+    setting_str two("test.two", "", "two");
+    setting_bool three("test.three", "", false);
+
+    write_file("clink_settings", "test.one = 10\ntest.two = twenty\n");
+    write_file("default_settings", "");
+    REQUIRE(settings::load("clink_settings", "default_settings"));
+    REQUIRE(one.get() == 10);
+    REQUIRE(strcmp(two.get(), "twenty") == 0);
+    REQUIRE(!three.get());
+
+    // Reloading after a reload must match a full load.
+    auto require_same_as_load = [] () {
+        std::vector<str_moveable> reloaded;
+        std::vector<str_moveable> loaded;
+        get_values(reloaded);
+        settings::load("clink_settings", "default_settings");
+        get_values(loaded);
+        REQUIRE(reloaded.size() == loaded.size());
+        for (size_t i = 0; i < loaded.size(); ++i)
+        {
+            REQUIRE(reloaded[i].equals(loaded[i].c_str()), [&] () {
+                printf("reloaded '%s'\nloaded   '%s'\n", reloaded[i].c_str(), loaded[i].c_str());
+            });
+        }
+    };
+
+    SECTION("Unchanged")
+    {
+        REQUIRE(!settings::reload("clink_settings", "default_settings"));
+        write_file("clink_settings", "test.one = 10\ntest.two = twenty\n");
+        REQUIRE(!settings::reload("clink_settings", "default_settings"));
+        REQUIRE(one.get() == 10);
+    }
+
+    SECTION("Changed")
+    {
+        write_file("clink_settings", "test.one = 100\ntest.three = true\ntest.unknown = abc\n");
+        REQUIRE(settings::reload("clink_settings", "default_settings"));
+        REQUIRE(one.get() == 100);
+        REQUIRE(strcmp(two.get(), "two") == 0);
+        REQUIRE(three.get());
+        require_same_as_load();
+
+        write_file("clink_settings", "test.one = bogus\n");
+        REQUIRE(settings::reload("clink_settings", "default_settings"));
+        REQUIRE(one.get() == 1);
+        require_same_as_load();
+    }
+
+    SECTION("Custom defaults")
+    {
+        write_file("default_settings", "test.one = 5\ntest.two = custom\ntest.three = true\n");
+        REQUIRE(settings::reload("clink_settings", "default_settings"));
+        REQUIRE(one.get() == 10);
+        REQUIRE(strcmp(two.get(), "twenty") == 0);
+        REQUIRE(three.get());
+        require_same_as_load();
+
+        write_file("clink_settings", "test.two = twenty\n");
+        REQUIRE(settings::reload("clink_settings", "default_settings"));
+        REQUIRE(one.get() == 5);
+        require_same_as_load();
+    }
+
+    SECTION("Changed in memory")
+    {
+        REQUIRE(one.set("7"));
+        REQUIRE(settings::reload("clink_settings", "default_settings"));
+        REQUIRE(one.get() == 10);
+    }
+
+    settings::load(nullptr);
+}
@@ -56,6 +56,34 @@ TEST_CASE("String iterator (str_iter)")
         new (&iter) str_iter("\xc2\x9b", 1);
         REQUIRE(iter.next() == 0);
     }
+
+    SECTION("Skip printable ASCII")
+    {
+        // Long enough for the vectorized path, at every alignment.
+        static const char c_stops[] = { '\0', '\x1b', '\x7f', '\xc2' };
+        char buffer[16 + 64];
+        for (int32 offset = 0; offset < 16; ++offset)
+        {
+            char* const s = buffer + offset;
+            for (char stop : c_stops)
+            {
+                for (int32 at = 0; at < 40; ++at)
+                {
+                    memset(s, 'a', 48);
+                    s[at] = stop;
+                    s[48] = '\0';
+
+                    str_iter iter(s);
+                    REQUIRE(iter.skip_printable_ascii() == uint32(at));
+                    REQUIRE(iter.get_pointer() == s + at);
+
+                    new (&iter) str_iter(s, at / 2);
+                    REQUIRE(iter.skip_printable_ascii() == uint32(at / 2));
+                    REQUIRE(!iter.more());
+                }
+            }
+        }
+    }
 }
 
 //------------------------------------------------------------------------------
@@ -0,0 +1,88 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#pragma once
+
+#include "history_db.h"
+
+#include <core/str.h>
+#include <core/str_map.h>
+#include <core/singleton.h>
+
+#include <deque>
+#include <memory>
+#include <set>
+#include <vector>
+
+class trigram_index;
+class dir_lock;
+
+//------------------------------------------------------------------------------
+// Persistent directory history, ranked by frecency.
+//
+// Each visit adds an exponentially decayed weight to its directory, so a
+// directory ranks higher the more often and the more recently it's visited.
+// The rank is kept in the log domain relative to a fixed epoch, so ranks don't
+// change as time passes, and applying the same visits in any order yields the
+// same ranks.  That lets every session append its visits to a shared file
+// (locked the same way as the history banks) and replay the other sessions'
+// visits incrementally.
+class dir_history_db : public no_copy
+{
+public:
+    struct entry
+    {
+        const char*     dir;
+        uint32          visits;
+        uint32          last_visit;         // Seconds since 1970.
+        double          score;              // Decayed visits as of the query time.
+    };
+
+                        dir_history_db(const char* path);
+                        ~dir_history_db();
+    bool                load();
+    bool                add(const char* dir, uint32 time=0);
+    bool                remove(const char* dir);
+    bool                compact();
+    uint32              size() const { return uint32(m_by_rank.size()); }
+    void                find_top(uint32 max_count, std::vector<entry>& out, const char* filter=nullptr, bool prefix=false, uint32 now=0) const;
+
+private:
+    struct dir_entry
+    {
+        str_moveable    dir;
+        uint32          visits = 0;
+        uint32          last_visit = 0;
+        double          rank;
+        bool            live = false;
+    };
+
+    typedef std::set<std::pair<double, uint32>> rank_set;
+
+    void                reset();
+    bool                read_records(dir_lock& lock);
+    void                apply_record(char* line);
+    bool                append_record(dir_lock& lock, const char* record);
+    void                rewrite(dir_lock& lock);
+    uint32              get_entry(const char* dir);
+    void                set_rank(uint32 index, double rank);
+    void                kill(uint32 index);
+    void                make_entry(uint32 index, uint32 now, entry& out) const;
+    const trigram_index& get_trigrams() const;
+
+    void*               m_handle = nullptr;
+    concurrency_tag     m_ctag;
+    uint32              m_loaded_size = 0;  // Bytes of the file that have been applied.
+    uint32              m_records = 0;      // Records applied since the last rewrite.
+    std::deque<dir_entry> m_entries;    // Stable addresses; m_by_name refers to their names.
+    str_map_caseless<uint32>::type m_by_name;
+    rank_set            m_by_rank;          // Live entries, ascending rank.
+    mutable std::unique_ptr<trigram_index> m_trigrams; // Built on demand.
+};
+
+//------------------------------------------------------------------------------
+class dir_history_database : public dir_history_db, public singleton<dir_history_database>
+{
+public:
+    dir_history_database(const char* path);
+};
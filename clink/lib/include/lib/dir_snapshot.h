@@ -0,0 +1,113 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <core/globber.h>
+#include <core/str.h>
+#include <core/str_map.h>
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+//------------------------------------------------------------------------------
+// The files in one directory, as of one FindFirstFile sweep.  Immutable once
+// built, so it can be shared across threads.
+class dir_snapshot : public no_copy
+{
+public:
+    struct file
+    {
+        str_moveable        name;       // No trailing path separator.
+        globber::extrainfo  info;
+    };
+
+                            dir_snapshot(const char* dir, std::vector<file>&& files);
+    const char*             get_dir() const { return m_dir.c_str(); }
+    const std::vector<file>& get_files() const { return m_files; }
+    const file*             find(const char* name) const;
+
+private:
+    str_moveable            m_dir;
+    std::vector<file>       m_files;
+    str_map_caseless<uint32>::type m_by_name;
+};
+
+//------------------------------------------------------------------------------
+// Tells whether a directory may have changed since it was swept.  Uses a
+// change notification on fixed drives and RAM disks; elsewhere (or once the
+// notification is released) it compares the directory's last write time every
+// time it's asked.  Unless expires is false, it gives up after a maximum age, so
+// that change notification handles don't stay open indefinitely.  Owners that
+// don't expire must release the notification themselves.
+//
+// Create it before enumerating, so changes made during the enumeration are
+// caught as well.
+class dir_watch : public no_copy
+{
+public:
+                            dir_watch(const char* dir, bool expires=true);
+                            ~dir_watch();
+    const char*             get_dir() const { return m_dir.c_str(); }
+    bool                    is_stale();
+    bool                    has_notification() const { return m_change != nullptr; }
+    bool                    release_notification();
+
+private:
+    void                    read_last_write_time();
+    str_moveable            m_dir;
+    HANDLE                  m_change = nullptr;
+    FILETIME                m_modified = {};
+    DWORD                   m_armed;
+    const bool              m_expires;
+    bool                    m_trusted = false;  // Whether m_modified can be compared.
+};
+
+//------------------------------------------------------------------------------
+// Process-wide cache of directory snapshots, keyed by normalized full path.
+// File completion, match coloring, the recognizer, and scripts enumerate the
+// same directories over and over; this lets them share one sweep until the
+// directory changes.  Thread safe.
+class dir_snapshot_cache : public no_copy
+{
+public:
+    enum lookup_result { lookup_unknown, lookup_missing, lookup_found };
+
+    struct stats
+    {
+        uint32              dirs;
+        uint32              files;
+        uint32              hits;
+        uint32              misses;
+        uint32              sweeps;
+        uint32              invalidations;
+    };
+
+    static dir_snapshot_cache& get();
+    static bool             normalize(const char* dir, str_base& out);
+
+    std::shared_ptr<const dir_snapshot> find(const char* dir, bool sweep=false);
+    lookup_result           lookup(const char* path, dir_snapshot::file* out=nullptr, bool sweep=false);
+    void                    add(std::unique_ptr<dir_watch>&& watch, std::vector<dir_snapshot::file>&& files);
+    void                    clear();
+    void                    release_notifications();
+    void                    get_stats(stats& out) const;
+
+private:
+    struct slot
+    {
+        std::unique_ptr<dir_watch> watch;
+        std::shared_ptr<const dir_snapshot> snapshot;
+        DWORD               used;
+    };
+
+    std::shared_ptr<const dir_snapshot> find_fresh(const char* dir);
+    void                    insert(std::unique_ptr<dir_watch>&& watch, const std::shared_ptr<const dir_snapshot>& snapshot);
+    void                    expire();
+    void                    evict();
+
+    mutable std::mutex      m_mutex;
+    str_map_caseless<slot>::type m_slots;   // Keys point into the snapshots' dirs.
+    stats                   m_stats = {};
+};
@@ -2,6 +2,7 @@
 
 #include <core/base.h>
 #include <core/str.h>
+#include <functional>
 #include <vector>
 
 // Define USE_SUGGESTION_HINT_INLINE to show "[Right]=Insert Suggestion" (with a hyperlink)
@@ -40,6 +41,17 @@ SHORT calc_max_y_scroll_pos(SHORT y);
 void clear_comment_row();
 void defer_clear_lines(uint32 prompt_lines, bool transient);
 
+// Lays out new_buffer from scratch and again by reusing a layout of old_buffer,
+// and describes the first difference in mismatch.  change() runs in between,
+// to move the cursor or change the selection or faces.  When the old layout
+// has rows scroll_top through scroll_bottom, they get scroll markers first.
+// For tests.
+bool compare_incremental_parse(uint32 width, uint32 prompt_botlin, uint32 col,
+                               const char* old_buffer, const char* new_buffer,
+                               const std::function<void()>& change,
+                               uint32 scroll_top, uint32 scroll_bottom,
+                               uint32& reused, str_base& mismatch);
+
 extern bool g_display_manager_no_comment_row;
 
 //------------------------------------------------------------------------------
@@ -66,6 +78,12 @@ struct prompt_problem_details
 };
 int32 prompt_contains_problem_codes(const char* prompt, std::vector<prompt_problem_details>* out=nullptr);
 
+//------------------------------------------------------------------------------
+// Same as ecma48_processor(), but remembers the output for recently seen
+// prompts.  Appends to out.
+enum class ecma48_processor_flags;
+void bracket_prompt(const char* prompt, str_base& out, ecma48_processor_flags flags);
+
 //------------------------------------------------------------------------------
 #define FACE_INVALID        ((char)1)
 #define FACE_SPACE          ' '
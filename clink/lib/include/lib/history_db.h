@@ -3,10 +3,18 @@
 
 #pragma once
 
+#include "history_prefix_index.h"
+
 #include <core/str_iter.h>
 #include <core/singleton.h>
 
+#include <memory>
 #include <vector>
+#include <unordered_map>
+
+class read_lock;
+class write_lock;
+struct compact_task;
 
 //------------------------------------------------------------------------------
 class concurrency_tag
@@ -42,6 +50,7 @@ struct bank_handles
     explicit        operator bool () const;
     void*           m_handle_lines = nullptr;
     void*           m_handle_removals = nullptr;
+    void*           m_handle_sidecar = nullptr;     // Only for bank_master.
 };
 
 //------------------------------------------------------------------------------
@@ -124,6 +133,7 @@ public:
     bool                        remove(line_id id) { return remove_internal(id, true); }
     bool                        remove(int32 rl_history_index, const char* line);
     line_id                     find(const char* line) const;
+    const char*                 find_suggestion(const char* line, bool match_prev_cmd);
     template <int32 S> iter     read_lines(char (&buffer)[S]);
     iter                        read_lines(char* buffer, uint32 buffer_size);
 
@@ -139,6 +149,12 @@ private:
     bool                        is_valid() const;
     void                        get_file_path(str_base& out, bool session) const;
     void                        load_internal();
+    uint32                      scan_bank(uint32 bank_index, bool mapped) const;
+    bool                        reload_internal();
+    bool                        is_rl_history_loaded() const;
+    void                        remove_rl_entry(int32 rl_history_index);
+    bool                        compact_internal(bool force, bool uniq, int32 limit, bool background);
+    bool                        finish_compact(bool wait);
     void                        reap();
     template <typename T> void  for_each_bank(T&& callback);
     template <typename T> void  for_each_bank(T&& callback) const;
@@ -146,6 +162,13 @@ private:
     bank_t                      get_active_bank() const;
     bank_handles                get_bank(uint32 index) const;
     bool                        remove_internal(line_id id, bool guard_ctag);
+    template <class L, class T> void find_in_bank(uint32 bank_index, L& lock, const char* line, T&& callback) const;
+    bool                        is_index_usable(uint32 bank_index, const read_lock& lock) const;
+    void                        index_line(uint32 bank_index, line_id id, const char* line, uint32 length);
+    void                        unindex_line(line_id id, uint32 hash);
+    void                        clear_index();
+    bool                        open_sidecar();
+    void                        update_sidecar(write_lock& lock);
     void                        make_open_error(str_base* error_message, bank_t bank) const;
     void*                       m_alive_file = nullptr;
     str_moveable                m_path;
@@ -158,8 +181,36 @@ private:
     size_t                      m_master_len;
     size_t                      m_master_deleted_count;
 
+    // Maps the hash of each loaded line to its line_id, so that duplicate
+    // detection only needs to touch the file to confirm candidates.  Only
+    // lines up to m_indexed_size in each bank are covered; anything appended
+    // beyond that (e.g. by other sessions) is found by scanning the tail.
+    std::unordered_multimap<uint32, line_id> m_line_hashes;
+    uint32                      m_indexed_size[bank_count];
+    bool                        m_index_valid = false;
+
+    // Remembers how much of each bank (and of the session's removals file)
+    // Readline's history list reflects, so that reloading only needs to read
+    // what was appended since.  A different master ctag, a bank that shrank, or
+    // a history list that was changed behind history_db's back forces a full
+    // load instead.
+    uint32                      m_loaded_size[bank_count];
+    uint32                      m_removals_loaded_size = 0;
+    unsigned __int64            m_master_write_time = 0;
+    const void*                 m_rl_last = nullptr; // Last HIST_ENTRY loaded.
+    bool                        m_loaded = false;
+
+    // Indexes Readline's history list by prefix, for history suggestions.
+    history_prefix_index        m_prefix_index;
+
     size_t                      m_min_compact_threshold = 200;
 
+    // Compacting the master bank happens in the background when it's started
+    // by load_rl_history(), so that it never delays the prompt.  The hook lets
+    // tests change the bank while it's being compacted.
+    std::unique_ptr<compact_task> m_compact;
+    void                        (*m_before_compact_write)() = nullptr;
+
     bool                        m_use_master_bank = false;
     bool                        m_diagnostic = false;
 };
@@ -0,0 +1,62 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <vector>
+
+//------------------------------------------------------------------------------
+// Indexes Readline's in-memory history list by line prefix, so that history
+// suggestions can find the most recent line starting with some text without
+// scanning the list.  Keys are case folded and accent normalized, and matches
+// are confirmed against the actual history line using the current
+// str_compare_scope.
+//
+// Entries that Readline appends after the index is built are picked up
+// incrementally the next time the index is queried.  Entries have stable ids
+// that increase with their position in the history list, so removing an
+// entry doesn't renumber the others; removed entries are only dropped once
+// there are many of them.
+class history_prefix_index
+{
+public:
+                            history_prefix_index() = default;
+    void                    clear();
+    void                    rebuild();
+    void                    remove(int32 rl_history_index);
+    const char*             find(const char* line, bool match_prev_cmd);
+    uint32                  size() const { return uint32(m_entries.size()); }
+
+private:
+    struct entry
+    {
+        uint32              key_offset;
+        uint32              key_len;
+        int32               id;             // Stable id; see index_of().
+    };
+
+    void                    sync();
+    void                    compact();
+    void                    insert(int32 id, const char* line);
+    void                    update_blocks(uint32 from, uint32 to);
+    uint32                  fold_key(const char* line);
+    int32                   compare_key(const entry& e, const char* key, uint32 len) const;
+    uint32                  find_most_recent(uint32 lo, uint32 hi) const;
+    const char*             find_by_recency(const char* line, uint32 lo, uint32 hi, uint32 tried) const;
+    bool                    is_suggestion(int32 index, const char* line, bool match_prev_cmd) const;
+    bool                    is_live(int32 id) const { return m_live[id]; }
+    int32                   index_of(int32 id) const;
+    int32                   id_of(int32 index) const;
+    void                    reset_ids(int32 count);
+    void                    add_id();
+    void                    remove_id(int32 id);
+
+    std::vector<entry>      m_entries;      // Sorted by key, then by id.
+    std::vector<uint32>     m_block_best;   // Most recent live entry in each block.
+    std::vector<char>       m_keys;         // Storage for the folded keys.
+    std::vector<bool>       m_live;         // Whether each id is still in the history list.
+    std::vector<int32>      m_live_tree;    // Fenwick tree counting the live ids.
+    uint32                  m_removed = 0;  // Number of entries for removed ids.
+    const void*             m_last = nullptr; // Last HIST_ENTRY that was indexed.
+    int32                   m_count = 0;    // Number of history entries indexed.
+};
@@ -15,3 +15,5 @@ const char* get_indicator_color(enum_indicator_no colored_filetype);
 const char* get_completion_prefix_color();
 bool is_colored(enum_indicator_no colored_filetype);
 void make_color(const char* seq, str_base& out);
+void clear_match_color_stat_cache();
+void cache_match_color_stat(const char* full, uint32 attr, bool symlink);
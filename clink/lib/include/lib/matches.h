@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include <core/match_wild.h>
 #include <core/object.h>
 #include <core/str_iter.h>
 
@@ -153,7 +154,7 @@ private:
     bool                    try_substring();
     const matches&          m_matches;
     char*                   m_expanded_pattern;
-    str_iter                m_pattern;
+    path::wild_matcher      m_pattern;
     bool                    m_has_pattern = false;
     bool                    m_can_try_substring = false;
     uint32                  m_index = 0;
@@ -8,8 +8,8 @@
 //------------------------------------------------------------------------------
 struct match_extra
 {
-    unsigned short  display_offset;
-    unsigned short  description_offset;
+    uint32          display_offset;
+    uint32          description_offset;
     match_type      type;
     char            append_char;
     uint8           flags;
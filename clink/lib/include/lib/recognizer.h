@@ -13,4 +13,5 @@ HANDLE get_recognizer_event();
 bool check_recognizer_refresh();
 
 extern "C" void end_recognizer();
+void release_recognizer_notifications();
 void shutdown_recognizer();
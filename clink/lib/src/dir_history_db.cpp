@@ -0,0 +1,575 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+#include "dir_history_db.h"
+#include "trigram_index.h"
+
+#include <core/base.h>
+#include <core/str.h>
+#include <core/str_compare.h>
+#include <core/settings.h>
+#include <core/log.h>
+#include <assert.h>
+
+#include <algorithm>
+#include <math.h>
+#include <time.h>
+
+//------------------------------------------------------------------------------
+// File format:  the first line is a concurrency tag, which changes whenever the
+// file is rewritten.  Each following line is a record:
+//
+//      v <tab> time <tab> dir                      A visit.
+//      r <tab> dir                                 Removes a directory.
+//      s <tab> rank <tab> visits <tab> last <tab> dir  Summary of past visits.
+//
+// Sessions only ever append records, except that compacting rewrites the file
+// with one summary record per directory (and a new concurrency tag).
+
+//------------------------------------------------------------------------------
+static const double c_half_life = 7.0 * 24 * 60 * 60;  // Seconds.
+static const double c_decay = 0.69314718055994531 / c_half_life; // ln(2) / half life.
+static const double c_no_rank = -HUGE_VAL;
+static const uint32 c_max_dirs = 5000;                  // Kept when compacting.
+static const uint32 c_compact_slack = 256;
+static const uint32 c_max_ctag = 128;
+
+//------------------------------------------------------------------------------
+// Adds two weights that are in the log domain:  log(exp(a) + exp(b)).
+static double log_add(double a, double b)
+{
+    if (a == c_no_rank)
+        return b;
+    if (b == c_no_rank)
+        return a;
+    if (a < b)
+        std::swap(a, b);
+    return a + log1p(exp(b - a));
+}
+
+//------------------------------------------------------------------------------
+extern setting_bool g_fuzzy_accent;
+
+//------------------------------------------------------------------------------
+// Whether haystack contains needle, comparing the way str_compare() does in
+// caseless mode, the same as filtering in popup lists.
+static bool contains_caseless(const char* haystack, const char* needle)
+{
+    if (!*needle)
+        return true;
+
+    str_compare_scope _(str_compare_scope::caseless, g_fuzzy_accent.get());
+    const int32 needle_len = int32(strlen(needle));
+    str_iter sift(haystack);
+    while (sift.more())
+    {
+        const int32 cmp = str_compare(needle, sift.get_pointer());
+        if (cmp == -1 || cmp == needle_len)
+            return true;
+        sift.next();
+    }
+    return false;
+}
+
+//------------------------------------------------------------------------------
+static void* open_file(const char* path)
+{
+    wstr<> wpath(path);
+
+    DWORD share_flags = FILE_SHARE_READ|FILE_SHARE_WRITE;
+    void* handle = CreateFileW(wpath.c_str(), GENERIC_READ|GENERIC_WRITE, share_flags,
+        nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+    return (handle == INVALID_HANDLE_VALUE) ? nullptr : handle;
+}
+
+//------------------------------------------------------------------------------
+static uint32 read_bytes(void* handle, uint32 offset, char* out, uint32 length)
+{
+    DWORD bytes_read = 0;
+    if (SetFilePointer(handle, LONG(offset), nullptr, FILE_BEGIN) == INVALID_SET_FILE_POINTER ||
+        !ReadFile(handle, out, length, &bytes_read, nullptr))
+        return 0;
+    return bytes_read;
+}
+
+
+
+//------------------------------------------------------------------------------
+// Same locking model as the history banks:  shared while reading, exclusive
+// while writing, and the whole file at once.
+class dir_lock : public no_copy
+{
+public:
+                    dir_lock(void* handle, bool exclusive);
+                    ~dir_lock();
+    void*           get_handle() const { return m_handle; }
+
+private:
+    void*           m_handle;
+};
+
+//------------------------------------------------------------------------------
+dir_lock::dir_lock(void* handle, bool exclusive)
+: m_handle(handle)
+{
+    OVERLAPPED overlapped = {};
+    int32 flags = exclusive ? LOCKFILE_EXCLUSIVE_LOCK : 0;
+    LockFileEx(m_handle, flags, 0, ~0u, ~0u, &overlapped);
+}
+
+//------------------------------------------------------------------------------
+dir_lock::~dir_lock()
+{
+    OVERLAPPED overlapped = {};
+    UnlockFileEx(m_handle, 0, ~0u, ~0u, &overlapped);
+}
+
+
+
+//------------------------------------------------------------------------------
+dir_history_db::dir_history_db(const char* path)
+{
+    m_handle = open_file(path);
+    if (!m_handle)
+        LOG("can't open directory history '%s'; error %u", path, GetLastError());
+}
+
+//------------------------------------------------------------------------------
+dir_history_db::~dir_history_db()
+{
+    if (m_handle)
+        CloseHandle(m_handle);
+}
+
+//------------------------------------------------------------------------------
+void dir_history_db::reset()
+{
+    m_ctag.clear();
+    m_loaded_size = 0;
+    m_records = 0;
+    m_entries.clear();
+    m_by_name.clear();
+    m_by_rank.clear();
+    m_trigrams.reset();
+}
+
+//------------------------------------------------------------------------------
+// Applies whatever other sessions have appended since the last load.
+bool dir_history_db::load()
+{
+    if (!m_handle)
+        return false;
+
+    dir_lock lock(m_handle, false);
+    read_records(lock);
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Returns false if the file has no valid concurrency tag (e.g. it's new), in
+// which case it needs to be rewritten before appending to it.
+bool dir_history_db::read_records(dir_lock& lock)
+{
+    const DWORD size = GetFileSize(lock.get_handle(), nullptr);
+    if (size == INVALID_FILE_SIZE)
+        return false;
+
+    // Read the concurrency tag.
+    char tag[c_max_ctag + 1];
+    const uint32 tag_read = read_bytes(lock.get_handle(), 0, tag, min<uint32>(size, c_max_ctag));
+    tag[tag_read] = '\0';
+    char* eol = strchr(tag, '\n');
+    if (!eol || strncmp(tag, "|CTAG_", 6) != 0)
+    {
+        reset();
+        return false;
+    }
+    *eol = '\0';
+    const uint32 tag_size = uint32(eol + 1 - tag);
+
+    // If the file was rewritten, start over.
+    if (m_ctag.empty() || strcmp(tag, m_ctag.get()) != 0 || size < m_loaded_size)
+    {
+        reset();
+        m_ctag.set(tag);
+        m_loaded_size = tag_size;
+    }
+
+    // Apply the new records.  A partial record at the end (from an append in
+    // progress) is left for next time.
+    if (size > m_loaded_size)
+    {
+        const uint32 length = size - m_loaded_size;
+        std::unique_ptr<char[]> buffer(new char[length + 1]);
+        const uint32 got = read_bytes(lock.get_handle(), m_loaded_size, buffer.get(), length);
+        buffer[got] = '\0';
+
+        char* line = buffer.get();
+        for (char* end; (end = strchr(line, '\n')) != nullptr; line = end + 1)
+        {
+            *end = '\0';
+            apply_record(line);
+        }
+        m_loaded_size += uint32(line - buffer.get());
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+void dir_history_db::apply_record(char* line)
+{
+    char* fields[5] = {};
+    uint32 count = 0;
+    for (char* p = line; count < sizeof_array(fields); ++count)
+    {
+        fields[count] = p;
+        p = strchr(p, '\t');
+        if (!p)
+        {
+            ++count;
+            break;
+        }
+        *(p++) = '\0';
+    }
+
+    // The directory is always the last field.
+    const char* dir = fields[count - 1];
+    if (!*dir || count < 2)
+        return;
+
+    ++m_records;
+    switch (fields[0][0])
+    {
+    case 'v':
+        if (count == 3)
+        {
+            const uint32 time = strtoul(fields[1], nullptr, 10);
+            const uint32 index = get_entry(dir);
+            dir_entry& e = m_entries[index];
+            e.visits++;
+            e.last_visit = max(e.last_visit, time);
+            set_rank(index, log_add(e.rank, c_decay * time));
+        }
+        break;
+    case 's':
+        if (count == 5)
+        {
+            const double rank = strtod(fields[1], nullptr);
+            const uint32 index = get_entry(dir);
+            dir_entry& e = m_entries[index];
+            e.visits += strtoul(fields[2], nullptr, 10);
+            e.last_visit = max<uint32>(e.last_visit, strtoul(fields[3], nullptr, 10));
+            set_rank(index, log_add(e.rank, rank));
+        }
+        break;
+    case 'r':
+        if (count == 2)
+        {
+            const auto it = m_by_name.find(dir);
+            if (it != m_by_name.end())
+                kill(it->second);
+        }
+        break;
+    }
+}
+
+//------------------------------------------------------------------------------
+bool dir_history_db::append_record(dir_lock& lock, const char* record)
+{
+    str<> tmp;
+    tmp.format("%s\n", record);
+
+    DWORD written = 0;
+    if (SetFilePointer(lock.get_handle(), 0, nullptr, FILE_END) == INVALID_SET_FILE_POINTER ||
+        !WriteFile(lock.get_handle(), tmp.c_str(), tmp.length(), &written, nullptr) ||
+        written != tmp.length())
+        return false;
+
+    // Apply it the same way as records from other sessions.
+    tmp.truncate(tmp.length() - 1);
+    apply_record(tmp.data());
+    m_loaded_size += written;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Rewrites the file with a summary record for each of the highest ranked
+// directories, and a new concurrency tag so other sessions reload it.
+void dir_history_db::rewrite(dir_lock& lock)
+{
+    concurrency_tag ctag;
+    ctag.generate_new_tag();
+
+    str_moveable content;
+    content.format("%s\n", ctag.get());
+
+    uint32 kept = 0;
+    str<> record;
+    for (auto it = m_by_rank.rbegin(); it != m_by_rank.rend() && kept < c_max_dirs; ++it, ++kept)
+    {
+        const dir_entry& e = m_entries[it->second];
+        record.format("s\t%.17g\t%u\t%u\t%s\n", e.rank, e.visits, e.last_visit, e.dir.c_str());
+        content.concat(record.c_str(), record.length());
+    }
+
+    // Keep the original records, to put them back if the write fails.
+    const DWORD size = GetFileSize(lock.get_handle(), nullptr);
+    std::unique_ptr<char[]> original;
+    uint32 original_len = 0;
+    if (size != INVALID_FILE_SIZE)
+    {
+        original.reset(new char[size]);
+        original_len = read_bytes(lock.get_handle(), 0, original.get(), size);
+    }
+
+    DWORD written = 0;
+    if (SetFilePointer(lock.get_handle(), 0, nullptr, FILE_BEGIN) == INVALID_SET_FILE_POINTER ||
+        !WriteFile(lock.get_handle(), content.c_str(), content.length(), &written, nullptr) ||
+        written != content.length())
+    {
+        LOG("can't rewrite directory history");
+        if (written && original_len)
+        {
+            SetFilePointer(lock.get_handle(), 0, nullptr, FILE_BEGIN);
+            WriteFile(lock.get_handle(), original.get(), original_len, &written, nullptr);
+        }
+        return;
+    }
+    SetEndOfFile(lock.get_handle());
+
+    // Reload from what was written, so memory matches the file exactly.
+    reset();
+    read_records(lock);
+}
+
+//------------------------------------------------------------------------------
+bool dir_history_db::add(const char* dir, uint32 time)
+{
+    if (!m_handle || !dir || !*dir || strpbrk(dir, "\t\r\n"))
+        return false;
+
+    if (!time)
+        time = uint32(::time(nullptr));
+
+    dir_lock lock(m_handle, true);
+    if (!read_records(lock))
+        rewrite(lock);
+
+    str<> record;
+    record.format("v\t%u\t%s", time, dir);
+    if (!append_record(lock, record.c_str()))
+        return false;
+
+    if (m_records > size() * 2 + c_compact_slack)
+        rewrite(lock);
+    return true;
+}
+
+//------------------------------------------------------------------------------
+bool dir_history_db::remove(const char* dir)
+{
+    if (!m_handle || !dir || !*dir || strpbrk(dir, "\t\r\n"))
+        return false;
+
+    dir_lock lock(m_handle, true);
+    if (!read_records(lock))
+        return false;
+
+    const auto it = m_by_name.find(dir);
+    if (it == m_by_name.end() || !m_entries[it->second].live)
+        return false;
+
+    str<> record;
+    record.format("r\t%s", m_entries[it->second].dir.c_str());
+    return append_record(lock, record.c_str());
+}
+
+//------------------------------------------------------------------------------
+bool dir_history_db::compact()
+{
+    if (!m_handle)
+        return false;
+
+    dir_lock lock(m_handle, true);
+    read_records(lock);
+    rewrite(lock);
+    return true;
+}
+
+//------------------------------------------------------------------------------
+uint32 dir_history_db::get_entry(const char* dir)
+{
+    const auto it = m_by_name.find(dir);
+    if (it != m_by_name.end())
+    {
+        dir_entry& e = m_entries[it->second];
+        if (!e.live)
+        {
+            // Revive a removed directory with no history.
+            e.live = true;
+            e.visits = 0;
+            e.last_visit = 0;
+            e.rank = c_no_rank;
+            m_by_rank.emplace(e.rank, it->second);
+        }
+        return it->second;
+    }
+
+    const uint32 index = uint32(m_entries.size());
+    m_entries.emplace_back();
+    dir_entry& e = m_entries.back();
+    e.dir = dir;
+    e.rank = c_no_rank;
+    e.live = true;
+    m_by_name.emplace(e.dir.c_str(), index);
+    m_by_rank.emplace(e.rank, index);
+    m_trigrams.reset();
+    return index;
+}
+
+//------------------------------------------------------------------------------
+void dir_history_db::set_rank(uint32 index, double rank)
+{
+    dir_entry& e = m_entries[index];
+    assert(e.live);
+    m_by_rank.erase(std::make_pair(e.rank, index));
+    e.rank = rank;
+    m_by_rank.emplace(e.rank, index);
+}
+
+//------------------------------------------------------------------------------
+void dir_history_db::kill(uint32 index)
+{
+    dir_entry& e = m_entries[index];
+    if (!e.live)
+        return;
+    m_by_rank.erase(std::make_pair(e.rank, index));
+    e.live = false;
+    e.visits = 0;
+    e.last_visit = 0;
+    e.rank = c_no_rank;
+}
+
+//------------------------------------------------------------------------------
+void dir_history_db::make_entry(uint32 index, uint32 now, entry& out) const
+{
+    const dir_entry& e = m_entries[index];
+    out.dir = e.dir.c_str();
+    out.visits = e.visits;
+    out.last_visit = e.last_visit;
+    out.score = exp(e.rank - c_decay * now);
+}
+
+//------------------------------------------------------------------------------
+const trigram_index& dir_history_db::get_trigrams() const
+{
+    if (!m_trigrams)
+    {
+        m_trigrams = std::make_unique<trigram_index>();
+        for (uint32 i = 0; i < m_entries.size(); ++i)
+            m_trigrams->add(int32(i), m_entries[i].dir.c_str());
+        m_trigrams->finish();
+    }
+    return *m_trigrams;
+}
+
+//------------------------------------------------------------------------------
+// Collects up to max_count directories, highest ranked first.  If filter is
+// given, only directories that start with it (if prefix) or contain it are
+// collected.  Without a filter this walks the rank order directly; a prefix
+// filter is located by binary search of the names, and a substring filter is
+// narrowed by the trigram index; either way only the best max_count of the
+// candidates are sorted.
+void dir_history_db::find_top(uint32 max_count, std::vector<entry>& out, const char* filter, bool prefix, uint32 now) const
+{
+    out.clear();
+    if (!max_count)
+        return;
+
+    if (!now)
+        now = uint32(time(nullptr));
+
+    entry tmp;
+    if (!filter || !*filter)
+    {
+        for (auto it = m_by_rank.rbegin(); it != m_by_rank.rend() && out.size() < max_count; ++it)
+        {
+            make_entry(it->second, now, tmp);
+            out.push_back(tmp);
+        }
+        return;
+    }
+
+    std::vector<uint32> candidates;
+    if (prefix)
+    {
+        // Directory names always use backslashes.
+        str<> match(filter);
+        for (char* p = match.data(); *p; ++p)
+        {
+            if (*p == '/')
+                *p = '\\';
+        }
+
+        for (auto it = m_by_name.lower_bound(match.c_str());
+             it != m_by_name.end() && _strnicmp(it->first, match.c_str(), match.length()) == 0;
+             ++it)
+        {
+            if (m_entries[it->second].live)
+                candidates.push_back(it->second);
+        }
+    }
+    else
+    {
+        auto consider = [&] (uint32 index) {
+            const dir_entry& e = m_entries[index];
+            if (e.live && contains_caseless(e.dir.c_str(), filter))
+                candidates.push_back(index);
+        };
+
+        std::vector<int32> found;
+        if (get_trigrams().find(filter, found))
+        {
+            for (const int32 index : found)
+                consider(uint32(index));
+        }
+        else
+        {
+            for (uint32 index = 0; index < m_entries.size(); ++index)
+                consider(index);
+        }
+    }
+
+    auto better = [&] (uint32 a, uint32 b) {
+        if (m_entries[a].rank != m_entries[b].rank)
+            return m_entries[a].rank > m_entries[b].rank;
+        return a > b;
+    };
+
+    if (candidates.size() > max_count)
+    {
+        std::partial_sort(candidates.begin(), candidates.begin() + max_count, candidates.end(), better);
+        candidates.resize(max_count);
+    }
+    else
+    {
+        std::sort(candidates.begin(), candidates.end(), better);
+    }
+
+    for (const uint32 index : candidates)
+    {
+        make_entry(index, now, tmp);
+        out.push_back(tmp);
+    }
+}
+
+
+
+//------------------------------------------------------------------------------
+dir_history_database::dir_history_database(const char* path)
+: dir_history_db(path)
+{
+}
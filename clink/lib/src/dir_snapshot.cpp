@@ -0,0 +1,425 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+#include "dir_snapshot.h"
+
+#include <core/os.h>
+#include <core/path.h>
+
+#include <sys/stat.h>
+
+//------------------------------------------------------------------------------
+static const uint32 c_max_dirs = 64;
+static const uint32 c_max_files = 50000;    // Larger directories aren't cached.
+static const DWORD c_max_age_ms = 30000;
+static const uint64 c_time_granularity = 2 * 10000000ull; // FAT's 2 seconds, in FILETIME units.
+
+//------------------------------------------------------------------------------
+static FILETIME get_last_write_time(const char* dir)
+{
+    FILETIME modified = {};
+    wstr<280> wdir(dir);
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (GetFileAttributesExW(wdir.c_str(), GetFileExInfoStandard, &data))
+        modified = data.ftLastWriteTime;
+    return modified;
+}
+
+//------------------------------------------------------------------------------
+static uint64 to_uint64(const FILETIME& ft)
+{
+    return (uint64(ft.dwHighDateTime) << 32) | ft.dwLowDateTime;
+}
+
+//------------------------------------------------------------------------------
+// This produces the same extrainfo as globber::next().
+static void get_extrainfo(const WIN32_FIND_DATAW& data, globber::extrainfo& out)
+{
+    const uint32 attr = data.dwFileAttributes;
+
+    int32 mode = 0;
+#ifdef S_ISLNK
+    const bool symlink = ((attr & FILE_ATTRIBUTE_REPARSE_POINT) &&
+                          !(attr & FILE_ATTRIBUTE_OFFLINE) &&
+                          (data.dwReserved0 == IO_REPARSE_TAG_SYMLINK));
+    if (symlink)                                mode |= _S_IFLNK;
+#endif
+    if (attr & FILE_ATTRIBUTE_DIRECTORY)        mode |= _S_IFDIR;
+    if (!mode)                                  mode |= _S_IFREG;
+    out.st_mode = mode;
+
+    out.attr = attr;
+
+    ULARGE_INTEGER size;
+    size.LowPart = data.nFileSizeLow;
+    size.HighPart = data.nFileSizeHigh;
+    out.size = size.QuadPart;
+
+    out.accessed = data.ftLastAccessTime;
+    out.modified = data.ftLastWriteTime;
+    out.created = data.ftCreationTime;
+}
+
+//------------------------------------------------------------------------------
+static bool sweep_dir(const char* dir, std::vector<dir_snapshot::file>& out)
+{
+    str<280> pattern(dir);
+    path::append(pattern, "*");
+    wstr<280> wpattern(pattern.c_str());
+
+    WIN32_FIND_DATAW fd;
+    HANDLE h = FindFirstFileExW(wpattern.c_str(), FindExInfoBasic, &fd, FindExSearchNameMatch, nullptr, FIND_FIRST_EX_LARGE_FETCH);
+    if (h == INVALID_HANDLE_VALUE)
+        return false;
+
+    bool ok = true;
+    do
+    {
+        const wchar_t* c = fd.cFileName;
+        if (c[0] == '.' && (!c[1] || (c[1] == '.' && !c[2])))
+            continue;
+
+        if (out.size() >= c_max_files)
+        {
+            ok = false;
+            break;
+        }
+
+        out.emplace_back();
+        dir_snapshot::file& file = out.back();
+        file.name = fd.cFileName;
+        get_extrainfo(fd, file.info);
+    }
+    while (FindNextFileW(h, &fd));
+
+    FindClose(h);
+    return ok;
+}
+
+
+
+//------------------------------------------------------------------------------
+dir_snapshot::dir_snapshot(const char* dir, std::vector<file>&& files)
+: m_dir(dir)
+, m_files(std::move(files))
+{
+    // The vector doesn't change anymore, so the keys stay valid.
+    for (uint32 i = 0; i < m_files.size(); ++i)
+        m_by_name.emplace(m_files[i].name.c_str(), i);
+}
+
+//------------------------------------------------------------------------------
+const dir_snapshot::file* dir_snapshot::find(const char* name) const
+{
+    const auto iter = m_by_name.find(name);
+    return (iter != m_by_name.end()) ? &m_files[iter->second] : nullptr;
+}
+
+
+
+//------------------------------------------------------------------------------
+dir_watch::dir_watch(const char* dir, bool expires)
+: m_dir(dir)
+, m_expires(expires)
+{
+    // Change notifications on network shares tie up server resources and
+    // aren't reliable everywhere, and on removable drives they get in the way
+    // of safely removing the drive.  So only use them on fixed drives.
+    bool local = false;
+    if (dir[0] && dir[1] == ':')
+    {
+        char drive[4];
+        drive[0] = dir[0];
+        drive[1] = ':';
+        drive[2] = '\\';
+        drive[3] = '\0';
+        const int32 type = os::get_drive_type(drive);
+        local = (type == os::drive_type_fixed || type == os::drive_type_ramdisk);
+    }
+
+    if (local)
+    {
+        wstr<280> wdir(dir);
+        const DWORD filter = (FILE_NOTIFY_CHANGE_FILE_NAME |
+                              FILE_NOTIFY_CHANGE_DIR_NAME |
+                              FILE_NOTIFY_CHANGE_ATTRIBUTES |
+                              FILE_NOTIFY_CHANGE_SIZE |
+                              FILE_NOTIFY_CHANGE_LAST_WRITE);
+        m_change = FindFirstChangeNotificationW(wdir.c_str(), FALSE, filter);
+        if (m_change == INVALID_HANDLE_VALUE)
+            m_change = nullptr;
+    }
+
+    if (!m_change)
+        read_last_write_time();
+
+    m_armed = GetTickCount();
+}
+
+//------------------------------------------------------------------------------
+dir_watch::~dir_watch()
+{
+    if (m_change)
+        FindCloseChangeNotification(m_change);
+}
+
+//------------------------------------------------------------------------------
+bool dir_watch::is_stale()
+{
+    // The last write time of a directory changes when names are added or
+    // removed, but not when files are modified, so snapshots also expire.
+    // Expiring also closes change notification handles, which can otherwise
+    // interfere with deleting or renaming the directory.
+    if (m_expires && GetTickCount() - m_armed >= c_max_age_ms)
+        return true;
+
+    if (m_change)
+        return WaitForSingleObject(m_change, 0) == WAIT_OBJECT_0;
+
+    // Without a notification, the last write time is checked every time, so
+    // that existence queries are never answered from an unverified snapshot.
+    if (!m_trusted)
+        return true;
+
+    const FILETIME modified = get_last_write_time(m_dir.c_str());
+    return CompareFileTime(&modified, &m_modified) != 0;
+}
+
+//------------------------------------------------------------------------------
+// Remembers the directory's last write time.  A change within the timestamp
+// granularity of the file system (2 seconds on FAT) may not change the last
+// write time, so a directory written that recently can't be trusted.
+void dir_watch::read_last_write_time()
+{
+    FILETIME now;
+    m_modified = get_last_write_time(m_dir.c_str());
+    GetSystemTimeAsFileTime(&now);
+    const uint64 modified = to_uint64(m_modified);
+    m_trusted = (modified && to_uint64(now) >= modified + c_time_granularity);
+}
+
+
+
+//------------------------------------------------------------------------------
+// Switches to comparing the last write time, and closes the change
+// notification handle.  Returns false if the directory has changed.
+bool dir_watch::release_notification()
+{
+    if (!m_change)
+        return true;
+
+    // Get the last write time before checking the notification, so that
+    // nothing can slip in between.
+    read_last_write_time();
+    const bool changed = (WaitForSingleObject(m_change, 0) == WAIT_OBJECT_0);
+
+    FindCloseChangeNotification(m_change);
+    m_change = nullptr;
+    return !changed && m_trusted;
+}
+
+
+
+//------------------------------------------------------------------------------
+dir_snapshot_cache& dir_snapshot_cache::get()
+{
+    static dir_snapshot_cache s_cache;
+    return s_cache;
+}
+
+//------------------------------------------------------------------------------
+bool dir_snapshot_cache::normalize(const char* dir, str_base& out)
+{
+    if (!dir || !*dir)
+        dir = ".";
+    if (!os::get_full_path_name(dir, out))
+        return false;
+    path::maybe_strip_last_separator(out);
+    return true;
+}
+
+//------------------------------------------------------------------------------
+std::shared_ptr<const dir_snapshot> dir_snapshot_cache::find(const char* _dir, bool sweep)
+{
+    str<280> dir;
+    if (!normalize(_dir, dir))
+        return nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto snapshot = find_fresh(dir.c_str());
+        if (snapshot)
+        {
+            m_stats.hits++;
+            return snapshot;
+        }
+        m_stats.misses++;
+        if (!sweep)
+            return nullptr;
+        m_stats.sweeps++;
+    }
+
+    // Sweep without holding the lock, so other threads aren't blocked.
+    auto watch = std::make_unique<dir_watch>(dir.c_str());
+    std::vector<dir_snapshot::file> files;
+    if (!sweep_dir(dir.c_str(), files))
+        return nullptr;
+
+    auto snapshot = std::make_shared<const dir_snapshot>(dir.c_str(), std::move(files));
+    insert(std::move(watch), snapshot);
+    return snapshot;
+}
+
+//------------------------------------------------------------------------------
+dir_snapshot_cache::lookup_result dir_snapshot_cache::lookup(const char* path, dir_snapshot::file* out, bool sweep)
+{
+    str<280> full;
+    if (!path || !*path || !normalize(path, full))
+        return lookup_unknown;
+
+    const char* name = path::get_name(full.c_str());
+    if (!name || !*name)
+        return lookup_unknown;
+
+    str<280> dir;
+    path::get_directory(full.c_str(), dir);
+    if (dir.empty())
+        return lookup_unknown;
+
+    auto snapshot = find(dir.c_str(), sweep);
+    if (!snapshot)
+        return lookup_unknown;
+
+    const dir_snapshot::file* file = snapshot->find(name);
+    if (!file)
+        return lookup_missing;
+
+    if (out)
+    {
+        out->name = file->name.c_str();
+        out->info = file->info;
+    }
+    return lookup_found;
+}
+
+//------------------------------------------------------------------------------
+// Adds a snapshot from an enumeration done elsewhere.  The watch must have been
+// created before the enumeration started.
+void dir_snapshot_cache::add(std::unique_ptr<dir_watch>&& watch, std::vector<dir_snapshot::file>&& files)
+{
+    if (files.size() > c_max_files)
+        return;
+
+    auto snapshot = std::make_shared<const dir_snapshot>(watch->get_dir(), std::move(files));
+    insert(std::move(watch), snapshot);
+}
+
+//------------------------------------------------------------------------------
+void dir_snapshot_cache::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_slots.clear();
+    m_stats = {};
+}
+
+//------------------------------------------------------------------------------
+// Closes all change notification handles.  Snapshots that are still fresh are
+// kept, and are verified by their directories' last write times on every use
+// from now on.
+// This is called when an input line begins or ends, so that handles aren't
+// held open while commands run or after the user has moved on.
+void dir_snapshot_cache::release_notifications()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto iter = m_slots.begin(); iter != m_slots.end();)
+    {
+        dir_watch& watch = *iter->second.watch;
+        if (watch.has_notification() && (watch.is_stale() || !watch.release_notification()))
+        {
+            m_stats.invalidations++;
+            iter = m_slots.erase(iter);
+        }
+        else
+        {
+            ++iter;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+void dir_snapshot_cache::get_stats(stats& out) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    out = m_stats;
+    out.dirs = uint32(m_slots.size());
+    out.files = 0;
+    for (const auto& iter : m_slots)
+        out.files += uint32(iter.second.snapshot->get_files().size());
+}
+
+//------------------------------------------------------------------------------
+std::shared_ptr<const dir_snapshot> dir_snapshot_cache::find_fresh(const char* dir)
+{
+    const auto iter = m_slots.find(dir);
+    if (iter == m_slots.end())
+        return nullptr;
+
+    if (iter->second.watch->is_stale())
+    {
+        m_stats.invalidations++;
+        m_slots.erase(iter);
+        return nullptr;
+    }
+
+    iter->second.used = GetTickCount();
+    return iter->second.snapshot;
+}
+
+//------------------------------------------------------------------------------
+void dir_snapshot_cache::insert(std::unique_ptr<dir_watch>&& watch, const std::shared_ptr<const dir_snapshot>& snapshot)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_slots.erase(snapshot->get_dir());
+    expire();
+    evict();
+    slot& s = m_slots[snapshot->get_dir()];
+    s.watch = std::move(watch);
+    s.snapshot = snapshot;
+    s.used = GetTickCount();
+}
+
+//------------------------------------------------------------------------------
+// Drops snapshots that are too old, even if nothing has asked for them since,
+// so their change notification handles get closed.
+void dir_snapshot_cache::expire()
+{
+    for (auto iter = m_slots.begin(); iter != m_slots.end();)
+    {
+        if (iter->second.watch->has_notification() && iter->second.watch->is_stale())
+        {
+            m_stats.invalidations++;
+            iter = m_slots.erase(iter);
+        }
+        else
+        {
+            ++iter;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+// Makes room for one more slot by dropping the least recently used ones.
+void dir_snapshot_cache::evict()
+{
+    while (m_slots.size() >= c_max_dirs)
+    {
+        auto oldest = m_slots.begin();
+        for (auto iter = m_slots.begin(); iter != m_slots.end(); ++iter)
+        {
+            if (int32(iter->second.used - oldest->second.used) < 0)
+                oldest = iter;
+        }
+        m_slots.erase(oldest);
+    }
+}
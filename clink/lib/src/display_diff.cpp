@@ -0,0 +1,313 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+#include "display_diff.h"
+#include "display_readline.h"
+
+#include <core/base.h>
+#include <terminal/wcwidth.h>
+
+#include <algorithm>
+#include <assert.h>
+
+//------------------------------------------------------------------------------
+// Limits the size of the cost table; a row in a terminal up to 255 columns
+// wide always fits.
+static const uint32 c_max_cells = 256 * 256;
+static const uint32 c_infinite = 0xffffffff;
+
+// Matching cells kept on each side of the changed cells when trimming.
+static const uint32 c_trim_margin = 8;
+
+//------------------------------------------------------------------------------
+uint32 display_diff_costs::move(uint32 col) const
+{
+    // CR, or CSI n G.
+    if (!col)
+        return 1;
+    uint32 digits = 1;
+    for (uint32 n = col + 1; n >= 10; n /= 10)
+        ++digits;
+    return 3 + digits;
+}
+
+
+
+//------------------------------------------------------------------------------
+bool display_diff::get_units(const char* chars, uint32 len, std::vector<unit>& out)
+{
+    out.clear();
+
+    wcwidth_iter iter(chars, len);
+    while (iter.next())
+    {
+        if (iter.character_wcwidth_signed() != 1)
+            return false;
+        out.push_back({ uint32(iter.character_pointer() - chars), iter.character_length() });
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+bool display_diff::plan(const char* ochars, const char* ofaces, uint32 olen,
+                        const char* dchars, const char* dfaces, uint32 dlen,
+                        uint32 base_col, bool can_erase_tail)
+{
+    m_ops.clear();
+    m_cost = 0;
+
+    if (!get_units(ochars, olen, m_old) || !get_units(dchars, dlen, m_new))
+        return false;
+
+    auto equal = [&] (uint32 i, uint32 j) {
+        const unit& d = m_new[i];
+        const unit& o = m_old[j];
+        return (d.len == o.len &&
+                !memcmp(dchars + d.offset, ochars + o.offset, d.len) &&
+                !memcmp(dfaces + d.offset, ofaces + o.offset, d.len));
+    };
+
+    // Matching cells at the start and end are skipped without planning them,
+    // which keeps the table small.  A few of them are kept, since rewriting a
+    // couple of matching cells can cost less than a cursor move, or erasing
+    // to the end of the row.  The units keep their byte offsets, so only the
+    // columns need adjusting.
+    uint32 prefix = 0;
+    uint32 suffix = 0;
+    {
+        const uint32 both = uint32(min(m_old.size(), m_new.size()));
+        while (prefix < both && equal(prefix, prefix))
+            ++prefix;
+        while (suffix < both - prefix && equal(uint32(m_new.size()) - 1 - suffix, uint32(m_old.size()) - 1 - suffix))
+            ++suffix;
+        prefix = (prefix > c_trim_margin) ? prefix - c_trim_margin : 0;
+        suffix = (suffix > c_trim_margin) ? suffix - c_trim_margin : 0;
+    }
+    m_old.erase(m_old.begin(), m_old.begin() + prefix);
+    m_new.erase(m_new.begin(), m_new.begin() + prefix);
+    m_old.resize(m_old.size() - suffix);
+    m_new.resize(m_new.size() - suffix);
+    base_col += prefix;
+    if (suffix)
+        can_erase_tail = false;
+
+    const uint32 n = uint32(m_old.size());
+    const uint32 m = uint32(m_new.size());
+    const uint32 stride = n + 1;
+    const uint32 cells = (m + 1) * stride;
+    if (cells > c_max_cells)
+        return false;
+
+    // The buffers only grow.  m_from needs no initializing, since build_ops()
+    // only reads the entries along the cheapest path, which were all relaxed.
+    if (m_table.size() < cells * state_count)
+    {
+        m_table.resize(cells * state_count);
+        m_from.resize(cells * state_count);
+    }
+    std::fill_n(m_table.begin(), cells * state_count, c_infinite);
+
+    auto at = [&] (uint32 i, uint32 j, state s) { return (i * stride + j) * state_count + s; };
+    auto face = [&] (uint32 i) { return dfaces[m_new[i].offset]; };
+
+    // Cost of writing new character i at the start of a write.
+    auto start = [&] (uint32 i) {
+        return m_new[i].len + ((face(i) != FACE_NORMAL) ? m_costs.sgr : 0);
+    };
+    // Cost of writing new character i after new character i - 1.
+    auto cont = [&] (uint32 i) {
+        uint32 cost = m_new[i].len;
+        if (face(i) != face(i - 1))
+            cost += (face(i) == FACE_NORMAL) ? m_costs.sgr_normal : m_costs.sgr;
+        return cost;
+    };
+    // Cost of ending a write after new character i - 1.
+    auto end = [&] (uint32 i) {
+        return (face(i - 1) != FACE_NORMAL) ? m_costs.sgr_normal : 0;
+    };
+    auto move = [&] (uint32 i) {
+        return m_costs.move(base_col + i);
+    };
+    auto relax = [&] (uint32 i, uint32 j, state s, uint32 cost, state from) {
+        uint32& slot = m_table[at(i, j, s)];
+        if (cost < slot)
+        {
+            slot = cost;
+            m_from[at(i, j, s)] = from;
+        }
+    };
+
+    m_table[at(0, 0, skipping)] = 0;
+
+    for (uint32 i = 0; i <= m; ++i)
+    {
+        for (uint32 j = 0; j <= n; ++j)
+        {
+            for (uint8 s8 = 0; s8 < state_count; ++s8)
+            {
+                const state s = state(s8);
+                const uint32 c = m_table[at(i, j, s)];
+                if (c == c_infinite)
+                    continue;
+
+                const bool in_write = (s == writing || s == inserting);
+
+                // Skip a matching cell.
+                if (i < m && j < n && equal(i, j))
+                    relax(i + 1, j + 1, skipping, c + (in_write ? end(i) : 0), s);
+
+                // Overwrite a cell.
+                if (i < m && j < n)
+                {
+                    uint32 cost;
+                    if (in_write)
+                        cost = cont(i);
+                    else if (s == skipping)
+                        cost = move(i) + start(i);
+                    else
+                        cost = start(i);
+                    relax(i + 1, j + 1, writing, c + cost, s);
+                }
+
+                // Insert a cell.  A write can continue after inserting, but
+                // inserting after writing needs a new ICH.
+                if (i < m)
+                {
+                    uint32 cost;
+                    if (s == inserting)
+                        cost = cont(i);
+                    else if (s == writing)
+                        cost = end(i) + m_costs.shift + start(i);
+                    else if (s == skipping)
+                        cost = move(i) + m_costs.shift + start(i);
+                    else
+                        cost = m_costs.shift + start(i);
+                    relax(i + 1, j, inserting, c + cost, s);
+                }
+
+                // Delete a cell.
+                if (j < n)
+                {
+                    uint32 cost;
+                    if (s == deleting)
+                        cost = 0;
+                    else if (s == skipping)
+                        cost = move(i) + m_costs.shift;
+                    else
+                        cost = end(i) + m_costs.shift;
+                    relax(i, j + 1, deleting, c + cost, s);
+                }
+            }
+        }
+    }
+
+    // Find the cheapest way to finish:  either everything is consumed, or the
+    // rest of the old cells are erased to the end of the row.
+    uint32 best = c_infinite;
+    uint32 best_j = n;
+    state best_state = skipping;
+    bool best_erase = false;
+    for (uint32 j = can_erase_tail ? 0 : n; j <= n; ++j)
+    {
+        const bool erase = (j < n);
+        for (uint8 s8 = 0; s8 < state_count; ++s8)
+        {
+            const state s = state(s8);
+            uint32 c = m_table[at(m, j, s)];
+            if (c == c_infinite)
+                continue;
+
+            if (s == writing || s == inserting)
+                c += end(m);
+            if (erase)
+                c += m_costs.erase + ((s == skipping) ? move(m) : 0);
+
+            if (c < best)
+            {
+                best = c;
+                best_j = j;
+                best_state = s;
+                best_erase = erase;
+            }
+        }
+    }
+
+    assert(best != c_infinite);
+    m_cost = best;
+    build_ops(prefix, best_j, best_state, best_erase);
+    return true;
+}
+
+//------------------------------------------------------------------------------
+void display_diff::build_ops(uint32 first_col, uint32 end_j, state end_state, bool erase_tail)
+{
+    const uint32 m = uint32(m_new.size());
+    const uint32 stride = uint32(m_old.size()) + 1;
+
+    // Walk back through the table to collect the steps.
+    m_steps.clear();
+    uint32 i = m;
+    uint32 j = end_j;
+    state s = end_state;
+    while (i || j)
+    {
+        m_steps.push_back(s);
+        const state prev = state(m_from[(i * stride + j) * state_count + s]);
+        switch (s)
+        {
+        case skipping:
+        case writing:   --i; --j; break;
+        case inserting: --i; break;
+        case deleting:  --j; break;
+        }
+        s = prev;
+    }
+
+    // Replay the steps forward to build the operations.
+    display_diff_op* op = nullptr;
+    state prev = skipping;
+    i = 0;
+    for (size_t k = m_steps.size(); k--;)
+    {
+        const state step = m_steps[k];
+        switch (step)
+        {
+        case skipping:
+            op = nullptr;
+            ++i;
+            break;
+
+        case writing:
+        case inserting:
+            if (!op || op->type != display_diff_op::write || (step == inserting && prev == writing))
+            {
+                m_ops.push_back({ display_diff_op::write, first_col + i, m_new[i].offset, 0, 0, 0 });
+                op = &m_ops.back();
+            }
+            op->bytes += m_new[i].len;
+            op->count++;
+            if (step == inserting)
+            {
+                assert(op->insert == op->count - 1);
+                op->insert++;
+            }
+            ++i;
+            break;
+
+        case deleting:
+            if (!op || op->type != display_diff_op::remove)
+            {
+                m_ops.push_back({ display_diff_op::remove, first_col + i, 0, 0, 0, 0 });
+                op = &m_ops.back();
+            }
+            op->count++;
+            break;
+        }
+        prev = step;
+    }
+
+    if (erase_tail)
+        m_ops.push_back({ display_diff_op::erase, first_col + m, 0, 0, 0, 0 });
+}
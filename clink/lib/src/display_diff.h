@@ -0,0 +1,79 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <vector>
+
+//------------------------------------------------------------------------------
+// Estimated bytes emitted for each kind of terminal operation.  The SGR costs
+// are estimates, since the actual escape codes depend on the configured colors.
+struct display_diff_costs
+{
+    uint32              move(uint32 col) const;     // CR or CHA.
+    uint32              shift = 4;                  // ICH or DCH.
+    uint32              erase = 3;                  // EL.
+    uint32              sgr = 8;                    // Changing to a face other than FACE_NORMAL.
+    uint32              sgr_normal = 3;             // Changing back to FACE_NORMAL.
+};
+
+//------------------------------------------------------------------------------
+struct display_diff_op
+{
+    enum op_type : uint8 { write, remove, erase };
+
+    op_type             type;
+    uint32              col;        // Column, relative to the start of the range.
+    uint32              offset;     // write: Byte offset into the new range.
+    uint32              bytes;      // write: Number of bytes to write.
+    uint32              count;      // write: Columns to write; remove: Columns to delete.
+    uint32              insert;     // write: Columns to insert (ICH) before writing.
+};
+
+//------------------------------------------------------------------------------
+// Plans the cheapest sequence of terminal operations that turns the old range
+// of a display line into the new range, given that the cells to the left of
+// the range are already correct and the cells to the right of the old range
+// must end up to the right of the new range.  Cells that already match are
+// skipped, runs are overwritten, and cells are inserted (ICH) or deleted (DCH)
+// to realign the rest of the row, whichever emits the fewest bytes.  Each write
+// is a separate call to rl_puts_face_func, which begins and ends with the
+// normal face, so the cost model includes the SGR codes for the face changes
+// within and around each write; that naturally coalesces writes separated by
+// short runs of matching cells.
+//
+// Only ranges where every character is one column wide are supported, so that
+// character indices and columns are interchangeable.  plan() returns false if
+// that isn't the case or if the ranges are too long; the caller should fall
+// back to rewriting the range.
+class display_diff
+{
+public:
+    bool                plan(const char* ochars, const char* ofaces, uint32 olen,
+                             const char* dchars, const char* dfaces, uint32 dlen,
+                             uint32 base_col, bool can_erase_tail);
+    const std::vector<display_diff_op>& ops() const { return m_ops; }
+    uint32              cost() const { return m_cost; }
+    display_diff_costs& costs() { return m_costs; }
+
+private:
+    struct unit
+    {
+        uint32          offset;
+        uint32          len;
+    };
+
+    enum state : uint8 { skipping, writing, inserting, deleting, state_count };
+
+    static bool         get_units(const char* chars, uint32 len, std::vector<unit>& out);
+    void                build_ops(uint32 first_col, uint32 end_j, state end_state, bool erase_tail);
+
+    display_diff_costs  m_costs;
+    std::vector<unit>   m_old;
+    std::vector<unit>   m_new;
+    std::vector<uint32> m_table;        // Cost per state per (new, old) index.
+    std::vector<uint8>  m_from;         // Previous state per state per (new, old) index.
+    std::vector<state>  m_steps;
+    std::vector<display_diff_op> m_ops;
+    uint32              m_cost = 0;
+};
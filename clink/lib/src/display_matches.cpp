@@ -646,8 +646,13 @@ int32 __fnwidth(const char* string)
     int32 width = 0;
 
     wcwidth_iter iter(string);
-    while (iter.next())
+    while (true)
+    {
+        width += iter.next_ascii_run();
+        if (!iter.next())
+            break;
         width += iter.character_wcwidth_twoctrl();
+    }
 
     return width;
 }
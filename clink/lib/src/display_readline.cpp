@@ -23,6 +23,7 @@
 #endif
 
 #include "display_readline.h"
+#include "display_diff.h"
 #include "line_buffer.h"
 #include "ellipsify.h"
 #include "line_editor_integration.h"
@@ -33,10 +34,14 @@
 #include <core/log.h>
 #include <core/settings.h>
 #include <core/debugheap.h>
+#include <core/str_hash.h>
 #include <terminal/ecma48_iter.h>
+#include <terminal/screen_buffer.h>
 #include <terminal/wcwidth.h>
 #include <terminal/terminal_helpers.h>
 
+#include <algorithm>
+#include <functional>
 #include <memory>
 
 #ifdef REPORT_REDISPLAY
@@ -375,6 +380,7 @@ struct display_line
     display_line&       operator=(display_line&& d);
 
     void                clear();
+    void                assign(const display_line& d, int32 delta);
     void                append(char c, char face);
     void                appendspace();
     void                appendnul();
@@ -396,6 +402,7 @@ struct display_line
     signed char         m_scroll_mark = 0;  // Number of columns for scrolling indicator (positive at left, negative at right).
 
 private:
+    bool                reserve(uint32 len);
     void                appendinternal(char c, char face);
 };
 
@@ -439,31 +446,69 @@ void display_line::clear()
 }
 
 //------------------------------------------------------------------------------
-void display_line::appendinternal(char c, char face)
+// Copies a line from a layout of the same text, with the text shifted by delta
+// bytes.
+void display_line::assign(const display_line& d, int32 delta)
 {
-    if (m_len >= m_allocated)
+    assert(this != &d);
+
+    if (!reserve(d.m_len + 1))
+        return;
+
+    if (d.m_len)
     {
+        memcpy(m_chars, d.m_chars, d.m_len);
+        memcpy(m_faces, d.m_faces, d.m_len);
+    }
+    m_len = d.m_len;
+    appendnul();
+
+    m_start = d.m_start + delta;
+    m_end = d.m_end + delta;
+    m_x = d.m_x;
+    m_lastcol = d.m_lastcol;
+    m_lead = d.m_lead;
+    m_trail = d.m_trail;
+
+    m_newline = d.m_newline;
+    m_toeol = d.m_toeol;
+    m_scroll_mark = d.m_scroll_mark;
+}
+
+//------------------------------------------------------------------------------
+bool display_line::reserve(uint32 len)
+{
+    if (len <= m_allocated)
+        return true;
+
 #ifdef DEBUG
-        const uint32 min_alloc = 40;
+    const uint32 min_alloc = 40;
 #else
-        const uint32 min_alloc = 160;
+    const uint32 min_alloc = 160;
 #endif
 
-        const uint32 alloc = max<uint32>(min_alloc, m_allocated * 3 / 2);
-        char* chars = static_cast<char*>(realloc(m_chars, alloc));
-        char* faces = static_cast<char*>(realloc(m_faces, alloc));
-        if (!chars || !faces)
-        {
-            free(chars);
-            free(faces);
-            return;
-        }
-
-        m_chars = chars;
-        m_faces = faces;
-        m_allocated = alloc;
+    const uint32 alloc = max<uint32>(len, max<uint32>(min_alloc, m_allocated * 3 / 2));
+    char* chars = static_cast<char*>(realloc(m_chars, alloc));
+    char* faces = static_cast<char*>(realloc(m_faces, alloc));
+    if (!chars || !faces)
+    {
+        free(chars);
+        free(faces);
+        return false;
     }
 
+    m_chars = chars;
+    m_faces = faces;
+    m_allocated = alloc;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+void display_line::appendinternal(char c, char face)
+{
+    if (m_len >= m_allocated && !reserve(m_len + 1))
+        return;
+
     m_chars[m_len] = c;
     m_faces[m_len] = face;
     ++m_len;
@@ -499,7 +544,7 @@ public:
                         display_lines() = default;
                         ~display_lines() = default;
 
-    void                parse(uint32 prompt_botlin, uint32 col, const char* buffer, uint32 len);
+    void                parse(uint32 prompt_botlin, uint32 col, const char* buffer, uint32 len, const display_lines* ref=nullptr);
     void                horz_parse(uint32 prompt_botlin, uint32 col, const char* buffer, uint32 point, uint32 len, const display_lines& ref);
     void                apply_scroll_markers(uint32 top, uint32 bottom);
     void                set_top(uint32 top);
@@ -521,10 +566,14 @@ public:
     uint32              vpos() const { return m_vpos; }
     uint32              cpos() const { return m_cpos; }
     uint32              top() const { return m_top; }
+    uint32              reused() const { return m_reused; }
 
 private:
     display_line*       next_line(uint32 start);
     bool                adjust_columns(uint32& point, int32 delta, const char* buffer, uint32 len) const;
+    bool                can_reuse(uint32 prompt_botlin, uint32 col) const;
+    bool                is_pristine(uint32 index) const;
+    void                locate_point(const char* buffer, uint32 first, uint32 last);
 
     std::vector<display_line> m_lines;
     uint32              m_width = 0;
@@ -537,25 +586,69 @@ private:
     bool                m_horz_scroll = false;
     bool                m_has_comment_row = false;
     str_moveable        m_comment_row;
+    str_moveable        m_text;             // Buffer that was parsed, for reusing lines.
+    bool                m_has_text = false;
+    uint32              m_reused = 0;       // Lines copied from the previous layout.
 };
 
 //------------------------------------------------------------------------------
-void display_lines::parse(uint32 prompt_botlin, uint32 col, const char* buffer, uint32 len)
+// Control characters are displayed as ^X.
+static const uint32 c_ctrl_expansion_len = 2;
+
+//------------------------------------------------------------------------------
+// Reapplies faces to a line copied from another layout.  Faces can change even
+// where the text didn't change (e.g. classifications or the selection).
+static void apply_faces(display_line& d, const char* buffer, int32 hl_begin, int32 hl_end)
+{
+    const uint32 end = d.m_len - d.m_trail;
+    uint32 index = d.m_start;
+    uint32 i = 0;
+
+    if (d.m_lead)
+    {
+        // The wrapped part of a control character.
+        const char face = rl_get_face_func(index, hl_begin, hl_end);
+        for (; i < d.m_lead; ++i)
+            d.m_faces[i] = face;
+        ++index;
+    }
+
+    while (i < end)
+    {
+        const char face = rl_get_face_func(index, hl_begin, hl_end);
+        if (d.m_chars[i] == buffer[index])
+        {
+            d.m_faces[i++] = face;
+        }
+        else
+        {
+            assert(d.m_chars[i] == '^');
+            for (uint32 n = min<uint32>(c_ctrl_expansion_len, end - i); n--;)
+                d.m_faces[i++] = face;
+        }
+        ++index;
+    }
+}
+
+//------------------------------------------------------------------------------
+// Parsing walks the whole buffer, which adds up for very long input lines.  So
+// when a previous layout of the buffer is available (ref), the lines before the
+// first changed byte are copied from it, parsing resumes at the start of the
+// nearest line that doesn't begin with the wrapped part of a control character,
+// and it stops as soon as a line starts at the same place in the unchanged
+// remainder of the buffer as a line in the previous layout.  That saves the
+// wcwidth parsing and the line building, but faces are still reapplied to the
+// copied lines and the buffer is still copied, so each redraw is still linear
+// in the length of the buffer.
+void display_lines::parse(uint32 prompt_botlin, uint32 col, const char* buffer, uint32 len, const display_lines* ref)
 {
     assert(col < _rl_screenwidth);
+    assert(ref != this);
     dbg_ignore_scope(snapshot, "display_readline");
 
     clear();
     m_width = _rl_screenwidth;
 
-    m_prompt_botlin = prompt_botlin;
-    while (prompt_botlin--)
-        next_line(0);
-
-    display_line* d = next_line(0);
-    d->m_x = col;
-    m_cpos = col;
-
     int32 hl_begin = -1;
     int32 hl_end = -1;
 
@@ -568,10 +661,109 @@ void display_lines::parse(uint32 prompt_botlin, uint32 col, const char* buffer,
         }
     }
 
-    str<16> tmp;
+#ifdef DISPLAY_TABS
+    // apply_faces() can't tell tabs apart from spaces.
+    ref = nullptr;
+#endif
+    if (ref && !ref->can_reuse(prompt_botlin, col))
+        ref = nullptr;
+
+    // Find how much text is unchanged at the beginning and end of the buffer.
+    uint32 same_begin = 0;
+    uint32 same_end = len;
+    int32 delta = 0;
+    if (ref)
+    {
+        const char* old = ref->m_text.c_str();
+        const uint32 old_len = ref->m_text.length();
+        const uint32 common = min<uint32>(len, old_len);
+        while (same_begin < common && buffer[same_begin] == old[same_begin])
+            ++same_begin;
+        uint32 same_len = 0;
+        while (same_begin + same_len < common && buffer[len - same_len - 1] == old[old_len - same_len - 1])
+            ++same_len;
+        same_end = len - same_len;
+        delta = int32(len - old_len);
+    }
+
+    m_prompt_botlin = prompt_botlin;
+    while (prompt_botlin--)
+        next_line(0);
+
+    // Copy lines that end far enough before the first changed byte that the
+    // character after them is unchanged as well.
+    const uint32 first = m_count;
+    uint32 resume = first;
+    if (ref)
+    {
+        for (uint32 i = first + 1; i < ref->m_count; ++i)
+        {
+            const display_line& r = ref->m_lines[i];
+            if (!ref->is_pristine(i - 1) || r.m_start + 4 > same_begin) // 4 = longest UTF-8 sequence.
+                break;
+            if (!r.m_lead)
+                resume = i;
+        }
+
+        for (uint32 i = first; i < resume; ++i)
+        {
+            display_line* d = next_line(0);
+            d->assign(ref->m_lines[i], 0);
+            apply_faces(*d, buffer, hl_begin, hl_end);
+        }
+        m_reused = resume - first;
+    }
+
     uint32 index = 0;
+    m_cpos = col;
+    if (resume > first)
+    {
+        index = ref->m_lines[resume].m_start;
+        col = 0;
+    }
+
+    display_line* d = next_line(index);
+    d->m_x = col;
+
+    // Once a line starts in the unchanged remainder of the buffer at the same
+    // place as a line in the previous layout, the rest of the lines are the
+    // same, except for faces.  But only after the cursor position is known.
+    auto resync = [&] () -> bool
+    {
+        if (!ref || index < same_end || uint32(rl_point) >= index)
+            return false;
+
+        const uint32 old_index = index - delta;
+        const auto begin = ref->m_lines.begin() + first + 1;
+        const auto end = ref->m_lines.begin() + ref->m_count;
+        const auto iter = std::lower_bound(begin, end, old_index, [] (const display_line& r, uint32 start) {
+            return r.m_start < start;
+        });
+        if (iter == end || iter->m_start != old_index || iter->m_lead)
+            return false;
+
+        const uint32 from = uint32(iter - ref->m_lines.begin());
+        for (uint32 i = from; i < ref->m_count; ++i)
+        {
+            if (!ref->is_pristine(i))
+                return false;
+        }
+
+        --m_count;
+        for (uint32 i = from; i < ref->m_count; ++i)
+        {
+            d = next_line(0);
+            d->assign(ref->m_lines[i], delta);
+            apply_faces(*d, buffer, hl_begin, hl_end);
+        }
+        m_reused += ref->m_count - from;
+        return true;
+    };
 
-    wcwidth_iter iter(buffer, len);
+    str<16> tmp;
+    bool resynced = false;
+
+    wcwidth_iter iter(buffer + index, len - index);
     while (const uint32 c = iter.next())
     {
         if (c == '\n' && !_rl_horizontal_scroll_mode && _rl_term_up && *_rl_term_up)
@@ -590,6 +782,11 @@ void display_lines::parse(uint32 prompt_botlin, uint32 col, const char* buffer,
             ++index;
             d = next_line(index);
             col = 0;
+            if (resync())
+            {
+                resynced = true;
+                break;
+            }
             continue;
         }
 #ifdef DISPLAY_TABS
@@ -635,6 +832,11 @@ void display_lines::parse(uint32 prompt_botlin, uint32 col, const char* buffer,
 
                 d = next_line(uint32(iter.character_pointer() - buffer));
                 col = 0;
+                if (resync())
+                {
+                    resynced = true;
+                    break;
+                }
             }
 
             if (index <= rl_point && rl_point < index + iter.character_length())
@@ -698,27 +900,93 @@ void display_lines::parse(uint32 prompt_botlin, uint32 col, const char* buffer,
             d->m_lead = col;
     }
 
-    assert(uint32(iter.get_pointer() - buffer) == index);
-
-    d->m_lastcol = col;
-    d->m_end = index;
-    d->appendnul();
-
-    if (d->m_lastcol + d->m_trail >= _rl_screenwidth)
+    if (!resynced)
     {
-        assert(d->m_lead <= d->m_lastcol);
-        assert(d->m_lastcol == _rl_screenwidth);
-        assert(d->m_trail == 0);
+        assert(uint32(iter.get_pointer() - buffer) == index);
 
-        d = next_line(index);
+        d->m_lastcol = col;
         d->m_end = index;
-        col = 0;
+        d->appendnul();
+
+        if (d->m_lastcol + d->m_trail >= _rl_screenwidth)
+        {
+            assert(d->m_lead <= d->m_lastcol);
+            assert(d->m_lastcol == _rl_screenwidth);
+            assert(d->m_trail == 0);
+
+            d = next_line(index);
+            d->m_end = index;
+            col = 0;
+        }
+
+        if (index == rl_point)
+        {
+            m_vpos = m_count - 1;
+            m_cpos = col;
+        }
     }
 
-    if (index == rl_point)
+    if (resume > first && uint32(rl_point) < m_lines[resume].m_start)
+        locate_point(buffer, first, resume);
+
+    m_text.clear();
+    m_text.concat(buffer, len);
+    m_has_text = true;
+}
+
+//------------------------------------------------------------------------------
+// Whether parse() can reuse lines from this layout.
+bool display_lines::can_reuse(uint32 prompt_botlin, uint32 col) const
+{
+    return (m_has_text &&
+            !m_horz_scroll &&
+            m_width == _rl_screenwidth &&
+            m_prompt_botlin == prompt_botlin &&
+            m_count > prompt_botlin &&
+            m_lines[prompt_botlin].m_x == col);
+}
+
+//------------------------------------------------------------------------------
+// Whether a line is still exactly as parse() produced it.
+bool display_lines::is_pristine(uint32 index) const
+{
+    // apply_scroll_markers() modifies the top and bottom lines.
+    if (m_lines[index].m_scroll_mark)
+        return false;
+    if (index == m_top && m_top > m_prompt_botlin)
+        return false;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Sets the cursor position when it's in lines copied from another layout.
+void display_lines::locate_point(const char* buffer, uint32 first, uint32 last)
+{
+    const uint32 point = uint32(rl_point);
+
+    for (uint32 i = last; i-- > first;)
     {
-        m_vpos = m_count - 1;
+        const display_line& d = m_lines[i];
+
+        // A control character that wraps belongs to the line where it begins.
+        const bool split = (d.m_lead && d.m_lead < c_ctrl_expansion_len);
+        const uint32 begin = d.m_start + split;
+        if (point < begin)
+            continue;
+
+        uint32 col = d.m_x + (split ? d.m_lead : 0);
+        wcwidth_iter iter(buffer + begin, d.m_end - begin);
+        while (iter.next())
+        {
+            if (uint32(iter.get_pointer() - buffer) > point)
+                break;
+            const int32 wc_width = iter.character_wcwidth_signed();
+            col += (wc_width < 0) ? c_ctrl_expansion_len : wc_width;
+        }
+
+        m_vpos = i;
         m_cpos = col;
+        return;
     }
 }
 
@@ -984,6 +1252,9 @@ void display_lines::swap(display_lines& d)
     std::swap(m_horz_scroll, d.m_horz_scroll);
     std::swap(m_comment_row, d.m_comment_row);
     std::swap(m_has_comment_row, d.m_has_comment_row);
+    std::swap(m_text, d.m_text);
+    std::swap(m_has_text, d.m_has_text);
+    std::swap(m_reused, d.m_reused);
 }
 
 //------------------------------------------------------------------------------
@@ -999,6 +1270,8 @@ void display_lines::clear()
     m_top = 0;
     m_horz_start = 0;
     m_horz_scroll = false;
+    m_has_text = false;
+    m_reused = 0;
     clear_comment_row();
 }
 
@@ -1125,6 +1398,89 @@ bool display_lines::adjust_columns(uint32& index, int32 delta, const char* buffe
     return index > 0;
 }
 
+//------------------------------------------------------------------------------
+static bool compare_display_lines(const display_lines& a, const display_lines& b, str_base& mismatch)
+{
+    if (a.count() != b.count())
+    {
+        mismatch.format("count %u vs %u", a.count(), b.count());
+        return false;
+    }
+    if (a.vpos() != b.vpos() || a.cpos() != b.cpos())
+    {
+        mismatch.format("cursor %u,%u vs %u,%u", a.cpos(), a.vpos(), b.cpos(), b.vpos());
+        return false;
+    }
+
+    for (uint32 i = 0; i < a.count(); ++i)
+    {
+        const display_line& x = *a.get(i);
+        const display_line& y = *b.get(i);
+        if (x.m_len != y.m_len ||
+            (x.m_len && memcmp(x.m_chars, y.m_chars, x.m_len)) ||
+            (x.m_len && memcmp(x.m_faces, y.m_faces, x.m_len)) ||
+            x.m_start != y.m_start ||
+            x.m_end != y.m_end ||
+            x.m_x != y.m_x ||
+            x.m_lastcol != y.m_lastcol ||
+            x.m_lead != y.m_lead ||
+            x.m_trail != y.m_trail ||
+            x.m_newline != y.m_newline ||
+            x.m_toeol != y.m_toeol ||
+            x.m_scroll_mark != y.m_scroll_mark)
+        {
+            str_moveable xc, yc, xf, yf;
+            xc.concat(x.m_chars, x.m_len);
+            yc.concat(y.m_chars, y.m_len);
+            xf.concat(x.m_faces, x.m_len);
+            yf.concat(y.m_faces, y.m_len);
+            mismatch.format("line %u:  '%s' [%s] %u-%u lead %u trail %u  vs  '%s' [%s] %u-%u lead %u trail %u",
+                            i, xc.c_str(), xf.c_str(), x.m_start, x.m_end, x.m_lead, x.m_trail,
+                            yc.c_str(), yf.c_str(), y.m_start, y.m_end, y.m_lead, y.m_trail);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+bool compare_incremental_parse(uint32 width, uint32 prompt_botlin, uint32 col,
+                               const char* old_buffer, const char* new_buffer,
+                               const std::function<void()>& change,
+                               uint32 scroll_top, uint32 scroll_bottom,
+                               uint32& reused, str_base& mismatch)
+{
+    static char s_up[] = "\x1b[A";
+    rollback<int32> rb_width(_rl_screenwidth, int32(width));
+    rollback<char*> rb_up(_rl_term_up, s_up);
+    rollback<int32> rb_horz(_rl_horizontal_scroll_mode, 0);
+    rollback<int32> rb_end(rl_end);
+
+    display_lines prev;
+    rl_end = int32(strlen(old_buffer));
+    prev.parse(prompt_botlin, col, old_buffer, rl_end);
+    if (scroll_top < scroll_bottom && scroll_bottom < prev.count())
+    {
+        // The way display_manager marks the visible rows.
+        prev.set_top(scroll_top);
+        prev.apply_scroll_markers(scroll_top, scroll_bottom);
+    }
+
+    if (change)
+        change();
+
+    display_lines full;
+    display_lines incremental;
+    rl_end = int32(strlen(new_buffer));
+    full.parse(prompt_botlin, col, new_buffer, rl_end);
+    incremental.parse(prompt_botlin, col, new_buffer, rl_end, &prev);
+
+    reused = incremental.reused();
+    mismatch.clear();
+    return compare_display_lines(incremental, full, mismatch);
+}
+
 
 
 //------------------------------------------------------------------------------
@@ -1163,6 +1519,24 @@ void measure_columns::measure(const char* text, uint32 length, bool is_prompt)
     ecma48_iter iter(text, state, length);
     const char* last_lf = nullptr;
     bool wrapped = false;
+
+    auto advance = [&] (int32 n) {
+        if (wrapped)
+        {
+            wrapped = false;
+            ++m_line_count;
+        }
+        m_col += n;
+        if (m_col >= m_width)
+        {
+            if (is_prompt && m_mode == print && m_col == m_width)
+                wrapped = true; // Defer, for accurate measurement.
+            else
+                ++m_line_count;
+            m_col = (m_col > m_width) ? n : 0;
+        }
+    };
+
     while (const ecma48_code &code = iter.next())
     {
         switch (code.get_type())
@@ -1170,6 +1544,29 @@ void measure_columns::measure(const char* text, uint32 length, bool is_prompt)
         case ecma48_code::type_chars:
             for (wcwidth_iter i(code.get_pointer(), code.get_length()); i.more();)
             {
+                // Printable ASCII is one cell per character, so only the
+                // characters that reach the right edge need to be advanced
+                // one at a time.
+                if (uint32 run = i.next_ascii_run())
+                {
+                    while (run)
+                    {
+                        const int32 room = int32(m_width) - 1 - m_col;
+                        if (room > 0 && !wrapped)
+                        {
+                            const uint32 fits = min<uint32>(run, room);
+                            m_col += fits;
+                            run -= fits;
+                        }
+                        else
+                        {
+                            advance(1);
+                            --run;
+                        }
+                    }
+                    continue;
+                }
+
                 const uint32 c = i.next();
                 assert(c != '\n');          // See ecma48_code::c0_lf below.
                 assert(!CTRL_CHAR(c)); // See ecma48_code::type_c0 below.
@@ -1180,21 +1577,7 @@ void measure_columns::measure(const char* text, uint32 length, bool is_prompt)
                 }
                 else
                 {
-                    if (wrapped)
-                    {
-                        wrapped = false;
-                        ++m_line_count;
-                    }
-                    int32 n = i.character_wcwidth_onectrl();
-                    m_col += n;
-                    if (m_col >= m_width)
-                    {
-                        if (is_prompt && m_mode == print && m_col == m_width)
-                            wrapped = true; // Defer, for accurate measurement.
-                        else
-                            ++m_line_count;
-                        m_col = (m_col > m_width) ? n : 0;
-                    }
+                    advance(i.character_wcwidth_onectrl());
                 }
             }
             break;
@@ -1300,6 +1683,162 @@ COORD measure_readline_display(const char* prompt, const char* buffer, uint32 le
 
 
 
+//------------------------------------------------------------------------------
+// Prompt filters tend to produce the same prompt over and over, and every
+// forced redisplay reprocesses whatever prompt is current.  This remembers the
+// results for the last few prompts.  Slots are keyed by a hash of the text plus
+// anything else that affects the results, and the text itself is compared as
+// well to rule out hash collisions.
+class prompt_cache : public no_copy
+{
+public:
+    struct layout
+    {
+        int32           col;
+        int32           botlin;
+        int32           problems;
+        bool            force_wrap;
+    };
+
+    static prompt_cache& get();
+    void                bracket(const char* prompt, str_base& out, ecma48_processor_flags flags);
+    layout              measure(const char* prompt, bool modmark);
+    void                clear_layouts();
+
+private:
+    enum slot_kind { slot_empty, slot_bracket, slot_layout };
+    struct slot
+    {
+        slot_kind       kind = slot_empty;
+        uint32          param;
+        uint32          hash;
+        str_moveable    text;
+        str_moveable    bracketed;
+        str_moveable    title;
+        layout          measured;
+    };
+
+    slot*               find(slot_kind kind, uint32 param, const char* text, uint32 hash);
+    slot&               claim(slot_kind kind, uint32 param, const char* text, uint32 hash);
+
+    slot                m_slots[8];
+    uint32              m_next = 0;
+};
+
+//------------------------------------------------------------------------------
+prompt_cache& prompt_cache::get()
+{
+    static prompt_cache s_cache;
+    return s_cache;
+}
+
+//------------------------------------------------------------------------------
+void prompt_cache::bracket(const char* prompt, str_base& out, ecma48_processor_flags flags)
+{
+    const uint32 param = uint32(flags);
+    const uint32 hash = str_hash(prompt);
+    slot* s = find(slot_bracket, param, prompt, hash);
+    if (!s)
+    {
+        str_moveable bracketed;
+        str_moveable title;
+        bool visible_osc;
+        ecma48_processor(prompt, &bracketed, nullptr/*cell_count*/, flags, &title, &visible_osc);
+
+        // OSC codes with visible output, such as `ESC]9;8;"var"ST` which shows
+        // the value of an env var, can produce different output each time.
+        if (visible_osc)
+        {
+            out.concat(bracketed.c_str(), bracketed.length());
+            return;
+        }
+
+        s = &claim(slot_bracket, param, prompt, hash);
+        s->bracketed = std::move(bracketed);
+        s->title = std::move(title);
+    }
+    else if (!s->title.empty())
+    {
+        // Setting the title is a side effect, so it isn't skipped.
+        set_console_title(s->title.c_str());
+    }
+
+    out.concat(s->bracketed.c_str(), s->bracketed.length());
+}
+
+//------------------------------------------------------------------------------
+// Measures the last line of a prompt the way display_manager::display() needs
+// it, and also checks it for problem codes.
+prompt_cache::layout prompt_cache::measure(const char* prompt, bool modmark)
+{
+    const uint32 param = (uint32(_rl_screenwidth) << 1) | uint32(modmark);
+    const uint32 hash = str_hash(prompt);
+    slot* s = find(slot_layout, param, prompt, hash);
+    if (!s)
+    {
+        s = &claim(slot_layout, param, prompt, hash);
+
+        measure_columns mc(measure_columns::print);
+        if (modmark)
+            mc.measure("*", true);
+        mc.measure(prompt, true);
+
+        s->measured.col = mc.get_column();
+        s->measured.botlin = mc.get_line_count() - 1;
+        s->measured.problems = prompt_contains_problem_codes(prompt);
+        s->measured.force_wrap = mc.get_force_wrap();
+    }
+
+    return s->measured;
+}
+
+//------------------------------------------------------------------------------
+// Measurements depend on character widths, which depend on settings that can
+// change between input lines.
+void prompt_cache::clear_layouts()
+{
+    for (slot& s : m_slots)
+    {
+        if (s.kind == slot_layout)
+            s.kind = slot_empty;
+    }
+}
+
+//------------------------------------------------------------------------------
+prompt_cache::slot* prompt_cache::find(slot_kind kind, uint32 param, const char* text, uint32 hash)
+{
+    for (slot& s : m_slots)
+    {
+        if (s.kind == kind && s.param == param && s.hash == hash && s.text.equals(text))
+            return &s;
+    }
+    return nullptr;
+}
+
+//------------------------------------------------------------------------------
+prompt_cache::slot& prompt_cache::claim(slot_kind kind, uint32 param, const char* text, uint32 hash)
+{
+    slot& s = m_slots[m_next];
+    m_next = (m_next + 1) % sizeof_array(m_slots);
+
+    s.kind = kind;
+    s.param = param;
+    s.hash = hash;
+    s.text = text;
+    s.bracketed.clear();
+    s.title.clear();
+    s.measured = {};
+    return s;
+}
+
+//------------------------------------------------------------------------------
+void bracket_prompt(const char* prompt, str_base& out, ecma48_processor_flags flags)
+{
+    prompt_cache::get().bracket(prompt, out, flags);
+}
+
+
+
 //------------------------------------------------------------------------------
 void (*display_accumulator::s_saved_fwrite)(FILE*, const char*, int32) = nullptr;
 void (*display_accumulator::s_saved_fflush)(FILE*) = nullptr;
@@ -1451,12 +1990,14 @@ private:
 
     display_lines       m_next;
     display_lines       m_curr;
+    display_diff        m_diff;
     history_expansion*  m_histexpand = nullptr;
     uint32              m_top = 0;      // Vertical scrolling; index to top displayed line.
     str_moveable        m_last_rprompt;
     str_moveable        m_last_prompt_line;
     int32               m_last_prompt_line_width = -1;
     int32               m_last_prompt_line_botlin = -1;
+    int32               m_last_prompt_line_problems = 0;
     int32               m_last_point = -1;
     bool                m_last_modmark = false;
     bool                m_horz_scroll = false;
@@ -1525,6 +2066,7 @@ void display_manager::clear()
     m_last_prompt_line.clear();
     m_last_prompt_line_width = -1;
     m_last_prompt_line_botlin = -1;
+    m_last_prompt_line_problems = 0;
     m_last_point = -1;
     m_last_modmark = false;
     m_horz_scroll = false;
@@ -1841,13 +2383,11 @@ void display_manager::display()
     bool force_wrap = false;
     if (forced_display)
     {
-        measure_columns mc(measure_columns::print);
-        if (modmark)
-            mc.measure("*", true);
-        mc.measure(prompt, true);
-        force_wrap = mc.get_force_wrap();
-        m_last_prompt_line_width = mc.get_column();
-        m_last_prompt_line_botlin = mc.get_line_count() - 1;
+        const prompt_cache::layout layout = prompt_cache::get().measure(prompt, modmark);
+        force_wrap = layout.force_wrap;
+        m_last_prompt_line_width = layout.col;
+        m_last_prompt_line_botlin = layout.botlin;
+        m_last_prompt_line_problems = layout.problems;
     }
 
     // Activate horizontal scroll mode when requested or when necessary.
@@ -1872,7 +2412,7 @@ void display_manager::display()
         if (m_horz_scroll)
             update_next->horz_parse(m_last_prompt_line_botlin, m_last_prompt_line_width, rl_line_buffer, rl_point, rl_end, m_curr);
         else
-            update_next->parse(m_last_prompt_line_botlin, m_last_prompt_line_width, rl_line_buffer, rl_end);
+            update_next->parse(m_last_prompt_line_botlin, m_last_prompt_line_width, rl_line_buffer, rl_end, &m_curr);
         assert(update_next->count() > 0);
     }
 #define m_next __use_next_instead__ // Or use update_next if need_update is true.
@@ -1944,7 +2484,7 @@ void display_manager::display()
         if (is_message && _rl_display_message_color)
             rl_fwrite_function(_rl_out_stream, _rl_display_message_color, strlen(_rl_display_message_color));
 
-        if (prompt_contains_problem_codes(prompt) & BIT_PROMPT_PROBLEM)
+        if (m_last_prompt_line_problems & BIT_PROMPT_PROBLEM)
             m_curr.clear();
 
         rl_fwrite_function(_rl_out_stream, prompt, strlen(prompt));
@@ -2395,6 +2935,7 @@ void display_manager::update_line(int32 i, const display_line* o, const display_
     uint32 lind = 0;
     uint32 rind = d->m_len;
     int32 delta = 0;
+    bool planned = false;
 
     // If the old and new lines are identical, there's nothing to do.
     if (o &&
@@ -2544,6 +3085,15 @@ void display_manager::update_line(int32 i, const display_line* o, const display_
             dbg_printf_row(-1, "new=[%*s]\tdface='[%*s]'\r\n", dlen, dc, dlen, df);
         }
 #endif
+
+        // Plan the fewest bytes to update the changed range, rather than
+        // rewriting all of it.  Erasing to the end of the row is only an
+        // option when nothing after the range needs to be kept.
+        if (o->m_x == d->m_x && !has_rprompt && _rl_term_IC && _rl_term_DC && *_rl_term_DC)
+        {
+            const bool can_erase_tail = (oc2 == o->m_chars + o->m_len);
+            planned = m_diff.plan(oc, of, olen, dc, df, dlen, lcol, can_erase_tail);
+        }
     }
 
     assert(i >= m_top);
@@ -2551,6 +3101,43 @@ void display_manager::update_line(int32 i, const display_line* o, const display_
 
     move_to_row(row);
 
+    if (planned)
+    {
+        const char* const dc = d->m_chars + lind;
+        const char* const df = d->m_faces + lind;
+        for (const auto& op : m_diff.ops())
+        {
+            // Cells at or past the right edge were already pushed off by an
+            // insert, so there's nothing to remove or erase there.
+            const uint32 col = lcol + op.col;
+            if (col >= _rl_screenwidth)
+                break;
+
+            move_to_column(col);
+            switch (op.type)
+            {
+            case display_diff_op::write:
+                if (op.insert)
+                    shift_cols(col, min<int32>(op.insert, _rl_screenwidth - col - 1));
+                rl_puts_face_func(dc + op.offset, df + op.offset, op.bytes);
+                _rl_last_c_pos = col + op.count;
+                break;
+            case display_diff_op::remove:
+                if (op.count < _rl_screenwidth - col)
+                    shift_cols(col, -int32(op.count));
+                else
+                    _rl_clear_to_eol(_rl_screenwidth - col);
+                break;
+            case display_diff_op::erase:
+                _rl_clear_to_eol(_rl_screenwidth - col);
+                break;
+            }
+        }
+
+        detect_pending_wrap();
+        return;
+    }
+
     if (o && o->m_x > d->m_x)
     {
         move_to_column(d->m_x);
@@ -2882,6 +3469,7 @@ extern "C" void reset_display_readline(void)
 {
     s_transient_prompt_context = false;
     s_display_manager.on_new_line();
+    prompt_cache::get().clear_layouts();
 
 #ifdef REPORT_REDISPLAY
     s_calls = 0;
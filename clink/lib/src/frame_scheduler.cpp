@@ -0,0 +1,143 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+#include <assert.h>
+#include "frame_scheduler.h"
+
+#include <core/os.h>
+#include <core/settings.h>
+#include <terminal/terminal_in.h>
+
+//------------------------------------------------------------------------------
+static setting_int g_max_refresh_rate(
+    "clink.max_refresh_rate",
+    "Maximum redraws per second",
+    "This limits how often the input line is redrawn while input arrives faster\n"
+    "than it can be displayed, for example while pasting.  When this is 0, there\n"
+    "is no limit.",
+    120);
+
+//------------------------------------------------------------------------------
+static os::high_resolution_clock s_clock;
+static double s_last_frame = -1;
+
+//------------------------------------------------------------------------------
+frame_scheduler* frame_scheduler::s_armed = nullptr;
+
+//------------------------------------------------------------------------------
+frame_scheduler::defer_scope::defer_scope(frame_scheduler& frames)
+: m_prev(s_armed)
+{
+    s_armed = &frames;
+}
+
+//------------------------------------------------------------------------------
+frame_scheduler::defer_scope::~defer_scope()
+{
+    s_armed = m_prev;
+}
+
+
+
+//------------------------------------------------------------------------------
+frame_scheduler::frame_scheduler(terminal_in* input)
+: m_input(input)
+{
+}
+
+//------------------------------------------------------------------------------
+void frame_scheduler::reset()
+{
+    m_deferred_update = false;
+    m_deferred_display = false;
+}
+
+//------------------------------------------------------------------------------
+// Returns true if the line editor should skip updating (collecting words,
+// suggestions, and redisplaying) because more input is already queued, or
+// because more input arrives before the next frame is due.
+bool frame_scheduler::defer_update(bool input_pending)
+{
+    if (!input_pending)
+    {
+        const uint32 wait_ms = get_wait_ms();
+        input_pending = m_input->available(wait_ms);
+    }
+
+    m_deferred_update = input_pending;
+    return input_pending;
+}
+
+//------------------------------------------------------------------------------
+bool frame_scheduler::has_deferred() const
+{
+    return m_deferred_update || m_deferred_display;
+}
+
+//------------------------------------------------------------------------------
+bool frame_scheduler::take_deferred_display()
+{
+    const bool deferred = m_deferred_display;
+    m_deferred_display = false;
+    return deferred;
+}
+
+//------------------------------------------------------------------------------
+bool frame_scheduler::is_deferring(bool input_pending)
+{
+    return s_armed && s_armed->is_input_pending(input_pending);
+}
+
+//------------------------------------------------------------------------------
+// Called instead of redisplaying.  Returns true if the redisplay has been
+// deferred; the line editor redisplays once the queued input is processed.
+bool frame_scheduler::defer_display(bool input_pending)
+{
+    if (!is_deferring(input_pending))
+        return false;
+
+    s_armed->m_deferred_display = true;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Returns true if a redisplay was deferred and must happen now, for example
+// because the line is being accepted.  Nothing more gets deferred until the
+// active defer_scope ends.
+bool frame_scheduler::flush_display()
+{
+    if (!s_armed)
+        return false;
+
+    const bool deferred = s_armed->take_deferred_display();
+    s_armed = nullptr;
+    return deferred;
+}
+
+//------------------------------------------------------------------------------
+void frame_scheduler::on_display()
+{
+    s_last_frame = s_clock.elapsed();
+}
+
+//------------------------------------------------------------------------------
+bool frame_scheduler::is_input_pending(bool input_pending) const
+{
+    return input_pending || m_input->available(0);
+}
+
+//------------------------------------------------------------------------------
+// Returns how long until the next frame is due.
+uint32 frame_scheduler::get_wait_ms() const
+{
+    const int32 rate = g_max_refresh_rate.get();
+    if (rate <= 0 || s_last_frame < 0)
+        return 0;
+
+    const double remaining = (1.0 / rate) - (s_clock.elapsed() - s_last_frame);
+    if (remaining <= 0)
+        return 0;
+
+    return uint32(remaining * 1000 + 0.5);
+}
@@ -0,0 +1,48 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <core/base.h>
+
+class terminal_in;
+
+//------------------------------------------------------------------------------
+// Decides when the line editor redraws.  While more input is already queued,
+// redisplays (and the suggestions, classifications, and hints that go with
+// them) are deferred until the queued input has been processed, and redraws
+// are limited to the `clink.max_refresh_rate` setting.
+class frame_scheduler : public no_copy
+{
+public:
+    // Deferring displays is only allowed while a defer_scope is active.
+    class defer_scope : public no_copy
+    {
+    public:
+                        defer_scope(frame_scheduler& frames);
+                        ~defer_scope();
+    private:
+        frame_scheduler* m_prev;
+    };
+
+                        frame_scheduler(terminal_in* input);
+    void                reset();
+    bool                defer_update(bool input_pending);
+    bool                has_deferred() const;
+    bool                take_deferred_display();
+
+    static bool         is_deferring(bool input_pending);
+    static bool         defer_display(bool input_pending);
+    static bool         flush_display();
+    static void         on_display();
+
+private:
+    bool                is_input_pending(bool input_pending) const;
+    uint32              get_wait_ms() const;
+
+    terminal_in* const  m_input;
+    bool                m_deferred_update = false;
+    bool                m_deferred_display = false;
+
+    static frame_scheduler* s_armed;
+};
@@ -0,0 +1,392 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+#include "fuzzy_match.h"
+
+#include <core/str_compare.h>
+#include <core/str_iter.h>
+
+#include <algorithm>
+
+#if defined(ARCHITECTURE_x64) || defined(ARCHITECTURE_x86)
+#include <intrin.h>
+#include <emmintrin.h>
+#define USE_SSE2
+#endif
+
+//------------------------------------------------------------------------------
+// Scoring constants, the same as fzf's.
+static const int32 c_score_match = 16;
+static const int32 c_score_gap_start = -3;
+static const int32 c_score_gap_extension = -1;
+static const int32 c_bonus_boundary = c_score_match / 2;
+static const int32 c_bonus_non_word = c_score_match / 2;
+static const int32 c_bonus_camel123 = c_bonus_boundary + c_score_gap_extension;
+static const int32 c_bonus_consecutive = -(c_score_gap_start + c_score_gap_extension);
+static const int32 c_bonus_boundary_white = c_bonus_boundary + 2;
+static const int32 c_bonus_boundary_delimiter = c_bonus_boundary + 1;
+static const int32 c_bonus_first_char_multiplier = 2;
+
+//------------------------------------------------------------------------------
+enum char_class : uint8
+{
+    class_white,
+    class_non_word,
+    class_delimiter,
+    class_lower,
+    class_upper,
+    class_letter,                           // Bytes of non-ASCII characters.
+    class_number,
+};
+
+//------------------------------------------------------------------------------
+static char_class get_char_class(int32 c)
+{
+    if (c >= 'a' && c <= 'z')
+        return class_lower;
+    if (c >= 'A' && c <= 'Z')
+        return class_upper;
+    if (c >= '0' && c <= '9')
+        return class_number;
+    if (c >= 0x80)
+        return class_letter;
+    if (c == ' ' || c == '\t' || c == '\r' || c == '\n')
+        return class_white;
+    if (c && strchr("/\\,:;|", c))
+        return class_delimiter;
+    return class_non_word;
+}
+
+//------------------------------------------------------------------------------
+static int32 get_bonus(char_class prev, char_class curr)
+{
+    if (curr > class_non_word)
+    {
+        // Start of a word.
+        switch (prev)
+        {
+        case class_white:       return c_bonus_boundary_white;
+        case class_delimiter:   return c_bonus_boundary_delimiter;
+        case class_non_word:    return c_bonus_boundary;
+        }
+    }
+
+    if ((prev == class_lower && curr == class_upper) ||
+        (prev != class_number && curr == class_number))
+        return c_bonus_camel123;
+
+    switch (curr)
+    {
+    case class_non_word:
+    case class_delimiter:       return c_bonus_non_word;
+    case class_white:           return c_bonus_boundary_white;
+    }
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+// Finds the first byte in [p, end) that equals x or y.
+static const char* find_either(const char* p, const char* end, uint8 x, uint8 y)
+{
+#ifdef USE_SSE2
+    const __m128i vx = _mm_set1_epi8(char(x));
+    const __m128i vy = _mm_set1_epi8(char(y));
+    while (end - p >= 16)
+    {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        const __m128i eq = _mm_or_si128(_mm_cmpeq_epi8(chunk, vx), _mm_cmpeq_epi8(chunk, vy));
+        const uint32 mask = uint32(_mm_movemask_epi8(eq));
+        if (mask)
+        {
+            unsigned long bit;
+            _BitScanForward(&bit, mask);
+            return p + bit;
+        }
+        p += 16;
+    }
+#endif
+
+    for (; p < end; ++p)
+    {
+        if (uint8(*p) == x || uint8(*p) == y)
+            return p;
+    }
+    return nullptr;
+}
+
+//------------------------------------------------------------------------------
+static bool is_ascii(const char* p, const char* end)
+{
+#ifdef USE_SSE2
+    while (end - p >= 16)
+    {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        if (_mm_movemask_epi8(chunk))
+            return false;
+        p += 16;
+    }
+#endif
+
+    for (; p < end; ++p)
+    {
+        if (uint8(*p) >= 0x80)
+            return false;
+    }
+    return true;
+}
+
+
+
+//------------------------------------------------------------------------------
+fuzzy_matcher::fuzzy_matcher(const char* needle, bool caseless, bool relaxed, bool fuzzy_accents)
+: m_caseless(caseless)
+, m_relaxed(relaxed)
+, m_fuzzy_accents(fuzzy_accents)
+{
+    for (int32 c = 0; c < 0x80; ++c)
+    {
+        const int32 folded = fold_wide(c);
+        m_ascii_fold[c] = uint8((folded < 0x80) ? folded : c);
+    }
+
+    str_iter iter(needle);
+    while (iter.more())
+    {
+        const int32 c = fold(iter.next());
+        m_needle.push_back(c);
+        m_ascii = m_ascii && c < 0x80;
+    }
+
+    if (m_ascii)
+    {
+        for (int32 c : m_needle)
+        {
+            uint8 alt = uint8(c);
+            for (int32 other = 0; other < 0x80; ++other)
+            {
+                if (other != c && m_ascii_fold[other] == c)
+                    alt = uint8(other);
+            }
+
+            const char byte = char(c);
+            m_bytes.concat(&byte, 1);
+            m_alt.push_back(alt);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+int32 fuzzy_matcher::fold(int32 c) const
+{
+    return (c < 0x80) ? m_ascii_fold[c] : fold_wide(c);
+}
+
+//------------------------------------------------------------------------------
+int32 fuzzy_matcher::fold_wide(int32 c) const
+{
+    if (m_caseless && c <= 0xffff)
+        c = int32(uintptr_t(CharLowerW(LPWSTR(uintptr_t(c)))));
+    if (m_relaxed && c == '-')
+        c = '_';
+    if (c == '\\')
+        c = '/';
+    if (m_fuzzy_accents)
+        c = normalize_accent(c);
+    return c;
+}
+
+//------------------------------------------------------------------------------
+bool fuzzy_matcher::match(const char* text, int32& score) const
+{
+    return match(text, uint32(strlen(text)), score);
+}
+
+//------------------------------------------------------------------------------
+bool fuzzy_matcher::match(const char* text, uint32 len, int32& score) const
+{
+    score = 0;
+
+    const uint32 needle_len = uint32(m_needle.size());
+    if (!needle_len)
+        return true;
+    if (len < needle_len)
+        return false;
+
+    const char* const end = text + len;
+    if (!m_ascii || !is_ascii(text, end))
+        return match_wide(text, len, score);
+
+    // Forward scan:  find where the earliest match ends.  This rejects most
+    // non-matching text without ever looking at it byte by byte.
+    const uint8* needle = reinterpret_cast<const uint8*>(m_bytes.c_str());
+    const char* p = text;
+    const char* last = nullptr;
+    for (uint32 i = 0; i < needle_len; ++i)
+    {
+        last = find_either(p, end, needle[i], m_alt[i]);
+        if (!last)
+            return false;
+        p = last + 1;
+    }
+
+    const uint8* bytes = reinterpret_cast<const uint8*>(text);
+    const uint32 start = find_start(bytes, uint32(last - text));
+    score = calc_score(bytes, start, uint32(last - text) + 1);
+    return true;
+}
+
+//------------------------------------------------------------------------------
+bool fuzzy_matcher::match_wide(const char* text, uint32 len, int32& score) const
+{
+    std::vector<int32> chars;
+    chars.reserve(len);
+    str_iter iter(text, len);
+    while (iter.more())
+        chars.push_back(iter.next());
+
+    // Same as the forward scan in match().
+    const uint32 needle_len = uint32(m_needle.size());
+    uint32 n = 0;
+    uint32 last = 0;
+    for (uint32 i = 0; n < needle_len && i < chars.size(); ++i)
+    {
+        if (fold(chars[i]) == m_needle[n])
+        {
+            last = i;
+            ++n;
+        }
+    }
+    if (n < needle_len)
+        return false;
+
+    const uint32 start = find_start(chars.data(), last);
+    score = calc_score(chars.data(), start, last + 1);
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Backward scan:  find the latest start for a match that ends at `last`, which
+// yields the shortest window.
+template <class T>
+uint32 fuzzy_matcher::find_start(const T* text, uint32 last) const
+{
+    uint32 start = last;
+    for (int32 i = int32(m_needle.size()) - 1;; --start)
+    {
+        if (fold(int32(text[start])) == m_needle[i] && --i < 0)
+            break;
+    }
+    return start;
+}
+
+//------------------------------------------------------------------------------
+template <class T>
+int32 fuzzy_matcher::calc_score(const T* text, uint32 start, uint32 end) const
+{
+    const uint32 needle_len = uint32(m_needle.size());
+
+    int32 score = 0;
+    int32 consecutive = 0;
+    int32 first_bonus = 0;
+    bool in_gap = false;
+    uint32 n = 0;
+    char_class prev = start ? get_char_class(int32(text[start - 1])) : class_white;
+    for (uint32 i = start; i < end; ++i)
+    {
+        const int32 c = int32(text[i]);
+        const char_class curr = get_char_class(c);
+        if (n < needle_len && fold(c) == m_needle[n])
+        {
+            int32 bonus = get_bonus(prev, curr);
+            if (!consecutive)
+            {
+                first_bonus = bonus;
+            }
+            else
+            {
+                // Break consecutive chunks at word boundaries.
+                if (bonus >= c_bonus_boundary && bonus > first_bonus)
+                    first_bonus = bonus;
+                bonus = max<int32>(bonus, max<int32>(first_bonus, c_bonus_consecutive));
+            }
+
+            score += c_score_match;
+            score += n ? bonus : bonus * c_bonus_first_char_multiplier;
+            in_gap = false;
+            ++consecutive;
+            ++n;
+        }
+        else
+        {
+            score += in_gap ? c_score_gap_extension : c_score_gap_start;
+            in_gap = true;
+            consecutive = 0;
+            first_bonus = 0;
+        }
+        prev = curr;
+    }
+
+    return score;
+}
+
+
+
+//------------------------------------------------------------------------------
+// Short lists aren't worth the cost of starting threads.
+uint32 fuzzy_rank_threads(uint32 count)
+{
+    const uint32 c_min_items_per_thread = 10000;
+    const uint32 c_max_threads = 8;
+
+    uint32 threads = std::thread::hardware_concurrency();
+    threads = min(threads, c_max_threads);
+    threads = min(threads, count / c_min_items_per_thread);
+    return max(threads, 1u);
+}
+
+//------------------------------------------------------------------------------
+static bool is_better(const fuzzy_result& a, const fuzzy_result& b)
+{
+    if (a.score != b.score)
+        return a.score > b.score;
+    return a.index < b.index;
+}
+
+//------------------------------------------------------------------------------
+void fuzzy_sort(std::vector<fuzzy_result>& run)
+{
+    std::sort(run.begin(), run.end(), is_better);
+}
+
+//------------------------------------------------------------------------------
+// Merges runs that are each sorted best first.  There are only a handful of
+// runs (one per thread), so a linear pick of the best head is fine.
+void fuzzy_merge(std::vector<std::vector<fuzzy_result>>& runs, std::vector<fuzzy_result>& out)
+{
+    out.clear();
+    if (runs.size() == 1)
+    {
+        out = std::move(runs[0]);
+        return;
+    }
+
+    size_t total = 0;
+    for (const auto& run : runs)
+        total += run.size();
+    out.reserve(total);
+
+    std::vector<size_t> heads(runs.size(), 0);
+    while (out.size() < total)
+    {
+        size_t best = runs.size();
+        for (size_t r = 0; r < runs.size(); ++r)
+        {
+            if (heads[r] < runs[r].size() &&
+                (best == runs.size() || is_better(runs[r][heads[r]], runs[best][heads[best]])))
+                best = r;
+        }
+        out.push_back(runs[best][heads[best]++]);
+    }
+}
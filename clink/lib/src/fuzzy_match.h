@@ -0,0 +1,91 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <core/str.h>
+
+#include <thread>
+#include <vector>
+
+//------------------------------------------------------------------------------
+// Fuzzy matching in the style of fzf:  the needle matches if its characters
+// occur in order in the text, and the score favors matches that start words,
+// follow path separators or camel case humps, and run consecutively, and
+// penalizes gaps.  Like fzf's fast path, the score is computed over the
+// shortest window that ends where a greedy forward scan ends; the forward scan
+// uses SIMD where available, so non-matching text is rejected quickly.
+//
+// Characters compare the way str_compare() compares them:  caselessly when
+// caseless is set, with '-' and '_' equivalent when relaxed is set, ignoring
+// accents when fuzzy_accents is set, and with '\' and '/' always equivalent.
+// Text that is entirely ASCII is matched byte by byte; other text is decoded
+// first, since a non-ASCII character can fold to an ASCII one.
+class fuzzy_matcher
+{
+public:
+                    fuzzy_matcher(const char* needle, bool caseless, bool relaxed, bool fuzzy_accents=false);
+    bool            empty() const { return m_needle.empty(); }
+    bool            match(const char* text, int32& score) const;
+    bool            match(const char* text, uint32 len, int32& score) const;
+
+private:
+    int32           fold(int32 c) const;
+    int32           fold_wide(int32 c) const;
+    bool            match_wide(const char* text, uint32 len, int32& score) const;
+    template <class T> uint32 find_start(const T* text, uint32 last) const;
+    template <class T> int32 calc_score(const T* text, uint32 start, uint32 end) const;
+    std::vector<int32> m_needle;            // Folded characters.
+    str_moveable    m_bytes;                // Folded needle, if it's ASCII.
+    std::vector<uint8> m_alt;               // Other ASCII byte that folds to each needle byte.
+    uint8           m_ascii_fold[128];
+    bool            m_caseless;
+    bool            m_relaxed;
+    bool            m_fuzzy_accents;
+    bool            m_ascii = true;         // Whether the folded needle is ASCII.
+};
+
+//------------------------------------------------------------------------------
+struct fuzzy_result
+{
+    int32           index;                  // Negative if not a match.
+    int32           score;
+};
+
+uint32 fuzzy_rank_threads(uint32 count);
+void fuzzy_sort(std::vector<fuzzy_result>& run);
+void fuzzy_merge(std::vector<std::vector<fuzzy_result>>& runs, std::vector<fuzzy_result>& out);
+
+//------------------------------------------------------------------------------
+// Calls score_item(i) for each i in [0, count), and collects the matches best
+// first; ties keep ascending index order.  Long lists are split across worker
+// threads, each of which sorts its own matches, and then the sorted runs are
+// merged.  So score_item must be safe to call concurrently.
+template <class T>
+void fuzzy_rank(uint32 count, T&& score_item, std::vector<fuzzy_result>& out)
+{
+    const uint32 threads = fuzzy_rank_threads(count);
+    std::vector<std::vector<fuzzy_result>> runs(threads);
+
+    auto work = [&] (uint32 thread) {
+        const uint32 begin = uint32(uint64(count) * thread / threads);
+        const uint32 end = uint32(uint64(count) * (thread + 1) / threads);
+        std::vector<fuzzy_result>& run = runs[thread];
+        for (uint32 i = begin; i < end; ++i)
+        {
+            const fuzzy_result result = score_item(i);
+            if (result.index >= 0)
+                run.push_back(result);
+        }
+        fuzzy_sort(run);
+    };
+
+    std::vector<std::thread> workers;
+    for (uint32 thread = 1; thread < threads; ++thread)
+        workers.emplace_back(work, thread);
+    work(0);
+    for (auto& worker : workers)
+        worker.join();
+
+    fuzzy_merge(runs, out);
+}
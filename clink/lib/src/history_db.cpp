@@ -11,6 +11,7 @@
 #include <core/str.h>
 #include <core/str_tokeniser.h>
 #include <core/str_map.h>
+#include <core/str_hash.h>
 #include <core/auto_free_str.h>
 #include <core/path.h>
 #include <core/log.h>
@@ -23,10 +24,13 @@ extern "C" {
 #include <readline/rlprivate.h> // Needed for _rl_free_undo_list().
 #include <readline/history.h>
 #include <readline/histlib.h>   // Depends on config.h.
+#include <readline/xmalloc.h>
 }
 
 #include <algorithm>
+#include <atomic>
 #include <memory>
+#include <thread>
 #include <unordered_set>
 
 #include <core/debugheap.h>
@@ -210,6 +214,64 @@ union line_id_impl
 
 static const line_id_impl c_max_line_id(uint32(-1));
 
+//------------------------------------------------------------------------------
+inline bool is_line_breaker(uint8 c)
+{
+    return c == 0x00 || c == 0x0a || c == 0x0d;
+}
+
+
+
+//------------------------------------------------------------------------------
+// The master bank can have a sidecar index file next to it, with the same name
+// plus ".idx".  It has a record for each line in the bank, followed by a
+// footer.  The footer says how much of the bank the records cover, and which
+// ctag the bank had when they were written.
+//
+// The leading records are sorted by hash so lookups can binary search them.
+// Records for appended lines are appended unsorted, and once there are too
+// many of those they're merged into the sorted records.
+//
+// The sidecar is only a hint; the bank is always the authority.  A sidecar for
+// a different ctag is ignored, lines past what it covers are found by scanning
+// the bank (e.g. lines appended by versions of Clink that don't know about the
+// sidecar), and lines deleted in place still have records, so candidates found
+// through the sidecar are always confirmed against the bank.
+struct sidecar_record
+{
+    uint32          offset;         // Offset of the line in the bank.
+    uint32          hash;           // str_hash() of the line.
+    uint32          time;           // Timestamp of the line, or 0 if none.
+};
+
+struct sidecar_footer
+{
+    char            magic[4];
+    uint32          count;          // Number of records.
+    uint32          covered;        // Size of the bank the records cover.
+    uint32          sorted;         // Number of leading records sorted by hash.
+    char            ctag[64];       // Ctag of the bank, NUL terminated.
+};
+
+static_assert(sizeof(sidecar_record) == 12, "");
+static const char c_sidecar_magic[4] = { 'C', 'H', 'I', '1' };
+static const uint32 c_max_unsorted_sidecar_records = 256;
+
+//------------------------------------------------------------------------------
+static bool sidecar_record_less(const sidecar_record& a, const sidecar_record& b)
+{
+    if (a.hash != b.hash)
+        return a.hash < b.hash;
+    return a.offset < b.offset;
+}
+
+//------------------------------------------------------------------------------
+static void get_sidecar_path(const char* bank_path, str_base& out)
+{
+    out = bank_path;
+    out << ".idx";
+}
+
 
 
 //------------------------------------------------------------------------------
@@ -221,6 +283,11 @@ bank_handles::operator bool () const
 //------------------------------------------------------------------------------
 void bank_handles::close()
 {
+    if (m_handle_sidecar)
+    {
+        CloseHandle(m_handle_sidecar);
+        m_handle_sidecar = nullptr;
+    }
     if (m_handle_removals)
     {
         CloseHandle(m_handle_removals);
@@ -250,12 +317,14 @@ protected:
     bank_lock&      operator = (bank_lock&& other);
     void*           m_handle_lines = nullptr;       // From bank_master or bank_session.
     void*           m_handle_removals = nullptr;    // Always from bank_session, or nullptr.
+    void*           m_handle_sidecar = nullptr;     // Only from bank_master; not locked.
 };
 
 //------------------------------------------------------------------------------
 bank_lock::bank_lock(const bank_handles& handles, bool exclusive)
 : m_handle_lines(handles.m_handle_lines)
 , m_handle_removals(handles.m_handle_removals)
+, m_handle_sidecar(handles.m_handle_sidecar)
 {
     if (m_handle_lines == nullptr)
         return;
@@ -296,8 +365,10 @@ bank_lock& bank_lock::operator = (bank_lock&& other)
 {
     m_handle_lines = other.m_handle_lines;
     m_handle_removals = other.m_handle_removals;
+    m_handle_sidecar = other.m_handle_sidecar;
     other.m_handle_lines = nullptr;
     other.m_handle_removals = nullptr;
+    other.m_handle_sidecar = nullptr;
     return *this;
 }
 
@@ -351,11 +422,13 @@ public:
                             ~line_iter() = default;
         line_id_impl        next(str_iter& out, str_base* timestamp=nullptr, history_db::line_id* timestamp_id=nullptr);
         void                set_file_offset(uint32 offset);
+        void                set_tombstones(std::vector<uint32>* out) { m_tombstones = out; }
         uint32              get_deleted_count() const { return m_deleted; }
 
     private:
         bool                provision();
         file_iter           m_file_iter;
+        std::vector<uint32>* m_tombstones = nullptr;
         uint32              m_remaining = 0;
         uint32              m_deleted = 0;
         bool                m_first_line = true;
@@ -363,15 +436,52 @@ public:
         std::unordered_set<uint32> m_removals;
     };
 
+    // Same as line_iter, but maps the bank into memory instead of reading it
+    // through a buffer, so the returned lines point into the mapped view and
+    // are not NUL terminated.  The view is only valid while the iterator and
+    // the lock are alive; a mapped view prevents the file from being truncated,
+    // so it must not outlive the lock.  If the bank can't be mapped, it is read
+    // into a temporary copy instead.
+    class map_iter : public no_copy
+    {
+    public:
+                            map_iter(const read_lock& lock, uint32 start_offset=0);
+                            map_iter(const char* data, uint32 size);
+                            ~map_iter();
+        line_id_impl        next(str_iter& out, str_base* timestamp=nullptr, history_db::line_id* timestamp_id=nullptr);
+        uint32              get_deleted_count() const { return m_deleted; }
+
+    private:
+        void*               m_mapping = nullptr;
+        const char*         m_view = nullptr;
+        char*               m_copy = nullptr;
+        const char*         m_base = nullptr;
+        const char*         m_next = nullptr;
+        const char*         m_end = nullptr;
+        uint32              m_base_offset = 0;
+        uint32              m_deleted = 0;
+        bool                m_first_line = true;
+        std::unordered_set<uint32> m_removals;
+    };
+
     explicit                read_lock() = default;
     explicit                read_lock(const bank_handles& handles, bool exclusive=false);
     line_id_impl            find(const char* line) const;
-    template <class T> void find(const char* line, T&& callback) const;
+    template <class T> void find(const char* line, T&& callback, uint32 start_offset=0) const;
+    bool                    line_equals(uint32 offset, const char* line, uint32 length) const;
+    bool                    read_line(uint32 offset, str_base& out) const;
+    uint32                  get_file_size() const;
+    uint32                  get_removals_size() const;
+    unsigned __int64        get_write_time() const;
+    uint32                  read_bytes(uint32 offset, char* out, uint32 length) const;
+    bool                    read_sidecar(sidecar_footer& footer, std::vector<sidecar_record>* records=nullptr) const;
+    bool                    find_sidecar(const sidecar_footer& footer, uint32 hash, std::vector<uint32>& offsets) const;
     int32                   apply_removals(write_lock& lock) const;
-    int32                   collect_removals(write_lock& lock, std::vector<line_id_impl>& removals) const;
+    int32                   collect_removals(const read_lock& target, std::vector<line_id_impl>& removals, uint32 start_offset=0) const;
 
 private:
-    template <typename T> int32 for_each_removal(const read_lock& target, T&& callback) const;
+    template <typename T> int32 for_each_removal(const read_lock& target, T&& callback, uint32 start_offset=0) const;
+    uint32                  read_sidecar_records(uint32 index, uint32 count, sidecar_record* out) const;
 };
 
 //------------------------------------------------------------------------------
@@ -382,9 +492,14 @@ public:
                     write_lock() = default;
     explicit        write_lock(const bank_handles& handles);
     void            clear();
-    line_id_impl    add(const char* line);
+    line_id_impl    add(const char* line, uint32 time=0);
     bool            remove(line_id_impl id);
     void            append(const read_lock& src);
+    bool            replace(const char* data, uint32 length);
+    void            write_sidecar(std::vector<sidecar_record>& records, const char* ctag);
+
+private:
+    void            append_sidecar(uint32 offset, const std::vector<sidecar_record>& records);
 };
 
 //------------------------------------------------------------------------------
@@ -400,10 +515,12 @@ read_lock::read_lock(const bank_handles& handles, bool exclusive)
 }
 
 //------------------------------------------------------------------------------
-template <class T> void read_lock::find(const char* line, T&& callback) const
+template <class T> void read_lock::find(const char* line, T&& callback, uint32 start_offset) const
 {
     history_read_buffer buffer;
     line_iter iter(*this, buffer.data(), buffer.size());
+    if (start_offset)
+        iter.set_file_offset(start_offset);
 
     line_id_impl id;
     for (str_iter read; id = iter.next(read);)
@@ -434,6 +551,200 @@ line_id_impl read_lock::find(const char* line) const
     return id;
 }
 
+//------------------------------------------------------------------------------
+bool read_lock::line_equals(uint32 offset, const char* line, uint32 length) const
+{
+    // Read one extra byte so the line terminator can be verified as well.
+    char stack_buffer[256];
+    char* buffer = stack_buffer;
+    if (length + 1 > sizeof(stack_buffer))
+    {
+        buffer = static_cast<char*>(malloc(length + 1));
+        if (!buffer)
+            return false;
+    }
+
+    bool equal = false;
+    const uint32 file_ptr = SetFilePointer(m_handle_lines, 0, nullptr, FILE_CURRENT);
+    if (SetFilePointer(m_handle_lines, offset, nullptr, FILE_BEGIN) != INVALID_SET_FILE_POINTER)
+    {
+        DWORD read = 0;
+        if (ReadFile(m_handle_lines, buffer, length + 1, &read, nullptr) &&
+            read >= length &&
+            memcmp(buffer, line, length) == 0)
+        {
+            equal = (read == length || is_line_breaker(buffer[length]));
+        }
+    }
+    SetFilePointer(m_handle_lines, file_ptr, nullptr, FILE_BEGIN);
+
+    if (buffer != stack_buffer)
+        free(buffer);
+    return equal;
+}
+
+//------------------------------------------------------------------------------
+bool read_lock::read_line(uint32 offset, str_base& out) const
+{
+    out.clear();
+
+    const uint32 file_ptr = SetFilePointer(m_handle_lines, 0, nullptr, FILE_CURRENT);
+    if (SetFilePointer(m_handle_lines, offset, nullptr, FILE_BEGIN) != INVALID_SET_FILE_POINTER)
+    {
+        char chunk[256];
+        DWORD read;
+        while (ReadFile(m_handle_lines, chunk, sizeof(chunk), &read, nullptr) && read)
+        {
+            DWORD len = 0;
+            while (len < read && !is_line_breaker(chunk[len]))
+                ++len;
+            out.concat(chunk, len);
+            if (len < read)
+                break;
+        }
+    }
+    SetFilePointer(m_handle_lines, file_ptr, nullptr, FILE_BEGIN);
+
+    return !out.empty();
+}
+
+//------------------------------------------------------------------------------
+uint32 read_lock::get_file_size() const
+{
+    return GetFileSize(m_handle_lines, nullptr);
+}
+
+//------------------------------------------------------------------------------
+uint32 read_lock::get_removals_size() const
+{
+    return m_handle_removals ? GetFileSize(m_handle_removals, nullptr) : 0;
+}
+
+//------------------------------------------------------------------------------
+unsigned __int64 read_lock::get_write_time() const
+{
+    FILETIME ft;
+    if (!GetFileTime(m_handle_lines, nullptr, nullptr, &ft))
+        return 0;
+    return (unsigned __int64(ft.dwHighDateTime) << 32) | ft.dwLowDateTime;
+}
+
+//------------------------------------------------------------------------------
+uint32 read_lock::read_bytes(uint32 offset, char* out, uint32 length) const
+{
+    DWORD read = 0;
+    if (SetFilePointer(m_handle_lines, offset, nullptr, FILE_BEGIN) == INVALID_SET_FILE_POINTER ||
+        !ReadFile(m_handle_lines, out, length, &read, nullptr))
+        return 0;
+    return read;
+}
+
+//------------------------------------------------------------------------------
+bool read_lock::read_sidecar(sidecar_footer& footer, std::vector<sidecar_record>* records) const
+{
+    if (!m_handle_sidecar)
+        return false;
+
+    DWORD read = 0;
+    const DWORD size = GetFileSize(m_handle_sidecar, nullptr);
+    if (size == INVALID_FILE_SIZE ||
+        size < sizeof(footer) ||
+        (size - sizeof(footer)) % sizeof(sidecar_record) != 0 ||
+        SetFilePointer(m_handle_sidecar, LONG(size - sizeof(footer)), nullptr, FILE_BEGIN) == INVALID_SET_FILE_POINTER ||
+        !ReadFile(m_handle_sidecar, &footer, sizeof(footer), &read, nullptr) ||
+        read != sizeof(footer))
+        return false;
+
+    footer.ctag[sizeof(footer.ctag) - 1] = '\0';
+    if (memcmp(footer.magic, c_sidecar_magic, sizeof(footer.magic)) != 0 ||
+        footer.count != (size - sizeof(footer)) / sizeof(sidecar_record) ||
+        footer.sorted > footer.count)
+        return false;
+
+    // The records are only meaningful for the bank they were written for.
+    char ctag[sizeof(footer.ctag)];
+    const uint32 ctag_len = uint32(strlen(footer.ctag));
+    if (ctag_len < 6 ||
+        footer.covered > get_file_size() ||
+        read_bytes(0, ctag, ctag_len + 1) != ctag_len + 1 ||
+        memcmp(ctag, footer.ctag, ctag_len) != 0 ||
+        !is_line_breaker(ctag[ctag_len]))
+        return false;
+
+    if (records)
+    {
+        records->resize(footer.count);
+        if (read_sidecar_records(0, footer.count, records->data()) != footer.count)
+            return false;
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Collects the offsets of the lines whose records match hash, in bank order.
+// The sorted records are binary searched, so only the unsorted records are
+// read in full.
+bool read_lock::find_sidecar(const sidecar_footer& footer, uint32 hash, std::vector<uint32>& offsets) const
+{
+    sidecar_record record;
+    uint32 lo = 0;
+    uint32 hi = footer.sorted;
+    while (lo < hi)
+    {
+        const uint32 mid = lo + (hi - lo) / 2;
+        if (!read_sidecar_records(mid, 1, &record))
+            return false;
+        if (record.hash < hash)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    sidecar_record chunk[16];
+    for (uint32 index = lo; index < footer.sorted;)
+    {
+        const uint32 count = read_sidecar_records(index, min<uint32>(sizeof_array(chunk), footer.sorted - index), chunk);
+        if (!count)
+            return false;
+        uint32 i = 0;
+        while (i < count && chunk[i].hash == hash)
+            offsets.push_back(chunk[i++].offset);
+        if (i < count)
+            break;
+        index += count;
+    }
+
+    const uint32 unsorted = footer.count - footer.sorted;
+    if (unsorted)
+    {
+        std::vector<sidecar_record> records(unsorted);
+        if (read_sidecar_records(footer.sorted, unsorted, records.data()) != unsorted)
+            return false;
+        for (const sidecar_record& r : records)
+        {
+            if (r.hash == hash)
+                offsets.push_back(r.offset);
+        }
+    }
+
+    std::sort(offsets.begin(), offsets.end());
+    return true;
+}
+
+//------------------------------------------------------------------------------
+uint32 read_lock::read_sidecar_records(uint32 index, uint32 count, sidecar_record* out) const
+{
+    if (!count)
+        return 0;
+
+    DWORD read = 0;
+    if (SetFilePointer(m_handle_sidecar, LONG(index * sizeof(sidecar_record)), nullptr, FILE_BEGIN) == INVALID_SET_FILE_POINTER ||
+        !ReadFile(m_handle_sidecar, out, DWORD(count * sizeof(sidecar_record)), &read, nullptr))
+        return 0;
+    return uint32(read / sizeof(sidecar_record));
+}
+
 //------------------------------------------------------------------------------
 int32 read_lock::apply_removals(write_lock& lock) const
 {
@@ -445,16 +756,16 @@ int32 read_lock::apply_removals(write_lock& lock) const
 }
 
 //------------------------------------------------------------------------------
-int32 read_lock::collect_removals(write_lock& lock, std::vector<line_id_impl>& removals) const
+int32 read_lock::collect_removals(const read_lock& target, std::vector<line_id_impl>& removals, uint32 start_offset) const
 {
-    return for_each_removal(lock, [&] (uint32 offset)
+    return for_each_removal(target, [&] (uint32 offset)
     {
         removals.emplace_back(offset);
-    });
+    }, start_offset);
 }
 
 //------------------------------------------------------------------------------
-template <typename T> int32 read_lock::for_each_removal(const read_lock& target, T&& callback) const
+template <typename T> int32 read_lock::for_each_removal(const read_lock& target, T&& callback, uint32 start_offset) const
 {
     if (!m_handle_removals)
         return 0;
@@ -507,6 +818,8 @@ template <typename T> int32 read_lock::for_each_removal(const read_lock& target,
     // Read removal offsets; call the specified callback for each offset.
     str_iter value;
     line_iter iter(m_handle_removals, tmp);
+    if (start_offset)
+        iter.set_file_offset(start_offset);
     while (iter.next(value))
     {
         unsigned __int64 offset = 0;
@@ -600,8 +913,9 @@ void read_lock::file_iter::set_file_offset(uint32 offset)
     m_remaining = GetFileSize(m_handle, nullptr);
     offset = clamp(offset, (uint32)0, m_remaining);
     m_remaining -= offset;
-    // BUGBUG: Should this be `offset - m_buffer_offset`?
-    m_buffer_offset = static_cast<unsigned __int64>(0) - m_buffer_size;
+    // The next call to next() advances m_buffer_offset by m_buffer_size, so
+    // back it up by that much to make the next buffer start at offset.
+    m_buffer_offset = static_cast<unsigned __int64>(offset) - m_buffer_size;
     SetFilePointer(m_handle, offset, nullptr, FILE_BEGIN);
     m_buffer[0] = '\0';
 }
@@ -642,12 +956,6 @@ bool read_lock::line_iter::provision()
     return !!(m_remaining = m_file_iter.next(m_remaining));
 }
 
-//------------------------------------------------------------------------------
-inline bool is_line_breaker(uint8 c)
-{
-    return c == 0x00 || c == 0x0a || c == 0x0d;
-}
-
 //------------------------------------------------------------------------------
 line_id_impl read_lock::line_iter::next(str_iter& out, str_base* timestamp, history_db::line_id* timestamp_id)
 {
@@ -731,6 +1039,20 @@ line_id_impl read_lock::line_iter::next(str_iter& out, str_base* timestamp, hist
                 timestamp->clear();
             if (timestamp_id)
                 *timestamp_id = 0;
+
+            // Tombstones say which line was deleted in place; they aren't
+            // deleted lines themselves.
+            if (end - start > 6 && strncmp(start, "|\tdel=", 6) == 0)
+            {
+                if (m_tombstones)
+                {
+                    uint32 deleted = 0;
+                    for (const char* digit = start + 6; digit < end && *digit >= '0' && *digit <= '9'; ++digit)
+                        deleted = deleted * 10 + (*digit - '0');
+                    m_tombstones->push_back(deleted);
+                }
+                continue;
+            }
         }
 
         // Removals from master are deferred when `history.shared` is false, so
@@ -754,11 +1076,169 @@ line_id_impl read_lock::line_iter::next(str_iter& out, str_base* timestamp, hist
 void read_lock::line_iter::set_file_offset(uint32 offset)
 {
     m_file_iter.set_file_offset(offset);
+    m_remaining = 0;
+    m_first_line = (offset == 0);
     m_eating_ctag = false;
 }
 
 
 
+//------------------------------------------------------------------------------
+read_lock::map_iter::map_iter(const read_lock& lock, uint32 start_offset)
+{
+    lock.for_each_removal(lock, [&] (uint32 offset)
+    {
+        m_removals.insert(offset);
+    });
+
+    const uint32 size = lock.get_file_size();
+    if (size == INVALID_FILE_SIZE || start_offset >= size)
+        return;
+
+    // A view must start at a multiple of the allocation granularity.
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    const uint32 view_offset = start_offset - (start_offset % info.dwAllocationGranularity);
+
+    m_mapping = CreateFileMappingW(lock.m_handle_lines, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (m_mapping)
+        m_view = static_cast<const char*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, view_offset, size - view_offset));
+
+    if (m_view)
+    {
+        m_base = m_view;
+        m_base_offset = view_offset;
+    }
+    else
+    {
+        m_copy = static_cast<char*>(malloc(size - start_offset));
+        if (!m_copy)
+            return;
+
+        DWORD read = 0;
+        SetFilePointer(lock.m_handle_lines, start_offset, nullptr, FILE_BEGIN);
+        ReadFile(lock.m_handle_lines, m_copy, size - start_offset, &read, nullptr);
+
+        m_base = m_copy;
+        m_base_offset = start_offset;
+        m_end = m_copy + read;
+    }
+
+    m_next = m_base + (start_offset - m_base_offset);
+    if (!m_end)
+        m_end = m_base + (size - m_base_offset);
+    m_first_line = (start_offset == 0);
+}
+
+//------------------------------------------------------------------------------
+read_lock::map_iter::map_iter(const char* data, uint32 size)
+: m_base(data)
+, m_next(data)
+, m_end(data + size)
+{
+}
+
+//------------------------------------------------------------------------------
+read_lock::map_iter::~map_iter()
+{
+    if (m_view)
+        UnmapViewOfFile(m_view);
+    if (m_mapping)
+        CloseHandle(m_mapping);
+    free(m_copy);
+}
+
+//------------------------------------------------------------------------------
+line_id_impl read_lock::map_iter::next(str_iter& out, str_base* timestamp, history_db::line_id* timestamp_id)
+{
+    if (timestamp)
+        timestamp->clear();
+    if (timestamp_id)
+        *timestamp_id = 0;
+
+    while (true)
+    {
+        const char* start = m_next;
+        while (start < m_end && is_line_breaker(*start))
+            ++start;
+        if (start >= m_end)
+            break;
+
+        const char* end = start;
+        while (end < m_end && !is_line_breaker(*end))
+            ++end;
+        m_next = end;
+
+        const uint32 bytes = uint32(end - start);
+        const bool first_line = m_first_line;
+        m_first_line = false;
+
+        const unsigned __int64 real_offset = m_base_offset + (start - m_base);
+        const bool too_big = (real_offset >= c_max_line_id.offset);
+        assert(!too_big);
+        const uint32 offset = too_big ? c_max_line_id.offset : uint32(real_offset);
+
+        // Same rules as line_iter::next(), except the whole bank is available
+        // so the ctag line can simply be skipped.
+        if (*start == '|')
+        {
+            if (first_line && bytes >= 6 && strncmp(start, "|CTAG_", 6) == 0)
+                continue;
+            if (bytes >= 7 && strncmp(start, "|\ttime=", 7) == 0)
+            {
+                if (timestamp)
+                {
+                    timestamp->clear();
+                    timestamp->concat(start + 7, int32(bytes - 7));
+                }
+                if (timestamp_id)
+                    *timestamp_id = line_id_impl(offset).outer;
+                continue;
+            }
+            if (timestamp)
+                timestamp->clear();
+            if (timestamp_id)
+                *timestamp_id = 0;
+            if (bytes > 6 && strncmp(start, "|\tdel=", 6) == 0)
+                continue;
+        }
+
+        if (*start == '|' || (!too_big && m_removals.find(offset) != m_removals.end()))
+        {
+            ++m_deleted;
+            continue;
+        }
+
+        new (&out) str_iter(start, int32(bytes));
+
+        return line_id_impl(offset);
+    }
+
+    return line_id_impl();
+}
+
+
+
+//------------------------------------------------------------------------------
+// Makes sidecar records for the lines in data, which is the part of a bank that
+// starts at base_offset.
+static void collect_sidecar_records(const char* data, uint32 size, uint32 base_offset, std::vector<sidecar_record>& out)
+{
+    read_lock::map_iter iter(data, size);
+    str_iter line;
+    str<32> time;
+    while (const line_id_impl id = iter.next(line, &time))
+    {
+        const uint32 offset = base_offset + id.offset;
+        if (offset >= c_max_line_id.offset)
+            break;
+        const uint32 hash = str_hash(line.get_pointer(), line.length());
+        out.push_back({ offset, hash, uint32(strtoul(time.c_str(), nullptr, 10)) });
+    }
+}
+
+
+
 //------------------------------------------------------------------------------
 write_lock::write_lock(const bank_handles& handles)
 : read_lock(handles, true)
@@ -775,17 +1255,42 @@ void write_lock::clear()
         SetFilePointer(m_handle_removals, 0, nullptr, FILE_BEGIN);
         SetEndOfFile(m_handle_removals);
     }
+    if (m_handle_sidecar)
+    {
+        SetFilePointer(m_handle_sidecar, 0, nullptr, FILE_BEGIN);
+        SetEndOfFile(m_handle_sidecar);
+    }
 }
 
 //------------------------------------------------------------------------------
-line_id_impl write_lock::add(const char* line)
+line_id_impl write_lock::add(const char* line, uint32 time)
 {
     DWORD written;
-    const DWORD offset = SetFilePointer(m_handle_lines, 0, nullptr, FILE_END);
-    if (offset == INVALID_SET_FILE_POINTER)
+    const DWORD start = SetFilePointer(m_handle_lines, 0, nullptr, FILE_END);
+    if (start == INVALID_SET_FILE_POINTER)
         return line_id_impl();
-    WriteFile(m_handle_lines, line, int32(strlen(line)), &written, nullptr);
+
+    DWORD offset = start;
+    if (time)
+    {
+        str<32> timestamp;
+        timestamp.format("|\ttime=%u\n", time);
+        WriteFile(m_handle_lines, timestamp.c_str(), timestamp.length(), &written, nullptr);
+        offset += timestamp.length();
+    }
+
+    const uint32 length = uint32(strlen(line));
+    WriteFile(m_handle_lines, line, length, &written, nullptr);
     WriteFile(m_handle_lines, "\n", 1, &written, nullptr);
+
+    if (m_handle_sidecar && offset < c_max_line_id.offset)
+    {
+        std::vector<sidecar_record> records;
+        if (line[0] != '|')
+            records.push_back({ uint32(offset), str_hash(line, length), time });
+        append_sidecar(start, records);
+    }
+
     if (offset >= c_max_line_id.offset)
         return c_max_line_id;
     return line_id_impl(offset);
@@ -815,6 +1320,19 @@ bool write_lock::remove(line_id_impl id)
         DWORD written;
         SetFilePointer(m_handle_lines, id.offset, nullptr, FILE_BEGIN);
         WriteFile(m_handle_lines, "|", 1, &written, nullptr);
+
+        // Other sessions only read what was appended to the master bank since
+        // they last loaded, so also append a tombstone that tells them which
+        // line was deleted.  Session banks are only read by their own session.
+        if (id.bank_index == bank_master)
+        {
+            str<32> tombstone;
+            tombstone.format("|\tdel=%u\n", id.offset);
+            const DWORD start = SetFilePointer(m_handle_lines, 0, nullptr, FILE_END);
+            WriteFile(m_handle_lines, tombstone.c_str(), tombstone.length(), &written, nullptr);
+            if (m_handle_sidecar && start != INVALID_SET_FILE_POINTER)
+                append_sidecar(start, std::vector<sidecar_record>());
+        }
     }
 
     return true;
@@ -824,19 +1342,106 @@ bool write_lock::remove(line_id_impl id)
 void write_lock::append(const read_lock& src)
 {
     DWORD written;
-
-    SetFilePointer(m_handle_lines, 0, nullptr, FILE_END);
+    const DWORD start = SetFilePointer(m_handle_lines, 0, nullptr, FILE_END);
 
     history_read_buffer buffer;
     read_lock::file_iter src_iter(src, buffer.data(), buffer.size());
     while (int32 bytes_read = src_iter.next())
         WriteFile(m_handle_lines, buffer.data(), bytes_read, &written, nullptr);
-}
-
 
+    // Session banks are small, so the appended lines are simply read back to
+    // extend the sidecar.
+    if (m_handle_sidecar && start != INVALID_SET_FILE_POINTER)
+    {
+        const uint32 size = get_file_size() - start;
+        std::vector<char> data(size);
+        if (read_bytes(start, data.data(), size) == size)
+        {
+            std::vector<sidecar_record> records;
+            collect_sidecar_records(data.data(), size, start, records);
+            append_sidecar(start, records);
+        }
+    }
+}
 
 //------------------------------------------------------------------------------
-class read_line_iter
+// Overwrites the bank with data.  The bank is only truncated if all of data was
+// written; otherwise it returns false.
+bool write_lock::replace(const char* data, uint32 length)
+{
+    DWORD written = 0;
+    if (SetFilePointer(m_handle_lines, 0, nullptr, FILE_BEGIN) == INVALID_SET_FILE_POINTER ||
+        !WriteFile(m_handle_lines, data, length, &written, nullptr) ||
+        written != length)
+        return false;
+    return !!SetEndOfFile(m_handle_lines);
+}
+
+//------------------------------------------------------------------------------
+// Replaces the sidecar with records that cover the whole bank.  The records are
+// sorted by hash in place.
+void write_lock::write_sidecar(std::vector<sidecar_record>& records, const char* ctag)
+{
+    if (!m_handle_sidecar)
+        return;
+
+    std::sort(records.begin(), records.end(), sidecar_record_less);
+
+    sidecar_footer footer = {};
+    memcpy(footer.magic, c_sidecar_magic, sizeof(footer.magic));
+    footer.count = uint32(records.size());
+    footer.sorted = footer.count;
+    footer.covered = get_file_size();
+    const size_t ctag_len = strlen(ctag);
+    if (ctag_len < sizeof(footer.ctag))
+        memcpy(footer.ctag, ctag, ctag_len);
+
+    DWORD written;
+    SetFilePointer(m_handle_sidecar, 0, nullptr, FILE_BEGIN);
+    SetEndOfFile(m_handle_sidecar);
+    if (!records.empty())
+        WriteFile(m_handle_sidecar, records.data(), DWORD(records.size() * sizeof(sidecar_record)), &written, nullptr);
+    WriteFile(m_handle_sidecar, &footer, sizeof(footer), &written, nullptr);
+}
+
+//------------------------------------------------------------------------------
+// Extends the sidecar with records for lines appended at offset.  The sidecar
+// is left alone unless it covers exactly up to offset; a sidecar that falls
+// behind is rebuilt by the next full load.
+void write_lock::append_sidecar(uint32 offset, const std::vector<sidecar_record>& records)
+{
+    sidecar_footer footer;
+    if (!read_sidecar(footer) || footer.covered != offset)
+        return;
+
+    // Too many unsorted records would make lookups scan again, so then the
+    // whole sidecar is rewritten sorted instead.
+    if (footer.count - footer.sorted + records.size() > c_max_unsorted_sidecar_records)
+    {
+        std::vector<sidecar_record> all;
+        if (read_sidecar(footer, &all))
+        {
+            all.insert(all.end(), records.begin(), records.end());
+            write_sidecar(all, footer.ctag);
+            return;
+        }
+    }
+
+    // The records overwrite the old footer.  If writing is interrupted the size
+    // no longer matches the count, so the sidecar is ignored until rebuilt.
+    DWORD written;
+    SetFilePointer(m_handle_sidecar, LONG(footer.count * sizeof(sidecar_record)), nullptr, FILE_BEGIN);
+    if (!records.empty())
+        WriteFile(m_handle_sidecar, records.data(), DWORD(records.size() * sizeof(sidecar_record)), &written, nullptr);
+    footer.count += uint32(records.size());
+    footer.covered = get_file_size();
+    WriteFile(m_handle_sidecar, &footer, sizeof(footer), &written, nullptr);
+}
+
+
+
+//------------------------------------------------------------------------------
+class read_line_iter
 {
 public:
                             read_line_iter(const history_db& db, uint32 this_size);
@@ -1112,6 +1717,359 @@ static void rewrite_master_bank(write_lock& lock, size_t limit=0, size_t* _kept=
     }
 }
 
+//------------------------------------------------------------------------------
+// Compacts the master bank without holding its lock while the bank is parsed
+// and rebuilt.  The bank is copied under a read lock, the compacted bank is
+// built in memory, and then it's written over the bank under a brief write
+// lock, after folding in whatever other sessions changed in the meantime.
+//
+// Every session keeps the bank open without FILE_SHARE_DELETE, so the bank
+// can't be swapped by renaming a temporary file; it's overwritten in a single
+// write instead.  A task uses its own file handles and doesn't touch any
+// history_db state, so it can run on a background thread.
+struct compact_task
+{
+    bool                run();
+
+    // Inputs.
+    str_moveable        m_master_path;
+    std::vector<str_moveable> m_session_paths;
+    size_t              m_limit = 0;
+    bool                m_uniq = false;
+    void                (*m_before_write)() = nullptr;
+
+    // Results.
+    concurrency_tag     m_ctag;
+    const char*         m_abandoned = nullptr;  // Reason, if not compacted.
+    size_t              m_kept = 0;
+    size_t              m_deleted = 0;
+    size_t              m_dups = 0;
+    uint32              m_tail = 0;             // Bytes appended meanwhile.
+    double              m_read_ms = 0;
+    double              m_build_ms = 0;
+    double              m_write_ms = 0;
+
+    std::unique_ptr<std::thread> m_thread;
+    std::atomic<bool>   m_done { false };
+
+private:
+    struct keep_line
+    {
+        const char*     m_line;
+        const char*     m_time;                 // Whole timestamp line.
+        uint32          m_line_len;
+        uint32          m_time_len;
+        uint32          m_old;
+        uint32          m_old_time;
+        uint32          m_new;
+    };
+
+    bool                run(const bank_handles& handles);
+    uint32              translate(uint32 offset) const;
+
+    std::vector<std::pair<uint32, uint32>> m_remap;
+    uint32              m_snapshot_size = 0;
+    uint32              m_tail_offset = 0;
+};
+
+//------------------------------------------------------------------------------
+bool compact_task::run()
+{
+    bank_handles handles;
+    handles.m_handle_lines = open_file(m_master_path.c_str(), true/*if_exists*/);
+    if (!handles)
+    {
+        m_abandoned = "can't open master bank";
+        return false;
+    }
+
+    str<280> sidecar;
+    get_sidecar_path(m_master_path.c_str(), sidecar);
+    handles.m_handle_sidecar = open_file(sidecar.c_str());
+
+    const bool ok = run(handles);
+    handles.close();
+    return ok;
+}
+
+//------------------------------------------------------------------------------
+bool compact_task::run(const bank_handles& handles)
+{
+    // Copy the bank.  The copy gets NUL terminated lines, so it needs room for
+    // a terminator after the last line.
+    os::high_resolution_clock read_clock;
+    std::vector<char> snapshot;
+    {
+        read_lock lock(handles);
+        if (!lock)
+        {
+            m_abandoned = "can't lock master bank";
+            return false;
+        }
+
+        m_snapshot_size = lock.get_file_size();
+        snapshot.resize(m_snapshot_size + 1);
+        if (lock.read_bytes(0, snapshot.data(), m_snapshot_size) != m_snapshot_size)
+        {
+            m_abandoned = "can't read master bank";
+            return false;
+        }
+    }
+    m_read_ms = read_clock.elapsed() * 1000;
+
+    // The ctag line in the copy is compared with the bank again before writing,
+    // to detect whether another session compacted the bank meanwhile.
+    uint32 ctag_len = 0;
+    while (ctag_len < m_snapshot_size && !is_line_breaker(snapshot[ctag_len]))
+        ++ctag_len;
+    if (ctag_len < 6 || ctag_len >= m_snapshot_size || strncmp(snapshot.data(), "|CTAG_", 6) != 0)
+    {
+        m_abandoned = "no ctag";
+        return false;
+    }
+
+    // Collect the lines to keep.
+    os::high_resolution_clock build_clock;
+    std::vector<keep_line> lines;
+    str_map_case<size_t>::type seen;
+    {
+        read_lock::map_iter iter(snapshot.data(), m_snapshot_size);
+        str_iter out;
+        line_id_impl time_id;
+        while (const line_id_impl id = iter.next(out, nullptr, &time_id.outer))
+        {
+            char* line = snapshot.data() + id.offset;
+            line[out.length()] = '\0';
+
+            keep_line keep = { line, nullptr, uint32(out.length()), 0, uint32(id.offset), 0, 0 };
+            if (time_id)
+            {
+                keep.m_time = snapshot.data() + time_id.offset;
+                keep.m_time_len = uint32(id.offset - time_id.offset);
+                while (keep.m_time_len && is_line_breaker(keep.m_time[keep.m_time_len - 1]))
+                    --keep.m_time_len;
+                keep.m_old_time = time_id.offset;
+            }
+
+            // Maybe apply uniq and keep only the latest.  Leave the old entry
+            // present but empty, so the indices don't shift.
+            if (m_uniq)
+            {
+                const auto lookup = seen.find(line);
+                if (lookup != seen.end())
+                {
+                    lines[lookup->second].m_line = nullptr;
+                    ++m_dups;
+                }
+                seen.insert_or_assign(line, lines.size());
+            }
+
+            lines.push_back(keep);
+        }
+        m_deleted = iter.get_deleted_count();
+    }
+
+    // Decide how many lines to keep.
+    size_t start = 0;
+    if (0 < m_limit && m_limit < lines.size())
+    {
+        size_t limit = m_limit;
+        for (start = lines.size(); limit && start--;)
+            if (lines[start].m_line)
+                --limit;
+    }
+
+    // Build the compacted bank.
+    m_ctag.generate_new_tag();
+    std::vector<char> image;
+    image.reserve(m_snapshot_size);
+    auto append = [&] (const char* text, uint32 len)
+    {
+        image.insert(image.end(), text, text + len);
+        image.push_back('\n');
+    };
+
+    append(m_ctag.get(), uint32(strlen(m_ctag.get())));
+    for (size_t i = start; i < lines.size(); ++i)
+    {
+        keep_line& keep = lines[i];
+        if (!keep.m_line)
+            continue;
+
+        if (keep.m_time)
+        {
+            m_remap.emplace_back(keep.m_old_time, uint32(image.size()));
+            append(keep.m_time, keep.m_time_len);
+        }
+
+        keep.m_new = uint32(image.size());
+        m_remap.emplace_back(keep.m_old, keep.m_new);
+        append(keep.m_line, keep.m_line_len);
+        ++m_kept;
+    }
+    m_build_ms = build_clock.elapsed() * 1000;
+
+    if (m_before_write)
+        m_before_write();
+
+    // Write the compacted bank, unless another session already compacted it.
+    os::high_resolution_clock write_clock;
+    write_lock lock(handles);
+    if (!lock)
+    {
+        m_abandoned = "can't lock master bank";
+        return false;
+    }
+
+    const uint32 size = lock.get_file_size();
+    std::vector<char> current(m_snapshot_size);
+    if (size < m_snapshot_size ||
+        lock.read_bytes(0, current.data(), m_snapshot_size) != m_snapshot_size ||
+        memcmp(current.data(), snapshot.data(), ctag_len + 1) != 0)
+    {
+        m_abandoned = "master bank was compacted elsewhere";
+        return false;
+    }
+
+    // Lines removed since the copy was made are removed in place, so they are
+    // marked again in the compacted bank.
+    for (size_t i = start; i < lines.size(); ++i)
+    {
+        const keep_line& keep = lines[i];
+        if (keep.m_line && current[keep.m_old] == '|')
+        {
+            image[keep.m_new] = '|';
+            --m_kept;
+            ++m_deleted;
+        }
+    }
+
+    // Lines added since the copy was made are appended as they are.  Any
+    // tombstones among them refer to offsets in the old bank, but they're
+    // never applied because sessions do a full load once the ctag changes.
+    m_tail_offset = uint32(image.size());
+    m_tail = size - m_snapshot_size;
+    if (m_tail)
+    {
+        image.resize(m_tail_offset + m_tail);
+        if (lock.read_bytes(m_snapshot_size, image.data() + m_tail_offset, m_tail) != m_tail)
+        {
+            m_abandoned = "can't read master bank";
+            return false;
+        }
+    }
+
+    // Collect line ids from all removals files that match the current master.
+    // After the master bank gets a new concurrency tag the collected line ids
+    // are translated to their corresponding new ids and written back to the
+    // respective removals files with the updated concurrency tag.
+    struct removal_file_data
+    {
+        str_moveable                m_file;
+        std::vector<line_id_impl>   m_lines;
+    };
+
+    std::vector<removal_file_data> removals_files;
+    for (const auto& path : m_session_paths)
+    {
+        str_moveable removals;
+        removals = path.c_str();
+        removals << ".removals";
+
+        if (os::get_file_size(path.c_str()) <= 0 && os::get_file_size(removals.c_str()) <= 0)
+            continue;
+
+        bank_handles session_handles;
+        session_handles.m_handle_lines = open_file(path.c_str());
+        session_handles.m_handle_removals = open_file(removals.c_str(), true/*if_exists*/);
+
+        if (session_handles.m_handle_removals)
+        {
+            // WARNING: ALWAYS LOCK MASTER BEFORE SESSION!
+            read_lock src(session_handles);
+            if (src)
+            {
+                removal_file_data data;
+                if (src.collect_removals(lock, data.m_lines) > 0)
+                {
+                    data.m_file = std::move(removals);
+                    removals_files.emplace_back(std::move(data));
+                }
+            }
+        }
+
+        session_handles.close();
+    }
+
+    if (!lock.replace(image.data(), uint32(image.size())))
+    {
+        // Put back the original bank, so a partial write doesn't leave a mix
+        // of old and new lines.  The sidecar and removals files still match
+        // the original bank, so they're left alone.
+        current.insert(current.end(), image.begin() + m_tail_offset, image.end());
+        lock.replace(current.data(), uint32(current.size()));
+        m_abandoned = "can't write master bank";
+        return false;
+    }
+
+    // Write a sidecar for the compacted bank.
+    std::vector<sidecar_record> records;
+    records.reserve(m_kept);
+    for (size_t i = start; i < lines.size(); ++i)
+    {
+        const keep_line& keep = lines[i];
+        if (keep.m_line && image[keep.m_new] != '|')
+        {
+            const uint32 time = keep.m_time ? uint32(strtoul(keep.m_time + 7, nullptr, 10)) : 0;
+            records.push_back({ keep.m_new, str_hash(keep.m_line, keep.m_line_len), time });
+        }
+    }
+    collect_sidecar_records(image.data() + m_tail_offset, m_tail, m_tail_offset, records);
+    lock.write_sidecar(records, m_ctag.get());
+
+    // Rewrite each removals file with the new master concurrency tag and the
+    // translated line ids.
+    str<64> tmp;
+    DWORD written;
+    for (const auto& r : removals_files)
+    {
+        assert(os::get_path_type(r.m_file.c_str()) == os::path_type_file);
+        void* handle = make_removals_file(r.m_file.c_str(), m_ctag.get());
+
+        // Truncate file immedately after the ctag to keep the file in a
+        // consistent state even while being rewritten.
+        SetEndOfFile(handle);
+
+        // Look up the ids and write the new ids for ones that were kept.
+        for (const auto& id : r.m_lines)
+        {
+            const uint32 offset = translate(id.offset);
+            if (offset)
+            {
+                tmp.format("%u\n", offset);
+                WriteFile(handle, tmp.c_str(), tmp.length(), &written, nullptr);
+            }
+        }
+
+        CloseHandle(handle);
+    }
+
+    m_write_ms = write_clock.elapsed() * 1000;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+uint32 compact_task::translate(uint32 offset) const
+{
+    if (offset >= m_snapshot_size)
+        return m_tail_offset + (offset - m_snapshot_size);
+
+    const auto nth = std::lower_bound(m_remap.begin(), m_remap.end(), offset, [] (const std::pair<uint32, uint32>& a, uint32 b) {
+        return a.first < b;
+    });
+    return (nth != m_remap.end() && nth->first == offset) ? nth->second : 0;
+}
+
 //------------------------------------------------------------------------------
 static void migrate_history(const char* path, bool m_diagnostic)
 {
@@ -1178,6 +2136,8 @@ history_db::history_db(const char* path, int32 id, bool use_master_bank)
     static_assert(sizeof(line_id) == sizeof(line_id_impl), "");
 
     memset(m_bank_handles, 0, sizeof(m_bank_handles));
+    memset(m_indexed_size, 0, sizeof(m_indexed_size));
+    memset(m_loaded_size, 0, sizeof(m_loaded_size));
     m_master_len = 0;
     m_master_deleted_count = 0;
 
@@ -1210,6 +2170,9 @@ history_db::history_db(const char* path, int32 id, bool use_master_bank)
 //------------------------------------------------------------------------------
 history_db::~history_db()
 {
+    // Let a background compaction finish before reaping into the master bank.
+    finish_compact(true/*wait*/);
+
     // Close alive handle
     if (m_alive_file)
         CloseHandle(m_alive_file);
@@ -1308,6 +2271,12 @@ void history_db::initialise(str_base* error_message)
         m_bank_handles[bank_master].m_handle_lines = open_file(path.c_str(), m_bank_error[bank_master]);
         make_open_error(error_message, bank_master);
 
+        // The sidecar is created when the master bank is cleared, compacted,
+        // or added to, if it doesn't exist.
+        str<280> sidecar;
+        get_sidecar_path(path.c_str(), sidecar);
+        m_bank_handles[bank_master].m_handle_sidecar = open_file(sidecar.c_str(), true/*if_exists*/);
+
         // Retrieve concurrency tag from start of master bank.
         m_master_ctag.clear();
         {
@@ -1381,7 +2350,10 @@ bank_handles history_db::get_bank(uint32 index) const
     {
         handles.m_handle_lines = m_bank_handles[index].m_handle_lines;
         if (index == bank_master)
+        {
             handles.m_handle_removals = m_bank_handles[bank_session].m_handle_removals;
+            handles.m_handle_sidecar = m_bank_handles[bank_master].m_handle_sidecar;
+        }
     }
     return handles;
 }
@@ -1450,30 +2422,61 @@ void history_db::get_file_path(str_base& out, bool session) const
 }
 
 //------------------------------------------------------------------------------
-static void __clear_history()
+// Adds a line to Readline's history list.  The line isn't NUL terminated (it
+// may point into a read-only mapped view), so it goes through tmp.
+static void add_rl_entry(const char* line, uint32 len, const char* time, str_base& tmp)
 {
-    rl_clear_history();
-    assert(!rl_undo_list);
+    tmp.clear();
+    tmp.concat(line, len);
+    add_history(tmp.c_str());
+    if (time && *time)
+        add_history_time(time);
+}
 
+//------------------------------------------------------------------------------
+static void reset_history_lookup()
+{
+    // History expansion caches history positions, which are invalidated when
+    // entries are removed or reordered.
     history_prev_use_curr = 0;
 
     free(const_cast<char*>(history_event_lookup_cache.search_string));
     memset(&history_event_lookup_cache, 0, sizeof(history_event_lookup_cache));
+}
+
+//------------------------------------------------------------------------------
+static void __clear_history()
+{
+    rl_clear_history();
+    assert(!rl_undo_list);
+
+    reset_history_lookup();
 
 #ifdef UNDO_LIST_HEAP_DIAGNOSTICS
     clink_check_undo_entry_leaks();
 #endif
 }
 
+//------------------------------------------------------------------------------
+static const void* get_last_rl_entry()
+{
+    HIST_ENTRY** list = history_list();
+    return (list && history_length > 0) ? list[history_length - 1] : nullptr;
+}
+
 //------------------------------------------------------------------------------
 void history_db::load_internal()
 {
     __clear_history();
+    clear_index();
     m_index_map.clear();
     m_master_len = 0;
     m_master_deleted_count = 0;
+    memset(m_loaded_size, 0, sizeof(m_loaded_size));
+    m_removals_loaded_size = 0;
+    m_master_write_time = 0;
 
-    history_read_buffer buffer;
+    str<> tmp;
 
     DIAG("... loading history\n");
 
@@ -1488,47 +2491,357 @@ void history_db::load_internal()
             extract_ctag(lock, m_master_ctag);
         }
 
-        // Subtract 1 from the size to accommodate the forced NUL termination
-        // prior to calling add_history.
-        read_lock::line_iter iter(lock, buffer.data(), buffer.size() - 1);
-
         dbg_snapshot_heap(snapshot);
 
+        uint32 num_lines = 0;
         str_iter out;
         str<32> time;
-        line_id_impl id;
-        uint32 num_lines = 0;
-        while (id = iter.next(out, &time))
+        read_lock::map_iter iter(lock);
+        while (line_id_impl id = iter.next(out, &time))
         {
             const char* line = out.get_pointer();
-            int32 buffer_offset = int32(line - buffer.data());
-            buffer.data()[buffer_offset + out.length()] = '\0';
-            add_history(line);
-            if (!time.empty())
-                add_history_time(time.c_str());
+            add_rl_entry(line, out.length(), time.c_str(), tmp);
 
             num_lines++;
 
             id.bank_index = bank_index;
             m_index_map.push_back(id.outer);
+            index_line(bank_index, id.outer, line, out.length());
             if (bank_index == bank_master)
             {
                 //LOG("load:  bank %u, offset %u, active %u:  '%s', len %u", id.bank_index, id.offset, id.active, line, out.length());
                 m_master_len = m_index_map.size();
             }
         }
+        const uint32 deleted = iter.get_deleted_count();
+
+        m_indexed_size[bank_index] = lock.get_file_size();
+        m_loaded_size[bank_index] = m_indexed_size[bank_index];
+        if (bank_index == bank_master)
+        {
+            m_removals_loaded_size = lock.get_removals_size();
+            m_master_write_time = lock.get_write_time();
+        }
 
         dbg_ignore_since_snapshot(snapshot, "History");
 
         if (bank_index == bank_master)
-            m_master_deleted_count = iter.get_deleted_count();
+            m_master_deleted_count = deleted;
+
+        DIAG(":  lines active %u / deleted %u\n", num_lines, deleted);
+
+        return true;
+    });
+
+    m_index_valid = true;
+    m_prefix_index.rebuild();
+
+    m_rl_last = get_last_rl_entry();
+    m_loaded = true;
+
+    DIAG("... total lines active %zu\n", m_index_map.size());
+}
+
+//------------------------------------------------------------------------------
+// Reads every line in a bank with either the buffered iterator or the mapped
+// iterator, without loading anything into Readline's history list.  Returns
+// the number of active lines.  This lets tests compare the two iterators.
+uint32 history_db::scan_bank(uint32 bank_index, bool mapped) const
+{
+    read_lock lock(get_bank(bank_index));
+    if (!lock)
+        return 0;
+
+    uint32 num_lines = 0;
+    str_iter out;
+    str<32> time;
+    if (mapped)
+    {
+        read_lock::map_iter iter(lock);
+        while (iter.next(out, &time))
+            num_lines++;
+    }
+    else
+    {
+        history_read_buffer buffer;
+        read_lock::line_iter iter(lock, buffer.data(), buffer.size());
+        while (iter.next(out, &time))
+            num_lines++;
+    }
+    return num_lines;
+}
+
+//------------------------------------------------------------------------------
+bool history_db::reload_internal()
+{
+    if (!m_index_valid || !is_rl_history_loaded())
+        return false;
+
+    struct tail_line
+    {
+        auto_free_str       m_line;
+        auto_free_str       m_time;
+        line_id_impl        m_id;
+    };
+
+    std::vector<tail_line> added[bank_count];
+    std::vector<uint32> removed;            // Indices in m_index_map.
+    std::vector<line_id_impl> removals;
+    std::vector<uint32> tombstones;
+    uint32 sizes[bank_count];
+    uint32 removals_size = m_removals_loaded_size;
+    unsigned __int64 write_time = m_master_write_time;
+    uint32 tail_deleted = 0;
+    bool full = false;
+
+    memcpy(sizes, m_loaded_size, sizeof(sizes));
+
+    history_read_buffer buffer;
+
+    DIAG("... reloading history\n");
+
+    // Collect the changes first, so that nothing is modified if a full load
+    // turns out to be needed.
+    const history_db& const_this = *this;
+    const_this.for_each_bank([&] (uint32 bank_index, const read_lock& lock)
+    {
+        const char* const bank_name = (bank_index == bank_master) ? "master" : "session";
+
+        const uint32 size = lock.get_file_size();
+        if (size < m_loaded_size[bank_index])
+        {
+            DIAG("... ... %s bank shrank\n", bank_name);
+            full = true;
+            return false;
+        }
+
+        if (bank_index == bank_master)
+        {
+            concurrency_tag tag;
+            if (!extract_ctag(lock, tag) || strcmp(tag.get(), m_master_ctag.get()) != 0)
+            {
+                DIAG("... ... master bank ctag changed\n");
+                full = true;
+                return false;
+            }
+        }
 
-        DIAG(":  lines active %u / deleted %u\n", num_lines, iter.get_deleted_count());
+        sizes[bank_index] = size;
+
+        const bool master = (bank_index == bank_master);
+
+        // Lines deleted in place are found by checking the first byte of each
+        // loaded line.  This only reads the bank; nothing is parsed or
+        // allocated.
+        //
+        // Only the session itself writes to its session bank, which is small,
+        // so it's always checked.  Other sessions (or reaping) append
+        // tombstones when they delete master lines in place, which are
+        // collected with the appended lines below.  Versions of Clink that
+        // don't write tombstones can still delete master lines in place, but
+        // appending changes the size, so the master bank is only checked if it
+        // was written to without changing size.
+        uint32 first = 0;
+        uint32 last = 0;
+        if (!master)
+        {
+            first = uint32(m_master_len);
+            last = uint32(m_index_map.size());
+        }
+        else
+        {
+            write_time = lock.get_write_time();
+            if (size == m_loaded_size[bank_index] && write_time != m_master_write_time)
+            {
+                DIAG("... ... master bank changed in place\n");
+                last = uint32(m_master_len);
+            }
+        }
+
+        if (first < last)
+        {
+            read_lock::file_iter iter(lock, buffer.data(), buffer.size());
+            uint32 index = first;
+            for (uint32 read; index < last && (read = iter.next());)
+            {
+                const unsigned __int64 buffer_offset = iter.get_buffer_offset();
+                for (; index < last; ++index)
+                {
+                    line_id_impl id;
+                    id.outer = m_index_map[index];
+                    if (id.offset >= buffer_offset + read)
+                        break;
+                    if (iter.get_buffer()[id.offset - buffer_offset] == '|')
+                        removed.push_back(index);
+                }
+            }
+        }
+
+        // Deferred removals appended to this session's removals file.
+        if (master)
+        {
+            removals_size = lock.get_removals_size();
+            if (removals_size < m_removals_loaded_size)
+            {
+                DIAG("... ... removals file shrank\n");
+                full = true;
+                return false;
+            }
+
+            if (removals_size > m_removals_loaded_size &&
+                lock.collect_removals(lock, removals, m_removals_loaded_size) < 0)
+            {
+                full = true;
+                return false;
+            }
+
+            const auto begin = m_index_map.begin();
+            const auto end = begin + m_master_len;
+            for (line_id_impl id : removals)
+            {
+                const auto nth = std::lower_bound(begin, end, id.outer);
+                if (nth != end && *nth == id.outer)
+                    removed.push_back(uint32(nth - begin));
+            }
+        }
+
+        // Lines appended since the last load.
+        if (size > m_loaded_size[bank_index])
+        {
+            read_lock::line_iter iter(lock, buffer.data(), buffer.size());
+            iter.set_file_offset(m_loaded_size[bank_index]);
+            if (master)
+                iter.set_tombstones(&tombstones);
+
+            str_iter out;
+            str<32> time;
+            while (line_id_impl id = iter.next(out, &time))
+            {
+                id.bank_index = bank_index;
+
+                tail_line tail;
+                tail.m_line.set(out.get_pointer(), out.length());
+                if (!time.empty())
+                    tail.m_time = time.c_str();
+                tail.m_id = id;
+                added[bank_index].emplace_back(std::move(tail));
+            }
+
+            if (master)
+                tail_deleted = iter.get_deleted_count();
+        }
+
+        // Loaded master lines deleted in place by other sessions.
+        if (master && !tombstones.empty())
+        {
+            const auto begin = m_index_map.begin();
+            const auto end = begin + m_master_len;
+            for (uint32 offset : tombstones)
+            {
+                const auto nth = std::lower_bound(begin, end, line_id_impl(offset).outer);
+                if (nth != end && *nth == line_id_impl(offset).outer)
+                    removed.push_back(uint32(nth - begin));
+            }
+        }
 
         return true;
     });
 
+    if (full)
+        return false;
+
+    // Apply removals, last first so the indices stay valid.
+    std::sort(removed.begin(), removed.end());
+    removed.erase(std::unique(removed.begin(), removed.end()), removed.end());
+    for (size_t i = removed.size(); i--;)
+    {
+        const uint32 index = removed[i];
+        unindex_line(m_index_map[index], str_hash(history_list()[index]->line));
+        remove_rl_entry(index);
+        m_index_map.erase(m_index_map.begin() + index);
+        if (index < m_master_len)
+        {
+            --m_master_len;
+            ++m_master_deleted_count;
+        }
+    }
+    m_master_deleted_count += tail_deleted;
+
+    // Append new lines.  Master lines precede session lines, so if there are
+    // session entries then the new master entries are rotated in front of
+    // them.
+    bool reordered = false;
+    for (uint32 bank_index = 0; bank_index < bank_count; ++bank_index)
+    {
+        const auto& lines = added[bank_index];
+        if (lines.empty())
+            continue;
+
+        const int32 insert_at = (bank_index == bank_master) ? int32(m_master_len) : history_length;
+        const int32 old_length = history_length;
+
+        std::vector<line_id> ids;
+        ids.reserve(lines.size());
+        for (const auto& tail : lines)
+        {
+            add_history(tail.m_line.get());
+            if (tail.m_time.get())
+                add_history_time(tail.m_time.get());
+
+            ids.push_back(tail.m_id.outer);
+            if (tail.m_id.offset >= m_indexed_size[bank_index])
+                index_line(bank_index, tail.m_id.outer, tail.m_line.get(), uint32(strlen(tail.m_line.get())));
+        }
+
+        m_index_map.insert(m_index_map.begin() + insert_at, ids.begin(), ids.end());
+        if (bank_index == bank_master)
+            m_master_len += ids.size();
+
+        if (insert_at < old_length)
+        {
+            HIST_ENTRY** list = history_list();
+            std::rotate(list + insert_at, list + old_length, list + history_length);
+            reordered = true;
+        }
+    }
+
+    for (uint32 bank_index = 0; bank_index < bank_count; ++bank_index)
+    {
+        m_indexed_size[bank_index] = max(m_indexed_size[bank_index], sizes[bank_index]);
+        m_loaded_size[bank_index] = sizes[bank_index];
+    }
+    m_removals_loaded_size = removals_size;
+    m_master_write_time = write_time;
+
+    if (reordered)
+        m_prefix_index.rebuild();
+    reset_history_lookup();
+    m_rl_last = get_last_rl_entry();
+
+    DIAG("... ... lines added %zu / removed %zu\n", added[bank_master].size() + added[bank_session].size(), removed.size());
     DIAG("... total lines active %zu\n", m_index_map.size());
+    return true;
+}
+
+//------------------------------------------------------------------------------
+bool history_db::is_rl_history_loaded() const
+{
+    // Readline's history list must still correspond one-to-one to
+    // m_index_map.  Entries added only in memory (e.g. by the add-history
+    // command) or a different list (e.g. loaded by another history_db) can't be
+    // reconciled incrementally.
+    return (m_loaded &&
+            history_length == int32(m_index_map.size()) &&
+            get_last_rl_entry() == m_rl_last);
+}
+
+//------------------------------------------------------------------------------
+void history_db::remove_rl_entry(int32 rl_history_index)
+{
+    // The prefix index must be updated before Readline removes the entry.
+    m_prefix_index.remove(rl_history_index);
+    free_history_entry(remove_history(rl_history_index));
+    m_rl_last = get_last_rl_entry();
 }
 
 //------------------------------------------------------------------------------
@@ -1537,13 +2850,18 @@ void history_db::load_rl_history(bool can_clean)
     if (!is_valid())
         return;
 
-    load_internal();
+    // A compaction that finished in the background changed the master ctag,
+    // so this falls back to a full load.
+    finish_compact(false/*wait*/);
+
+    if (!reload_internal())
+        load_internal();
 
     // The `clink history` command needs to be able to avoid cleaning the master
     // history file.
     if (can_clean && m_use_master_bank)
     {
-        if (compact())
+        if (compact_internal(false/*force*/, false/*uniq*/, -1, true/*background*/))
             load_internal();
     }
 }
@@ -1554,8 +2872,12 @@ void history_db::clear()
     if (!is_valid())
         return;
 
+    finish_compact(true/*wait*/);
+
     DIAG("... clearing history\n");
 
+    open_sidecar();
+
     for_each_bank([&] (uint32 bank_index, write_lock& lock)
     {
         DIAG("... ... %s bank\n", bank_index == bank_master ? "master" : "session");
@@ -1566,17 +2888,39 @@ void history_db::clear()
             m_master_ctag.clear();
             m_master_ctag.generate_new_tag();
             lock.add(m_master_ctag.get());
+
+            std::vector<sidecar_record> records;
+            lock.write_sidecar(records, m_master_ctag.get());
         }
         return true;
     });
 
+    clear_index();
     m_index_map.clear();
     m_master_len = 0;
     m_master_deleted_count = 0;
+    m_loaded = false;
+}
+
+//------------------------------------------------------------------------------
+bool history_db::compact(bool force, bool uniq, int32 limit)
+{
+    if (compact_internal(force, uniq, limit, false/*background*/))
+        return true;
+
+    // Compacting writes a new sidecar; otherwise make sure the sidecar covers
+    // the master bank.
+    if (is_valid() && open_sidecar())
+    {
+        write_lock lock(get_bank(bank_master));
+        if (lock)
+            update_sidecar(lock);
+    }
+    return false;
 }
 
 //------------------------------------------------------------------------------
-bool history_db::compact(bool force, bool uniq, int32 _limit)
+bool history_db::compact_internal(bool force, bool uniq, int32 _limit, bool background)
 {
     if (!is_valid())
         return false;
@@ -1600,7 +2944,7 @@ bool history_db::compact(bool force, bool uniq, int32 _limit)
         limit = c_max_max_history_lines;
 
     // When force is true, load_internal() was not called, so m_master_len is 0,
-    // this loop can't remove entries, and rewrite_master_bank() does instead.
+    // this loop can't remove entries, and compact_task does instead.
     if (limit > 0 && !force)
     {
         LOG("History:  %zu active, %zu deleted", m_master_len, m_master_deleted_count);
@@ -1610,6 +2954,10 @@ bool history_db::compact(bool force, bool uniq, int32 _limit)
         // deleted; compacting is a separate operation.
         if (m_master_len > limit)
         {
+            // Keep Readline's history list in sync, so the next reload can
+            // still be incremental.
+            const bool loaded = is_rl_history_loaded();
+
             uint32 removed = 0;
             while (m_master_len > limit)
             {
@@ -1627,6 +2975,8 @@ bool history_db::compact(bool force, bool uniq, int32 _limit)
                     DIAG("... ... failed to remove line at offset %u\n", id.offset);
                     break;
                 }
+                if (loaded)
+                    remove_rl_entry(0);
                 removed++;
             }
             LOG("History:  removed %u", removed);
@@ -1643,118 +2993,250 @@ bool history_db::compact(bool force, bool uniq, int32 _limit)
         return false;
     }
 
-    DIAG("... compact:  rewrite master bank\n");
-
-    size_t kept, deleted, dups;
-    assert(!m_master_ctag.empty());
-
-    bank_handles master_handles = get_bank(bank_master);
-    master_handles.m_handle_removals = nullptr; // Don't redirect removals.
-    write_lock dest(master_handles);
-
-    struct removal_file_data
+    // Only one compaction at a time.
+    if (m_compact)
     {
-        str_moveable                m_file;
-        std::vector<line_id_impl>   m_lines;
-    };
+        if (background)
+        {
+            DIAG("... skip compact; already compacting in background\n");
+            return false;
+        }
+        finish_compact(true/*wait*/);
+    }
 
-    std::vector<removal_file_data> removals_files;
-    str_moveable removals;
+    // Readline's history list stays valid while the master bank is rewritten
+    // in the background; the next load notices the new ctag and reloads.
+    m_compact = std::make_unique<compact_task>();
+    m_compact->m_master_path = m_bank_filenames[bank_master].c_str();
+    m_compact->m_limit = limit;
+    m_compact->m_uniq = uniq;
+    m_compact->m_before_write = m_before_compact_write;
+    for_each_session([&] (str_base& path, bool local)
+    {
+        if (!local)
+            m_compact->m_session_paths.emplace_back(path.c_str());
+    });
 
-    // Collect line ids from all removals files that match the current
-    // master.  After the master bank gets a new concurreny tag the
-    // collected line ids will be translated to their corresponding new ids
-    // and written back to the respective removals files with the updated
-    // concurrency tag.
-    for_each_session([&](str_base& path, bool local)
+    if (background)
     {
-        if (m_use_master_bank)
+        DIAG("... compact:  rewrite master bank in background\n");
+
+        compact_task* task = m_compact.get();
+        dbg_ignore_scope(snapshot, "History compact thread");
+        task->m_thread = std::make_unique<std::thread>([task] ()
         {
-            removals = path.c_str();
-            removals << ".removals";
+            task->run();
+            task->m_done = true;
+        });
+        return false;
+    }
 
-            if (os::get_file_size(path.c_str()) > 0 ||
-                os::get_file_size(removals.c_str()) > 0)
-            {
-                bank_handles compact_handles;
-                compact_handles.m_handle_lines = open_file(path.c_str());
-                compact_handles.m_handle_removals = open_file(removals.c_str(), true/*if_exists*/);
+    DIAG("... compact:  rewrite master bank\n");
 
-                if (compact_handles.m_handle_removals)
-                {
-                    DIAG("... compact:  apply removals from '%s'\n", removals.c_str());
+    m_compact->run();
+    m_compact->m_done = true;
+    return finish_compact(true/*wait*/);
+}
 
-                    // WARNING: ALWAYS LOCK MASTER BEFORE SESSION!
-                    read_lock src(compact_handles);
-                    if (src && dest)
-                    {
-                        removal_file_data data;
-                        if (src.collect_removals(dest, data.m_lines) > 0)
-                        {
-                            data.m_file = std::move(removals);
-                            removals_files.emplace_back(std::move(data));
-                        }
-                    }
-                }
+//------------------------------------------------------------------------------
+bool history_db::finish_compact(bool wait)
+{
+    if (!m_compact || !(wait || m_compact->m_done))
+        return false;
 
-                compact_handles.close();
-            }
+    if (m_compact->m_thread)
+        m_compact->m_thread->join();
+
+    const compact_task& task = *m_compact;
+    const bool compacted = !task.m_abandoned;
+    if (!compacted)
+    {
+        LOG("History:  compact abandoned; %s", task.m_abandoned);
+        DIAG("... compact:  abandoned; %s\n", task.m_abandoned);
+    }
+    else
+    {
+        if (task.m_uniq)
+        {
+            LOG("Compacted history:  %zu active, %zu deleted, %zu duplicates removed", task.m_kept, task.m_deleted, task.m_dups);
+            DIAG("... compact:  lines active %zu / purged %zu / duplicates removed %zu\n", task.m_kept, task.m_deleted, task.m_dups);
         }
-    });
+        else
+        {
+            LOG("Compacted history:  %zu active, %zu deleted", task.m_kept, task.m_deleted);
+            DIAG("... compact:  lines active %zu / purged %zu\n", task.m_kept, task.m_deleted);
+        }
+        if (task.m_tail)
+            DIAG("... ... bytes appended meanwhile %u\n", task.m_tail);
+        DIAG("... ... read %.3f ms / rebuild %.3f ms / write %.3f ms\n", task.m_read_ms, task.m_build_ms, task.m_write_ms);
 
-    // Rewrite the master bank and apply the limit (if any).  This may also
-    // optionally enforce uniqueness.  The result counters are written to
-    // the log file.
-    std::map<line_id_impl, line_id_impl> remap_removals;
-    rewrite_master_bank(dest, limit, &kept, &deleted, uniq, &dups, &remap_removals);
+        // Every line id in the master bank has changed, so the index and
+        // Readline's history list are stale until the next full load.
+        m_master_ctag.clear();
+        m_master_ctag.set(task.m_ctag.get());
+        clear_index();
+        m_loaded = false;
+    }
 
-    // Extract the new master concurrency tag.
-    str<64> old_ctag(m_master_ctag.get());
-    m_master_ctag.clear();
-    extract_ctag(dest, m_master_ctag);
-    assert(!old_ctag.iequals(m_master_ctag.get())); // It should be different.
+    m_compact.reset();
+    return compacted;
+}
 
-    // Rewrite each removals files with the new master concurrency tag and
-    // the translated line ids.
-    str<64> tmp;
-    DWORD written;
-    for (const auto& r : removals_files)
+//------------------------------------------------------------------------------
+template <class L, class T> void history_db::find_in_bank(uint32 bank_index, L& lock, const char* line, T&& callback) const
+{
+    if (!is_index_usable(bank_index, lock))
     {
-        assert(os::get_path_type(r.m_file.c_str()) == os::path_type_file);
-        void* handle = make_removals_file(r.m_file.c_str(), m_master_ctag.get());
-
-        // Truncate file immedately after the ctag to keep the file in a
-        // consistent state even while being rewritten.
-        SetEndOfFile(handle);
-
-        // Look up the ids and write the new ids for ones that were kept.
-        for (const auto& id : r.m_lines)
+        // The master bank's sidecar can stand in for the index, e.g. before
+        // history is loaded.  Only the part of the bank it doesn't cover needs
+        // to be scanned.
+        uint32 start_offset = 0;
+        sidecar_footer footer;
+        std::vector<uint32> offsets;
+        const uint32 length = uint32(strlen(line));
+        if (bank_index == bank_master &&
+            lock.read_sidecar(footer) &&
+            lock.find_sidecar(footer, str_hash(line, length), offsets))
         {
-            const auto iter = remap_removals.find(id);
-            if (iter != remap_removals.end())
+            for (const uint32 offset : offsets)
             {
-                tmp.format("%u\n", iter->second.offset);
-                WriteFile(handle, tmp.c_str(), tmp.length(), &written, nullptr);
+                if (lock.line_equals(offset, line, length) &&
+                    !callback(line_id_impl(offset)))
+                    return;
             }
+            start_offset = footer.covered;
         }
 
-        CloseHandle(handle);
+        lock.find(line, callback, start_offset);
+        return;
     }
 
-    if (uniq)
+    // Collect the candidates first, because the callback may remove lines
+    // from the index.  Sorting by offset visits them in the same order as
+    // scanning the bank would.
+    const uint32 length = uint32(strlen(line));
+    std::vector<line_id_impl> candidates;
+    const auto range = m_line_hashes.equal_range(str_hash(line, length));
+    for (auto it = range.first; it != range.second; ++it)
     {
-        LOG("Compacted history:  %zu active, %zu deleted, %zu duplicates removed", kept, deleted, dups);
-        DIAG("... ... lines active %zu / purged %zu / duplicates removed %zu\n", kept, deleted, dups);
+        line_id_impl id;
+        id.outer = it->second;
+        if (id.bank_index == bank_index)
+        {
+            id.bank_index = 0; // Same as ids produced by scanning the bank.
+            candidates.push_back(id);
+        }
     }
-    else
+    std::sort(candidates.begin(), candidates.end(), [] (const line_id_impl& a, const line_id_impl& b) {
+        return a.offset < b.offset;
+    });
+
+    // Hash collisions and lines that were deleted in place by other sessions
+    // are weeded out by comparing against the actual file content.
+    for (const line_id_impl& id : candidates)
+    {
+        if (lock.line_equals(id.offset, line, length) && !callback(id))
+            return;
+    }
+
+    // Lines appended after the bank was indexed aren't in the index.
+    lock.find(line, callback, m_indexed_size[bank_index]);
+}
+
+//------------------------------------------------------------------------------
+bool history_db::is_index_usable(uint32 bank_index, const read_lock& lock) const
+{
+    if (!m_index_valid || bank_index >= bank_count)
+        return false;
+
+    // A bank that shrank was rewritten by something else.
+    if (lock.get_file_size() < m_indexed_size[bank_index])
+        return false;
+
+    // A different ctag means the master bank was compacted by another session.
+    if (bank_index == bank_master)
     {
-        LOG("Compacted history:  %zu active, %zu deleted", kept, deleted);
-        DIAG("... ... lines active %zu / purged %zu\n", kept, deleted);
+        concurrency_tag tag;
+        if (!extract_ctag(lock, tag) || strcmp(tag.get(), m_master_ctag.get()) != 0)
+            return false;
     }
 
     return true;
 }
 
+//------------------------------------------------------------------------------
+void history_db::index_line(uint32 bank_index, line_id id, const char* line, uint32 length)
+{
+    line_id_impl id_impl;
+    id_impl.outer = id;
+    id_impl.bank_index = bank_index;
+    m_line_hashes.emplace(str_hash(line, length), id_impl.outer);
+}
+
+//------------------------------------------------------------------------------
+void history_db::unindex_line(line_id id, uint32 hash)
+{
+    const auto range = m_line_hashes.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        if (it->second == id)
+        {
+            m_line_hashes.erase(it);
+            break;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+void history_db::clear_index()
+{
+    m_line_hashes.clear();
+    memset(m_indexed_size, 0, sizeof(m_indexed_size));
+    m_index_valid = false;
+}
+
+//------------------------------------------------------------------------------
+// Opens the master bank's sidecar, creating it if it doesn't exist yet.
+bool history_db::open_sidecar()
+{
+    bank_handles& master = m_bank_handles[bank_master];
+    if (!master)
+        return false;
+
+    if (!master.m_handle_sidecar)
+    {
+        str<280> path;
+        get_sidecar_path(m_bank_filenames[bank_master].c_str(), path);
+        master.m_handle_sidecar = open_file(path.c_str());
+    }
+
+    return master.m_handle_sidecar != nullptr;
+}
+
+//------------------------------------------------------------------------------
+// Rebuilds the master bank's sidecar if it doesn't cover the whole bank, e.g.
+// because it doesn't exist yet, or because the bank was changed by something
+// that doesn't know about the sidecar.  The caller must hold a write lock on
+// the master bank, taken after open_sidecar().
+void history_db::update_sidecar(write_lock& lock)
+{
+    sidecar_footer footer;
+    const uint32 size = lock.get_file_size();
+    if (lock.read_sidecar(footer) && footer.covered == size)
+        return;
+
+    concurrency_tag tag;
+    std::vector<char> data(size);
+    if (!extract_ctag(lock, tag) || lock.read_bytes(0, data.data(), size) != size)
+        return;
+
+    std::vector<sidecar_record> records;
+    collect_sidecar_records(data.data(), size, 0, records);
+    lock.write_sidecar(records, tag.get());
+
+    DIAG("... rebuilt sidecar index:  %zu lines\n", records.size());
+}
+
 //------------------------------------------------------------------------------
 bool history_db::add(const char* line)
 {
@@ -1778,19 +3260,29 @@ bool history_db::add(const char* line)
     }
 
     // Add the line.
-    write_lock lock(get_bank(get_active_bank()));
+    const bank_t bank = get_active_bank();
+    const bool sidecar = (bank == bank_master && open_sidecar());
+    write_lock lock(get_bank(bank));
     if (!lock)
         return false;
 
-    if (g_history_timestamp.get() > 0)
+    if (sidecar)
+        update_sidecar(lock);
+
+    // The index can only be extended if nothing else has appended to the bank
+    // since it was indexed; otherwise the tail scan in find_in_bank() covers
+    // the new line.
+    const bool contiguous = (is_index_usable(bank, lock) &&
+                             lock.get_file_size() == m_indexed_size[bank]);
+
+    const uint32 now = (g_history_timestamp.get() > 0) ? uint32(time(0)) : 0;
+    const line_id_impl id = lock.add(line, now);
+    if (contiguous && id && id.offset != c_max_line_id.offset)
     {
-        str<32> timestamp;
-        const time_t now = time(0);
-        timestamp.format("|\ttime=%u", now);
-        lock.add(timestamp.c_str());
+        if (line[0] != '|')
+            index_line(bank, id.outer, line, uint32(strlen(line)));
+        m_indexed_size[bank] = lock.get_file_size();
     }
-
-    lock.add(line);
     return true;
 }
 
@@ -1798,12 +3290,15 @@ bool history_db::add(const char* line)
 int32 history_db::remove(const char* line)
 {
     int32 count = 0;
-    for_each_bank([line, &count] (uint32 index, write_lock& lock)
+    const uint32 hash = str_hash(line);
+    for_each_bank([&] (uint32 index, write_lock& lock)
     {
-        lock.find(line, [&] (line_id_impl id) {
+        find_in_bank(index, lock, line, [&] (line_id_impl id) {
             // The line id was retrieved inside this lock scope, so it's still
             // valid; no need to guard the ctag.
+            id.bank_index = index;
             lock.remove(id);
+            unindex_line(id.outer, hash);
             count++;
             return true;
         });
@@ -1848,9 +3343,25 @@ bool history_db::remove_internal(line_id id, bool guard_ctag)
         }
     }
 
+    // Hash the line before removing it, since removal can overwrite it.
+    uint32 hash = 0;
+    bool indexed = false;
+    if (m_index_valid)
+    {
+        str<> text;
+        if (lock.read_line(id_impl.offset, text))
+        {
+            hash = str_hash(text.c_str(), text.length());
+            indexed = true;
+        }
+    }
+
     if (!lock.remove(id_impl))
         return false;
 
+    if (indexed)
+        unindex_line(id, hash);
+
     if (id_impl.bank_index == bank_master)
     {
         auto last = m_index_map.begin() + m_master_len;
@@ -1914,13 +3425,19 @@ bool history_db::remove(int32 rl_history_index, const char* /*line*/)
     if (rl_history_index < 0)
         return false;
 
-    if (size_t(rl_history_index) >= m_index_map.size())
+    // It may be an in-memory-only entry, so allow Readline to remove it.
+    const bool removed = (size_t(rl_history_index) >= m_index_map.size() ||
+                          remove(m_index_map[rl_history_index]));
+
+    // Readline removes the entry after this returns true.
+    if (removed)
     {
-        // It may be an in-memory-only entry, so allow Readline to remove it.
-        return true;
+        m_prefix_index.remove(rl_history_index);
+        if (rl_history_index == history_length - 1)
+            m_rl_last = rl_history_index ? history_list()[rl_history_index - 1] : nullptr;
     }
 
-    return remove(m_index_map[rl_history_index]);
+    return removed;
 }
 
 //------------------------------------------------------------------------------
@@ -1928,9 +3445,13 @@ history_db::line_id history_db::find(const char* line) const
 {
     line_id_impl ret;
 
-    for_each_bank([line, &ret] (uint32 index, const read_lock& lock)
+    for_each_bank([&] (uint32 index, const read_lock& lock)
     {
-        if (ret = lock.find(line))
+        find_in_bank(index, lock, line, [&] (line_id_impl id) {
+            ret = id;
+            return false;
+        });
+        if (ret)
             ret.bank_index = index;
         return !ret;
     });
@@ -1938,6 +3459,12 @@ history_db::line_id history_db::find(const char* line) const
     return ret.outer;
 }
 
+//------------------------------------------------------------------------------
+const char* history_db::find_suggestion(const char* line, bool match_prev_cmd)
+{
+    return m_prefix_index.find(line, match_prev_cmd);
+}
+
 //------------------------------------------------------------------------------
 history_db::expand_result history_db::expand(const char* line, str_base& out)
 {
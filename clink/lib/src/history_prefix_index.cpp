@@ -0,0 +1,554 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+#include "history_prefix_index.h"
+
+#include <core/base.h>
+#include <core/path.h>
+#include <core/str_compare.h>
+#include <core/str_iter.h>
+
+#include <algorithm>
+#include <assert.h>
+
+extern "C" {
+#include <readline/history.h>
+}
+
+//------------------------------------------------------------------------------
+static const uint32 c_block_size = 64;
+static const uint32 c_none = ~0u;
+
+//------------------------------------------------------------------------------
+static void append_utf8(std::vector<char>& out, int32 c)
+{
+    if (c < 0x80)
+    {
+        out.push_back(char(c));
+    }
+    else if (c < 0x800)
+    {
+        out.push_back(char(0xc0 | (c >> 6)));
+        out.push_back(char(0x80 | (c & 0x3f)));
+    }
+    else if (c < 0x10000)
+    {
+        out.push_back(char(0xe0 | (c >> 12)));
+        out.push_back(char(0x80 | ((c >> 6) & 0x3f)));
+        out.push_back(char(0x80 | (c & 0x3f)));
+    }
+    else
+    {
+        out.push_back(char(0xf0 | (c >> 18)));
+        out.push_back(char(0x80 | ((c >> 12) & 0x3f)));
+        out.push_back(char(0x80 | ((c >> 6) & 0x3f)));
+        out.push_back(char(0x80 | (c & 0x3f)));
+    }
+}
+
+
+
+//------------------------------------------------------------------------------
+void history_prefix_index::clear()
+{
+    m_entries.clear();
+    m_block_best.clear();
+    m_keys.clear();
+    m_live.clear();
+    m_live_tree.clear();
+    m_removed = 0;
+    m_last = nullptr;
+    m_count = 0;
+}
+
+//------------------------------------------------------------------------------
+void history_prefix_index::rebuild()
+{
+    clear();
+
+    HIST_ENTRY** list = history_list();
+    if (!list || history_length <= 0)
+        return;
+
+    m_entries.reserve(history_length);
+    for (int32 i = 0; i < history_length; ++i)
+    {
+        entry e;
+        e.key_offset = uint32(m_keys.size());
+        e.key_len = fold_key(list[i]->line);
+        e.id = i;
+        m_entries.emplace_back(e);
+    }
+
+    const char* keys = m_keys.data();
+    std::sort(m_entries.begin(), m_entries.end(), [keys] (const entry& l, const entry& r) {
+        const int32 cmp = memcmp(keys + l.key_offset, keys + r.key_offset, min(l.key_len, r.key_len));
+        if (cmp)
+            return cmp < 0;
+        if (l.key_len != r.key_len)
+            return l.key_len < r.key_len;
+        return l.id < r.id;
+    });
+
+    reset_ids(history_length);
+    update_blocks(0, uint32(m_entries.size()));
+
+    m_count = history_length;
+    m_last = list[history_length - 1];
+}
+
+//------------------------------------------------------------------------------
+void history_prefix_index::remove(int32 rl_history_index)
+{
+    // This is called before Readline removes the entry, so the list still
+    // includes it.
+    HIST_ENTRY** list = history_list();
+    if (!list || rl_history_index < 0 || rl_history_index >= m_count || m_count > history_length || list[m_count - 1] != m_last)
+    {
+        // The index is out of sync; it gets rebuilt on the next query.
+        clear();
+        return;
+    }
+
+    const int32 id = id_of(rl_history_index);
+    const uint32 key_offset = uint32(m_keys.size());
+    const uint32 key_len = fold_key(list[rl_history_index]->line);
+    const char* key = m_keys.data() + key_offset;
+
+    // Within a run of equal keys, the entries are ordered by id.
+    auto iter = std::lower_bound(m_entries.begin(), m_entries.end(), id, [&] (const entry& e, int32 id) {
+        const int32 cmp = compare_key(e, key, key_len);
+        return cmp ? cmp < 0 : e.id < id;
+    });
+
+    m_keys.resize(key_offset);
+
+    if (iter == m_entries.end() || iter->id != id)
+    {
+        clear();
+        return;
+    }
+
+    // The entry stays until compact(), but its id no longer counts.
+    const uint32 pos = uint32(iter - m_entries.begin());
+    remove_id(id);
+    ++m_removed;
+    update_blocks(pos, pos + 1);
+
+    if (rl_history_index == m_count - 1)
+        m_last = rl_history_index ? list[rl_history_index - 1] : nullptr;
+    --m_count;
+}
+
+//------------------------------------------------------------------------------
+const char* history_prefix_index::find(const char* line, bool match_prev_cmd)
+{
+    // Without match_prev_cmd, an empty line never gets a suggestion.
+    if (!match_prev_cmd && !*line)
+        return nullptr;
+
+    sync();
+
+    HIST_ENTRY** list = history_list();
+    if (!list || !m_count)
+        return nullptr;
+
+    if (match_prev_cmd)
+    {
+        // Find the most recent occurrence of the previous command whose next
+        // entry starts with the line.
+        const char* prev_cmd = list[m_count - 1]->line;
+
+        const uint32 key_offset = uint32(m_keys.size());
+        const uint32 key_len = fold_key(prev_cmd);
+        const char* key = m_keys.data() + key_offset;
+
+        auto first = std::lower_bound(m_entries.begin(), m_entries.end(), 0, [&] (const entry& e, int) {
+            return compare_key(e, key, key_len) < 0;
+        });
+        auto last = std::upper_bound(first, m_entries.end(), 0, [&] (int, const entry& e) {
+            return compare_key(e, key, key_len) > 0;
+        });
+
+        m_keys.resize(key_offset);
+
+        while (last != first)
+        {
+            --last;
+            if (!is_live(last->id))
+                continue;
+            const int32 index = index_of(last->id) + 1;
+            if (index >= m_count)
+                continue;
+            if (str_compare<char, false/*compute_lcd*/, true/*exact_slash*/>(prev_cmd, list[index - 1]->line) != -1)
+                continue;
+            if (is_suggestion(index, line, true))
+                return list[index]->line;
+        }
+
+        return nullptr;
+    }
+
+    const uint32 key_offset = uint32(m_keys.size());
+    const uint32 key_len = fold_key(line);
+    const char* key = m_keys.data() + key_offset;
+
+    // Entries whose keys equal the line can't be suggestions (they have
+    // nothing more to add), so the range starts after them.
+    const auto lo = std::upper_bound(m_entries.begin(), m_entries.end(), 0, [&] (int, const entry& e) {
+        return compare_key(e, key, key_len) > 0;
+    });
+    const auto hi = std::upper_bound(lo, m_entries.end(), 0, [&] (int, const entry& e) {
+        return memcmp(key, m_keys.data() + e.key_offset, min(key_len, e.key_len)) < 0;
+    });
+
+    m_keys.resize(key_offset);
+
+    const uint32 lo_pos = uint32(lo - m_entries.begin());
+    const uint32 hi_pos = uint32(hi - m_entries.begin());
+    if (lo_pos >= hi_pos)
+        return nullptr;
+
+    // Usually the most recent entry in the range is the answer.
+    const uint32 best = find_most_recent(lo_pos, hi_pos);
+    if (best == c_none)
+        return nullptr;
+    const int32 best_index = index_of(m_entries[best].id);
+    if (is_suggestion(best_index, line, false))
+        return list[best_index]->line;
+
+    // Otherwise the folded key was more lenient than the current comparison
+    // mode, so try the rest of the range from most recent to least recent.
+    return find_by_recency(line, lo_pos, hi_pos, best);
+}
+
+//------------------------------------------------------------------------------
+// Walks the entries in [lo, hi) from most recent to least recent, skipping
+// `tried`, and returns the first suggestion.  The range is split into blocks
+// (plus partial blocks at the ends), and a heap holds the most recent untried
+// entry of each; a block's entries are only sorted once its most recent entry
+// has been tried.  Like the history scan this replaced, it gives up after
+// 50ms once it has tried a couple hundred entries.
+const char* history_prefix_index::find_by_recency(const char* line, uint32 lo, uint32 hi, uint32 tried) const
+{
+    struct segment
+    {
+        uint32              begin;
+        uint32              end;
+        std::vector<uint32> sorted;     // Live entries, most recent first.
+        uint32              next;
+    };
+
+    std::vector<segment> segments;
+    for (uint32 begin = lo; begin < hi;)
+    {
+        const uint32 end = min((begin / c_block_size + 1) * c_block_size, hi);
+        segments.push_back({ begin, end, {}, 0 });
+        begin = end;
+    }
+
+    // Each heap item is an entry position and its segment.
+    typedef std::pair<uint32, uint32> item;
+    auto less_recent = [this] (const item& l, const item& r) {
+        return m_entries[l.first].id < m_entries[r.first].id;
+    };
+    std::vector<item> heap;
+    auto push = [&] (uint32 pos, uint32 seg) {
+        heap.emplace_back(pos, seg);
+        std::push_heap(heap.begin(), heap.end(), less_recent);
+    };
+
+    for (uint32 seg = 0; seg < segments.size(); ++seg)
+    {
+        const uint32 pos = find_most_recent(segments[seg].begin, segments[seg].end);
+        if (pos != c_none)
+            push(pos, seg);
+    }
+
+    HIST_ENTRY** list = history_list();
+    const DWORD tick = GetTickCount();
+    const int32 scan_min = 200;
+    const DWORD ms_max = 50;
+    int32 scanned = 0;
+
+    while (!heap.empty())
+    {
+        std::pop_heap(heap.begin(), heap.end(), less_recent);
+        const item top = heap.back();
+        heap.pop_back();
+
+        if (top.first != tried)
+        {
+            if (scanned >= scan_min && !(scanned % 20) && GetTickCount() - tick >= ms_max)
+                break;
+            scanned++;
+
+            const int32 index = index_of(m_entries[top.first].id);
+            if (is_suggestion(index, line, false))
+                return list[index]->line;
+        }
+
+        // The top was the most recent entry left in its segment, so the
+        // segment's next entry goes on the heap.
+        segment& seg = segments[top.second];
+        if (!seg.next)
+        {
+            for (uint32 i = seg.begin; i < seg.end; ++i)
+            {
+                if (is_live(m_entries[i].id))
+                    seg.sorted.push_back(i);
+            }
+            std::sort(seg.sorted.begin(), seg.sorted.end(), [this] (uint32 l, uint32 r) {
+                return m_entries[l].id > m_entries[r].id;
+            });
+            seg.next = 1;
+        }
+        if (seg.next < seg.sorted.size())
+            push(seg.sorted[seg.next++], top.second);
+    }
+
+    return nullptr;
+}
+
+//------------------------------------------------------------------------------
+void history_prefix_index::sync()
+{
+    HIST_ENTRY** list = history_list();
+    const int32 length = list ? history_length : 0;
+
+    if (!m_count || length < m_count || list[m_count - 1] != m_last)
+    {
+        rebuild();
+        return;
+    }
+
+    // Entries for removed ids are only dropped once they're the majority.
+    if (m_removed > c_block_size && m_removed > m_entries.size() / 2)
+        compact();
+
+    // Append any entries Readline added since the index was last updated.
+    for (int32 i = m_count; i < length; ++i)
+    {
+        add_id();
+        insert(int32(m_live.size()) - 1, list[i]->line);
+    }
+
+    if (length > m_count)
+    {
+        m_count = length;
+        m_last = list[length - 1];
+    }
+}
+
+//------------------------------------------------------------------------------
+// Drops the entries for removed ids, and renumbers the rest so the ids match
+// the indices in Readline's history list again.  Renumbering keeps the order,
+// so nothing needs to be sorted.
+void history_prefix_index::compact()
+{
+    std::vector<int32> indices(m_live.size());
+    int32 count = 0;
+    for (size_t id = 0; id < m_live.size(); ++id)
+        indices[id] = m_live[id] ? count++ : -1;
+
+    m_entries.erase(std::remove_if(m_entries.begin(), m_entries.end(), [this] (const entry& e) {
+        return !is_live(e.id);
+    }), m_entries.end());
+    for (auto& e : m_entries)
+        e.id = indices[e.id];
+
+    reset_ids(count);
+    update_blocks(0, uint32(m_entries.size()));
+}
+
+//------------------------------------------------------------------------------
+void history_prefix_index::insert(int32 id, const char* line)
+{
+    entry e;
+    e.key_offset = uint32(m_keys.size());
+    e.key_len = fold_key(line);
+    e.id = id;
+
+    // The new entry is the most recent, so it goes after any equal keys.
+    const char* key = m_keys.data() + e.key_offset;
+    const auto iter = std::upper_bound(m_entries.begin(), m_entries.end(), 0, [&] (int, const entry& other) {
+        return compare_key(other, key, e.key_len) > 0;
+    });
+
+    const uint32 pos = uint32(iter - m_entries.begin());
+    m_entries.insert(iter, e);
+    update_blocks(pos, uint32(m_entries.size()));
+}
+
+//------------------------------------------------------------------------------
+// Updates the blocks that contain the entries from `from` up to `to`.
+void history_prefix_index::update_blocks(uint32 from, uint32 to)
+{
+    const uint32 count = uint32(m_entries.size());
+    const uint32 num_blocks = (count + c_block_size - 1) / c_block_size;
+    m_block_best.resize(num_blocks);
+
+    const uint32 last_block = min((to + c_block_size - 1) / c_block_size, num_blocks);
+    for (uint32 block = from / c_block_size; block < last_block; ++block)
+    {
+        const uint32 begin = block * c_block_size;
+        const uint32 end = min(begin + c_block_size, count);
+        uint32 best = c_none;
+        for (uint32 i = begin; i < end; ++i)
+        {
+            if (is_live(m_entries[i].id) && (best == c_none || m_entries[i].id > m_entries[best].id))
+                best = i;
+        }
+        m_block_best[block] = best;
+    }
+}
+
+//------------------------------------------------------------------------------
+// Makes ids 0 through count - 1 live.
+void history_prefix_index::reset_ids(int32 count)
+{
+    m_live.assign(count, true);
+    m_live_tree.resize(count + 1);
+    m_live_tree[0] = 0;
+    for (int32 i = 1; i <= count; ++i)
+        m_live_tree[i] = i & -i;
+    m_removed = 0;
+}
+
+//------------------------------------------------------------------------------
+// Adds a live id after the existing ones.
+void history_prefix_index::add_id()
+{
+    // Tree node i counts ids i - lowbit(i) through i - 1.
+    const int32 i = int32(m_live.size()) + 1;
+    m_live_tree.push_back(1 + index_of(i - 1) - index_of(i - (i & -i)));
+    m_live.push_back(true);
+}
+
+//------------------------------------------------------------------------------
+void history_prefix_index::remove_id(int32 id)
+{
+    m_live[id] = false;
+    for (int32 i = id + 1; i < int32(m_live_tree.size()); i += i & -i)
+        --m_live_tree[i];
+}
+
+//------------------------------------------------------------------------------
+// Returns the index in Readline's history list for a live id, which is the
+// number of live ids before it.
+int32 history_prefix_index::index_of(int32 id) const
+{
+    int32 index = 0;
+    for (int32 i = id; i > 0; i -= i & -i)
+        index += m_live_tree[i];
+    return index;
+}
+
+//------------------------------------------------------------------------------
+// Returns the live id for an index in Readline's history list.
+int32 history_prefix_index::id_of(int32 index) const
+{
+    const int32 n = int32(m_live.size());
+    int32 step = 1;
+    while (step * 2 <= n)
+        step *= 2;
+
+    int32 id = 0;
+    int32 remaining = index + 1;
+    for (; step; step >>= 1)
+    {
+        if (id + step <= n && m_live_tree[id + step] < remaining)
+        {
+            id += step;
+            remaining -= m_live_tree[id];
+        }
+    }
+    return id;
+}
+
+//------------------------------------------------------------------------------
+uint32 history_prefix_index::fold_key(const char* line)
+{
+    // Fold so that anything str_compare() could consider equal (in caseless
+    // or relaxed mode, with or without fuzzy accents) gets the same key.
+    const size_t start = m_keys.size();
+
+    str_iter iter(line);
+    while (iter.more())
+    {
+        int32 c = iter.next();
+        c = (c > 0xffff) ? c : int32(uintptr_t(CharLowerW(LPWSTR(uintptr_t(c)))));
+        c = normalize_accent(c);
+        if (c == '-')
+            c = '_';
+        append_utf8(m_keys, c);
+
+        // str_compare() considers a run of separators after '/' equal to a
+        // single '/'.
+        if (c == '/')
+        {
+            while (path::is_separator(iter.peek()))
+                iter.next();
+        }
+    }
+
+    return uint32(m_keys.size() - start);
+}
+
+//------------------------------------------------------------------------------
+int32 history_prefix_index::compare_key(const entry& e, const char* key, uint32 len) const
+{
+    const int32 cmp = memcmp(m_keys.data() + e.key_offset, key, min(e.key_len, len));
+    if (cmp)
+        return cmp;
+    return int32(e.key_len) - int32(len);
+}
+
+//------------------------------------------------------------------------------
+uint32 history_prefix_index::find_most_recent(uint32 lo, uint32 hi) const
+{
+    assert(lo < hi);
+
+    uint32 best = c_none;
+    auto consider = [&] (uint32 i) {
+        if (i != c_none && is_live(m_entries[i].id) && (best == c_none || m_entries[i].id > m_entries[best].id))
+            best = i;
+    };
+
+    const uint32 first_full = (lo + c_block_size - 1) / c_block_size;
+    const uint32 last_full = hi / c_block_size;
+    if (first_full >= last_full)
+    {
+        for (uint32 i = lo; i < hi; ++i)
+            consider(i);
+        return best;
+    }
+
+    for (uint32 i = lo; i < first_full * c_block_size; ++i)
+        consider(i);
+    for (uint32 block = first_full; block < last_full; ++block)
+        consider(m_block_best[block]);
+    for (uint32 i = last_full * c_block_size; i < hi; ++i)
+        consider(i);
+    return best;
+}
+
+//------------------------------------------------------------------------------
+bool history_prefix_index::is_suggestion(int32 index, const char* line, bool match_prev_cmd) const
+{
+    HIST_ENTRY** list = history_list();
+    if (!list || index >= history_length)
+        return false;
+
+    str_iter lhs(line);
+    str_iter rhs(list[index]->line);
+    const int32 matchlen = str_compare<char, false/*compute_lcd*/, true/*exact_slash*/>(lhs, rhs);
+
+    // lhs isn't exhausted, or rhs is exhausted?  Not a suggestion.
+    if (lhs.more() || !rhs.more())
+        return false;
+
+    // Zero matching length is only ok with 'match_prev_cmd'.
+    return matchlen || match_prev_cmd;
+}
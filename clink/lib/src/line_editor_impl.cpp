@@ -13,6 +13,7 @@
 #include "cmd_tokenisers.h"
 #include "doskey.h"
 #include "display_readline.h"
+#include "dir_snapshot.h"
 #include "clink_ctrlevent.h"
 #include "clink_rl_signal.h"
 #include "line_editor_integration.h"
@@ -232,6 +233,7 @@ line_editor_impl::line_editor_impl(const desc& desc)
 : m_desc(desc)
 , m_module(desc.input)
 , m_collector(desc.command_tokeniser, desc.word_tokeniser, desc.get_quote_pair())
+, m_frames(desc.input)
 , m_printer(*desc.printer)
 , m_pager(*this)
 , m_selectcomplete(*this)
@@ -311,6 +313,10 @@ void line_editor_impl::begin_line()
     match_pipeline pipeline(m_matches);
     pipeline.reset();
 
+    // Prompt filters may have swept directories since the last line ended.
+    dir_snapshot_cache::get().release_notifications();
+    release_recognizer_notifications();
+
     const int32 began = m_desc.input->begin();
     assert(began == 1);
     m_desc.output->begin();
@@ -363,6 +369,10 @@ void line_editor_impl::end_line()
     m_command_line_states.clear();
     m_classify_words.clear();
 
+    // Don't hold change notification handles while the command runs.
+    dir_snapshot_cache::get().release_notifications();
+    release_recognizer_notifications();
+
     set_active_line_editor(nullptr, nullptr);
 
     clear_flag(flag_editing);
@@ -447,7 +457,12 @@ bool line_editor_impl::edit(str_base& out, bool edit)
         while (update())
         {
             if (!m_module.is_input_pending())
+            {
+                // Never wait for input while an update is deferred.
+                if (m_frames.has_deferred() && !m_desc.input->available(0))
+                    update_frame();
                 m_desc.input->select(m_idle);
+            }
         }
     }
     else
@@ -505,17 +520,39 @@ bool line_editor_impl::update()
         return true;
     }
 
-    update_input();
+    {
+        frame_scheduler::defer_scope defer(m_frames);
+        update_input();
+    }
 
     maybe_handle_signal();
 
     if (!check_flag(flag_editing))
+    {
+        m_frames.reset();
         return false;
+    }
 
-    update_internal();
+    // Coalesce updates while more input is already queued, e.g. while pasting
+    // or during key repeat.
+    if (m_frames.defer_update(m_module.is_input_pending()))
+        return true;
+
+    update_frame();
     return true;
 }
 
+//------------------------------------------------------------------------------
+void line_editor_impl::update_frame()
+{
+    if (m_frames.take_deferred_display())
+        m_buffer.set_need_draw();
+    m_frames.reset();
+
+    update_internal();
+    maybe_redisplay_readline();
+}
+
 //------------------------------------------------------------------------------
 void line_editor_impl::reset_generate_matches()
 {
@@ -874,7 +911,11 @@ bool line_editor_impl::update_input()
         }
         else
         {
-            before_display_readline();
+            // Displaying also classifies and hints, so this can wait while
+            // more input is queued.
+            if ((result.flags & result_impl::flag_done) ||
+                !frame_scheduler::is_deferring(m_module.is_input_pending()))
+                before_display_readline();
 
             if (result.flags & result_impl::flag_done)
             {
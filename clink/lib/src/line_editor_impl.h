@@ -6,6 +6,7 @@
 #include "bind_resolver.h"
 #include "binder.h"
 #include "editor_module.h"
+#include "frame_scheduler.h"
 #include "input_dispatcher.h"
 #include "terminal/input_idle.h"
 #include "terminal/key_tester.h"
@@ -136,6 +137,7 @@ private:
     void                maybe_send_oncommand_event();
     matches*            get_mutable_matches(bool nosort=false);
     void                update_internal(bool force=false);
+    void                update_frame();
     bool                update_input();
     module::context     get_context() const;
     line_state          get_linestate() const;
@@ -158,6 +160,7 @@ private:
     hinter*             m_hinter = nullptr;
     word_classifier*    m_classifier = nullptr;
     input_idle*         m_idle = nullptr;
+    frame_scheduler     m_frames;
     binder              m_binder;
     bind_resolver       m_bind_resolver = { m_binder };
     input_hint          m_input_hint;
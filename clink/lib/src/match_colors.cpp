@@ -30,12 +30,15 @@
 #include "pch.h"
 #include <assert.h>
 #include <core/debugheap.h>
+#include <core/linear_allocator.h>
 #include <core/os.h>
 #include <core/path.h>
 #include <core/settings.h>
+#include <core/str_unordered_set.h>
 #include <wildmatch/wildmatch.h>
 
 #include "match_colors.h"
+#include "dir_snapshot.h"
 
 extern "C" {
 #define READLINE_LIBRARY
@@ -790,6 +793,175 @@ void make_color(const char* seq, str_base& out)
     out << s_colors[C_LEFT] << seq << s_colors[C_RIGHT];
 }
 
+//------------------------------------------------------------------------------
+// Caches stat results for the current completion generation, keyed by full
+// path name, so that redrawing the match list doesn't need to query the file
+// system again for each match.  Directory enumerations can fill it in advance,
+// and misses are answered from the shared directory snapshots when possible.
+// Only used on the main thread.
+class stat_cache
+{
+    enum { c_unknown = -2, c_max_entries = 20000 };
+    struct entry
+    {
+        int32               lstat_ok = c_unknown;
+        int32               stat_ok = c_unknown;
+        mode_t              lstat_mode = 0;
+        mode_t              stat_mode = 0;
+    };
+
+public:
+                            stat_cache() : m_store(8192) {}
+    void                    clear();
+    void                    add(const char* full, uint32 attr, bool symlink);
+    int32                   get_lstat(const char* name, struct stat* out);
+    int32                   get_stat(const char* name, struct stat* out);
+
+private:
+    entry*                  find(const char* name, bool create);
+    void                    fill_from_snapshot(const char* name, entry* e);
+    linear_allocator        m_store;
+    str_unordered_map<entry> m_entries;
+};
+
+//------------------------------------------------------------------------------
+void stat_cache::clear()
+{
+    m_entries.clear();
+    m_store.reset();
+}
+
+//------------------------------------------------------------------------------
+stat_cache::entry* stat_cache::find(const char* name, bool create)
+{
+    str<280> full;
+    if (!os::get_full_path_name(name, full))
+        return nullptr;
+    path::maybe_strip_last_separator(full);
+
+    const auto iter = m_entries.find(full.c_str());
+    if (iter != m_entries.end())
+        return &iter->second;
+    if (!create)
+        return nullptr;
+
+    if (m_entries.size() >= c_max_entries)
+        clear();
+
+    const char* key = m_store.store(full.c_str());
+    if (!key)
+        return nullptr;
+    return &m_entries.emplace(key, entry()).first->second;
+}
+
+//------------------------------------------------------------------------------
+void stat_cache::add(const char* full, uint32 attr, bool symlink)
+{
+    entry* e = find(full, true);
+    if (!e)
+        return;
+
+    // This produces the same mode as hooked_lstat().
+    mode_t mode = 0;
+    mode |= (attr & FILE_ATTRIBUTE_DIRECTORY) ? _S_IFDIR|_S_IEXEC : _S_IFREG;
+    mode |= (attr & FILE_ATTRIBUTE_READONLY) ? _S_IREAD : _S_IREAD|_S_IWRITE;
+    if (!S_ISDIR(mode) && path::is_executable_extension(full))
+        mode |= _S_IEXEC;
+#if defined(S_ISLNK)
+    if (symlink)
+        mode |= _S_IFLNK;
+#endif
+    mode |= (mode & 0700) >> 3;
+    mode |= (mode & 0700) >> 6;
+
+    e->lstat_ok = 0;
+    e->lstat_mode = mode;
+    e->stat_ok = c_unknown;
+}
+
+//------------------------------------------------------------------------------
+// Fills in an entry from the shared directory snapshots, if its directory has
+// been swept recently.
+void stat_cache::fill_from_snapshot(const char* name, entry* e)
+{
+    dir_snapshot::file file;
+    switch (dir_snapshot_cache::get().lookup(name, &file))
+    {
+    case dir_snapshot_cache::lookup_found:
+        add(name, file.info.attr, S_ISLNK(file.info.st_mode));
+        break;
+    case dir_snapshot_cache::lookup_missing:
+        e->lstat_ok = -1;
+        e->stat_ok = -1;
+        e->lstat_mode = 0;
+        e->stat_mode = 0;
+        break;
+    }
+}
+
+//------------------------------------------------------------------------------
+int32 stat_cache::get_lstat(const char* name, struct stat* out)
+{
+    entry* e = find(name, true);
+    if (e && e->lstat_ok == c_unknown && e->stat_ok == c_unknown)
+        fill_from_snapshot(name, e);
+    if (e && e->lstat_ok != c_unknown)
+    {
+        memset(out, 0, sizeof(*out));
+        out->st_mode = e->lstat_mode;
+        return e->lstat_ok;
+    }
+
+#if defined(HAVE_LSTAT)
+    const int32 ok = ::lstat(name, out);
+#else
+    const int32 ok = ::stat(name, out);
+#endif
+    if (e)
+    {
+        e->lstat_ok = ok;
+        e->lstat_mode = out->st_mode;
+    }
+    return ok;
+}
+
+//------------------------------------------------------------------------------
+int32 stat_cache::get_stat(const char* name, struct stat* out)
+{
+    entry* e = find(name, true);
+    if (e && e->lstat_ok == c_unknown && e->stat_ok == c_unknown)
+        fill_from_snapshot(name, e);
+    if (e && e->stat_ok != c_unknown)
+    {
+        memset(out, 0, sizeof(*out));
+        out->st_mode = e->stat_mode;
+        return e->stat_ok;
+    }
+
+    const int32 ok = ::stat(name, out);
+    if (e)
+    {
+        e->stat_ok = ok;
+        e->stat_mode = out->st_mode;
+    }
+    return ok;
+}
+
+//------------------------------------------------------------------------------
+static stat_cache s_stat_cache;
+
+//------------------------------------------------------------------------------
+void clear_match_color_stat_cache()
+{
+    s_stat_cache.clear();
+}
+
+//------------------------------------------------------------------------------
+void cache_match_color_stat(const char* full, uint32 attr, bool symlink)
+{
+    s_stat_cache.add(full, attr, symlink);
+}
+
 //------------------------------------------------------------------------------
 static bool get_ls_color(const char *f, match_type type, str_base& out)
 {
@@ -823,9 +995,9 @@ static bool get_ls_color(const char *f, match_type type, str_base& out)
 #endif
     else
 #if defined(HAVE_LSTAT)
-        stat_ok = lstat(name, &astat);
+        stat_ok = s_stat_cache.get_lstat(name, &astat);
 #else
-        stat_ok = stat(name, &astat);
+        stat_ok = s_stat_cache.get_stat(name, &astat);
 #endif
     if (stat_ok == 0)
     {
@@ -836,7 +1008,7 @@ static bool get_ls_color(const char *f, match_type type, str_base& out)
             if (!is_zero(type))
                 linkok = linkstat.st_mode != 0;
             else
-                linkok = stat(name, &linkstat) == 0;
+                linkok = s_stat_cache.get_stat(name, &linkstat) == 0;
             if (linkok && _strnicmp(LS_COLORS_indicator[C_LINK].string, "target", 6) == 0)
                 mode = linkstat.st_mode;
         }
@@ -985,9 +1157,9 @@ bool get_match_color(const char* f, match_type type, str_base& out)
     else
     {
 #if defined(HAVE_LSTAT)
-        stat_ok = lstat(name, &astat);
+        stat_ok = s_stat_cache.get_lstat(name, &astat);
 #else
-        stat_ok = stat(name, &astat);
+        stat_ok = s_stat_cache.get_stat(name, &astat);
 #endif
     }
 
@@ -1002,7 +1174,7 @@ bool get_match_color(const char* f, match_type type, str_base& out)
             if (!is_zero(type))
                 linkok = linkstat.st_mode != 0;
             else
-                linkok = stat(name, &linkstat) == 0;
+                linkok = s_stat_cache.get_stat(name, &linkstat) == 0;
             if (linkok && _strnicmp(s_colors[C_LINK], "target", 6) == 0)
                 mode = linkstat.st_mode;
         }
@@ -7,6 +7,7 @@
 #include "match_pipeline.h"
 #include "matches_impl.h"
 #include "display_matches.h"
+#include "match_colors.h"
 #include "slash_translation.h"
 
 #include <core/array.h>
@@ -105,7 +106,7 @@ static uint32 pattern_selector(
     int32 count,
     bool dot_prefix)
 {
-    const int32 needle_len = strlen(needle);
+    const path::wild_matcher matcher(needle);
     const bool include_hidden = (_rl_match_hidden_files || *path::get_name(needle) == '.');
     int32 select_count = 0;
     for (int32 i = 0; i < count; ++i)
@@ -119,7 +120,7 @@ static uint32 pattern_selector(
         const path::star_matches_everything flag = (is_pathish(info.type) ? path::at_end : path::yes);
         const bool select = ((include_hidden || !path::is_unix_hidden(match, true)) &&
                              include_match_type(info.type) &&
-                             path::match_wild(str_iter(needle, needle_len), str_iter(match, match_len), dot_prefix, flag));
+                             matcher.match(match, match_len, dot_prefix, flag));
         info.select = select;
         if (select)
             ++select_count;
@@ -128,10 +129,36 @@ static uint32 pattern_selector(
 }
 
 //------------------------------------------------------------------------------
+// Any match selected by prefix_selector() for a needle was also selected for
+// every prefix of the needle, as long as the other selection conditions are
+// the same.  This returns a key representing those conditions, or 0 if the
+// selection can't be narrowed that way.
+static uint32 get_narrowing_key(const char* needle)
+{
+    const bool dot_prefix = (rl_completion_type == '%' && g_default_bindings.get() == 1);
+    if (dot_prefix || g_match_wild.get())
+        return 0;
+
+    uint32 key = 1;
+    key |= uint32(uint8(rl_completion_type)) << 8;
+    key |= uint32(str_compare_scope::current()) << 16;
+    key |= uint32(str_compare_scope::current_fuzzy_accents()) << 18;
+    key |= uint32(!!_rl_match_hidden_files) << 19;
+    key |= uint32(g_files_hidden.get()) << 20;
+    key |= uint32(g_files_system.get()) << 21;
+    key |= uint32(*path::get_name(needle) == '.') << 22;
+    return key;
+}
+
+//------------------------------------------------------------------------------
+// When narrow_count is not 0, only the first narrow_count infos can match (the
+// rest must already be unselected).  Sets narrowable to whether the selection
+// can be narrowed by a later select.  Returns the number of selected matches.
 template<class INDEXER>
-static void select_matches(const char* needle, INDEXER& indexer, uint32 count)
+static uint32 select_matches(const char* needle, INDEXER& indexer, uint32 count, uint32 narrow_count, bool& narrowable)
 {
     uint32 found = 0;
+    narrowable = false;
 
     const bool dot_prefix = (rl_completion_type == '%' && g_default_bindings.get() == 1);
     if (dot_prefix || g_match_wild.get())
@@ -142,18 +169,22 @@ static void select_matches(const char* needle, INDEXER& indexer, uint32 count)
     }
     else
     {
-        found = prefix_selector(needle, indexer, count);
+        found = prefix_selector(needle, indexer, narrow_count ? narrow_count : count);
+        narrowable = !!found;
     }
 
     if (!found && can_try_substring_pattern(needle))
     {
+        // Substring matches aren't limited to the previous selection.
         char* sub = make_substring_pattern(needle, "*");
         if (sub)
         {
-            pattern_selector(sub, indexer, count, dot_prefix);
+            found = pattern_selector(sub, indexer, count, dot_prefix);
             free(sub);
         }
     }
+
+    return found;
 }
 
 //------------------------------------------------------------------------------
@@ -169,108 +200,186 @@ static bool is_dir_match(const wstr_base& match, match_type type)
 }
 
 //------------------------------------------------------------------------------
-inline bool sort_worker(wstr_base& l, match_type l_type,
-                        wstr_base& r, match_type r_type,
-                        int32 order)
+// Everything the match sort order depends on, computed once per match.  This
+// turns sorting into plain key comparisons, instead of converting to UTF16 and
+// calling CompareStringW up to twice in every comparison.
+struct match_sort_key
 {
-    bool l_dir = is_dir_match(l, l_type);
-    bool r_dir = is_dir_match(r, r_type);
+    uint32          index;          // Index of the match_info.
+    uint32          minus_count;    // Number of leading minus signs.
+    uint32          fold_offset;    // Case-folded collation key.
+    uint32          fold_len;
+    uint32          exact_offset;   // Case-sensitive collation key.
+    uint32          exact_len;
+    uint8           bucket;         // Where dirs sort relative to non-dirs.
+    uint8           type_rank;      // Final tiebreak by match type.
+};
 
-    if (order != 1 && l_dir != r_dir)
-        return (order == 0) ? l_dir : r_dir;
+//------------------------------------------------------------------------------
+class match_sort_keys
+{
+public:
+                    match_sort_keys(int32 order) : m_order(order) {}
+    void            reserve(uint32 count);
+    void            add(uint32 index, const char* match, match_type type);
+    void            sort();
+    const std::vector<match_sort_key>& get_keys() const { return m_keys; }
+    bool            less(const match_sort_key& l, const match_sort_key& r) const;
 
-    if (l_dir)
-        path::maybe_strip_last_separator(l);
-    if (r_dir)
-        path::maybe_strip_last_separator(r);
+private:
+    uint32          append_collation_key(DWORD flags, uint32& len);
+    static uint8    get_type_rank(match_type type);
+    const int32     m_order;
+    std::vector<match_sort_key> m_keys;
+    std::vector<uint8> m_collation;
+    wstr<>          m_tmp;
+};
 
-    int32 cmp;
-    DWORD flags = SORT_DIGITSASNUMBERS|NORM_LINGUISTIC_CASING;
-    if (true/*casefold*/)
-        flags |= LINGUISTIC_IGNORECASE;
-    const wchar_t* l_str = l.c_str();
-    const wchar_t* r_str = r.c_str();
+//------------------------------------------------------------------------------
+void match_sort_keys::reserve(uint32 count)
+{
+    m_keys.reserve(count);
+    m_collation.reserve(count * 32);
+}
 
-    // Sort first by number of leading minus signs.  This is intended so that
-    // `-` flags precede `--` flags.
-    if (*l_str == '-' || *r_str == '-')
-    {
-        int32 l_minus = 0;
-        int32 r_minus = 0;
-        for (const wchar_t* l_walk = l_str; *l_walk == '-'; ++l_walk)
-            l_minus++;
-        for (const wchar_t* r_walk = r_str; *r_walk == '-'; ++r_walk)
-            r_minus++;
-        cmp = l_minus - r_minus;
-        if (cmp) return (cmp < 0);
-    }
+//------------------------------------------------------------------------------
+void match_sort_keys::add(uint32 index, const char* match, match_type type)
+{
+    m_tmp.clear();
+    to_utf16(m_tmp, match);
 
-    // Sort next by the strings.
-    cmp = CompareStringW(LOCALE_USER_DEFAULT, flags, l_str, l.length(), r_str, r.length());
-    cmp -= CSTR_EQUAL;
-    if (cmp) return (cmp < 0);
+    match_sort_key key;
+    key.index = index;
 
-    // If case insensitive sort, then compare again as case sensitive, for
-    // consistent ordering.
-    if (flags & LINGUISTIC_IGNORECASE)
-    {
-        flags &= ~LINGUISTIC_IGNORECASE;
-        cmp = CompareStringW(LOCALE_USER_DEFAULT, flags, l_str, l.length(), r_str, r.length());
-        cmp -= CSTR_EQUAL;
-        if (cmp) return (cmp < 0);
-    }
+    // Dirs can go before files, with files, or after files.
+    const bool dir = is_dir_match(m_tmp, type);
+    key.bucket = (m_order == 0) ? !dir : (m_order == 2) ? dir : 0;
+    if (dir)
+        path::maybe_strip_last_separator(m_tmp);
 
-    // Finally sort by type (dir, alias, command, word, arg, file).
-    const uint8 t1 = uint8(l_type) & MATCH_TYPE_MASK;
-    const uint8 t2 = uint8(r_type) & MATCH_TYPE_MASK;
+    // Sort first by number of leading minus signs.  This is intended so that
+    // `-` flags precede `--` flags.
+    key.minus_count = 0;
+    for (const wchar_t* walk = m_tmp.c_str(); *walk == '-'; ++walk)
+        key.minus_count++;
 
-    cmp = int32(t1 == MATCH_TYPE_DIR) - int32(t2 == MATCH_TYPE_DIR);
-    if (cmp) return (cmp < 0);
+    // Sort next by the strings case insensitively, and then case sensitively
+    // for consistent ordering.
+    const DWORD flags = SORT_DIGITSASNUMBERS|NORM_LINGUISTIC_CASING;
+    key.fold_offset = append_collation_key(flags|LINGUISTIC_IGNORECASE, key.fold_len);
+    key.exact_offset = append_collation_key(flags, key.exact_len);
 
-    cmp = int32(t1 == MATCH_TYPE_ALIAS) - int32(t2 == MATCH_TYPE_ALIAS);
-    if (cmp) return (cmp < 0);
+    key.type_rank = get_type_rank(type);
 
-    cmp = int32(t1 == MATCH_TYPE_COMMAND) - int32(t2 == MATCH_TYPE_COMMAND);
-    if (cmp) return (cmp < 0);
+    m_keys.emplace_back(std::move(key));
+}
 
-    cmp = int32(t1 == MATCH_TYPE_WORD) - int32(t2 == MATCH_TYPE_WORD);
-    if (cmp) return (cmp < 0);
+//------------------------------------------------------------------------------
+uint32 match_sort_keys::append_collation_key(DWORD flags, uint32& len)
+{
+    const uint32 offset = uint32(m_collation.size());
+    len = 0;
+
+    // LCMapStringW rejects empty input; an empty key sorts first, the same as
+    // CompareStringW sorts an empty string.
+    if (m_tmp.empty())
+        return offset;
+
+    // Sort keys compare with memcmp the same as CompareStringW compares the
+    // strings they came from.  Guess at a size first to usually avoid calling
+    // LCMapStringW twice.
+    flags |= LCMAP_SORTKEY;
+    int32 room = max<int32>(64, m_tmp.length() * 8);
+    m_collation.resize(offset + room);
+    int32 bytes = LCMapStringW(LOCALE_USER_DEFAULT, flags, m_tmp.c_str(), m_tmp.length(), LPWSTR(m_collation.data() + offset), room);
+    if (!bytes)
+    {
+        room = LCMapStringW(LOCALE_USER_DEFAULT, flags, m_tmp.c_str(), m_tmp.length(), nullptr, 0);
+        m_collation.resize(offset + max<int32>(room, 0));
+        if (room > 0)
+            bytes = LCMapStringW(LOCALE_USER_DEFAULT, flags, m_tmp.c_str(), m_tmp.length(), LPWSTR(m_collation.data() + offset), room);
+    }
+
+    bytes = max<int32>(bytes, 0);
+    m_collation.resize(offset + bytes);
+    len = uint32(bytes);
+    return offset;
+}
 
-    cmp = int32(t1 == MATCH_TYPE_ARG) - int32(t2 == MATCH_TYPE_ARG);
-    if (cmp) return (cmp < 0);
+//------------------------------------------------------------------------------
+uint8 match_sort_keys::get_type_rank(match_type type)
+{
+    // Finally sort by type.  Types without a rank sort first, followed by
+    // file, arg, word, command, alias, and dir.
+    switch (uint8(type) & MATCH_TYPE_MASK)
+    {
+    case MATCH_TYPE_FILE:       return 1;
+    case MATCH_TYPE_ARG:        return 2;
+    case MATCH_TYPE_WORD:       return 3;
+    case MATCH_TYPE_COMMAND:    return 4;
+    case MATCH_TYPE_ALIAS:      return 5;
+    case MATCH_TYPE_DIR:        return 6;
+    default:                    return 0;
+    }
+}
 
-    cmp = int32(t1 == MATCH_TYPE_FILE) - int32(t2 == MATCH_TYPE_FILE);
-    if (cmp) return (cmp < 0);
+//------------------------------------------------------------------------------
+bool match_sort_keys::less(const match_sort_key& l, const match_sort_key& r) const
+{
+    if (l.bucket != r.bucket)
+        return l.bucket < r.bucket;
+
+    if (l.minus_count != r.minus_count)
+        return l.minus_count < r.minus_count;
+
+    const uint8* const collation = m_collation.data();
+    int32 cmp = memcmp(collation + l.fold_offset, collation + r.fold_offset, min(l.fold_len, r.fold_len));
+    if (!cmp)
+        cmp = int32(l.fold_len) - int32(r.fold_len);
+    if (cmp)
+        return cmp < 0;
+
+    cmp = memcmp(collation + l.exact_offset, collation + r.exact_offset, min(l.exact_len, r.exact_len));
+    if (!cmp)
+        cmp = int32(l.exact_len) - int32(r.exact_len);
+    if (cmp)
+        return cmp < 0;
+
+    return l.type_rank < r.type_rank;
+}
 
-    return (cmp < 0);
+//------------------------------------------------------------------------------
+void match_sort_keys::sort()
+{
+    std::sort(m_keys.begin(), m_keys.end(), [this] (const match_sort_key& l, const match_sort_key& r) {
+        return less(l, r);
+    });
 }
 
 //------------------------------------------------------------------------------
 bool compare_matches(const char* l, match_type l_type, const char* r, match_type r_type)
 {
-    wstr<> ltmp;
-    wstr<> rtmp;
-    to_utf16(ltmp, l);
-    to_utf16(rtmp, r);
-    return sort_worker(ltmp, l_type, rtmp, r_type, g_sort_dirs.get());
+    match_sort_keys keys(g_sort_dirs.get());
+    keys.add(0, l, l_type);
+    keys.add(1, r, r_type);
+    return keys.less(keys.get_keys()[0], keys.get_keys()[1]);
 }
 
 //------------------------------------------------------------------------------
 static void alpha_sorter(match_info* infos, int32 count)
 {
-    int32 order = g_sort_dirs.get();
-    wstr<> ltmp;
-    wstr<> rtmp;
+    match_sort_keys keys(g_sort_dirs.get());
+    keys.reserve(count);
+    for (int32 i = 0; i < count; ++i)
+        keys.add(i, infos[i].match, infos[i].type);
 
-    auto predicate = [&] (const match_info& lhs, const match_info& rhs) {
-        ltmp.clear();
-        rtmp.clear();
-        to_utf16(ltmp, lhs.match);
-        to_utf16(rtmp, rhs.match);
-        return sort_worker(ltmp, lhs.type, rtmp, rhs.type, order);
-    };
+    keys.sort();
 
-    std::sort(infos, infos + count, predicate);
+    std::vector<match_info> sorted;
+    sorted.reserve(count);
+    for (const auto& key : keys.get_keys())
+        sorted.emplace_back(infos[key.index]);
+    memcpy(infos, sorted.data(), count * sizeof(*infos));
 }
 
 //------------------------------------------------------------------------------
@@ -328,6 +437,10 @@ void match_pipeline::generate(
     }
     m_matches.set_path_separator(sep);
 
+    // Stat results for coloring are cached per generation.  Generators that
+    // enumerate directories fill the cache as they go.
+    clear_match_color_stat_cache();
+
     match_builder builder(m_matches);
     if (generator)
         generator->generate(states, builder, old_filtering);
@@ -459,14 +572,31 @@ void match_pipeline::select(const char* needle) const
         }
     }
 
+    uint32 found = 0;
     if (count)
     {
+        // When the needle extends the needle from the previous select, only
+        // the previously selected matches need to be considered.  Coalescing
+        // moved them to the front.
+        uint32 narrow_count = 0;
+        const uint32 key = get_narrowing_key(needle);
+        if (key && key == m_matches.m_select_key && m_matches.m_coalesced)
+        {
+            const uint32 len = m_matches.m_select_needle.length();
+            if (strncmp(needle, m_matches.m_select_needle.c_str(), len) == 0)
+                narrow_count = m_matches.get_match_count();
+        }
+
+        bool narrowable;
         match_info_indexer indexer(m_matches.get_infos());
-        select_matches(needle, indexer, count);
+        found = select_matches(needle, indexer, count, narrow_count, narrowable);
         m_matches.set_completion_type(rl_completion_type);
+
+        m_matches.m_select_key = narrowable ? key : 0;
+        m_matches.m_select_needle = needle;
     }
 
-    m_matches.coalesce(count);
+    m_matches.coalesce(found);
 
 #ifdef DEBUG
     if (dbg_get_env_int("DEBUG_PIPELINE"))
@@ -494,5 +624,11 @@ void match_pipeline::sort() const
     if (m_matches.m_nosort)
         ordinal_sorter(m_matches.get_infos(), count); // "no sort" means "original order".
     else
-        alpha_sorter(m_matches.get_infos(), count);
+        sort_match_infos(m_matches.get_infos(), count);
+}
+
+//------------------------------------------------------------------------------
+void sort_match_infos(match_info* infos, int32 count)
+{
+    alpha_sorter(infos, count);
 }
@@ -8,6 +8,7 @@
 class line_states;
 class match_generator;
 class matches_impl;
+struct match_info;
 
 //------------------------------------------------------------------------------
 class match_pipeline
@@ -25,3 +26,6 @@ public:
 private:
     matches_impl&       m_matches;
 };
+
+//------------------------------------------------------------------------------
+void sort_match_infos(match_info* infos, int32 count);
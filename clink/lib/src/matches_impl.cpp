@@ -411,8 +411,7 @@ static char* __tilde_expand(const char* in)
 matches_iter::matches_iter(const matches& matches, const char* pattern)
 : m_matches(matches)
 , m_expanded_pattern(pattern && rl_complete_with_tilde_expansion ? __tilde_expand(pattern) : nullptr)
-, m_pattern((m_expanded_pattern ? m_expanded_pattern : pattern),
-            (m_expanded_pattern ? m_expanded_pattern : pattern) ? -1 : 0)
+, m_pattern(m_expanded_pattern ? m_expanded_pattern : pattern)
 , m_has_pattern(pattern != nullptr)
 , m_can_try_substring(can_try_substring_pattern(pattern))
 , m_filename_completion_desired(matches.is_filename_completion_desired())
@@ -452,7 +451,7 @@ bool matches_iter::next()
                 match_len--;
 
             const path::star_matches_everything flag = is_pathish(get_match_type()) ? path::at_end : path::yes;
-            if (path::match_wild(m_pattern, str_iter(match, match_len), dot_prefix, flag))
+            if (m_pattern.match(match, match_len, dot_prefix, flag))
                 goto found;
         }
     }
@@ -537,13 +536,13 @@ bool matches_iter::try_substring()
 
     m_can_try_substring = false;
 
-    char* pattern = make_substring_pattern(m_pattern.get_pointer());
+    char* pattern = make_substring_pattern(m_pattern.get_pattern());
     if (!pattern)
         return false;
 
     free(m_expanded_pattern);
     m_expanded_pattern = pattern;
-    m_pattern = str_iter(m_expanded_pattern, -1);
+    m_pattern.set(m_expanded_pattern);
     m_index = 0;
     m_next = 0;
     return true;
@@ -916,6 +915,8 @@ void matches_impl::reset()
     m_filename_completion_desired.reset();
     m_filename_display_desired.reset();
     m_input_line.clear();
+    m_select_needle.clear();
+    m_select_key = 0;
 
     set_slash_translation(g_translate_slashes.get());
 }
@@ -947,6 +948,8 @@ void matches_impl::transfer(matches_impl& from)
     m_filename_completion_desired = from.m_filename_completion_desired;
     m_filename_display_desired = from.m_filename_display_desired;
     m_input_line = std::move(from.m_input_line);
+    m_select_needle = std::move(from.m_select_needle);
+    m_select_key = from.m_select_key;
 
     m_dedup = from.m_dedup;
 
@@ -1260,7 +1263,10 @@ void matches_impl::done_building()
 
                 // Check if it has become a duplicate.
                 if (m_dedup->find(lookup) != m_dedup->end())
+                {
                     m_infos.erase(m_infos.begin() + i);
+                    --m_count;
+                }
                 else
                     m_dedup->emplace(std::move(lookup));
             }
@@ -1269,6 +1275,7 @@ void matches_impl::done_building()
 
     delete m_dedup;
     m_dedup = nullptr;
+    m_select_key = 0;
 }
 
 //------------------------------------------------------------------------------
@@ -1306,7 +1313,10 @@ void matches_impl::coalesce(uint32 count_hint, bool restrict)
     m_coalesced = true;
 
     if (restrict)
+    {
         m_infos.resize(j);
+        m_select_key = 0;
+    }
 }
 
 //------------------------------------------------------------------------------
@@ -150,7 +150,7 @@ private:
 
     store_impl              m_store;
     infos                   m_infos;
-    unsigned short          m_count = 0;
+    uint32                  m_count = 0;
     bool                    m_any_none_type = false;
     bool                    m_deprecated_mode = false;
     bool                    m_coalesced = false;
@@ -169,6 +169,8 @@ private:
     shadow_bool             m_filename_completion_desired;
     shadow_bool             m_filename_display_desired;
     str_moveable            m_input_line;   // The line the generators were given.
+    str_moveable            m_select_needle; // Needle of the last select.
+    uint32                  m_select_key = 0; // Conditions of the last select; zero means it can't be narrowed.
 
     match_lookup_unordered_set* m_dedup = nullptr;
 };
@@ -178,8 +178,8 @@ bool matches_lookaside::add(const char* match)
     assert(is_magic);
     len += 4;
 #endif
-    extra->display_offset = static_cast<unsigned short>(len);
-    extra->description_offset = static_cast<unsigned short>(len + strlen(match + len) + 1);
+    extra->display_offset = static_cast<uint32>(len);
+    extra->description_offset = static_cast<uint32>(len + strlen(match + len) + 1);
 
     m_map.emplace(key, extra);
     return true;
@@ -0,0 +1,458 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+#include "path_index.h"
+#include "dir_snapshot.h"
+
+#include <core/os.h>
+#include <core/path.h>
+#include <core/str_tokeniser.h>
+#include <core/str_transform.h>
+#include <core/linear_allocator.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <shlwapi.h>
+
+//#define USE_SHFETFILEINFOW_IN_RECOGNIZER
+#ifdef USE_SHFETFILEINFOW_IN_RECOGNIZER
+#include <shellapi.h>
+#endif
+
+//------------------------------------------------------------------------------
+static bool has_extension_association(const char* ext)
+{
+    wstr<32> wext(ext);
+    DWORD cchOut = 0;
+    HRESULT hr = AssocQueryStringW(ASSOCF_INIT_IGNOREUNKNOWN|ASSOCF_NOFIXUPS, ASSOCSTR_FRIENDLYAPPNAME, wext.c_str(), nullptr, nullptr, &cchOut);
+    if (FAILED(hr) || !cchOut)
+        return false;
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Probing for each PATHEXT extension is one query per extension, so sweep the
+// directory once and answer the rest from the shared snapshot.
+static bool is_file(const char* full)
+{
+    dir_snapshot::file file;
+    switch (dir_snapshot_cache::get().lookup(full, &file, true/*sweep*/))
+    {
+    case dir_snapshot_cache::lookup_found:
+        return !(file.info.attr & FILE_ATTRIBUTE_DIRECTORY);
+    case dir_snapshot_cache::lookup_missing:
+        return false;
+    default:
+        return os::get_path_type(full) == os::path_type_file;
+    }
+}
+
+//------------------------------------------------------------------------------
+static bool has_file_association(const char* name)
+{
+    const char* ext = path::get_extension(name);
+    if (!ext)
+        return false;
+
+    if (!is_file(name))
+        return false;
+
+    return has_extension_association(ext);
+}
+
+//------------------------------------------------------------------------------
+static bool file_exists(const char* full, str_base& out)
+{
+    if (is_file(full))
+    {
+        os::get_full_path_name(full, out);
+        return true;
+    }
+    return false;
+}
+
+//------------------------------------------------------------------------------
+static void to_lower(const char* in, str_base& out)
+{
+    wstr<> win, wout;
+    win = in;
+    str_transform(win.c_str(), win.length(), wout, transform_mode::lower);
+    out = wout.c_str();
+}
+
+//------------------------------------------------------------------------------
+bool search_dir_for_executable(str_base& full, const char* word, str_base& out)
+{
+    path::append(full, "");
+    const uint32 trunc = full.length();
+
+    path::append(full, word);
+    if (has_file_association(full.c_str()))
+    {
+        if (file_exists(full.c_str(), out))
+            return true;
+    }
+
+    str<> pathext;
+    if (!os::get_env("pathext", pathext))
+        return false;
+
+    str_tokeniser tokens(pathext.c_str(), ";");
+    const char *start;
+    int32 length;
+
+    const char* ext = path::get_extension(word);
+    if (ext && str_icmp(ext, ".LNK") == 0 && file_exists(full.c_str(), out))
+        return true;
+
+    str<16> token_ext;
+    while (str_token token = tokens.next(start, length))
+    {
+        if (ext)
+        {
+            token_ext.clear();
+            token_ext.concat(start, length);
+            if (token_ext.iequals(ext))
+            {
+                full.truncate(trunc);
+                path::append(full, word);
+                if (file_exists(full.c_str(), out))
+                    return true;
+            }
+        }
+
+        full.truncate(trunc);
+        path::append(full, word);
+        full.concat(start, length);
+        if (file_exists(full.c_str(), out))
+            return true;
+    }
+
+// REVIEW:  Would it be useful to add this?  It was an experiment to try to
+// query the OS whether .LNK files are executable, but it doesn't recognize
+// them.  This runs only in the recognizer's background thread, so performance
+// and possible network access aren't necessarily a problem, although they
+// could of course potentially stall the recognizer.
+#ifdef USE_SHFETFILEINFOW_IN_RECOGNIZER
+    wstr<> wfull(full.c_str());
+    SHFILEINFOW fi = {};
+    const uint32 x = uint32(SHGetFileInfoW(wfull.c_str(), FILE_ATTRIBUTE_NORMAL, &fi, sizeof(fi), SHGFI_EXETYPE));
+    if (x != 0 && file_exists(full.c_str(), out))
+        return true;
+#endif
+
+    return false;
+}
+
+
+
+//------------------------------------------------------------------------------
+struct path_index::directory
+{
+                            directory(const char* path);
+    bool                    is_stale();
+    void                    enumerate(std::mutex& watch_mutex);
+    const char*             find(const char* name) const;
+
+    str_moveable            m_path;
+    std::unique_ptr<dir_watch> m_watch;         // Null means enumerate again.
+    bool                    m_indexed = false;  // False means probe the file system instead.
+    linear_allocator        m_store;
+    str_unordered_map<const char*> m_names;     // Lowercase names of files, to names on disk.
+};
+
+//------------------------------------------------------------------------------
+path_index::directory::directory(const char* path)
+: m_path(path)
+, m_store(16384)
+{
+}
+
+//------------------------------------------------------------------------------
+// The caller must hold the watch mutex.
+bool path_index::directory::is_stale()
+{
+    return !m_watch || m_watch->is_stale();
+}
+
+//------------------------------------------------------------------------------
+void path_index::directory::enumerate(std::mutex& watch_mutex)
+{
+    m_indexed = false;
+    m_names.clear();
+    m_store.reset();
+
+    // Watch before enumerating, so changes made while enumerating are noticed
+    // next time.  The watch doesn't expire; release_notifications() closes
+    // its change notification instead.
+    {
+        auto watch = std::make_unique<dir_watch>(m_path.c_str(), false/*expires*/);
+        std::lock_guard<std::mutex> lock(watch_mutex);
+        m_watch = std::move(watch);
+    }
+
+    str<280> pattern(m_path.c_str());
+    path::append(pattern, "*");
+    wstr<280> wpattern(pattern.c_str());
+
+    WIN32_FIND_DATAW fd;
+    HANDLE h = FindFirstFileExW(wpattern.c_str(), FindExInfoBasic, &fd, FindExSearchNameMatch, nullptr, FIND_FIRST_EX_LARGE_FETCH);
+    if (h == INVALID_HANDLE_VALUE)
+    {
+        // A directory that doesn't exist has no executables, but other errors
+        // (e.g. access denied) fall back to probing the file system.
+        const DWORD err = GetLastError();
+        m_indexed = (err == ERROR_FILE_NOT_FOUND || err == ERROR_PATH_NOT_FOUND);
+        return;
+    }
+
+    wstr<> lower;
+    str<> name;
+    str<> on_disk;
+    do
+    {
+        if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+            continue;
+
+        str_transform(fd.cFileName, uint32(wcslen(fd.cFileName)), lower, transform_mode::lower);
+        name = lower.c_str();
+        on_disk = fd.cFileName;
+
+        const char* stored = m_store.store(name.c_str());
+        const char* stored_on_disk = on_disk.equals(name.c_str()) ? stored : m_store.store(on_disk.c_str());
+        if (!stored || !stored_on_disk)
+        {
+            FindClose(h);
+            m_names.clear();
+            m_store.reset();
+            return;
+        }
+        m_names.emplace(stored, stored_on_disk);
+    }
+    while (FindNextFileW(h, &fd));
+
+    FindClose(h);
+    m_indexed = true;
+}
+
+//------------------------------------------------------------------------------
+// Returns the name on disk for a lowercase name, or nullptr.
+const char* path_index::directory::find(const char* name) const
+{
+    const auto iter = m_names.find(name);
+    return (iter != m_names.end()) ? iter->second : nullptr;
+}
+
+
+
+//------------------------------------------------------------------------------
+path_index::~path_index()
+{
+    clear();
+}
+
+//------------------------------------------------------------------------------
+void path_index::clear()
+{
+    std::lock_guard<std::mutex> lock(m_watch_mutex);
+    for (auto& iter : m_dirs)
+        delete iter.second;
+    m_dirs.clear();
+    m_order.clear();
+    m_exts.clear();
+    m_path.clear();
+    m_pathext.clear();
+    m_cwd.clear();
+    m_resolved = false;
+}
+
+//------------------------------------------------------------------------------
+bool path_index::find(const char* _word, const char* cwd, str_base& out)
+{
+    update(cwd);
+
+    str<> word;
+    to_lower(_word, word);
+
+    for (const directory* dir : m_order)
+    {
+        if (search(*dir, word.c_str(), out))
+            return true;
+    }
+
+    return false;
+}
+
+//------------------------------------------------------------------------------
+// Closes the directories' change notification handles, so they aren't held
+// while commands run; from now on the directories are verified by their last
+// write times.  This is called from the main thread when an input line begins
+// or ends.
+void path_index::release_notifications()
+{
+    std::lock_guard<std::mutex> lock(m_watch_mutex);
+    for (auto& iter : m_dirs)
+    {
+        directory* dir = iter.second;
+        if (dir->m_watch && dir->m_watch->has_notification() && !dir->m_watch->release_notification())
+            dir->m_watch.reset();
+    }
+}
+
+//------------------------------------------------------------------------------
+void path_index::update(const char* cwd)
+{
+    std::unique_lock<std::mutex> lock(m_watch_mutex);
+
+    str<> path;
+    str<> pathext;
+    os::get_env("PATH", path);
+    os::get_env("pathext", pathext);
+
+    // Resolve the directories in the PATH.  Relative directories depend on
+    // the cwd.
+    if (!m_resolved || !m_path.equals(path.c_str()) || !m_pathext.equals(pathext.c_str()) || !m_cwd.equals(cwd))
+    {
+        m_path = path.c_str();
+        m_pathext = pathext.c_str();
+        m_cwd = cwd;
+        m_resolved = true;
+
+        str<> lower;
+        to_lower(pathext.c_str(), lower);
+
+        m_exts.clear();
+        str<16> ext;
+        str_tokeniser exts(lower.c_str(), ";");
+        while (exts.next(ext))
+            m_exts.emplace_back(ext.c_str());
+
+        m_order.clear();
+
+        str<> tmp;
+        str<> full;
+        str<280> token;
+        str_tokeniser tokens(path.c_str(), ";");
+        while (tokens.next(token))
+        {
+            token.trim();
+            if (token.empty())
+                continue;
+
+            // Get full path name.
+            path::join(cwd, token.c_str(), tmp);
+            if (!os::get_full_path_name(tmp.c_str(), full, tmp.length()))
+                continue;
+
+            // Skip drives that are unknown, invalid, or remote.  dir_watch
+            // only uses change notifications on fixed drives and RAM disks.
+            {
+                char drive[4];
+                drive[0] = full.c_str()[0];
+                drive[1] = ':';
+                drive[2] = '\\';
+                drive[3] = '\0';
+                if (os::get_drive_type(drive) < os::drive_type_removable)
+                    continue;
+            }
+
+            directory* dir;
+            const auto iter = m_dirs.find(full.c_str());
+            if (iter != m_dirs.end())
+            {
+                dir = iter->second;
+                if (std::find(m_order.begin(), m_order.end(), dir) != m_order.end())
+                    continue;
+            }
+            else
+            {
+                dir = new directory(full.c_str());
+                m_dirs.emplace(dir->m_path.c_str(), dir);
+            }
+
+            m_order.push_back(dir);
+        }
+    }
+
+    // Enumerate stale directories, in parallel when there are several.
+    std::vector<directory*> stale;
+    for (directory* dir : m_order)
+    {
+        if (dir->is_stale())
+            stale.push_back(dir);
+    }
+
+    if (stale.empty())
+        return;
+
+    // Enumerate without holding the lock, so release_notifications() isn't
+    // blocked.  Only this thread changes m_dirs.
+    lock.unlock();
+
+    std::atomic<uint32> next(0);
+    auto worker = [&] () {
+        for (uint32 i; (i = next++) < stale.size();)
+            stale[i]->enumerate(m_watch_mutex);
+    };
+
+    const uint32 max_threads = clamp<uint32>(std::thread::hardware_concurrency(), 1, 8);
+    const uint32 num_threads = min<uint32>(uint32(stale.size()), max_threads);
+
+    std::vector<std::thread> threads;
+    for (uint32 i = 1; i < num_threads; ++i)
+        threads.emplace_back(worker);
+    worker();
+    for (auto& thread : threads)
+        thread.join();
+}
+
+//------------------------------------------------------------------------------
+bool path_index::search(const directory& dir, const char* word, str_base& out) const
+{
+    if (!dir.m_indexed)
+    {
+        str<> full(dir.m_path.c_str());
+        return search_dir_for_executable(full, word, out);
+    }
+
+    // This follows the same order as search_dir_for_executable().  The
+    // result uses the names on disk.
+
+    const char* ext = path::get_extension(word);
+    const char* found = ext ? dir.find(word) : nullptr;
+    if (found)
+    {
+        if (str_icmp(ext, ".lnk") == 0 || has_extension_association(ext))
+        {
+            out = dir.m_path.c_str();
+            path::append(out, found);
+            return true;
+        }
+    }
+
+    str<> name;
+    for (const auto& pathext : m_exts)
+    {
+        if (found && pathext.iequals(ext))
+        {
+            out = dir.m_path.c_str();
+            path::append(out, found);
+            return true;
+        }
+
+        name = word;
+        name.concat(pathext.c_str(), pathext.length());
+        if (const char* on_disk = dir.find(name.c_str()))
+        {
+            out = dir.m_path.c_str();
+            path::append(out, on_disk);
+            return true;
+        }
+    }
+
+    return false;
+}
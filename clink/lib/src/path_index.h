@@ -0,0 +1,45 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <core/str.h>
+#include <core/str_unordered_set.h>
+
+#include <mutex>
+#include <vector>
+
+//------------------------------------------------------------------------------
+// Indexes the file names in each directory in the PATH, so that searching the
+// PATH for an executable is a few hash lookups instead of probing the file
+// system for every PATHEXT extension in every directory.  A directory is
+// enumerated again when it changes, which dir_watch detects.  Stale directories
+// are enumerated in parallel.
+//
+// Not thread safe, except for release_notifications(); the recognizer uses it
+// only from its background thread.
+class path_index
+{
+public:
+                            path_index() = default;
+                            ~path_index();
+    bool                    find(const char* word, const char* cwd, str_base& out);
+    void                    clear();
+    void                    release_notifications();
+
+private:
+    struct directory;
+    void                    update(const char* cwd);
+    bool                    search(const directory& dir, const char* word, str_base& out) const;
+    str_moveable            m_path;
+    str_moveable            m_pathext;
+    str_moveable            m_cwd;
+    std::vector<str_moveable> m_exts;       // Lowercase PATHEXT extensions.
+    std::vector<directory*> m_order;        // Directories in PATH order.
+    str_unordered_map<directory*> m_dirs;   // Owns the directories.
+    std::mutex              m_watch_mutex;  // Guards m_dirs and the directories' watches.
+    bool                    m_resolved = false;
+};
+
+//------------------------------------------------------------------------------
+bool search_dir_for_executable(str_base& dir, const char* word, str_base& out);
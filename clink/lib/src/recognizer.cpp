@@ -3,6 +3,7 @@
 
 #include "pch.h"
 #include "intercept.h"
+#include "path_index.h"
 #include "reclassify.h"
 #include "recognizer.h"
 
@@ -20,12 +21,6 @@
 #include <memory>
 #include <thread>
 #include <mutex>
-#include <shlwapi.h>
-
-//#define USE_SHFETFILEINFOW_IN_RECOGNIZER
-#ifdef USE_SHFETFILEINFOW_IN_RECOGNIZER
-#include <shellapi.h>
-#endif
 
 extern "C" {
 #include <readline/readline.h>
@@ -36,101 +31,7 @@ extern setting_color g_color_unrecognized;
 extern setting_color g_color_executable;
 
 //------------------------------------------------------------------------------
-static bool has_file_association(const char* name)
-{
-    const char* ext = path::get_extension(name);
-    if (!ext)
-        return false;
-
-    if (os::get_path_type(name) != os::path_type_file)
-        return false;
-
-    wstr<32> wext(ext);
-    DWORD cchOut = 0;
-    HRESULT hr = AssocQueryStringW(ASSOCF_INIT_IGNOREUNKNOWN|ASSOCF_NOFIXUPS, ASSOCSTR_FRIENDLYAPPNAME, wext.c_str(), nullptr, nullptr, &cchOut);
-    if (FAILED(hr) || !cchOut)
-        return false;
-
-    return true;
-}
-
-//------------------------------------------------------------------------------
-static bool file_exists(const char* full, str_base& out)
-{
-    if (os::get_path_type(full) == os::path_type_file)
-    {
-        os::get_full_path_name(full, out);
-        return true;
-    }
-    return false;
-}
-
-//------------------------------------------------------------------------------
-static bool search_for_extension(str_base& full, const char* word, str_base& out)
-{
-    path::append(full, "");
-    const uint32 trunc = full.length();
-
-    path::append(full, word);
-    if (has_file_association(full.c_str()))
-    {
-        if (file_exists(full.c_str(), out))
-            return true;
-    }
-
-    str<> pathext;
-    if (!os::get_env("pathext", pathext))
-        return false;
-
-    str_tokeniser tokens(pathext.c_str(), ";");
-    const char *start;
-    int32 length;
-
-    const char* ext = path::get_extension(word);
-    if (ext && str_icmp(ext, ".LNK") == 0 && file_exists(full.c_str(), out))
-        return true;
-
-    str<16> token_ext;
-    while (str_token token = tokens.next(start, length))
-    {
-        if (ext)
-        {
-            token_ext.clear();
-            token_ext.concat(start, length);
-            if (token_ext.iequals(ext))
-            {
-                full.truncate(trunc);
-                path::append(full, word);
-                if (file_exists(full.c_str(), out))
-                    return true;
-            }
-        }
-
-        full.truncate(trunc);
-        path::append(full, word);
-        full.concat(start, length);
-        if (file_exists(full.c_str(), out))
-            return true;
-    }
-
-// REVIEW:  Would it be useful to add this?  It was an experiment to try to
-// query the OS whether .LNK files are executable, but it doesn't recognize
-// them.  This runs only in the recognizer's background thread, so performance
-// and possible network access aren't necessarily a problem, although they
-// could of course potentially stall the recognizer.
-#ifdef USE_SHFETFILEINFOW_IN_RECOGNIZER
-    wstr<> wfull(full.c_str());
-    SHFILEINFOW fi = {};
-    const uint32 x = uint32(SHGetFileInfoW(wfull.c_str(), FILE_ATTRIBUTE_NORMAL, &fi, sizeof(fi), SHGFI_EXETYPE));
-    if (x != 0 && file_exists(full.c_str(), out))
-        return true;
-#endif
-
-    return false;
-}
-
-//------------------------------------------------------------------------------
-static bool search_for_executable(const char* _word, const char* cwd, str_base& out)
+static bool search_for_executable(const char* _word, const char* cwd, str_base& out, path_index* index=nullptr)
 {
     // Bail out early if it's obviously not going to succeed.
     if (strlen(_word) >= MAX_PATH)
@@ -141,10 +42,12 @@ static bool search_for_executable(const char* _word, const char* cwd, str_base&
     const bool need_cwd = !!NeedCurrentDirectoryForExePathW(word.c_str());
     const bool need_path = !rl_last_path_separator(_word);
 
-    // Make list of paths to search.
+    // Make list of paths to search.  When there's a path index, it searches
+    // the PATH directories.
     str<> tmp;
     str<> paths;
-    if (path::is_rooted(_word))
+    const bool rooted = path::is_rooted(_word);
+    if (rooted)
     {
         path::get_directory(_word, paths);
     }
@@ -152,7 +55,7 @@ static bool search_for_executable(const char* _word, const char* cwd, str_base&
     {
         if (need_cwd)
             paths = cwd;
-        if (need_path && os::get_env("PATH", tmp))
+        if (need_path && !index && os::get_env("PATH", tmp))
         {
             if (paths.length() > 0)
                 paths.concat(";", 1);
@@ -186,10 +89,13 @@ static bool search_for_executable(const char* _word, const char* cwd, str_base&
         }
 
         // Try PATHEXT extensions.
-        if (search_for_extension(full, _word, out))
+        if (search_dir_for_executable(full, _word, out))
             return true;
     }
 
+    if (index && need_path && !rooted)
+        return index->find(_word, cwd, out);
+
     return false;
 }
 
@@ -235,6 +141,7 @@ public:
     bool                    enqueue(const char* key, const char* word, const char* cwd, const recognition* cached=nullptr);
     bool                    need_refresh();
     void                    end_line();
+    void                    release_notifications() { m_path_index.release_notifications(); }
 
     void                    wait_while_busy();
 
@@ -251,6 +158,7 @@ private:
     str_unordered_map<cache_entry> m_cache;
     str_unordered_map<cache_entry> m_pending;
     entry                   m_queue;
+    path_index              m_path_index;   // Only used by the thread.
     mutable std::recursive_mutex m_mutex;
     std::unique_ptr<std::thread> m_thread;
     HANDLE                  m_event = nullptr;
@@ -631,7 +539,7 @@ void recognizer::proc(recognizer* r)
             // Search for executable file.
             str<> found;
             recognition result = recognition::unrecognized;
-            if (search_for_executable(entry.m_word.c_str(), entry.m_cwd.c_str(), found))
+            if (search_for_executable(entry.m_word.c_str(), entry.m_cwd.c_str(), found, &r->m_path_index))
                 result = recognition::executable;
 
             // Store result.
@@ -682,6 +590,12 @@ extern "C" void end_recognizer()
     s_recognizer.clear();
 }
 
+//------------------------------------------------------------------------------
+void release_recognizer_notifications()
+{
+    s_recognizer.release_notifications();
+}
+
 //------------------------------------------------------------------------------
 void shutdown_recognizer()
 {
@@ -11,6 +11,7 @@
 #include "doskey.h"
 #include "textlist_impl.h"
 #include "history_db.h"
+#include "dir_snapshot.h"
 #include "ellipsify.h"
 #include "host_callbacks.h"
 #include "display_readline.h"
@@ -2807,6 +2808,29 @@ static void do_clink_diagnostics(bool include_settings=false)
 
     task_manager_diagnostics();
 
+    // Directory snapshot cache.
+
+    {
+        dir_snapshot_cache::stats stats;
+        dir_snapshot_cache::get().get_stats(stats);
+        if (rl_explicit_arg || stats.hits || stats.misses)
+        {
+            print_heading("directory cache");
+
+            t.format("%u (%u files)", stats.dirs, stats.files);
+            print_value("directories", t.c_str());
+            const uint32 lookups = stats.hits + stats.misses;
+            t.format("%u (%u%%)", stats.hits, lookups ? uint32(uint64(stats.hits) * 100 / lookups) : 0);
+            print_value("hits", t.c_str());
+            t.format("%u", stats.misses);
+            print_value("misses", t.c_str());
+            t.format("%u", stats.sweeps);
+            print_value("sweeps", t.c_str());
+            t.format("%u", stats.invalidations);
+            print_value("invalidations", t.c_str());
+        }
+    }
+
     // Check for known potential ambiguous character width issues.
 
     {
@@ -16,6 +16,7 @@
 #include "match_colors.h"
 #include "display_matches.h"
 #include "display_readline.h"
+#include "frame_scheduler.h"
 #include "clink_ctrlevent.h"
 #include "clink_rl_signal.h"
 #include "sticky_search.h"
@@ -811,7 +812,7 @@ int32 count_prompt_lines(const char* prompt_prefix)
 
     str<> bracketed;
     ecma48_processor_flags flags = ecma48_processor_flags::bracket;
-    ecma48_processor(prompt_prefix, &bracketed, nullptr/*cell_count*/, flags);
+    bracket_prompt(prompt_prefix, bracketed, flags);
 
     wcwidth_iter iter(bracketed.c_str(), bracketed.length());
     while (int32 c = iter.next())
@@ -1082,6 +1083,13 @@ static void hook_display()
         s_force_signaled_redisplay = false;
     }
 
+    // While more input is queued, wait until it's processed.  Forced displays
+    // (e.g. after printing something) can't wait, though.
+    if (!rl_get_forced_display() && frame_scheduler::defer_display(is_readline_input_pending()))
+        return;
+
+    frame_scheduler::on_display();
+
     if (!s_suggestion.more() || rl_point != rl_end)
     {
         display_readline();
@@ -1139,6 +1147,15 @@ bool pause_suggestions(bool pause)
     return s_suggestion.pause(pause);
 }
 
+//------------------------------------------------------------------------------
+// The display must be up to date before the prompt ends, e.g. when the line is
+// accepted while more pasted input is still queued.
+extern "C" void flush_deferred_display()
+{
+    if (frame_scheduler::flush_display())
+        hook_display();
+}
+
 //------------------------------------------------------------------------------
 extern "C" void clear_suggestion()
 {
@@ -2560,9 +2577,9 @@ void rl_module::set_prompt(const char* prompt, const char* const rprompt, const
     const ansi_handler native = get_native_ansi_handler();
     if (native != ansi_handler::conemu && native != ansi_handler::winterminal)
         flags |= ecma48_processor_flags::apply_title;
-    ecma48_processor(prompt, &m_rl_prompt, nullptr/*cell_count*/, flags);
+    bracket_prompt(prompt, m_rl_prompt, flags);
     if (rprompt)
-        ecma48_processor(rprompt, &m_rl_rprompt, nullptr/*cell_count*/, flags);
+        bracket_prompt(rprompt, m_rl_rprompt, flags);
 
     m_rl_prompt.concat("\x01\x1b[m\x02");
     if (rprompt)
@@ -13,6 +13,7 @@
 #include "clink_rl_signal.h"
 #include "history_timeformatter.h"
 #include "line_editor_integration.h"
+#include "fuzzy_match.h"
 #ifdef SHOW_VERT_SCROLLBARS
 #include "scroll_car.h"
 #endif
@@ -33,6 +34,7 @@
 #include <terminal/key_tester.h>
 #include <signal.h>
 #include <shellapi.h>
+#include <algorithm>
 
 extern "C" {
 #include <readline/readline.h>
@@ -84,8 +86,11 @@ static setting_enum g_popup_search_mode(
     "clink.popup_search_mode",
     "Default search mode in popup lists",
     "When this is 'find', typing in popup lists moves to the next matching item.\n"
-    "When this is 'filter', typing in popup lists filters the list.",
-    "find,filter",
+    "When this is 'filter', typing in popup lists filters the list.\n"
+    "When this is 'fuzzy', typing in popup lists filters the list to items that\n"
+    "contain the typed characters in order, and sorts them by how well they match\n"
+    "(favoring matches at the start of words and consecutive characters).",
+    "find,filter,fuzzy",
     0);
 
 extern setting_enum g_ignore_case;
@@ -101,6 +106,7 @@ static standalone_input* s_standalone_input = nullptr;
 static int32 s_old_default_popup_search_mode = -1;
 static int32 s_default_popup_search_mode = -1;
 const int32 min_screen_cols = 20;
+const int32 min_trigram_items = 1000;   // Shorter lists are filtered fast enough by scanning.
 
 //------------------------------------------------------------------------------
 static int32 make_item(const char* in, str_base& out)
@@ -548,7 +554,9 @@ popup_results textlist_impl::activate(const char* title, const char** entries, i
     m_mode = mode;
     m_history_mode = is_history_mode(mode);
     m_was_default_search_mode = (!config || config->search_mode < 0);
-    m_filter = (m_was_default_search_mode ? s_default_popup_search_mode : config->search_mode) > 0;
+    const int32 search_mode = (m_was_default_search_mode ? s_default_popup_search_mode : config->search_mode);
+    m_filter = search_mode > 0;
+    m_fuzzy = search_mode == 2;
     m_show_numbers = m_history_mode;
     m_win_history = (mode == textlist_mode::win_history);
     m_del_callback = config ? config->del_callback : nullptr;
@@ -621,6 +629,9 @@ popup_results textlist_impl::activate(const char* title, const char** entries, i
     }
     m_has_columns = has_columns || history_timestamps;
 
+    if (m_filter && !m_fuzzy)
+        build_trigram_index();
+
     if (title && *title)
         m_default_title = title;
 
@@ -1004,6 +1015,7 @@ find:
             m_items.erase(m_items.begin() + original_index);
             if (m_has_columns)
                 m_columns.erase_row(original_index);
+            m_trigrams.erase(original_index);
             if (m_infos)
             {
                 memmove(m_infos + original_index, m_infos + original_index + 1, move_count * sizeof(m_infos[0]));
@@ -1011,11 +1023,7 @@ find:
                     m_infos[i].index--;
             }
             if (!m_filtered_items.empty())
-            {
-                m_filtered_items.erase(m_filtered_items.begin() + m_index);
-                for (int32 i = m_count - 1; i-- > m_index;)
-                    m_filtered_items[i]--;
-            }
+                erase_filtered_item(m_filtered_items, m_index, original_index);
             m_count--;
             m_original_count--;
             if (!m_original_count)
@@ -1195,7 +1203,7 @@ do_insert:
                 clear_filter();
             m_filter = !m_filter;
             if (m_was_default_search_mode)
-                s_default_popup_search_mode = m_filter ? 1 : 0;
+                s_default_popup_search_mode = m_filter ? (m_fuzzy ? 2 : 1) : 0;
             need_display = true;
             goto update_needle;
         }
@@ -1279,7 +1287,7 @@ update_needle:
                 advance_before_find = false;
                 m_override_title.clear();
                 if (m_needle.length())
-                    m_override_title.format("%s: %-10s", m_filter ? "filter" : "find", m_needle.c_str());
+                    m_override_title.format("%s: %-10s", m_filter ? (m_fuzzy ? "fuzzy" : "filter") : "find", m_needle.c_str());
                 goto find;
             }
             else if (m_needle_is_number)
@@ -1989,6 +1997,7 @@ void textlist_impl::reset()
     m_filter_saved_top = -1;
     m_original_count = 0;
     m_filtered_items = std::move(std::vector<int32>());
+    m_trigrams.clear();
 
     m_mode = textlist_mode::general;
     m_pref_height = 0;
@@ -2100,47 +2109,64 @@ bool textlist_impl::filter_items()
         return true;
     };
 
-    // Build new filtered list.
-    std::vector<int32> filtered_items;
-    if (!m_filter_string.empty() && strncmp(m_needle.c_str(), m_filter_string.c_str(), m_filter_string.length()) == 0)
-    {
-        // Further filter the filtered list.
-        for (size_t i = 0; i < m_filtered_items.size(); ++i)
+    auto is_match = [&](int32 index){
+        bool match = strstr_compare(m_needle, m_items[index]);
+        if (m_has_columns)
         {
-            // Interrupt if more input is available.
-            if (!defer_test-- && test_input())
-                return false;
-
-            const int32 original_index = m_filtered_items[i];
+            for (int32 col = 0; !match && col < max_columns; col++)
+                match = strstr_compare(m_needle, m_columns.get_col_text(index, col));
+        }
+        return match;
+    };
 
-            bool match = m_needle.empty() || strstr_compare(m_needle, m_items[original_index]);
-            if (m_has_columns)
-            {
-                for (int32 col = 0; !match && col < max_columns; col++)
-                    match = strstr_compare(m_needle, m_columns.get_col_text(original_index, col));
-            }
+    // Only items in the previous filtered list can match a needle that
+    // extends the previous filter, and only items with every trigram in the
+    // needle can match it at all.  Use whichever is fewer.
+    const std::vector<int32>* subset = nullptr;
+    if (!m_filter_string.empty() && strncmp(m_needle.c_str(), m_filter_string.c_str(), m_filter_string.length()) == 0)
+        subset = &m_filtered_items;
 
-            if (match)
-                filtered_items.push_back(original_index);
-        }
+    // Build new filtered list.
+    std::vector<int32> filtered_items;
+    if (m_fuzzy)
+    {
+        // The needle's characters needn't be adjacent, so trigrams don't
+        // apply.  Scoring is split across threads and isn't interrupted.
+        fuzzy_filter_items(subset, filtered_items);
     }
     else
     {
-        for (size_t i = 0; i < m_items.size(); ++i)
-        {
-            // Interrupt if more input is available.
-            if (!defer_test-- && test_input())
-                return false;
+        std::vector<int32> candidates;
+        if (m_trigrams.empty() && m_original_count >= min_trigram_items)
+            build_trigram_index();
+        if (m_trigrams.find(m_needle.c_str(), candidates) && (!subset || candidates.size() < subset->size()))
+            subset = &candidates;
 
-            bool match = m_needle.empty() || strstr_compare(m_needle, m_items[i]);
-            if (m_has_columns)
+        if (subset)
+        {
+            // Further filter the candidates.
+            for (size_t i = 0; i < subset->size(); ++i)
             {
-                for (int32 col = 0; !match && col < max_columns; col++)
-                    match = strstr_compare(m_needle, m_columns.get_col_text(i, col));
+                // Interrupt if more input is available.
+                if (!defer_test-- && test_input())
+                    return false;
+
+                const int32 original_index = (*subset)[i];
+                if (is_match(original_index))
+                    filtered_items.push_back(original_index);
             }
+        }
+        else
+        {
+            for (size_t i = 0; i < m_items.size(); ++i)
+            {
+                // Interrupt if more input is available.
+                if (!defer_test-- && test_input())
+                    return false;
 
-            if (match)
-                filtered_items.push_back(int32(i));
+                if (is_match(int32(i)))
+                    filtered_items.push_back(int32(i));
+            }
         }
     }
 
@@ -2177,6 +2203,79 @@ bool textlist_impl::filter_items()
 
 
 
+//------------------------------------------------------------------------------
+// Removes the filtered item at index, which refers to original_index, and
+// adjusts the rest to account for the original item being removed.  Fuzzy
+// filtering sorts by score, so the filtered items can be in any order.
+void textlist_impl::erase_filtered_item(std::vector<int32>& filtered, int32 index, int32 original_index)
+{
+    assert(filtered[index] == original_index);
+    filtered.erase(filtered.begin() + index);
+    for (auto& i : filtered)
+    {
+        if (i > original_index)
+            i--;
+    }
+}
+
+//------------------------------------------------------------------------------
+// Collects the items that fuzzy match the needle (in any column), sorted by
+// score.  The best match comes first, or last if the list is reversed, so that
+// it's nearest where the selection starts.
+void textlist_impl::fuzzy_filter_items(const std::vector<int32>* subset, std::vector<int32>& out) const
+{
+    const int32 mode = g_ignore_case.get();
+    const fuzzy_matcher matcher(m_needle.c_str(), mode == str_compare_scope::caseless || mode == str_compare_scope::relaxed, mode == str_compare_scope::relaxed, g_fuzzy_accent.get());
+
+    const uint32 count = uint32(subset ? subset->size() : m_items.size());
+    std::vector<fuzzy_result> results;
+    fuzzy_rank(count, [&](uint32 i){
+        const int32 index = subset ? (*subset)[i] : int32(i);
+        fuzzy_result result = { -1, 0 };
+        int32 score;
+        if (matcher.match(m_items[index], score))
+            result = { index, score };
+        if (m_has_columns)
+        {
+            for (int32 col = 0; col < max_columns; col++)
+            {
+                const char* text = m_columns.get_col_text(index, col);
+                if (text && matcher.match(text, score) && (result.index < 0 || score > result.score))
+                    result = { index, score };
+            }
+        }
+        return result;
+    }, results);
+
+    out.clear();
+    out.reserve(results.size());
+    for (const fuzzy_result& result : results)
+        out.push_back(result.index);
+    if (m_reverse)
+        std::reverse(out.begin(), out.end());
+}
+
+//------------------------------------------------------------------------------
+void textlist_impl::build_trigram_index()
+{
+    m_trigrams.clear();
+    if (m_original_count < min_trigram_items)
+        return;
+
+    for (int32 i = 0; i < int32(m_items.size()); ++i)
+    {
+        m_trigrams.add(i, m_items[i]);
+        if (m_has_columns)
+        {
+            for (int32 col = 0; col < max_columns; col++)
+                m_trigrams.add(i, m_columns.get_col_text(i, col));
+        }
+    }
+    m_trigrams.finish();
+}
+
+
+
 //------------------------------------------------------------------------------
 textlist_impl::item_store::~item_store()
 {
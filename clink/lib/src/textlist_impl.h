@@ -7,6 +7,7 @@
 #include "input_dispatcher.h"
 #include "popup.h"
 #include "scroll_helper.h"
+#include "trigram_index.h"
 
 #include <core/str.h>
 
@@ -70,6 +71,8 @@ public:
     bool            is_active() const;
     bool            accepts_mouse_input(mouse_input_type type) const;
 
+    static void     erase_filtered_item(std::vector<int32>& filtered, int32 index, int32 original_index);
+
 private:
     // editor_module.
     virtual void    bind_input(binder& binder) override;
@@ -98,6 +101,8 @@ private:
     const entry_info& get_item_info(int32 index) const;
     void            clear_filter();
     bool            filter_items();
+    void            fuzzy_filter_items(const std::vector<int32>* subset, std::vector<int32>& out) const;
+    void            build_trigram_index();
 
     // Result.
     popup_results   m_results;
@@ -148,6 +153,7 @@ private:
     int32           m_filter_saved_top = -1;
     int32           m_original_count = 0;   // Original count of items from caller.
     std::vector<int32> m_filtered_items;    // Maps filtered index to original index.
+    trigram_index   m_trigrams;             // Narrows filtering in long lists.
 
     // Display.
     int32           m_prev_content_width = 0;
@@ -175,6 +181,7 @@ private:
     bool            m_history_mode = false;
     bool            m_was_default_search_mode = false;
     bool            m_filter = false;
+    bool            m_fuzzy = false;        // Filter by fuzzy match, sorted by score.
     bool            m_show_numbers = false;
     bool            m_win_history = false;
     bool            m_has_columns = false;
@@ -0,0 +1,215 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+#include "trigram_index.h"
+
+#include <core/base.h>
+#include <core/str_compare.h>
+#include <core/str_iter.h>
+
+#include <algorithm>
+#include <assert.h>
+
+//------------------------------------------------------------------------------
+static const uint32 c_break = ~0u;
+static const uint32 c_symbols = 0x7f - 0x20;
+static const uint32 c_num_trigrams = c_symbols * c_symbols * c_symbols;
+static const uint32 c_separator = '/' - 0x20;
+
+//------------------------------------------------------------------------------
+static int32 to_lower(int32 c)
+{
+    return (c > 0xffff) ? c : int32(uintptr_t(CharLowerW(LPWSTR(uintptr_t(c)))));
+}
+
+//------------------------------------------------------------------------------
+// Folds a character the way str_compare_impl() would in its loosest mode:
+// caseless, '-' and '_' equivalent, '\' and '/' equivalent, and accents
+// normalized.  Returns c_break if it doesn't fold to printable ASCII.
+static uint32 fold(int32 c)
+{
+    if (c >= 0x80)
+    {
+        c = to_lower(normalize_accent(to_lower(c)));
+        if (c >= 0x80)
+            return c_break;
+    }
+
+    if (c >= 'A' && c <= 'Z')
+        c += 'a' - 'A';
+    else if (c == '-')
+        c = '_';
+    else if (c == '\\')
+        c = '/';
+
+    if (c < 0x20 || c >= 0x7f)
+        return c_break;
+    return uint32(c - 0x20);
+}
+
+//------------------------------------------------------------------------------
+template <class T> void trigram_index::for_each_trigram(const char* text, T&& callback)
+{
+    uint32 a = c_break;
+    uint32 b = c_break;
+    str_iter iter(text);
+    while (iter.more())
+    {
+        const uint32 c = fold(iter.next());
+
+        // str_compare_impl() treats a run of path separators as one.
+        if (c == c_separator && b == c_separator)
+            continue;
+
+        if (c != c_break && b != c_break && a != c_break)
+            callback((a * c_symbols + b) * c_symbols + c);
+
+        a = b;
+        b = c;
+    }
+}
+
+//------------------------------------------------------------------------------
+void trigram_index::clear()
+{
+    m_offsets = std::move(std::vector<uint32>());
+    m_postings = std::move(std::vector<int32>());
+    m_pending = std::move(std::vector<uint64>());
+    m_item_trigrams.clear();
+    m_item = -1;
+}
+
+//------------------------------------------------------------------------------
+// Items must be added in ascending order; an item can be added more than once
+// (e.g. for each of its columns).
+void trigram_index::add(int32 item, const char* text)
+{
+    assert(item >= m_item);
+    if (item != m_item)
+    {
+        flush_item();
+        m_item = item;
+    }
+
+    if (text)
+    {
+        for_each_trigram(text, [&] (uint32 trigram) {
+            m_item_trigrams.push_back(trigram);
+        });
+    }
+}
+
+//------------------------------------------------------------------------------
+void trigram_index::flush_item()
+{
+    std::sort(m_item_trigrams.begin(), m_item_trigrams.end());
+    const auto end = std::unique(m_item_trigrams.begin(), m_item_trigrams.end());
+    for (auto it = m_item_trigrams.begin(); it != end; ++it)
+        m_pending.push_back((uint64(*it) << 32) | uint32(m_item));
+    m_item_trigrams.clear();
+}
+
+//------------------------------------------------------------------------------
+void trigram_index::finish()
+{
+    flush_item();
+
+    // Counting sort by trigram.  The pending pairs are in item order, so each
+    // trigram's postings end up in ascending order.
+    m_offsets.assign(c_num_trigrams + 1, 0);
+    for (const uint64 pair : m_pending)
+        ++m_offsets[uint32(pair >> 32)];
+
+    uint32 start = 0;
+    for (uint32& offset : m_offsets)
+    {
+        const uint32 count = offset;
+        offset = start;
+        start += count;
+    }
+
+    m_postings.resize(m_pending.size());
+    for (const uint64 pair : m_pending)
+        m_postings[m_offsets[uint32(pair >> 32)]++] = int32(uint32(pair));
+
+    // Each offset now points at the end of its trigram's postings, which is
+    // the start of the next one's.
+    memmove(m_offsets.data() + 1, m_offsets.data(), c_num_trigrams * sizeof(m_offsets[0]));
+    m_offsets[0] = 0;
+
+    m_pending = std::move(std::vector<uint64>());
+    m_item = -1;
+}
+
+//------------------------------------------------------------------------------
+// Removes an item, and shifts the indices of the items after it down by one.
+void trigram_index::erase(int32 item)
+{
+    if (empty())
+        return;
+
+    uint32 out = 0;
+    uint32 start = 0;
+    for (uint32 trigram = 0; trigram < c_num_trigrams; ++trigram)
+    {
+        const uint32 end = m_offsets[trigram + 1];
+        m_offsets[trigram] = out;
+        for (uint32 i = start; i < end; ++i)
+        {
+            const int32 posting = m_postings[i];
+            if (posting != item)
+                m_postings[out++] = (posting > item) ? posting - 1 : posting;
+        }
+        start = end;
+    }
+    m_offsets[c_num_trigrams] = out;
+    m_postings.resize(out);
+}
+
+//------------------------------------------------------------------------------
+// Collects the items that have every trigram in the needle, in ascending order.
+// Returns false if the needle has no trigrams, in which case every item is a
+// candidate.
+bool trigram_index::find(const char* needle, std::vector<int32>& out) const
+{
+    out.clear();
+    if (empty())
+        return false;
+
+    std::vector<uint32> trigrams;
+    for_each_trigram(needle, [&] (uint32 trigram) {
+        trigrams.push_back(trigram);
+    });
+    if (trigrams.empty())
+        return false;
+
+    std::sort(trigrams.begin(), trigrams.end());
+    trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+
+    // Start from the shortest postings, and narrow by the rest.
+    auto size = [&] (uint32 trigram) { return m_offsets[trigram + 1] - m_offsets[trigram]; };
+    std::sort(trigrams.begin(), trigrams.end(), [&] (uint32 a, uint32 b) {
+        return size(a) < size(b);
+    });
+
+    const int32* postings = m_postings.data();
+    out.assign(postings + m_offsets[trigrams[0]], postings + m_offsets[trigrams[0] + 1]);
+    for (size_t i = 1; i < trigrams.size() && !out.empty(); ++i)
+    {
+        const int32* begin = postings + m_offsets[trigrams[i]];
+        const int32* end = postings + m_offsets[trigrams[i] + 1];
+        size_t kept = 0;
+        for (const int32 item : out)
+        {
+            begin = std::lower_bound(begin, end, item);
+            if (begin == end)
+                break;
+            if (*begin == item)
+                out[kept++] = item;
+        }
+        out.resize(kept);
+    }
+
+    return true;
+}
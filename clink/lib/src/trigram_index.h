@@ -0,0 +1,38 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <vector>
+
+//------------------------------------------------------------------------------
+// Indexes the trigrams in a list of items, so that filtering a long list (e.g.
+// the history popup) only needs to compare the needle against items that have
+// every trigram in the needle, instead of against every item.
+//
+// Characters are folded so that any characters str_compare() can consider
+// equal (in any str_compare_scope mode, with or without fuzzy accents, and with
+// runs of path separators treated as one) fold to the same value.  So the
+// candidates are a superset of the matches in every mode, and the caller
+// confirms them with the same compare it would otherwise use.  Characters that
+// don't fold to printable ASCII break the text into separate runs, so they only
+// cost the trigrams that include them.
+class trigram_index
+{
+public:
+    void                    clear();
+    bool                    empty() const { return m_offsets.empty(); }
+    void                    add(int32 item, const char* text);
+    void                    finish();
+    void                    erase(int32 item);
+    bool                    find(const char* needle, std::vector<int32>& out) const;
+
+private:
+    template <class T> static void for_each_trigram(const char* text, T&& callback);
+    void                    flush_item();
+    std::vector<uint32>     m_offsets;      // Start of each trigram's postings.
+    std::vector<int32>      m_postings;     // Item indices, ascending per trigram.
+    std::vector<uint64>     m_pending;      // (trigram << 32) | item, while adding.
+    std::vector<uint32>     m_item_trigrams;
+    int32                   m_item = -1;
+};
@@ -0,0 +1,160 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+#include "fs_fixture.h"
+
+#include <core/path.h>
+#include <core/str.h>
+#include <lib/dir_history_db.h>
+
+#include <vector>
+
+//------------------------------------------------------------------------------
+static const uint32 c_now = 2000000000;
+static const uint32 c_day = 24 * 60 * 60;
+
+//------------------------------------------------------------------------------
+static void verify_top(const dir_history_db& db, const char* const* expected, const char* filter=nullptr, bool prefix=false)
+{
+    std::vector<dir_history_db::entry> top;
+    db.find_top(100, top, filter, prefix, c_now);
+
+    size_t count = 0;
+    while (expected[count])
+        ++count;
+
+    REQUIRE(top.size() == count, [&] () {
+        printf("filter '%s', prefix %d\n", filter ? filter : "", prefix);
+        for (const auto& entry : top)
+            printf("  %s\n", entry.dir);
+    });
+    for (size_t i = 0; i < count; ++i)
+        REQUIRE(_stricmp(top[i].dir, expected[i]) == 0, [&] () {
+            printf("expected '%s'\nactual   '%s'\n", expected[i], top[i].dir);
+        });
+}
+
+
+
+//------------------------------------------------------------------------------
+TEST_CASE("Dir history")
+{
+    const char* empty_fs[] = { nullptr };
+    fs_fixture fs(empty_fs);
+
+    str<> path;
+    path::join(fs.get_root(), "clink_dir_history", path);
+
+    dir_history_db a(path.c_str());
+    a.add("c:\\old", c_now - 30 * c_day);
+    a.add("c:\\old", c_now - 30 * c_day + 1);
+    a.add("c:\\old", c_now - 30 * c_day + 2);
+    a.add("c:\\recent", c_now - c_day);
+    a.add("d:\\repo\\clink", c_now - 2 * c_day);
+    a.add("d:\\repo\\clink", c_now - 3 * c_day);
+
+    SECTION("Frecency")
+    {
+        // Recent visits outweigh older ones; frequent visits add up.
+        const char* expected[] = { "d:\\repo\\clink", "c:\\recent", "c:\\old", nullptr };
+        verify_top(a, expected);
+
+        std::vector<dir_history_db::entry> top;
+        a.find_top(1, top, nullptr, false, c_now);
+        REQUIRE(top.size() == 1);
+        REQUIRE(top[0].visits == 2);
+        REQUIRE(top[0].last_visit == c_now - 2 * c_day);
+
+        // Visiting again with a different case is the same directory.
+        a.add("C:\\OLD", c_now);
+        a.add("C:\\OLD", c_now);
+        const char* expected2[] = { "c:\\old", "d:\\repo\\clink", "c:\\recent", nullptr };
+        verify_top(a, expected2);
+        REQUIRE(a.size() == 3);
+    }
+
+    SECTION("Filter")
+    {
+        const char* prefix[] = { "c:\\recent", "c:\\old", nullptr };
+        verify_top(a, prefix, "C:/", true);
+
+        const char* substring[] = { "d:\\repo\\clink", nullptr };
+        verify_top(a, substring, "REPO/cl");
+
+        // Too short for trigrams.
+        const char* short_substring[] = { "d:\\repo\\clink", "c:\\recent", nullptr };
+        verify_top(a, short_substring, "/R");
+
+        const char* none[] = { nullptr };
+        verify_top(a, none, "zzz");
+        verify_top(a, none, "d:\\repo\\clink\\", true);
+    }
+
+    SECTION("Non-ASCII filter")
+    {
+        // Substrings compare like str_compare(), so case folds beyond ASCII.
+        a.add("e:\\Caf\xc3\xa9\\\xc3\x89lan", c_now);                         // e:\Café\Élan
+        const char* expected[] = { "e:\\Caf\xc3\xa9\\\xc3\x89lan", nullptr };
+        verify_top(a, expected, "\xc3\xa9lan");                                    // élan
+        verify_top(a, expected, "CAF\xc3\x89/");                                   // CAFÉ/
+    }
+
+    SECTION("Shared")
+    {
+        // Another session sees the visits, and its visits are seen.
+        dir_history_db b(path.c_str());
+        b.load();
+        const char* expected[] = { "d:\\repo\\clink", "c:\\recent", "c:\\old", nullptr };
+        verify_top(b, expected);
+
+        b.add("e:\\new", c_now);
+        a.load();
+        const char* expected2[] = { "d:\\repo\\clink", "e:\\new", "c:\\recent", "c:\\old", nullptr };
+        verify_top(a, expected2);
+    }
+
+    SECTION("Remove")
+    {
+        dir_history_db b(path.c_str());
+        REQUIRE(b.remove("D:\\REPO\\CLINK"));
+        REQUIRE(!b.remove("d:\\repo\\clink"));
+        REQUIRE(!b.remove("x:\\never"));
+
+        a.load();
+        const char* expected[] = { "c:\\recent", "c:\\old", nullptr };
+        verify_top(a, expected);
+
+        // Visiting it again starts over.
+        a.add("d:\\repo\\clink", c_now - 40 * c_day);
+        const char* expected2[] = { "c:\\recent", "c:\\old", "d:\\repo\\clink", nullptr };
+        verify_top(a, expected2);
+    }
+
+    SECTION("Compact")
+    {
+        // Compacting keeps the ranks, and other sessions reload.
+        dir_history_db b(path.c_str());
+        b.load();
+        REQUIRE(a.compact());
+        b.add("c:\\recent", c_now - c_day);
+
+        a.load();
+        const char* expected[] = { "c:\\recent", "d:\\repo\\clink", "c:\\old", nullptr };
+        verify_top(a, expected);
+        verify_top(b, expected);
+
+        std::vector<dir_history_db::entry> top;
+        a.find_top(3, top, nullptr, false, c_now);
+        REQUIRE(top[2].visits == 3);
+
+        // Many visits compact automatically.
+        for (uint32 i = 0; i < 1000; ++i)
+            b.add("c:\\busy", c_now - 60 * c_day + i);
+        a.load();
+        REQUIRE(a.size() == 4);
+        a.find_top(100, top, "busy", false, c_now);
+        REQUIRE(top.size() == 1);
+        REQUIRE(top[0].visits == 1000);
+    }
+}
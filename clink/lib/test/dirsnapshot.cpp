@@ -0,0 +1,146 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+#include "fs_fixture.h"
+
+#include <core/path.h>
+#include <core/str.h>
+#include <lib/dir_snapshot.h>
+
+//------------------------------------------------------------------------------
+// Moves a directory's last write time an hour into the past, so it's outside
+// the file system's timestamp granularity.
+static void age_dir(const char* dir)
+{
+    wstr<> wdir(dir);
+    HANDLE h = CreateFileW(wdir.c_str(), FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+    REQUIRE(h != INVALID_HANDLE_VALUE);
+
+    FILETIME ft;
+    GetSystemTimeAsFileTime(&ft);
+    ULARGE_INTEGER time;
+    time.LowPart = ft.dwLowDateTime;
+    time.HighPart = ft.dwHighDateTime;
+    time.QuadPart -= 3600 * 10000000ull;
+    ft.dwLowDateTime = time.LowPart;
+    ft.dwHighDateTime = time.HighPart;
+    REQUIRE(SetFileTime(h, nullptr, nullptr, &ft));
+    CloseHandle(h);
+}
+
+
+
+//------------------------------------------------------------------------------
+TEST_CASE("Dir snapshot")
+{
+    fs_fixture fs;
+
+    dir_snapshot_cache& cache = dir_snapshot_cache::get();
+    cache.clear();
+
+    str<> root;
+    REQUIRE(dir_snapshot_cache::normalize(fs.get_root(), root));
+
+    SECTION("Lookup")
+    {
+        // Nothing is known until the directory is swept.
+        REQUIRE(cache.lookup("file1") == dir_snapshot_cache::lookup_unknown);
+        REQUIRE(!cache.find("."));
+
+        auto snapshot = cache.find(".", true);
+        REQUIRE(snapshot);
+        REQUIRE(snapshot->get_files().size() == 6);
+        REQUIRE(_stricmp(snapshot->get_dir(), root.c_str()) == 0);
+
+        dir_snapshot::file file;
+        REQUIRE(cache.lookup("FILE1", &file) == dir_snapshot_cache::lookup_found);
+        REQUIRE(file.name.equals("file1"));
+        REQUIRE(!(file.info.attr & FILE_ATTRIBUTE_DIRECTORY));
+        REQUIRE(cache.lookup("dir1\\", &file) == dir_snapshot_cache::lookup_found);
+        REQUIRE(file.info.attr & FILE_ATTRIBUTE_DIRECTORY);
+        REQUIRE(cache.lookup("nothing") == dir_snapshot_cache::lookup_missing);
+
+        // Other directories are unaffected.
+        REQUIRE(cache.lookup("dir1/only") == dir_snapshot_cache::lookup_unknown);
+        REQUIRE(cache.lookup("dir1/only", nullptr, true) == dir_snapshot_cache::lookup_found);
+
+        dir_snapshot_cache::stats stats;
+        cache.get_stats(stats);
+        REQUIRE(stats.dirs == 2);
+        REQUIRE(stats.files == 9);
+        REQUIRE(stats.sweeps == 2);
+    }
+
+    SECTION("Add")
+    {
+        std::vector<dir_snapshot::file> files;
+        files.emplace_back();
+        files.back().name = "added";
+        files.back().info = {};
+        cache.add(std::make_unique<dir_watch>(root.c_str()), std::move(files));
+
+        REQUIRE(cache.lookup("added") == dir_snapshot_cache::lookup_found);
+        REQUIRE(cache.lookup("file1") == dir_snapshot_cache::lookup_missing);
+    }
+
+    SECTION("Invalidate")
+    {
+        auto snapshot = cache.find(".", true);
+        REQUIRE(snapshot);
+        REQUIRE(cache.find(".") == snapshot);
+
+        FILE* f = fopen("new_file", "wt");
+        REQUIRE(f);
+        fclose(f);
+
+        // The change notification arrives asynchronously.
+        bool invalidated = false;
+        for (int32 i = 0; i < 100 && !invalidated; ++i)
+        {
+            invalidated = !cache.find(".");
+            if (!invalidated)
+                Sleep(10);
+        }
+        REQUIRE(invalidated);
+
+        REQUIRE(cache.lookup("new_file", nullptr, true) == dir_snapshot_cache::lookup_found);
+        remove("new_file");
+    }
+
+    SECTION("Release notifications")
+    {
+        age_dir(root.c_str());
+        auto snapshot = cache.find(".", true);
+        REQUIRE(snapshot);
+
+        // Fresh snapshots survive releasing their change notifications.
+        cache.release_notifications();
+        REQUIRE(cache.find(".") == snapshot);
+        REQUIRE(cache.lookup("file1") == dir_snapshot_cache::lookup_found);
+
+        dir_snapshot_cache::stats stats;
+        cache.get_stats(stats);
+        REQUIRE(stats.dirs == 1);
+        REQUIRE(stats.invalidations == 0);
+
+        // After that, a change is noticed right away, by the last write time.
+        REQUIRE(CreateDirectoryA("new_dir", nullptr));
+        REQUIRE(cache.lookup("new_dir") == dir_snapshot_cache::lookup_unknown);
+        REQUIRE(cache.lookup("new_dir", nullptr, true) == dir_snapshot_cache::lookup_found);
+        RemoveDirectoryA("new_dir");
+    }
+
+    SECTION("Recently written")
+    {
+        // The directory was just written, so a change within the timestamp
+        // granularity could go unnoticed; the snapshot can't outlive its
+        // change notification.
+        auto snapshot = cache.find(".", true);
+        REQUIRE(snapshot);
+        cache.release_notifications();
+        REQUIRE(!cache.find("."));
+    }
+
+    cache.clear();
+}
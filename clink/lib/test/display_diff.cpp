@@ -0,0 +1,334 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+
+#include <core/base.h>
+#include <core/os.h>
+#include <core/str.h>
+#include <display_diff.h>
+#include <terminal/vt_screen_buffer.h>
+
+#include <string>
+
+//------------------------------------------------------------------------------
+// Emits SGR codes the same way rl_puts_face_func does:  each write begins and
+// ends with the normal face.  Face '0' is normal, and face 'N' is color 3N.
+static void emit_chars(str_base& out, const char* chars, const char* faces, uint32 len)
+{
+    char cur = '0';
+    for (uint32 i = 0; i < len; ++i)
+    {
+        if (faces[i] != cur)
+        {
+            cur = faces[i];
+            if (cur == '0')
+            {
+                out << "\x1b[m";
+            }
+            else
+            {
+                char sgr[] = "\x1b[3?m";
+                sgr[3] = cur;
+                out << sgr;
+            }
+        }
+        out.concat(chars + i, 1);
+    }
+    if (cur != '0')
+        out << "\x1b[m";
+}
+
+//------------------------------------------------------------------------------
+static void emit_move(str_base& out, uint32 col)
+{
+    str<16> tmp;
+    if (col)
+        tmp.format("\x1b[%uG", col + 1);
+    else
+        tmp = "\r";
+    out << tmp;
+}
+
+//------------------------------------------------------------------------------
+static void emit_shift(str_base& out, int32 delta)
+{
+    str<16> tmp;
+    if (delta > 0)
+        tmp.format("\x1b[%d@", delta);
+    else if (delta < 0)
+        tmp.format("\x1b[%dP", -delta);
+    out << tmp;
+}
+
+//------------------------------------------------------------------------------
+static void emit_plan(str_base& out, const display_diff& diff, uint32 base, const char* dc, const char* df, uint32 width)
+{
+    for (const auto& op : diff.ops())
+    {
+        const uint32 col = base + op.col;
+        if (col >= width)
+            break;
+
+        emit_move(out, col);
+        switch (op.type)
+        {
+        case display_diff_op::write:
+            emit_shift(out, op.insert);
+            emit_chars(out, dc + op.offset, df + op.offset, op.bytes);
+            break;
+        case display_diff_op::remove:
+            emit_shift(out, -int32(op.count));
+            break;
+        case display_diff_op::erase:
+            out << "\x1b[K";
+            break;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+// Rewrites the whole range after shifting by the difference in length, which
+// is what update_line() did before planning.
+static void emit_rewrite(str_base& out, uint32 olen, uint32 base, const char* dc, const char* df, uint32 dlen)
+{
+    emit_move(out, base);
+    emit_shift(out, int32(dlen) - int32(olen));
+    emit_chars(out, dc, df, dlen);
+}
+
+//------------------------------------------------------------------------------
+static void show_row(vt_screen_buffer& screen, const std::string& chars, const std::string& faces)
+{
+    str<> out;
+    out << "\r";
+    emit_chars(out, chars.c_str(), faces.c_str(), uint32(chars.length()));
+    out << "\x1b[K";
+    screen.write(out.c_str(), out.length());
+}
+
+//------------------------------------------------------------------------------
+static bool same_row(const vt_screen_buffer& a, const vt_screen_buffer& b)
+{
+    str<> ta, tb;
+    a.get_line_text(0, ta);
+    b.get_line_text(0, tb);
+    if (!ta.equals(tb.c_str()))
+        return false;
+    for (int32 x = 0; x < a.get_columns(); ++x)
+        if (a.get_cell_attr(x, 0) != b.get_cell_attr(x, 0))
+            return false;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Plans the update for the range after the prefix, applies it to a screen
+// showing the old row, and checks it against a screen showing the new row.
+// Returns the bytes emitted.
+static uint32 verify_diff(const char* prefix, const char* ochars, const char* ofaces, const char* dchars, const char* dfaces, bool exact_cost=true)
+{
+    const uint32 width = 40;
+    const uint32 base = uint32(strlen(prefix));
+    const std::string pfaces(base, '0');
+    const bool erase_tail = true;
+
+    vt_screen_buffer screen(width, 1);
+    show_row(screen, std::string(prefix) + ochars, pfaces + ofaces);
+
+    display_diff diff;
+    diff.costs().sgr = 5; // The length of the SGR codes emitted above.
+    REQUIRE(diff.plan(ochars, ofaces, uint32(strlen(ochars)), dchars, dfaces, uint32(strlen(dchars)), base, erase_tail));
+
+    str<> out;
+    emit_plan(out, diff, base, dchars, dfaces, width);
+    screen.reset_counters();
+    screen.write(out.c_str(), out.length());
+
+    vt_screen_buffer expected(width, 1);
+    show_row(expected, std::string(prefix) + dchars, pfaces + dfaces);
+
+    REQUIRE(same_row(screen, expected), [&] () {
+        str<> text;
+        screen.get_line_text(0, text);
+        printf("old      '%s%s'\nnew      '%s%s'\nactual   '%s'\n", prefix, ochars, prefix, dchars, text.c_str());
+    });
+    if (exact_cost)
+    {
+        REQUIRE(screen.get_counters().bytes == diff.cost(), [&] () {
+            printf("bytes %u, cost %u\n", screen.get_counters().bytes, diff.cost());
+        });
+    }
+    return screen.get_counters().bytes;
+}
+
+
+
+//------------------------------------------------------------------------------
+TEST_CASE("Display diff")
+{
+    SECTION("Unchanged")
+    {
+        REQUIRE(verify_diff("> ", "abc", "000", "abc", "000") == 0);
+    }
+
+    SECTION("Insert")
+    {
+        // Inserting one character costs far less than rewriting the rest.
+        const uint32 bytes = verify_diff("> ", "echo hello world", "0000000000000000", "echo hello, world", "00000000000000000");
+        REQUIRE(bytes <= 10);
+    }
+
+    SECTION("Delete")
+    {
+        const uint32 bytes = verify_diff("> ", "echo hello, world", "00000000000000000", "echo hello world", "0000000000000000");
+        REQUIRE(bytes <= 10);
+    }
+
+    SECTION("Shifted")
+    {
+        // A wrapped row shifts by one when a character is inserted earlier in
+        // the line.
+        verify_diff("", "abcdefghijklmnopqrstuvwxyz", "00000000000000000000000000", "Zabcdefghijklmnopqrstuvwxy", "00000000000000000000000000");
+        verify_diff("", "abcdefghijklmnopqrstuvwxyz", "00000000000000000000000000", "bcdefghijklmnopqrstuvwxyz0", "00000000000000000000000000");
+    }
+
+    SECTION("Faces")
+    {
+        verify_diff("> ", "dir /s foo", "3333111000", "dir /s foo", "3333222000");
+        verify_diff("> ", "dir /s foo", "0000000000", "dir /s foo", "1110000000");
+        verify_diff("> ", "dir /s foo", "1110000000", "dir /s foo", "0000000000");
+    }
+
+    SECTION("Long matching ends")
+    {
+        // The matching cells at each end are trimmed before planning.
+        verify_diff("> ", "git commit -m 'first draft' --amend", "00000000000000222222222222200000000", "git commit -m 'final draft' --amend", "00000000000000222222222222200000000");
+        verify_diff("> ", "git commit -m 'first draft' --amend", "00000000000000222222222222200000000", "git commit -m 'draft' --amend", "00000000000000222222200000000");
+        verify_diff("> ", "git commit -m 'first draft' --amend", "00000000000000222222222222200000000", "git commit -m 'first draft'", "000000000000002222222222222");
+    }
+
+    SECTION("Erase tail")
+    {
+        verify_diff("> ", "echo hello world", "0000000000000000", "echo", "0000");
+        verify_diff("> ", "echo hello world", "0000000000000000", "", "");
+        verify_diff("", "", "", "echo", "0000");
+    }
+
+    SECTION("Random")
+    {
+        // Shifts of ten or more columns cost an extra byte, so the cost is
+        // only an estimate here.
+        srand(1);
+        static const char c_alphabet[] = "ab ";
+        for (int32 iteration = 0; iteration < 1000; ++iteration)
+        {
+            std::string oc, of;
+            const int32 olen = rand() % 30;
+            for (int32 i = 0; i < olen; ++i)
+            {
+                oc += c_alphabet[rand() % 3];
+                of += (rand() % 4) ? '0' : '1';
+            }
+
+            std::string dc = oc;
+            std::string df = of;
+            for (int32 edits = rand() % 4; edits--;)
+            {
+                const size_t pos = rand() % (dc.length() + 1);
+                switch (rand() % 3)
+                {
+                case 0:
+                    dc.insert(pos, 1, c_alphabet[rand() % 3]);
+                    df.insert(pos, 1, (rand() % 2) ? '0' : '2');
+                    break;
+                case 1:
+                    if (pos < dc.length())
+                    {
+                        dc.erase(pos, 1);
+                        df.erase(pos, 1);
+                    }
+                    break;
+                default:
+                    if (pos < dc.length())
+                        dc[pos] = 'c';
+                    break;
+                }
+            }
+
+            verify_diff("> ", oc.c_str(), of.c_str(), dc.c_str(), df.c_str(), false);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+BENCHMARK_CASE("display diff")
+{
+    // Insert a character in the middle of a 2,000 character command that wraps
+    // across rows 120 columns wide, and update each row the way update_line()
+    // does:  skip the common prefix and suffix, then either rewrite the rest or
+    // apply the planned diff.
+    const uint32 width = 120;
+    const uint32 len = 2000;
+
+    std::string before;
+    for (uint32 i = 0; i < len; ++i)
+        before += "abcdefghij klmnop "[i % 18];
+    std::string after = before;
+    after.insert(len / 2, 1, 'X');
+
+    const uint32 rows = uint32(after.length() + width - 1) / width;
+    const std::string faces(width, '0');
+
+    vt_screen_buffer rewrite_screen(width, 1);
+    vt_screen_buffer planned_screen(width, 1);
+    uint32 rewrite_bytes = 0, rewrite_cells = 0;
+    uint32 planned_bytes = 0, planned_cells = 0;
+    double planned_ms = 0;
+
+    display_diff diff;
+    for (uint32 row = 0; row < rows; ++row)
+    {
+        const std::string o = (row * width < before.length()) ? before.substr(row * width, width) : std::string();
+        const std::string d = after.substr(row * width, width);
+        if (o == d)
+            continue;
+
+        uint32 l = 0;
+        while (l < o.length() && l < d.length() && o[l] == d[l])
+            ++l;
+        uint32 ro = uint32(o.length());
+        uint32 rd = uint32(d.length());
+        while (ro > l && rd > l && o[ro - 1] == d[rd - 1])
+            --ro, --rd;
+
+        str<> out;
+        for (int32 pass = 0; pass < 2; ++pass)
+        {
+            vt_screen_buffer& screen = pass ? planned_screen : rewrite_screen;
+            screen.reset();
+            show_row(screen, o, faces.substr(0, o.length()));
+            screen.reset_counters();
+
+            out.clear();
+            if (pass)
+            {
+                os::high_resolution_clock clock;
+                diff.plan(o.c_str() + l, faces.c_str(), ro - l, d.c_str() + l, faces.c_str(), rd - l, l, ro == o.length());
+                planned_ms += clock.elapsed() * 1000;
+                emit_plan(out, diff, l, d.c_str() + l, faces.c_str(), width);
+            }
+            else
+            {
+                emit_rewrite(out, ro - l, l, d.c_str() + l, faces.c_str(), rd - l);
+            }
+            screen.write(out.c_str(), out.length());
+
+            (pass ? planned_bytes : rewrite_bytes) += screen.get_counters().bytes;
+            (pass ? planned_cells : rewrite_cells) += screen.get_counters().cells_changed;
+        }
+    }
+
+    printf("\n    rewrite:  %6u bytes, %6u cells changed", rewrite_bytes, rewrite_cells);
+    printf("\n    planned:  %6u bytes, %6u cells changed, %.3f ms planning", planned_bytes, planned_cells, planned_ms);
+    puts("");
+}
@@ -0,0 +1,288 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+
+#include <core/base.h>
+#include <core/str.h>
+#include <lib/display_readline.h>
+
+extern "C" {
+#include <readline/readline.h>
+}
+
+#include <string>
+
+//------------------------------------------------------------------------------
+static const uint32 c_width = 20;
+static const uint32 c_prompt_botlin = 1;
+static const uint32 c_col = 4;
+
+//------------------------------------------------------------------------------
+// Faces for each byte of the buffer; the selection wins, and bytes past the
+// end are normal.
+static std::string s_faces;
+static char get_test_face(int32 in, int32 active_begin, int32 active_end)
+{
+    if (active_begin <= in && in < active_end)
+        return FACE_SELECTION;
+    return (in >= 0 && size_t(in) < s_faces.length()) ? s_faces[in] : FACE_NORMAL;
+}
+
+//------------------------------------------------------------------------------
+// Lays out old_buffer, then lays out new_buffer both from scratch and by
+// reusing the old layout, and checks they're the same.  Returns the number of
+// lines that were reused.
+static uint32 verify_parse(const char* old_buffer, const char* new_buffer,
+                           int32 old_point, int32 new_point,
+                           const std::function<void()>& change=nullptr,
+                           uint32 scroll_top=0, uint32 scroll_bottom=0)
+{
+    rl_point = old_point;
+    auto update = [&] () {
+        rl_point = new_point;
+        if (change)
+            change();
+    };
+
+    uint32 reused = 0;
+    str<> mismatch;
+    REQUIRE(compare_incremental_parse(c_width, c_prompt_botlin, c_col, old_buffer, new_buffer, update, scroll_top, scroll_bottom, reused, mismatch), [&] () {
+        printf("old      '%s'\nnew      '%s'\npoint    %d\nmismatch %s\n", old_buffer, new_buffer, new_point, mismatch.c_str());
+    });
+    return reused;
+}
+
+//------------------------------------------------------------------------------
+// Moves pos forward to the beginning of a UTF-8 character.
+static size_t char_boundary(const std::string& s, size_t pos)
+{
+    while (pos < s.length() && (uint8(s[pos]) & 0xc0) == 0x80)
+        ++pos;
+    return pos;
+}
+
+//------------------------------------------------------------------------------
+static std::string make_text(uint32 len)
+{
+    std::string text;
+    for (uint32 i = 0; i < len; ++i)
+        text += "abcdefghij klmnop "[i % 18];
+    return text;
+}
+
+
+
+//------------------------------------------------------------------------------
+TEST_CASE("Display lines")
+{
+    rollback<rl_get_face_func_t*> rb_face(rl_get_face_func, get_test_face);
+    rollback<int32> rb_point(rl_point);
+    rollback<int32> rb_mark(rl_mark);
+    rl_deactivate_mark();
+    s_faces.clear();
+
+    SECTION("Edit after the cursor")
+    {
+        const std::string before = make_text(200);
+        std::string after = before;
+        after.insert(150, "X");
+
+        // Lines before the edit are copied, and the cursor is in them.
+        REQUIRE(verify_parse(before.c_str(), after.c_str(), 5, 5) > 0);
+        REQUIRE(verify_parse(before.c_str(), after.c_str(), 5, 60) > 0);
+        // The cursor after the edit.
+        REQUIRE(verify_parse(before.c_str(), after.c_str(), 151, 151) > 0);
+        REQUIRE(verify_parse(before.c_str(), after.c_str(), 151, int32(after.length())) > 0);
+    }
+
+    SECTION("Edit before the cursor")
+    {
+        // Inserting a whole row keeps the later rows wrapping at the same
+        // places, so once past the edit and the cursor they're copied.
+        const std::string before = make_text(200);
+        std::string after = before;
+        after.insert(40, std::string(c_width, 'X'));
+        REQUIRE(verify_parse(before.c_str(), after.c_str(), 0, 0) > 0);
+        REQUIRE(verify_parse(before.c_str(), after.c_str(), 40, 60) > 0);
+        verify_parse(before.c_str(), after.c_str(), 200, int32(after.length()));
+
+        // Otherwise only the rows before the edit are copied.
+        after = before;
+        after.erase(40, 3);
+        REQUIRE(verify_parse(before.c_str(), after.c_str(), 43, 40) > 0);
+        verify_parse(before.c_str(), after.c_str(), 0, 0);
+    }
+
+    SECTION("Control characters")
+    {
+        // Move a ^A across row boundaries, so its expansion wraps onto the
+        // next row (m_lead), and edit before, at, and after it.
+        for (uint32 pos = 10; pos < 60; ++pos)
+        {
+            std::string before = make_text(100);
+            before[pos] = '\x01';
+
+            for (uint32 edit : { 2u, pos, pos + 1, 90u })
+            {
+                std::string after = before;
+                after.insert(edit, "x");
+                verify_parse(before.c_str(), after.c_str(), int32(edit + 1), int32(edit + 1));
+                verify_parse(before.c_str(), after.c_str(), 0, 0);
+
+                after = before;
+                after.erase(edit, 1);
+                verify_parse(before.c_str(), after.c_str(), int32(edit), int32(edit));
+                verify_parse(before.c_str(), after.c_str(), int32(after.length()), int32(after.length()));
+            }
+        }
+    }
+
+    SECTION("Wide characters")
+    {
+        // Wide characters that don't fit at the end of a row leave trailing
+        // padding (m_trail); inserting a narrow character moves the padding.
+        std::string before = "a";
+        for (int32 i = 0; i < 40; ++i)
+            before += "\xe4\xb8\xad";                                           // 中
+
+        std::string after = before;
+        after.insert(0, "b");
+        verify_parse(before.c_str(), after.c_str(), 1, 2);
+        verify_parse(before.c_str(), after.c_str(), 0, 0);
+
+        after = before;
+        after.insert(61, "b");
+        REQUIRE(verify_parse(before.c_str(), after.c_str(), 61, 62) > 0);
+        REQUIRE(verify_parse(before.c_str(), after.c_str(), 4, 4) > 0);
+
+        after = before;
+        after += "\xe4\xb8\xad";
+        REQUIRE(verify_parse(before.c_str(), after.c_str(), int32(before.length()), int32(after.length())) > 0);
+    }
+
+    SECTION("Newlines")
+    {
+        std::string before;
+        for (int32 i = 0; i < 8; ++i)
+            before += "echo line " + std::to_string(i) + " of the script\n";
+
+        std::string after = before;
+        after.insert(before.find("line 6"), "another ");
+        REQUIRE(verify_parse(before.c_str(), after.c_str(), 0, 0) > 0);
+        REQUIRE(verify_parse(before.c_str(), after.c_str(), 10, 10) > 0);
+
+        after = before;
+        after.erase(before.find("line 2"), 5);
+        REQUIRE(verify_parse(before.c_str(), after.c_str(), 0, 0) > 0);
+
+        after = before;
+        after.insert(before.find("\n"), "\n");
+        REQUIRE(verify_parse(before.c_str(), after.c_str(), 0, 0) > 0);
+    }
+
+    SECTION("Scroll markers")
+    {
+        // Rows with scroll markers aren't copied, but the rest are.
+        const std::string before = make_text(200);
+        std::string after = before;
+        after.insert(150, "X");
+        REQUIRE(verify_parse(before.c_str(), after.c_str(), 151, 151, nullptr, 3, 6) > 0);
+        REQUIRE(verify_parse(before.c_str(), after.c_str(), 151, 151, nullptr, c_prompt_botlin, 4) > 0);
+
+        after = before;
+        after.erase(20, 1);
+        REQUIRE(verify_parse(before.c_str(), after.c_str(), 0, 0, nullptr, 2, 5) > 0);
+        REQUIRE(verify_parse(before.c_str(), after.c_str(), 0, 0, nullptr, 5, 9) > 0);
+    }
+
+    SECTION("Selection and faces")
+    {
+        // Faces change even where the text doesn't.
+        const std::string text = make_text(200);
+
+        REQUIRE(verify_parse(text.c_str(), text.c_str(), 30, 120, [] () {
+            rl_mark = 30;
+            rl_activate_mark();
+        }) > 0);
+        REQUIRE(verify_parse(text.c_str(), text.c_str(), 120, 10, [] () {
+            rl_mark = 150;
+        }) > 0);
+        REQUIRE(verify_parse(text.c_str(), text.c_str(), 10, 10, [] () {
+            rl_deactivate_mark();
+        }) > 0);
+
+        REQUIRE(verify_parse(text.c_str(), text.c_str(), 0, 0, [&] () {
+            s_faces.assign(text.length(), FACE_NORMAL);
+            s_faces.replace(0, 4, 4, FACE_COMMAND);
+            s_faces.replace(100, 30, 30, FACE_ARGUMENT);
+        }) > 0);
+        REQUIRE(verify_parse(text.c_str(), text.c_str(), 0, 0, [] () {
+            s_faces.clear();
+        }) > 0);
+
+        std::string ctrl = text;
+        ctrl[57] = '\x02';
+        verify_parse(ctrl.c_str(), ctrl.c_str(), 0, 0, [&] () {
+            s_faces.assign(ctrl.length(), FACE_ARGUMENT);
+        });
+        s_faces.clear();
+    }
+
+    SECTION("Random")
+    {
+        static const char* const c_pieces[] = {
+            "a", "b", " ", "echo ", "\x01", "\x7f", "\n",
+            "\xe4\xb8\xad",                                                     // 中
+            "\xc3\xa9",                                                         // é
+        };
+
+        srand(1);
+        std::string before;
+        for (int32 iteration = 0; iteration < 2000; ++iteration)
+        {
+            std::string after = before;
+            const size_t pos = char_boundary(after, rand() % (after.length() + 1));
+            switch (rand() % 3)
+            {
+            case 0:
+                for (int32 n = 1 + rand() % 4; n--;)
+                    after.insert(pos, c_pieces[rand() % sizeof_array(c_pieces)]);
+                break;
+            case 1:
+                {
+                    size_t end = pos;
+                    for (int32 n = 1 + rand() % 4; n-- && end < after.length();)
+                        end = char_boundary(after, end + 1);
+                    after.erase(pos, end - pos);
+                }
+                break;
+            }
+            if (after.length() > 300)
+                after.erase(0, char_boundary(after, 100));
+
+            const int32 point = int32(char_boundary(after, rand() % (after.length() + 1)));
+            const int32 old_point = int32(char_boundary(before, min<size_t>(point, before.length())));
+            const bool faces = !(rand() % 4);
+            const bool select = !(rand() % 4);
+            verify_parse(before.c_str(), after.c_str(), old_point, point, [&] () {
+                if (faces)
+                {
+                    s_faces.clear();
+                    for (size_t i = 0; i < after.length(); ++i)
+                        s_faces += "0cad"[rand() % 4];
+                }
+                rl_deactivate_mark();
+                if (select)
+                {
+                    rl_mark = int32(rand() % (after.length() + 1));
+                    rl_activate_mark();
+                }
+            });
+
+            before = after;
+        }
+        rl_deactivate_mark();
+        s_faces.clear();
+    }
+}
@@ -0,0 +1,76 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+
+#include <frame_scheduler.h>
+#include <terminal/terminal_in.h>
+
+//------------------------------------------------------------------------------
+class pending_terminal_in
+    : public terminal_in
+{
+public:
+    virtual int32           begin(bool can_hide_cursor) override { return 1; }
+    virtual int32           end(bool can_show_cursor) override { return 0; }
+    virtual bool            available(uint32 timeout) override { return m_pending; }
+    virtual void            select(input_idle*, uint32) override {}
+    virtual int32           read() override { return -1; }
+    virtual int32           peek() override { return -1; }
+    virtual key_tester*     set_key_tester(key_tester*) override { return nullptr; }
+    bool                    m_pending = false;
+};
+
+//------------------------------------------------------------------------------
+TEST_CASE("Frame scheduler")
+{
+    pending_terminal_in input;
+    frame_scheduler frames(&input);
+
+    SECTION("Displays defer only while armed")
+    {
+        input.m_pending = true;
+        REQUIRE(!frame_scheduler::defer_display(false));
+
+        {
+            frame_scheduler::defer_scope defer(frames);
+            REQUIRE(frame_scheduler::defer_display(false));
+        }
+
+        REQUIRE(frames.has_deferred());
+        REQUIRE(frames.take_deferred_display());
+        REQUIRE(!frames.has_deferred());
+    }
+
+    SECTION("Displays happen without pending input")
+    {
+        frame_scheduler::defer_scope defer(frames);
+        REQUIRE(!frame_scheduler::defer_display(false));
+        REQUIRE(frame_scheduler::defer_display(true));
+    }
+
+    SECTION("Flush")
+    {
+        input.m_pending = true;
+        frame_scheduler::defer_scope defer(frames);
+        REQUIRE(frame_scheduler::defer_display(false));
+        REQUIRE(frame_scheduler::flush_display());
+
+        // Nothing more is deferred until the scope ends.
+        REQUIRE(!frame_scheduler::defer_display(false));
+        REQUIRE(!frames.has_deferred());
+    }
+
+    SECTION("Updates")
+    {
+        REQUIRE(frames.defer_update(true));
+        REQUIRE(frames.has_deferred());
+
+        input.m_pending = true;
+        REQUIRE(frames.defer_update(false));
+
+        input.m_pending = false;
+        REQUIRE(!frames.defer_update(false));
+        REQUIRE(!frames.has_deferred());
+    }
+}
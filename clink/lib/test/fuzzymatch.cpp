@@ -0,0 +1,337 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+
+#include <core/base.h>
+#include <core/os.h>
+#include <core/str.h>
+#include <fuzzy_match.h>
+#include <textlist_impl.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+//------------------------------------------------------------------------------
+static int32 score_of(const fuzzy_matcher& matcher, const char* text)
+{
+    int32 score;
+    REQUIRE(matcher.match(text, score), [&] () {
+        printf("text '%s'\n", text);
+    });
+    return score;
+}
+
+//------------------------------------------------------------------------------
+// Naive subsequence test, to check the matcher against.
+static bool is_subsequence(const char* needle, const char* text)
+{
+    for (; *needle && *text; ++text)
+    {
+        if (tolower(uint8(*needle)) == tolower(uint8(*text)))
+            ++needle;
+    }
+    return !*needle;
+}
+
+
+
+//------------------------------------------------------------------------------
+TEST_CASE("Fuzzy match")
+{
+    SECTION("Subsequence")
+    {
+        fuzzy_matcher matcher("fzm", true, false);
+        int32 score;
+        REQUIRE(matcher.match("fuzzy_match", score));
+        REQUIRE(matcher.match("src/fuzzy/main.cpp", score));
+        REQUIRE(!matcher.match("match_fuzzy", score));
+        REQUIRE(!matcher.match("fz", score));
+        REQUIRE(!matcher.match("", score));
+    }
+
+    SECTION("Long text")
+    {
+        // Crosses the 16 byte blocks of the SIMD scan.
+        fuzzy_matcher matcher("xyz", true, false);
+        std::string text(100, 'a');
+        int32 score;
+        REQUIRE(!matcher.match(text.c_str(), score));
+        text[17] = 'X';
+        text[31] = 'y';
+        text[32] = 'Z';
+        REQUIRE(matcher.match(text.c_str(), score));
+        text[32] = 'a';
+        REQUIRE(!matcher.match(text.c_str(), score));
+        text[99] = 'z';
+        REQUIRE(matcher.match(text.c_str(), score));
+    }
+
+    SECTION("Compare modes")
+    {
+        int32 score;
+
+        fuzzy_matcher exact("Fm", false, false);
+        REQUIRE(exact.match("Fuzzy match", score));
+        REQUIRE(!exact.match("fuzzy match", score));
+
+        fuzzy_matcher caseless("FM", true, false);
+        REQUIRE(caseless.match("fuzzy match", score));
+        REQUIRE(caseless.match("FUZZY-MATCH", score));
+
+        fuzzy_matcher relaxed("a_b", true, true);
+        REQUIRE(relaxed.match("A-B", score));
+
+        fuzzy_matcher not_relaxed("a_b", true, false);
+        REQUIRE(!not_relaxed.match("a-b", score));
+
+        fuzzy_matcher slashes("c:/foo", false, false);
+        REQUIRE(slashes.match("c:\\foo", score));
+    }
+
+    SECTION("Non-ASCII")
+    {
+        int32 score;
+
+        // Caseless folds non-ASCII letters too.
+        fuzzy_matcher caseless("\xc3\xa9t\xc3\xa9", true, false);                     // été
+        REQUIRE(caseless.match("\xc3\x89T\xc3\x89 2024", score));                      // ÉTÉ 2024
+        REQUIRE(!caseless.match("ete", score));
+
+        fuzzy_matcher exact("\xc3\xa9t\xc3\xa9", false, false);                        // été
+        REQUIRE(!exact.match("\xc3\x89T\xc3\x89", score));                            // ÉTÉ
+
+        // Fuzzy accents let accented and unaccented letters match each other,
+        // even when the needle or the text is ASCII.
+        fuzzy_matcher accents("cafe", true, false, true);
+        REQUIRE(accents.match("Caf\xc3\xa9 cr\xc3\xa8me", score));                     // Café crème
+        fuzzy_matcher accented("caf\xc3\xa9", true, false, true);                      // café
+        REQUIRE(accented.match("cafe", score));
+        REQUIRE(accented.match("CAF\xc3\x89", score));                                 // CAFÉ
+
+        // Scores count characters, not bytes.
+        fuzzy_matcher gap("ab", true, false, true);
+        REQUIRE(score_of(gap, "a\xc3\xa9" "b") == score_of(gap, "axb"));              // aéb
+    }
+
+    SECTION("Ranking")
+    {
+        fuzzy_matcher matcher("fm", true, false);
+
+        // Word starts beat the middles of words.
+        REQUIRE(score_of(matcher, "fuzzy match") > score_of(matcher, "offer farm"));
+        // Camel case humps count as word starts.
+        REQUIRE(score_of(matcher, "FuzzyMatch") > score_of(matcher, "Fuzzymatch"));
+        // Path separators count as word starts.
+        REQUIRE(score_of(matcher, "src/fuzzy/match") > score_of(matcher, "src/fuzzymatch"));
+        // Consecutive characters beat gaps.
+        REQUIRE(score_of(matcher, "xfmx") > score_of(matcher, "xfxmx"));
+        // Short gaps beat long gaps.
+        REQUIRE(score_of(matcher, "xfxmx") > score_of(matcher, "xfxxxxxxmx"));
+    }
+
+    SECTION("Rank")
+    {
+        static const char* const c_items[] = {
+            "offer farm",
+            "fuzzy match",
+            "nothing",
+            "FuzzyMatch",
+            "fuzzy match",
+        };
+
+        fuzzy_matcher matcher("fm", true, false);
+        std::vector<fuzzy_result> results;
+        fuzzy_rank(uint32(sizeof_array(c_items)), [&] (uint32 i) {
+            fuzzy_result result = { -1, 0 };
+            int32 score;
+            if (matcher.match(c_items[i], score))
+                result = { int32(i), score };
+            return result;
+        }, results);
+
+        REQUIRE(results.size() == 4);
+        for (size_t i = 1; i < results.size(); ++i)
+            REQUIRE(results[i - 1].score >= results[i].score);
+        // Ties keep their original order.
+        REQUIRE(results[0].index == 1);
+        REQUIRE(results[1].index == 4);
+        REQUIRE(results[2].index == 3);
+        REQUIRE(results[3].index == 0);
+    }
+
+    SECTION("Threads")
+    {
+        // Enough items to be split across threads (if there are several
+        // cores), so the merged result must match a single sorted run.
+        srand(1);
+        std::vector<std::string> items;
+        for (int32 i = 0; i < 50000; ++i)
+        {
+            std::string item;
+            for (int32 len = rand() % 24; len--;)
+                item += char('a' + rand() % 6);
+            items.emplace_back(std::move(item));
+        }
+
+        fuzzy_matcher matcher("abc", true, false);
+        auto score_item = [&] (uint32 i) {
+            fuzzy_result result = { -1, 0 };
+            int32 score;
+            if (matcher.match(items[i].c_str(), score))
+                result = { int32(i), score };
+            return result;
+        };
+
+        std::vector<fuzzy_result> results;
+        fuzzy_rank(uint32(items.size()), score_item, results);
+
+        std::vector<fuzzy_result> expected;
+        for (uint32 i = 0; i < items.size(); ++i)
+        {
+            const fuzzy_result result = score_item(i);
+            REQUIRE((result.index >= 0) == is_subsequence("abc", items[i].c_str()));
+            if (result.index >= 0)
+                expected.push_back(result);
+        }
+        fuzzy_sort(expected);
+
+        REQUIRE(results.size() == expected.size());
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            REQUIRE(results[i].index == expected[i].index);
+            REQUIRE(results[i].score == expected[i].score);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+TEST_CASE("Fuzzy popup delete")
+{
+    // History in original order; fuzzy filtering sorts it by score.
+    std::vector<std::string> history = {
+        "dir /w",
+        "git commit -m fix",
+        "git checkout main",
+        "echo gcm",
+        "cd git",
+        "git cm",
+        "type gc.txt",
+        "git merge",
+    };
+
+    for (int32 reverse = 0; reverse < 2; ++reverse)
+    {
+        for (int32 del = 0; del < int32(history.size()); ++del)
+        {
+            std::vector<std::string> items(history);
+
+            fuzzy_matcher matcher("gcm", true, false);
+            std::vector<fuzzy_result> results;
+            fuzzy_rank(uint32(items.size()), [&] (uint32 i) {
+                fuzzy_result result = { -1, 0 };
+                int32 score;
+                if (matcher.match(items[i].c_str(), score))
+                    result = { int32(i), score };
+                return result;
+            }, results);
+
+            std::vector<int32> filtered;
+            for (const fuzzy_result& result : results)
+                filtered.push_back(result.index);
+            if (reverse)
+                std::reverse(filtered.begin(), filtered.end());
+            REQUIRE(filtered.size() >= 4);
+            if (filtered.size() <= size_t(del))
+                break;
+
+            std::vector<std::string> expected;
+            for (int32 index : filtered)
+                expected.push_back(items[index]);
+            expected.erase(expected.begin() + del);
+
+            // Delete the way the popup list does.
+            const int32 original_index = filtered[del];
+            items.erase(items.begin() + original_index);
+            textlist_impl::erase_filtered_item(filtered, del, original_index);
+
+            REQUIRE(filtered.size() == expected.size());
+            for (size_t i = 0; i < filtered.size(); ++i)
+            {
+                REQUIRE(items[filtered[i]] == expected[i], [&] () {
+                    printf("reverse %d, delete %d, row %zu:  '%s' vs '%s'\n",
+                           reverse, del, i, items[filtered[i]].c_str(), expected[i].c_str());
+                });
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+BENCHMARK_CASE("Fuzzy match")
+{
+    // Rank 200,000 history-like items the way the popup list does when typing
+    // a needle one character at a time.
+    static const char* const c_words[] = {
+        "git", "commit", "status", "push", "checkout", "dir", "cd", "echo",
+        "type", "findstr", "build", "release", "debug", "src", "include",
+        "test", "premake5", "vs2022", "clink", "readline", "lua", "x64",
+    };
+
+    srand(1);
+    std::vector<std::string> items;
+    for (int32 i = 0; i < 200000; ++i)
+    {
+        std::string item;
+        for (int32 words = 2 + rand() % 6; words--;)
+        {
+            if (!item.empty())
+                item += ' ';
+            item += c_words[rand() % sizeof_array(c_words)];
+            if (rand() % 3 == 0)
+            {
+                char num[16];
+                sprintf_s(num, "%u", rand());
+                item += num;
+            }
+        }
+        items.emplace_back(std::move(item));
+    }
+
+    const char* const needle = "gitcorel";
+    const uint32 threads = fuzzy_rank_threads(uint32(items.size()));
+
+    double total_ms = 0;
+    double worst_ms = 0;
+    size_t ranked = 0;
+    std::vector<fuzzy_result> results;
+    for (size_t len = 1; len <= strlen(needle); ++len)
+    {
+        const std::string step(needle, len);
+        fuzzy_matcher matcher(step.c_str(), true, false);
+
+        os::high_resolution_clock clock;
+        fuzzy_rank(uint32(items.size()), [&] (uint32 i) {
+            fuzzy_result result = { -1, 0 };
+            int32 score;
+            if (matcher.match(items[i].c_str(), score))
+                result = { int32(i), score };
+            return result;
+        }, results);
+        const double ms = clock.elapsed() * 1000;
+
+        total_ms += ms;
+        worst_ms = max(worst_ms, ms);
+        ranked += results.size();
+    }
+
+    const size_t keystrokes = strlen(needle);
+    const double items_per_sec = double(items.size() * keystrokes) / (total_ms / 1000);
+    printf("\n    threads:   %8u", threads);
+    printf("\n    average:   %8.3f ms per keystroke", total_ms / keystrokes);
+    printf("\n    worst:     %8.3f ms per keystroke", worst_ms);
+    printf("\n    rate:      %8.0f items per second", items_per_sec);
+    printf("\n    ranked:    %8zu matches", ranked);
+    puts("");
+}
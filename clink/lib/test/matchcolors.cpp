@@ -2,6 +2,7 @@
 // License: http://opensource.org/licenses/MIT
 
 #include "pch.h"
+#include "fs_fixture.h"
 
 #include <core\os.h>
 #include <match_colors.h>
@@ -104,4 +105,38 @@ TEST_CASE("Match colors")
         REQUIRE(get_match_color("zaaa.md", match_type::file, s));
         REQUIRE(test_color(s, "43"));
     }
+
+    SECTION("stat cache")
+    {
+        fs_fixture fs;
+        clear_match_color_stat_cache();
+
+        s.clear();
+        REQUIRE(get_match_color("file1", match_type::none, s));
+        REQUIRE(test_color(s, "1;34"));
+
+        s.clear();
+        REQUIRE(get_match_color("dir1", match_type::none, s));
+        REQUIRE(test_color(s, "93"));
+
+        // Cached results are used until the cache is cleared.
+        REQUIRE(os::unlink("file1"));
+        s.clear();
+        REQUIRE(get_match_color("file1", match_type::none, s));
+        REQUIRE(test_color(s, "1;34"));
+
+        clear_match_color_stat_cache();
+        s.clear();
+        REQUIRE(!get_match_color("file1", match_type::none, s));
+
+        // Results from enumerating a directory don't query the file system.
+        str<> full;
+        REQUIRE(os::get_full_path_name("ghost.exe", full));
+        cache_match_color_stat(full.c_str(), FILE_ATTRIBUTE_ARCHIVE, false);
+        s.clear();
+        REQUIRE(get_match_color("ghost.exe", match_type::none, s));
+        REQUIRE(test_color(s, "1"));
+
+        clear_match_color_stat_cache();
+    }
 }
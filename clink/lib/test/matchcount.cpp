@@ -0,0 +1,142 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+
+#include <core/os.h>
+#include <core/settings.h>
+#include <core/str.h>
+#include <lib/matches.h>
+#include <lib/matches_lookaside.h>
+#include <match_pipeline.h>
+#include <matches_impl.h>
+
+#include <psapi.h>
+
+extern "C" {
+#include <readline/readline.h>
+}
+
+#include <vector>
+
+//------------------------------------------------------------------------------
+static size_t get_peak_private_bytes()
+{
+    static BOOL (WINAPI *func)(HANDLE, PPROCESS_MEMORY_COUNTERS, DWORD) = nullptr;
+    if (func == nullptr)
+        if (HMODULE psapi = LoadLibrary("psapi.dll"))
+            *(FARPROC*)&func = GetProcAddress(psapi, "GetProcessMemoryInfo");
+
+    PROCESS_MEMORY_COUNTERS counters = { sizeof(counters) };
+    if (!func || !func(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+
+    return counters.PeakPagefileUsage;
+}
+
+//------------------------------------------------------------------------------
+static void add_numbered_matches(matches_impl& matches, uint32 count)
+{
+    match_builder builder(matches);
+
+    str<> name;
+    for (uint32 i = 0; i < count; ++i)
+    {
+        name.format("match_%07u", i);
+        builder.add_match(name.c_str(), match_type::word);
+    }
+
+    matches.done_building();
+}
+
+
+
+//------------------------------------------------------------------------------
+TEST_CASE("Match count beyond 16 bits")
+{
+    SECTION("Count")
+    {
+        const uint32 count = 0x10000 + 1234;
+
+        matches_impl matches;
+        add_numbered_matches(matches, count);
+
+        match_pipeline pipeline(matches);
+        pipeline.select("");
+        pipeline.sort();
+
+        REQUIRE(matches.get_match_count() == count);
+        REQUIRE(strcmp(matches.get_match(0), "match_0000000") == 0);
+        REQUIRE(strcmp(matches.get_match(count - 1), "match_0066769") == 0);
+
+        uint32 iterated = 0;
+        matches_iter iter = matches.get_iter();
+        while (iter.next())
+            ++iterated;
+        REQUIRE(iterated == count);
+
+        pipeline.select("match_00655");
+        REQUIRE(matches.get_match_count() == 100);
+    }
+
+    SECTION("Offsets")
+    {
+        // The display and description strings start more than 64KB past the
+        // start of the match.
+        str_moveable match;
+        for (uint32 i = 0; i < 0x10000; ++i)
+            match.concat("m", 1);
+        const char* display = "display";
+        const char* description = "description";
+
+        const size_t packed_size = calc_packed_size(match.c_str(), display, description);
+        char* packed = static_cast<char*>(malloc(packed_size));
+        REQUIRE(pack_match(packed, packed_size, match.c_str(), match_type::word, display, description, 0, 0));
+
+        char* list[] = { nullptr, packed, nullptr };
+        create_matches_lookaside(list);
+
+        match_details details = lookup_match(packed);
+        REQUIRE(details);
+        REQUIRE(details.get_type() == match_type::word);
+        REQUIRE(strcmp(details.get_display(), display) == 0);
+        REQUIRE(strcmp(details.get_description(), description) == 0);
+
+        destroy_matches_lookaside(list);
+        free(packed);
+    }
+}
+
+//------------------------------------------------------------------------------
+BENCHMARK_CASE("match count")
+{
+    for (uint32 count : { 10000, 100000, 1000000 })
+    {
+        const size_t peak_before = get_peak_private_bytes();
+
+        matches_impl matches;
+
+        os::high_resolution_clock build_clock;
+        add_numbered_matches(matches, count);
+        const double build_ms = build_clock.elapsed() * 1000;
+
+        match_pipeline pipeline(matches);
+
+        os::high_resolution_clock coalesce_clock;
+        pipeline.select("");
+        const double coalesce_ms = coalesce_clock.elapsed() * 1000;
+
+        os::high_resolution_clock sort_clock;
+        pipeline.sort();
+        const double sort_ms = sort_clock.elapsed() * 1000;
+
+        REQUIRE(matches.get_match_count() == count);
+
+        const size_t peak_after = get_peak_private_bytes();
+        const double peak_mb = double(peak_after - min(peak_before, peak_after)) / (1024 * 1024);
+
+        printf("\n    %7u matches:  build %9.3f ms, coalesce %9.3f ms, sort %9.3f ms, peak +%.1f MB",
+               count, build_ms, coalesce_ms, sort_ms, peak_mb);
+    }
+    puts("");
+}
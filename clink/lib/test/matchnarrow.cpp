@@ -0,0 +1,143 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+
+#include <core/base.h>
+#include <core/os.h>
+#include <core/str.h>
+#include <core/str_compare.h>
+#include <lib/matches.h>
+#include <match_pipeline.h>
+#include <matches_impl.h>
+
+extern "C" {
+#include <readline/readline.h>
+#include <readline/rlprivate.h>
+}
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+//------------------------------------------------------------------------------
+static void add_matches(matches_impl& matches, const char* const* names)
+{
+    match_builder builder(matches);
+    for (; *names; ++names)
+        builder.add_match(*names, match_type::word);
+    matches.done_building();
+}
+
+//------------------------------------------------------------------------------
+static void get_selected(const matches_impl& matches, std::vector<std::string>& out)
+{
+    out.clear();
+    for (uint32 i = 0; i < matches.get_match_count(); ++i)
+        out.emplace_back(matches.get_match(i));
+    std::sort(out.begin(), out.end());
+}
+
+//------------------------------------------------------------------------------
+// Selects each needle in turn from the same matches, which can narrow from the
+// previous selection, and checks the result against selecting from fresh
+// matches.
+static void verify_narrowing(const char* const* names, const char* const* needles)
+{
+    matches_impl narrowed;
+    add_matches(narrowed, names);
+    match_pipeline pipeline(narrowed);
+
+    std::vector<std::string> expected;
+    std::vector<std::string> actual;
+    for (; *needles; ++needles)
+    {
+        const char* needle = *needles;
+
+        pipeline.select(needle);
+        pipeline.sort();
+        get_selected(narrowed, actual);
+
+        matches_impl fresh;
+        add_matches(fresh, names);
+        match_pipeline(fresh).select(needle);
+        get_selected(fresh, expected);
+
+        REQUIRE(actual == expected, [&] () {
+            printf("needle '%s': narrowed %u, fresh %u\n", needle, uint32(actual.size()), uint32(expected.size()));
+        });
+    }
+}
+
+
+
+//------------------------------------------------------------------------------
+TEST_CASE("Match narrowing")
+{
+    static const char* const c_names[] = {
+        "abc", "abcd", "abd", "ab_x", "ab-y", "b", "bcd",
+        "dir\\", "dir\\.git\\", "dir\\abc", "dir\\abd", ".hidden",
+        nullptr,
+    };
+
+    static const char* const c_needles[] = {
+        "", "a", "ab", "abc", "abcd", "abcde", "abc", "ab", "ab_", "ab_x",
+        "b", "bc", "cd", "c", "dir", "dir\\", "dir\\.", "dir\\.g", "dir\\a",
+        ".", ".h", "zzz", "abd",
+        nullptr,
+    };
+
+    rollback<int> hidden(_rl_match_hidden_files, 0);
+
+    SECTION("Exact")
+    {
+        str_compare_scope _(str_compare_scope::exact, false);
+        verify_narrowing(c_names, c_needles);
+    }
+
+    SECTION("Relaxed")
+    {
+        str_compare_scope _(str_compare_scope::relaxed, false);
+        verify_narrowing(c_names, c_needles);
+    }
+}
+
+//------------------------------------------------------------------------------
+BENCHMARK_CASE("match narrowing")
+{
+    const uint32 count = 50000;
+
+    std::vector<str_moveable> names;
+    std::vector<const char*> name_ptrs;
+    str<> name;
+    for (uint32 i = 0; i < count; ++i)
+    {
+        name.format("item_%05u_%c", i, 'a' + (i % 26));
+        names.emplace_back(name.c_str());
+    }
+    for (const auto& n : names)
+        name_ptrs.push_back(n.c_str());
+    name_ptrs.push_back(nullptr);
+
+    matches_impl matches;
+    add_matches(matches, name_ptrs.data());
+    match_pipeline pipeline(matches);
+    pipeline.select("");
+    pipeline.sort();
+
+    // Type "item_12345_z" one character at a time.
+    const char* const typed = "item_12345_z";
+    str<> needle;
+    for (const char* walk = typed; *walk; ++walk)
+    {
+        needle.concat(walk, 1);
+
+        os::high_resolution_clock clock;
+        pipeline.select(needle.c_str());
+        pipeline.sort();
+        const double ms = clock.elapsed() * 1000;
+
+        printf("\n    %-14s %6u matches:  %9.3f ms", needle.c_str(), matches.get_match_count(), ms);
+    }
+    puts("");
+}
@@ -0,0 +1,220 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+
+#include <core/path.h>
+#include <core/settings.h>
+#include <core/str.h>
+#include <lib/matches.h>
+#include <match_pipeline.h>
+#include <matches_impl.h>
+
+extern "C" {
+#include <readline/readline.h>
+}
+
+#include <algorithm>
+#include <vector>
+
+//------------------------------------------------------------------------------
+// The comparator match_pipeline used before sort keys were precomputed.  The
+// sort keys must produce exactly the same ordering.
+static bool reference_less(const char* l_match, match_type l_type,
+                           const char* r_match, match_type r_type,
+                           int32 order)
+{
+    wstr<> l;
+    wstr<> r;
+    to_utf16(l, l_match);
+    to_utf16(r, r_match);
+
+    auto is_dir = [] (const wstr_base& match, match_type type) {
+        if (is_match_type(type, match_type::dir))
+            return true;
+        if (!is_match_type(type, match_type::none))
+            return false;
+        return !match.empty() && path::is_separator(match.c_str()[match.length() - 1]);
+    };
+
+    const bool l_dir = is_dir(l, l_type);
+    const bool r_dir = is_dir(r, r_type);
+    if (order != 1 && l_dir != r_dir)
+        return (order == 0) ? l_dir : r_dir;
+
+    if (l_dir)
+        path::maybe_strip_last_separator(l);
+    if (r_dir)
+        path::maybe_strip_last_separator(r);
+
+    int32 cmp;
+    DWORD flags = SORT_DIGITSASNUMBERS|NORM_LINGUISTIC_CASING|LINGUISTIC_IGNORECASE;
+    const wchar_t* l_str = l.c_str();
+    const wchar_t* r_str = r.c_str();
+
+    int32 l_minus = 0;
+    int32 r_minus = 0;
+    for (const wchar_t* walk = l_str; *walk == '-'; ++walk)
+        l_minus++;
+    for (const wchar_t* walk = r_str; *walk == '-'; ++walk)
+        r_minus++;
+    cmp = l_minus - r_minus;
+    if (cmp) return (cmp < 0);
+
+    cmp = CompareStringW(LOCALE_USER_DEFAULT, flags, l_str, l.length(), r_str, r.length()) - CSTR_EQUAL;
+    if (cmp) return (cmp < 0);
+
+    flags &= ~LINGUISTIC_IGNORECASE;
+    cmp = CompareStringW(LOCALE_USER_DEFAULT, flags, l_str, l.length(), r_str, r.length()) - CSTR_EQUAL;
+    if (cmp) return (cmp < 0);
+
+    const uint8 t1 = uint8(l_type) & MATCH_TYPE_MASK;
+    const uint8 t2 = uint8(r_type) & MATCH_TYPE_MASK;
+    static const uint8 c_types[] = { MATCH_TYPE_DIR, MATCH_TYPE_ALIAS, MATCH_TYPE_COMMAND, MATCH_TYPE_WORD, MATCH_TYPE_ARG, MATCH_TYPE_FILE };
+    for (uint8 t : c_types)
+    {
+        cmp = int32(t1 == t) - int32(t2 == t);
+        if (cmp) return (cmp < 0);
+    }
+
+    return false;
+}
+
+//------------------------------------------------------------------------------
+struct test_match_infos
+{
+    void add(const char* match, match_type type)
+    {
+        m_strings.emplace_back(match);
+        match_info info = {};
+        info.ordinal = uint32(m_infos.size());
+        info.type = type;
+        m_infos.emplace_back(info);
+    }
+
+    void fixup()
+    {
+        // The strings may have moved while adding.
+        for (size_t i = 0; i < m_infos.size(); ++i)
+            m_infos[i].match = m_strings[m_infos[i].ordinal].c_str();
+    }
+
+    std::vector<str_moveable> m_strings;
+    std::vector<match_info> m_infos;
+};
+
+
+
+//------------------------------------------------------------------------------
+TEST_CASE("Match sort keys")
+{
+    static const struct {
+        const char* match;
+        match_type type;
+    } c_matches[] = {
+        { "file10",         match_type::file },
+        { "file9",          match_type::file },
+        { "File9",          match_type::file },
+        { "file9",          match_type::word },
+        { "file9",          match_type::arg },
+        { "file9",          match_type::cmd },
+        { "file9",          match_type::alias },
+        { "file9",          match_type::none },
+        { "file9\\",        match_type::dir },
+        { "dir\\",          match_type::dir },
+        { "Dir\\",          match_type::dir },
+        { "dir",            match_type::file },
+        { "dir\\",          match_type::none },
+        { "-a",             match_type::arg },
+        { "--a",            match_type::arg },
+        { "-B",             match_type::arg },
+        { "--b",            match_type::arg },
+        { "---",            match_type::arg },
+        { "alpha",          match_type::word },
+        { "ALPHA",          match_type::word },
+        { "Alpha",          match_type::word },
+        { "\xc3\xa4pfel",   match_type::word }, // a-umlaut
+        { "apfel",          match_type::word },
+        { "zeta2beta",      match_type::word },
+        { "zeta10beta",     match_type::word },
+        { "x.txt",          match_type::file|match_type::hidden },
+        { "x.txt",          match_type::file|match_type::link },
+        { "c:\\",           match_type::dir },
+        { "\\",             match_type::none },
+    };
+
+    for (int32 order = 0; order <= 2; ++order)
+    {
+        str<> value;
+        value.format("%d", order);
+        settings::find("match.sort_dirs")->set(value.c_str());
+
+        test_match_infos infos;
+        for (const auto& m : c_matches)
+            infos.add(m.match, m.type);
+        infos.fixup();
+
+        sort_match_infos(infos.m_infos.data(), int32(infos.m_infos.size()));
+
+        REQUIRE(infos.m_infos.size() == sizeof_array(c_matches));
+        for (size_t i = 1; i < infos.m_infos.size(); ++i)
+        {
+            const match_info& prev = infos.m_infos[i - 1];
+            const match_info& next = infos.m_infos[i];
+            REQUIRE(!reference_less(next.match, next.type, prev.match, prev.type, order), [&] () {
+                printf("sort_dirs %d: '%s' (%u) should not follow '%s' (%u)\n",
+                       order, next.match, uint32(next.type), prev.match, uint32(prev.type));
+            });
+        }
+
+        for (const auto& l : c_matches)
+            for (const auto& r : c_matches)
+                REQUIRE(compare_matches(l.match, l.type, r.match, r.type) == reference_less(l.match, l.type, r.match, r.type, order));
+    }
+
+    settings::find("match.sort_dirs")->set();
+}
+
+//------------------------------------------------------------------------------
+BENCHMARK_CASE("match sort")
+{
+    settings::find("match.sort_dirs")->set();
+
+    for (int32 count : { 1000, 10000, 100000 })
+    {
+        // Mix of names, numbers, flags, and dirs, in a scrambled order.
+        test_match_infos infos;
+        str<> name;
+        for (int32 i = 0; i < count; ++i)
+        {
+            const int32 n = (i * 7919) % count;
+            switch (n % 4)
+            {
+            case 0: name.format("file%d.txt", n); infos.add(name.c_str(), match_type::file); break;
+            case 1: name.format("Dir_%d\\", n); infos.add(name.c_str(), match_type::dir); break;
+            case 2: name.format("--option-%d", n); infos.add(name.c_str(), match_type::arg); break;
+            case 3: name.format("Word%dX", n); infos.add(name.c_str(), match_type::word); break;
+            }
+        }
+        infos.fixup();
+
+        std::vector<match_info> reference(infos.m_infos);
+        const int32 order = 1; // The default for 'match.sort_dirs' is 'with'.
+
+        os::high_resolution_clock reference_clock;
+        std::sort(reference.begin(), reference.end(), [order] (const match_info& l, const match_info& r) {
+            return reference_less(l.match, l.type, r.match, r.type, order);
+        });
+        const double reference_ms = reference_clock.elapsed() * 1000;
+
+        os::high_resolution_clock keys_clock;
+        sort_match_infos(infos.m_infos.data(), count);
+        const double keys_ms = keys_clock.elapsed() * 1000;
+
+        for (int32 i = 0; i < count; ++i)
+            REQUIRE(strcmp(reference[i].match, infos.m_infos[i].match) == 0);
+
+        printf("\n    %6d matches:  comparator %9.3f ms, sort keys %9.3f ms", count, reference_ms, keys_ms);
+    }
+    puts("");
+}
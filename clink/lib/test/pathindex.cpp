@@ -0,0 +1,157 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+#include "env_fixture.h"
+#include "fs_fixture.h"
+
+#include <core/os.h>
+#include <core/path.h>
+#include <core/str.h>
+#include <path_index.h>
+
+//------------------------------------------------------------------------------
+// Probes the directories directly, the way the recognizer did before the path
+// index existed.
+static bool reference_find(const char* word, const char* const* dirs, str_base& out)
+{
+    for (; *dirs; ++dirs)
+    {
+        str<> full(*dirs);
+        if (search_dir_for_executable(full, word, out))
+            return true;
+    }
+    return false;
+}
+
+//------------------------------------------------------------------------------
+static bool find_eventually(path_index& index, const char* word, const char* cwd, bool expected)
+{
+    // Change notifications are delivered asynchronously.
+    str<> out;
+    for (int32 i = 0; i < 20; ++i)
+    {
+        if (index.find(word, cwd, out) == expected)
+            return true;
+        Sleep(50);
+    }
+    return false;
+}
+
+
+
+//------------------------------------------------------------------------------
+TEST_CASE("Path index")
+{
+    static const char* path_fs[] = {
+        "bin1/tool.exe",
+        "bin1/both.cmd",
+        "bin1/sub/nested.exe",
+        "bin2/both.exe",
+        "bin2/other.bat",
+        "bin2/Mixed.Exe",
+        "bin2/readme.txt",
+        nullptr,
+    };
+    fs_fixture fs(path_fs);
+
+    static const char* env_desc[] = {
+        "pathext", ".COM;.EXE;.BAT;.CMD",
+        nullptr
+    };
+    env_fixture env(env_desc);
+
+    str<> bin1;
+    str<> bin2;
+    str<> path;
+    path::join(fs.get_root(), "bin1", bin1);
+    path::join(fs.get_root(), "bin2", bin2);
+    path.format("%s;;%s;%s", bin1.c_str(), bin2.c_str(), bin1.c_str());
+    os::set_env("PATH", path.c_str());
+
+    const char* dirs[] = { bin1.c_str(), bin2.c_str(), nullptr };
+    const char* cwd = fs.get_root();
+
+    path_index index;
+
+    SECTION("Same as probing")
+    {
+        static const char* const c_words[] = {
+            "tool", "tool.exe", "TOOL", "both", "both.exe", "both.cmd",
+            "other", "mixed", "mixed.exe", "readme.txt", "readme",
+            "nested", "sub", "missing", "tool.bat",
+        };
+
+        for (const char* word : c_words)
+        {
+            str<> expected;
+            str<> out;
+            const bool expected_found = reference_find(word, dirs, expected);
+            const bool found = index.find(word, cwd, out);
+            REQUIRE(found == expected_found, [&] () {
+                printf("word '%s' (index %u, probe %u)\n", word, found, expected_found);
+            });
+            if (found)
+            {
+                REQUIRE(out.iequals(expected.c_str()), [&] () {
+                    printf("word '%s'\nindex '%s'\nprobe '%s'\n", word, out.c_str(), expected.c_str());
+                });
+            }
+        }
+    }
+
+    SECTION("Name case")
+    {
+        // Found files use the names on disk.
+        str<> out;
+        REQUIRE(index.find("MIXED", cwd, out));
+        REQUIRE(path::get_name(out.c_str()) && strcmp(path::get_name(out.c_str()), "Mixed.Exe") == 0);
+        REQUIRE(index.find("mixed.exe", cwd, out));
+        REQUIRE(path::get_name(out.c_str()) && strcmp(path::get_name(out.c_str()), "Mixed.Exe") == 0);
+    }
+
+    SECTION("Changes")
+    {
+        str<> out;
+        REQUIRE(!index.find("new", cwd, out));
+        REQUIRE(index.find("tool", cwd, out));
+
+        str<> file;
+        path::join(bin2.c_str(), "new.exe", file);
+        if (FILE* f = fopen(file.c_str(), "wt"))
+            fclose(f);
+        path::join(bin1.c_str(), "tool.exe", file);
+        REQUIRE(os::unlink(file.c_str()));
+
+        REQUIRE(find_eventually(index, "new", cwd, true));
+        REQUIRE(find_eventually(index, "tool", cwd, false));
+    }
+
+    SECTION("Release notifications")
+    {
+        str<> out;
+        REQUIRE(!index.find("new", cwd, out));
+
+        // Changes are still noticed after the change notifications are
+        // closed.
+        index.release_notifications();
+
+        str<> file;
+        path::join(bin2.c_str(), "new.exe", file);
+        if (FILE* f = fopen(file.c_str(), "wt"))
+            fclose(f);
+
+        REQUIRE(find_eventually(index, "new", cwd, true));
+    }
+
+    SECTION("PATH changes")
+    {
+        str<> out;
+        REQUIRE(index.find("other", cwd, out));
+
+        os::set_env("PATH", bin1.c_str());
+        REQUIRE(!index.find("other", cwd, out));
+        REQUIRE(index.find("both", cwd, out));
+        REQUIRE(path::get_name(out.c_str()) && _stricmp(path::get_name(out.c_str()), "both.cmd") == 0);
+    }
+}
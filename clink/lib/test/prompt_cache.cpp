@@ -0,0 +1,73 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+
+#include <core/base.h>
+#include <core/os.h>
+#include <core/str.h>
+#include <lib/display_readline.h>
+#include <terminal/ecma48_iter.h>
+
+//------------------------------------------------------------------------------
+TEST_CASE("Prompt cache")
+{
+    static const char* const c_prompts[] = {
+        "",
+        "c:\\>",
+        "\x1b[1;32mc:\\repo\x1b[m (main)\n$ ",
+        "\x1b[7m rev \x1b[m\x07beep",
+        "\x1b]9;8;\"USERNAME\"\x1b\\@host> ",
+    };
+
+    for (const char* prompt : c_prompts)
+    {
+        str<> expected;
+        ecma48_processor(prompt, &expected, nullptr, ecma48_processor_flags::bracket);
+
+        // The first call fills the cache and the second call hits it; both
+        // must produce the same output as ecma48_processor().
+        for (int32 pass = 0; pass < 2; ++pass)
+        {
+            str<> out("prefix");
+            bracket_prompt(prompt, out, ecma48_processor_flags::bracket);
+            REQUIRE(strncmp(out.c_str(), "prefix", 6) == 0, [&] () {
+                printf("prompt:   \"%s\"\n", prompt);
+            });
+            REQUIRE(expected.equals(out.c_str() + 6), [&] () {
+                printf("prompt:   \"%s\"\nexpected: \"%s\"\nactual:   \"%s\"\npass:     %d\n",
+                       prompt, expected.c_str(), out.c_str() + 6, pass);
+            });
+        }
+    }
+
+    SECTION("Flags are part of the key")
+    {
+        const char* prompt = "\x1b[31mred\x1b[m> ";
+
+        str<> bracketed;
+        bracket_prompt(prompt, bracketed, ecma48_processor_flags::bracket);
+        str<> plain;
+        bracket_prompt(prompt, plain, ecma48_processor_flags::plaintext);
+
+        REQUIRE(bracketed.equals("\x01\x1b[31m\x02red\x01\x1b[m\x02> "));
+        REQUIRE(plain.equals("red> "));
+    }
+
+    SECTION("Visible OSC output isn't cached")
+    {
+        const char* prompt = "\x1b]9;8;\"CLINK_TEST_PROMPT_VAR\"\x1b\\> ";
+
+        os::set_env("CLINK_TEST_PROMPT_VAR", "one");
+        str<> first;
+        bracket_prompt(prompt, first, ecma48_processor_flags::bracket);
+        REQUIRE(first.equals("one> "));
+
+        os::set_env("CLINK_TEST_PROMPT_VAR", "two");
+        str<> second;
+        bracket_prompt(prompt, second, ecma48_processor_flags::bracket);
+        REQUIRE(second.equals("two> "));
+
+        os::set_env("CLINK_TEST_PROMPT_VAR", nullptr);
+    }
+}
@@ -0,0 +1,238 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+
+#include <core/base.h>
+#include <core/os.h>
+#include <core/str.h>
+#include <core/str_compare.h>
+#include <trigram_index.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+//------------------------------------------------------------------------------
+// Same as the textlist's compare:  whether the needle matches anywhere in the
+// haystack, according to the current str_compare_scope.
+static bool reference_match(const char* needle, const char* haystack)
+{
+    const int32 needle_len = int32(strlen(needle));
+    str_iter sift(haystack);
+    while (sift.more())
+    {
+        const int32 cmp = str_compare(needle, sift.get_pointer());
+        if (cmp == -1 || cmp == needle_len)
+            return true;
+        sift.next();
+    }
+    return false;
+}
+
+//------------------------------------------------------------------------------
+// Verifies that every item that matches the needle in any mode is a candidate.
+static void verify_superset(const trigram_index& index, const std::vector<std::string>& items, const char* needle)
+{
+    std::vector<int32> candidates;
+    const bool narrowed = index.find(needle, candidates);
+    REQUIRE(std::is_sorted(candidates.begin(), candidates.end()));
+
+    for (int32 mode = 0; mode < str_compare_scope::num_scope_values; ++mode)
+    {
+        for (int32 fuzzy = 0; fuzzy < 2; ++fuzzy)
+        {
+            str_compare_scope _(mode, !!fuzzy);
+            for (int32 i = 0; i < int32(items.size()); ++i)
+            {
+                if (!reference_match(needle, items[i].c_str()))
+                    continue;
+                const bool found = !narrowed || std::binary_search(candidates.begin(), candidates.end(), i);
+                REQUIRE(found, [&] () {
+                    printf("needle '%s'\nitem   '%s'\nmode %d, fuzzy %d\n", needle, items[i].c_str(), mode, fuzzy);
+                });
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+static void build(trigram_index& index, const std::vector<std::string>& items)
+{
+    index.clear();
+    for (int32 i = 0; i < int32(items.size()); ++i)
+        index.add(i, items[i].c_str());
+    index.finish();
+}
+
+
+
+//------------------------------------------------------------------------------
+TEST_CASE("Trigram index")
+{
+    std::vector<std::string> items = {
+        "git commit -m \"fix\"",
+        "git_status",
+        "dir c:\\Program Files\\\\foo",
+        "type c:/program files/foo/readme.txt",
+        "echo caf\xc3\xa9 r\xc3\xa9sum\xc3\xa9",     // café résumé
+        "ECHO CAFE",
+        "cd ..",
+    };
+
+    trigram_index index;
+    build(index, items);
+
+    SECTION("Narrows")
+    {
+        std::vector<int32> candidates;
+        REQUIRE(index.find("commit", candidates));
+        REQUIRE(candidates.size() == 1);
+        REQUIRE(candidates[0] == 0);
+
+        REQUIRE(index.find("zzz", candidates));
+        REQUIRE(candidates.empty());
+    }
+
+    SECTION("Short needle")
+    {
+        // Needles without a whole trigram can't be narrowed.
+        std::vector<int32> candidates;
+        REQUIRE(!index.find("cd", candidates));
+        REQUIRE(!index.find("\xc3\xa9", candidates));
+    }
+
+    SECTION("Folding")
+    {
+        verify_superset(index, items, "GIT-STATUS");
+        verify_superset(index, items, "program files/foo");
+        verify_superset(index, items, "files\\foo");
+        verify_superset(index, items, "caf\xc3\xa9");
+        verify_superset(index, items, "cafe");
+        verify_superset(index, items, "R\xc3\x89SUM");
+        verify_superset(index, items, "sum\xc3\xa9");
+    }
+
+    SECTION("Erase")
+    {
+        index.erase(1);
+        items.erase(items.begin() + 1);
+
+        std::vector<int32> candidates;
+        REQUIRE(index.find("status", candidates));
+        REQUIRE(candidates.empty());
+        REQUIRE(index.find("readme", candidates));
+        REQUIRE(candidates.size() == 1);
+        REQUIRE(candidates[0] == 2);
+        verify_superset(index, items, "cafe");
+    }
+
+    SECTION("Random")
+    {
+        // Small alphabet, so that there are plenty of matches.
+        srand(1);
+        static const char* const c_alphabet[] = { "a", "B", "-", "_", "\\", "/", "\xc3\xa0", "\xc3\x80" };
+        auto make_text = [] (int32 len) {
+            std::string text;
+            for (int32 i = 0; i < len; ++i)
+                text += c_alphabet[rand() % sizeof_array(c_alphabet)];
+            return text;
+        };
+
+        items.clear();
+        for (int32 i = 0; i < 200; ++i)
+            items.emplace_back(make_text(rand() % 12));
+        build(index, items);
+
+        for (int32 i = 0; i < 200; ++i)
+            verify_superset(index, items, make_text(3 + rand() % 3).c_str());
+    }
+}
+
+//------------------------------------------------------------------------------
+BENCHMARK_CASE("Trigram index")
+{
+    // Filter 100,000 history-like items the way the popup list does:  type a
+    // needle one character at a time, then backspace over it.
+    static const char* const c_words[] = {
+        "git", "commit", "status", "push", "checkout", "dir", "cd", "echo",
+        "type", "findstr", "build", "release", "debug", "src", "include",
+        "test", "premake5", "vs2022", "clink", "readline", "lua", "x64",
+    };
+
+    srand(1);
+    std::vector<std::string> items;
+    for (int32 i = 0; i < 100000; ++i)
+    {
+        std::string item;
+        for (int32 words = 2 + rand() % 6; words--;)
+        {
+            if (!item.empty())
+                item += ' ';
+            item += c_words[rand() % sizeof_array(c_words)];
+            if (rand() % 3 == 0)
+            {
+                char num[16];
+                sprintf_s(num, "%u", rand());
+                item += num;
+            }
+        }
+        items.emplace_back(std::move(item));
+    }
+
+    const char* const needle = "checkout rel";
+    std::vector<std::string> steps;
+    for (size_t len = 1; len <= strlen(needle); ++len)
+        steps.emplace_back(needle, len);
+    for (size_t len = strlen(needle); --len;)
+        steps.emplace_back(needle, len);
+
+    str_compare_scope _(str_compare_scope::caseless, true);
+
+    os::high_resolution_clock build_clock;
+    trigram_index index;
+    build(index, items);
+    const double build_ms = build_clock.elapsed() * 1000;
+
+    double scan_ms = 0;
+    double index_ms = 0;
+    size_t scanned = 0;
+    size_t verified = 0;
+    std::vector<int32> candidates;
+    for (const std::string& step : steps)
+    {
+        size_t scan_matches = 0;
+        {
+            os::high_resolution_clock clock;
+            for (const std::string& item : items)
+                scan_matches += reference_match(step.c_str(), item.c_str());
+            scan_ms += clock.elapsed() * 1000;
+            scanned += items.size();
+        }
+
+        size_t index_matches = 0;
+        {
+            os::high_resolution_clock clock;
+            if (index.find(step.c_str(), candidates))
+            {
+                for (const int32 i : candidates)
+                    index_matches += reference_match(step.c_str(), items[i].c_str());
+                verified += candidates.size();
+            }
+            else
+            {
+                for (const std::string& item : items)
+                    index_matches += reference_match(step.c_str(), item.c_str());
+                verified += items.size();
+            }
+            index_ms += clock.elapsed() * 1000;
+        }
+
+        REQUIRE(index_matches == scan_matches);
+    }
+
+    printf("\n    build:    %8.3f ms", build_ms);
+    printf("\n    scan:     %8.3f ms, %8zu items compared", scan_ms, scanned);
+    printf("\n    indexed:  %8.3f ms, %8zu items compared", index_ms, verified);
+    puts("");
+}
@@ -27,6 +27,8 @@
 #include <core/debugheap.h>
 #include <lib/popup.h>
 #include <lib/cmd_tokenisers.h>
+#include <lib/history_db.h>
+#include <lib/dir_history_db.h>
 #include <lib/reclassify.h>
 #include <lib/recognizer.h>
 #include <lib/matches_lookaside.h>
@@ -751,7 +753,7 @@ static bool popup_del_callback(int32 index)
 /// -show:  &nbsp;   height          = 20,       -- Preferred height, not counting the border.
 /// -show:  &nbsp;   width           = 60,       -- Preferred width, not counting the border.
 /// -show:  &nbsp;   reverse         = true,     -- Start at bottom; search upwards.
-/// -show:  &nbsp;   searchmode      = "filter", -- Use "find" or "filter" to override the default search mode (in v1.6.13 and higher).
+/// -show:  &nbsp;   searchmode      = "filter", -- Use "find", "filter", or "fuzzy" to override the default search mode (in v1.6.13 and higher).
 /// -show:  &nbsp;   colors = {                  -- Override the popup colors using any colors in this table.
 /// -show:  &nbsp;       items       = "97;44",  -- The items color (e.g. bright white on blue).
 /// -show:  &nbsp;       desc        = "...",    -- The description color.
@@ -905,6 +907,8 @@ static int32 popup_list(lua_State* state)
                 config.search_mode = 0;
             else if (stricmp(searchmode, "filter") == 0)
                 config.search_mode = 1;
+            else if (stricmp(searchmode, "fuzzy") == 0)
+                config.search_mode = 2;
         }
     }
     lua_pop(state, 1);
@@ -1056,6 +1060,56 @@ static int32 get_session(lua_State* state)
     return 1;
 }
 
+//------------------------------------------------------------------------------
+/// -name:  clink.getdirhistory
+/// -ver:   1.7.22
+/// -arg:   [filter:string]
+/// -arg:   [prefix:boolean]
+/// -arg:   [max:integer]
+/// -ret:   table
+/// Returns a table of directories from the saved directory history, ranked by
+/// frecency (how often and how recently each directory has been visited), with
+/// the highest ranked directory first.  The table is empty unless the
+/// <code><a href="#directories_save">directories.save</a></code> setting is
+/// enabled.
+///
+/// When <span class="arg">filter</span> is provided, only directories that
+/// contain it are included, or only directories that start with it if
+/// <span class="arg">prefix</span> is true.  Comparisons ignore case and treat
+/// <code>/</code> and <code>\</code> as equal.  At most
+/// <span class="arg">max</span> directories are returned (default is 100).
+/// -show:  -- Show the 5 highest ranked directories under C:\Projects.
+/// -show:  for _, dir in ipairs(clink.getdirhistory("c:\\projects\\", true, 5)) do
+/// -show:  &nbsp;   print(dir)
+/// -show:  end
+static int32 get_dir_history(lua_State* state)
+{
+    const char* filter = optstring(state, 1, nullptr);
+    const bool prefix = lua_toboolean(state, 2);
+    const auto _max = optinteger(state, 3, 100);
+    if (!_max.isnum())
+        return 0;
+
+    lua_createtable(state, 0, 0);
+
+    dir_history_database* db = dir_history_database::get();
+    if (!db || _max <= 0)
+        return 1;
+
+    db->load();
+
+    std::vector<dir_history_db::entry> top;
+    db->find_top(uint32(int32(_max)), top, filter, prefix);
+
+    int32 i = 0;
+    for (const auto& entry : top)
+    {
+        lua_pushstring(state, entry.dir);
+        lua_rawseti(state, -2, ++i);
+    }
+    return 1;
+}
+
 //------------------------------------------------------------------------------
 /// -name:  clink.getansihost
 /// -ver:   1.1.48
@@ -1383,56 +1437,24 @@ static int32 history_suggester(lua_State* state)
     if (!line)
         return 0;
 
-    HIST_ENTRY** history = history_list();
-    if (!history || history_length <= 0)
+    history_database* h = history_database::get();
+    if (!h)
         return 0;
 
     // 'match_prev_cmd' only works when 'history.dupe_mode' is 'add'.
     if (match_prev_cmd && g_dupe_mode.get() != 0)
         return 0;
 
-    int32 scanned = 0;
-    const DWORD tick = GetTickCount();
-
-    const int32 scan_min = 200;
-    const DWORD ms_max = 50;
-
-    const char* prev_cmd = (match_prev_cmd && history_length > 0) ? history[history_length - 1]->line : nullptr;
-    for (int32 i = history_length; --i >= 0;)
-    {
-        // Search at least SCAN_MIN entries.  But after that don't keep going
-        // unless it's been less than MS_MAX milliseconds.
-        if (scanned >= scan_min && !(scanned % 20) && GetTickCount() - tick >= ms_max)
-            break;
-        scanned++;
-
-        str_iter lhs(line);
-        str_iter rhs(history[i]->line);
-        int32 matchlen = str_compare<char, false/*compute_lcd*/, true/*exact_slash*/>(lhs, rhs);
-
-        // lhs isn't exhausted, or rhs is exhausted?  Continue searching.
-        if (lhs.more() || !rhs.more())
-            continue;
-
-        // Zero matching length?  Is ok with 'match_prev_cmd', otherwise
-        // continue searching.
-        if (!matchlen && !match_prev_cmd)
-            continue;
-
-        // Match previous command, if needed.
-        if (match_prev_cmd)
-        {
-            if (i <= 0 || str_compare<char, false/*compute_lcd*/, true/*exact_slash*/>(prev_cmd, history[i - 1]->line) != -1)
-                continue;
-        }
-
-        // Suggest this history entry.
-        lua_pushstring(state, history[i]->line);
-        lua_pushinteger(state, 1);
-        return 2;
-    }
+    // The prefix index finds the most recent matching entry without scanning
+    // the history list.
+    const char* suggestion = h->find_suggestion(line, !!match_prev_cmd);
+    if (!suggestion)
+        return 0;
 
-    return 0;
+    // Suggest this history entry.
+    lua_pushstring(state, suggestion);
+    lua_pushinteger(state, 1);
+    return 2;
 }
 
 //------------------------------------------------------------------------------
@@ -2297,6 +2319,7 @@ void clink_lua_initialise(lua_state& lua, bool lua_interpreter)
         { 1,    "popuplist",              &popup_list },
         { 1,    "getpopuplistcolors",     &get_popup_list_colors },
         { 0,    "getsession",             &get_session },
+        { 0,    "getdirhistory",          &get_dir_history },
         { 1,    "getansihost",            &get_ansi_host },
         { 0,    "translateslashes",       &translate_slashes },
         { 0,    "reload",                 &reload },
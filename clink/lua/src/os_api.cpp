@@ -7,6 +7,7 @@
 #include "yield.h"
 
 #include <core/base.h>
+#include <core/async_globber.h>
 #include <core/globber.h>
 #include <core/os.h>
 #include <core/path.h>
@@ -15,6 +16,8 @@
 #include <core/str_iter.h>
 #include <lib/doskey.h>
 #include <lib/clink_ctrlevent.h>
+#include <lib/dir_snapshot.h>
+#include <lib/match_colors.h>
 #include <terminal/terminal_helpers.h>
 #include <process/process.h>
 #include <sys/utime.h>
@@ -119,7 +122,12 @@ protected:
     int32               close(lua_State* state);
 
 private:
-    globber             m_globber;
+    async_globber       m_globber;
+    std::vector<async_globber::entry> m_batch;
+    std::shared_ptr<const dir_snapshot> m_snapshot;
+    str_moveable        m_prefix;
+    glob_flags          m_flags;
+    bool                m_dirs_only;
     str<288>            m_parent;
     int32               m_extrainfo;
     int32               m_index = 1;
@@ -138,38 +146,60 @@ const globber_lua::method globber_lua::c_methods[] = {
 };
 
 //------------------------------------------------------------------------------
+static bool get_snapshot_glob(const char* mask, str_base& dir, str_base& prefix);
+static void push_glob_snapshot(lua_State* state, const dir_snapshot& snapshot, const char* prefix, bool dirs_only, const glob_flags& flags, str_base& parent, int32* index, int32 extrainfo);
 globber_lua::globber_lua(const char* pattern, int32 extrainfo, const glob_flags& flags, bool dirs_only, bool back_compat)
 : m_globber(pattern)
+, m_flags(flags)
+, m_dirs_only(dirs_only)
 , m_parent(pattern)
 , m_extrainfo(extrainfo)
 {
     path::to_parent(m_parent, nullptr);
 
+    str<280> dir;
+    str<280> prefix;
+    if (!back_compat && get_snapshot_glob(pattern, dir, prefix))
+    {
+        m_snapshot = dir_snapshot_cache::get().find(dir.c_str());
+        m_prefix = prefix.c_str();
+    }
+
     m_globber.files(!dirs_only);
     m_globber.hidden(flags.hidden);
     m_globber.system(flags.system);
     if (back_compat)
         m_globber.suffix_dirs(false);
+    if (!m_snapshot)
+        m_globber.start();
 }
 
 //------------------------------------------------------------------------------
-static bool glob_next(lua_State* state, globber& globber, str_base& parent, int32* index, int32 extrainfo);
+static void push_glob_batch(lua_State* state, const std::vector<async_globber::entry>& batch, str_base& parent, int32* index, int32 extrainfo);
 int32 globber_lua::next(lua_State* state)
 {
-    // Arg is table into which to glob files/dirs; glob_next appends into it.
+    // Arg is table into which to glob files/dirs; push_glob_batch appends
+    // into it.  The enumeration runs on a worker thread, so this only takes
+    // what has arrived within the time budget and never blocks on the file
+    // system; the caller yields between calls.
+
+    if (m_snapshot)
+    {
+        push_glob_snapshot(state, *m_snapshot, m_prefix.c_str(), m_dirs_only, m_flags, m_parent, &m_index, m_extrainfo);
+        m_snapshot.reset();
+        m_globber.cancel();
+        lua_pushboolean(state, false);
+        return 1;
+    }
 
     const DWORD ms_max = 20;
-    const DWORD num_max = 250;
     const DWORD tick = GetTickCount();
 
-    bool ret = false;
-    for (size_t c = 0; c < num_max; c++)
+    bool ret = true;
+    for (DWORD elapsed = 0; ret && elapsed <= ms_max; elapsed = GetTickCount() - tick)
     {
-        ret = glob_next(state, m_globber, m_parent, &m_index, m_extrainfo);
-        if (!ret)
-            break;
-        if (GetTickCount() - tick > ms_max)
-            break;
+        ret = m_globber.next_batch(m_batch, ms_max - elapsed);
+        push_glob_batch(state, m_batch, m_parent, &m_index, m_extrainfo);
     }
 
     lua_pushboolean(state, ret);
@@ -179,7 +209,7 @@ int32 globber_lua::next(lua_State* state)
 //------------------------------------------------------------------------------
 int32 globber_lua::close(lua_State* state)
 {
-    m_globber.close();
+    m_globber.cancel();
     return 0;
 }
 
@@ -578,6 +608,26 @@ static int32 remove_dir(lua_State* state)
     return lua_osboolresult(state, ok, dir);
 }
 
+//------------------------------------------------------------------------------
+// Scripts often check many paths in the same directories, so answer from the
+// directory snapshots when possible.
+static int32 get_path_type_cached(const char* path)
+{
+    dir_snapshot::file file;
+    switch (dir_snapshot_cache::get().lookup(path, &file))
+    {
+    case dir_snapshot_cache::lookup_found:
+        if (file.info.attr & FILE_ATTRIBUTE_DIRECTORY)
+            return os::path_type_dir;
+        // A file can't be named with a trailing path separator.
+        return path::is_separator(path[strlen(path) - 1]) ? os::path_type_invalid : os::path_type_file;
+    case dir_snapshot_cache::lookup_missing:
+        return os::path_type_invalid;
+    default:
+        return os::get_path_type(path);
+    }
+}
+
 //------------------------------------------------------------------------------
 /// -name:  os.isdir
 /// -ver:   1.0.0
@@ -590,7 +640,7 @@ int32 is_dir(lua_State* state)
     if (!path)
         return 0;
 
-    lua_pushboolean(state, (os::get_path_type(path) == os::path_type_dir));
+    lua_pushboolean(state, (get_path_type_cached(path) == os::path_type_dir));
     return 1;
 }
 
@@ -606,7 +656,7 @@ static int32 is_file(lua_State* state)
     if (!path)
         return 0;
 
-    lua_pushboolean(state, (os::get_path_type(path) == os::path_type_file));
+    lua_pushboolean(state, (get_path_type_cached(path) == os::path_type_file));
     return 1;
 }
 
@@ -758,13 +808,19 @@ static void add_type_tag(str_base& out, const char* tag)
 }
 
 //------------------------------------------------------------------------------
-static bool glob_next(lua_State* state, globber& globber, str_base& parent, int32* index, int32 extrainfo)
+static void push_glob_entry(lua_State* state, const str_base& file, const globber::extrainfo& info, str_base& parent, int32* index, int32 extrainfo)
 {
-    str<288> file;
-    globber::extrainfo info;
-    globber::extrainfo* info_ptr = extrainfo ? &info : nullptr;
-    if (!globber.next(file, false, info_ptr))
-        return false;
+    // Let match coloring reuse what the enumeration already knows.
+    {
+        bool symlink = false;
+#ifdef S_ISLNK
+        symlink = S_ISLNK(info.st_mode);
+#endif
+        uint32 len = parent.length();
+        path::append(parent, file.c_str());
+        cache_match_color_stat(parent.c_str(), info.attr, symlink);
+        parent.truncate(len);
+    }
 
     if (!extrainfo)
     {
@@ -828,9 +884,93 @@ static bool glob_next(lua_State* state, globber& globber, str_base& parent, int3
 
     if (index)
         lua_rawseti(state, -2, (*index)++);
+}
+
+//------------------------------------------------------------------------------
+static bool glob_next(lua_State* state, globber& globber, str_base& parent, int32* index, int32 extrainfo)
+{
+    str<288> file;
+    globber::extrainfo info;
+    if (!globber.next(file, false, &info))
+        return false;
+
+    push_glob_entry(state, file, info, parent, index, extrainfo);
+    return true;
+}
+
+//------------------------------------------------------------------------------
+static void push_glob_batch(lua_State* state, const std::vector<async_globber::entry>& batch, str_base& parent, int32* index, int32 extrainfo)
+{
+    for (const auto& entry : batch)
+        push_glob_entry(state, entry.name, entry.info, parent, index, extrainfo);
+}
+
+//------------------------------------------------------------------------------
+static bool is_glob_included(const globber::extrainfo& info, bool dirs_only, const glob_flags& flags)
+{
+    if ((info.attr & FILE_ATTRIBUTE_HIDDEN) && !flags.hidden)
+        return false;
+    if ((info.attr & FILE_ATTRIBUTE_SYSTEM) && !flags.system)
+        return false;
+    if (dirs_only && !(info.attr & FILE_ATTRIBUTE_DIRECTORY))
+        return false;
     return true;
 }
 
+//------------------------------------------------------------------------------
+// A directory snapshot can serve a glob pattern whose name part is a plain
+// prefix followed by a single trailing "*".  Other wildcards, and the "." and
+// ".." prefixes (which make the globber include the dot directories), need the
+// real globber.
+static bool get_snapshot_glob(const char* mask, str_base& dir, str_base& prefix)
+{
+    str<280> stripped;
+    concat_strip_quotes(stripped, mask);
+    if (path::is_incomplete_unc(stripped.c_str()))
+        return false;
+
+    const char* name = path::get_name(stripped.c_str());
+    if (!name)
+        return false;
+    const uint32 len = uint32(strlen(name));
+    if (!len || name[len - 1] != '*')
+        return false;
+    for (const char* p = name; p < name + len - 1; ++p)
+    {
+        if (*p == '*' || *p == '?' || uint8(*p) >= 0x80)
+            return false;
+    }
+
+    prefix.clear();
+    prefix.concat(name, len - 1);
+    if (prefix.equals(".") || prefix.equals(".."))
+        return false;
+
+    str<280> parent;
+    path::get_directory(stripped.c_str(), parent);
+    return dir_snapshot_cache::normalize(parent.c_str(), dir);
+}
+
+//------------------------------------------------------------------------------
+static void push_glob_snapshot(lua_State* state, const dir_snapshot& snapshot, const char* prefix, bool dirs_only, const glob_flags& flags, str_base& parent, int32* index, int32 extrainfo)
+{
+    const size_t prefix_len = strlen(prefix);
+
+    str<288> file;
+    for (const auto& entry : snapshot.get_files())
+    {
+        if (!is_glob_included(entry.info, dirs_only, flags))
+            continue;
+        if (_strnicmp(entry.name.c_str(), prefix, prefix_len) != 0)
+            continue;
+
+        file = entry.name.c_str();
+        if (entry.info.attr & FILE_ATTRIBUTE_DIRECTORY)
+            file << PATH_SEP;
+        push_glob_entry(state, file, entry.info, parent, index, extrainfo);
+    }
+}
+
 //------------------------------------------------------------------------------
 static void get_glob_flags(lua_State* state, int32 index, glob_flags& out, bool back_compat)
 {
@@ -887,32 +1027,80 @@ int32 glob_impl(lua_State* state, bool dirs_only, bool back_compat=false)
 
     lua_createtable(state, 0, 0);
 
-    globber globber(mask);
-    globber.files(!dirs_only);
-    globber.hidden(flags.hidden);
-    globber.system(flags.system);
-    if (back_compat)
-        globber.suffix_dirs(false);
-
     str_moveable tmp(mask);
     path::to_parent(tmp, nullptr);
 
     int32 i = 1;
     if (back_compat)
     {
+        globber globber(mask);
+        globber.files(!dirs_only);
+        globber.hidden(flags.hidden);
+        globber.system(flags.system);
+        globber.suffix_dirs(false);
+
         while (true)
             if (!glob_next(state, globber, tmp, &i, extrainfo))
                 break;
     }
     else
     {
-        while (true)
+        // Serve it from the directory snapshot, if the directory was swept
+        // recently and hasn't changed since.
+        str<280> dir;
+        str<280> prefix;
+        const bool snapshot_glob = get_snapshot_glob(mask, dir, prefix);
+        if (snapshot_glob)
         {
-            if (!glob_next(state, globber, tmp, &i, extrainfo))
-                break;
-            if (!(i & 0x03) && clink_is_signaled())
+            if (auto snapshot = dir_snapshot_cache::get().find(dir.c_str()))
+            {
+                push_glob_snapshot(state, *snapshot, prefix.c_str(), dirs_only, flags, tmp, &i, extrainfo);
+                return 1;
+            }
+        }
+
+        // Globbing everything in a directory can fill a snapshot for later,
+        // if it includes all of the files.
+        std::unique_ptr<dir_watch> watch;
+        std::vector<dir_snapshot::file> files;
+        if (snapshot_glob && prefix.empty() && os::get_path_type(dir.c_str()) == os::path_type_dir)
+            watch = std::make_unique<dir_watch>(dir.c_str());
+
+        // This still waits for the whole enumeration, since the results are
+        // returned all at once; os.globber() is what yields partial results.
+        // But enumerating on a worker thread lets Ctrl-Break interrupt even
+        // while a slow FindNextFile is blocked (e.g. on a network share).
+        async_globber globber(mask);
+        globber.files(!dirs_only || watch);
+        globber.hidden(flags.hidden || watch);
+        globber.system(flags.system || watch);
+        globber.start();
+
+        std::vector<async_globber::entry> batch;
+        while (globber.next_batch(batch, 50))
+        {
+            if (clink_is_signaled())
+            {
+                watch.reset();
                 break;
+            }
+
+            for (auto& entry : batch)
+            {
+                if (is_glob_included(entry.info, dirs_only, flags))
+                    push_glob_entry(state, entry.name, entry.info, tmp, &i, extrainfo);
+                if (watch)
+                {
+                    files.emplace_back();
+                    files.back().name = std::move(entry.name);
+                    files.back().info = entry.info;
+                    path::maybe_strip_last_separator(files.back().name);
+                }
+            }
         }
+
+        if (watch)
+            dir_snapshot_cache::get().add(std::move(watch), std::move(files));
     }
 
     return 1;
@@ -958,6 +1146,11 @@ int32 globber_impl(lua_State* state, bool dirs_only, bool back_compat=false)
 /// Starting in v1.3.1, when this is used in a coroutine it automatically yields
 /// periodically.
 ///
+/// Starting in v1.7.22, the enumeration happens on a worker thread.  It still
+/// returns only once the enumeration has finished, but
+/// <kbd>Ctrl</kbd>-<kbd>Break</kbd> can interrupt it even while a slow
+/// directory (e.g. on a network share) is being read.
+///
 /// The optional <span class="arg">extrainfo</span> argument can return a table
 /// of tables instead, where each sub-table corresponds to one directory and has
 /// the following scheme:
@@ -1005,6 +1198,11 @@ int32 glob_dirs(lua_State* state)
 /// Starting in v1.3.1, when this is used in a coroutine it automatically yields
 /// periodically.
 ///
+/// Starting in v1.7.22, the enumeration happens on a worker thread.  It still
+/// returns only once the enumeration has finished, but
+/// <kbd>Ctrl</kbd>-<kbd>Break</kbd> can interrupt it even while a slow
+/// directory (e.g. on a network share) is being read.
+///
 /// The optional <span class="arg">extrainfo</span> argument can return a table
 /// of tables instead, where each sub-table corresponds to one file or directory
 /// and has the following scheme:
@@ -1801,6 +1999,55 @@ static int32 find_files(lua_State* state)
     return 1;
 }
 
+//------------------------------------------------------------------------------
+/// -name:  os.snapshotdir
+/// -ver:   1.7.22
+/// -arg:   dir:string
+/// -arg:   [extrainfo:integer|boolean]
+/// -ret:   table | nil
+/// Returns a table of all files and directories in
+/// <span class="arg">dir</span>, including hidden and system ones, or nil if
+/// the directory can't be enumerated.  Directories have a <code>\</code>
+/// suffix.
+///
+/// The result comes from a cache of directory snapshots that Clink shares
+/// between file completion, match coloring, and command recognition.  A
+/// snapshot is reused until the directory changes, so calling this repeatedly
+/// for the same directory is cheap.  Very large directories aren't cached.
+///
+/// The optional <span class="arg">extrainfo</span> argument can return a table
+/// of tables instead, using the same scheme as
+/// <a href="#os.globfiles">os.globfiles()</a>.
+/// -show:  for _, t in ipairs(os.snapshotdir(os.getcwd(), true) or {}) do
+/// -show:  &nbsp;   print(t.name.." ("..t.type..")")
+/// -show:  end
+static int32 snapshot_dir(lua_State* state)
+{
+    const char* dir = checkstring(state, 1);
+    if (!dir)
+        return 0;
+
+    int32 extrainfo;
+    if (lua_isboolean(state, 2))
+        extrainfo = lua_toboolean(state, 2);
+    else
+        extrainfo = optinteger(state, 2, 0);
+
+    auto snapshot = dir_snapshot_cache::get().find(dir, true/*sweep*/);
+    if (!snapshot)
+        return 0;
+
+    glob_flags flags;
+    flags.hidden = true;
+    flags.system = true;
+
+    str_moveable parent(snapshot->get_dir());
+    lua_createtable(state, int32(snapshot->get_files().size()), 0);
+    int32 i = 1;
+    push_glob_snapshot(state, *snapshot, "", false, flags, parent, &i, extrainfo);
+    return 1;
+}
+
 //------------------------------------------------------------------------------
 /// -name:  os.touch
 /// -ver:   1.2.31
@@ -3139,6 +3386,7 @@ void os_lua_initialise(lua_state& lua)
         { "getfileversion", &get_file_version },
         { "enumshares",  &enum_shares },
         { "findfiles",   &find_files },
+        { "snapshotdir", &snapshot_dir },
         // UNDOCUMENTED; internal use only.
         { "_globdirs",   &glob_dirs },  // Public os.globdirs method is in core.lua.
         { "_globfiles",  &glob_files }, // Public os.globfiles method is in core.lua.
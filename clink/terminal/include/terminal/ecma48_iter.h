@@ -8,7 +8,7 @@
 //------------------------------------------------------------------------------
 enum class ecma48_processor_flags { none = 0, bracket = 1<<0, apply_title = 1<<1, plaintext = 1<<2, colorless = 1<<3 };
 DEFINE_ENUM_FLAG_OPERATORS(ecma48_processor_flags);
-void ecma48_processor(const char* in, str_base* out, uint32* cell_count, ecma48_processor_flags flags=ecma48_processor_flags::none);
+void ecma48_processor(const char* in, str_base* out, uint32* cell_count, ecma48_processor_flags flags=ecma48_processor_flags::none, str_base* applied_title=nullptr, bool* visible_osc=nullptr);
 extern "C" uint32 cell_count(const char*);
 
 //------------------------------------------------------------------------------
@@ -0,0 +1,120 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#pragma once
+
+#include "ecma48_iter.h"
+#include "screen_buffer.h"
+
+#include <vector>
+
+class str_base;
+enum find_line_mode : int32;
+
+//------------------------------------------------------------------------------
+// An in-memory screen buffer that applies the ECMA-48 stream written to it to
+// a grid of cells, without any console.  It reports native VT processing, so
+// ecma48_terminal_out passes the raw stream through and the buffer can count
+// every byte emitted (text, control codes, and escape sequences alike), as well
+// as the number of cells whose contents actually changed.  That makes it
+// possible to drive and measure the display code headlessly.
+//
+// Attributes are stored as console attributes (the same as win_screen_buffer
+// reads back from the console), so line_has_color() and find_line() behave the
+// same.  Line numbers are rows in the grid; lines scrolled off the top are
+// discarded.  Writing to the last column defers wrapping until the next
+// character, and LF also returns to the first column, like the console does.
+class vt_screen_buffer
+    : public screen_buffer
+{
+public:
+    struct counters
+    {
+        uint32      writes = 0;         // Number of write() calls.
+        uint32      bytes = 0;          // Bytes written, including escape codes.
+        uint32      cells_changed = 0;  // Cells whose character or attributes changed.
+        uint32      scrolled = 0;       // Lines scrolled within the scroll region.
+    };
+
+                    vt_screen_buffer(int32 columns=80, int32 rows=25);
+    virtual         ~vt_screen_buffer() override = default;
+    virtual void    open() override {}
+    virtual void    begin() override {}
+    virtual void    end() override {}
+    virtual void    close() override {}
+    virtual void    write(const char* data, int32 length) override;
+    virtual void    flush() override {}
+    virtual int32   get_columns() const override { return m_columns; }
+    virtual int32   get_rows() const override { return m_rows; }
+    virtual bool    get_line_text(int32 line, str_base& out) const override;
+    virtual bool    has_native_vt_processing() const override { return true; }
+    virtual void    clear(clear_type type) override;
+    virtual void    clear_line(clear_type type) override;
+    virtual void    set_horiz_cursor(int32 column) override;
+    virtual void    set_cursor(int32 column, int32 row) override;
+    virtual void    move_cursor(int32 dx, int32 dy) override;
+    virtual void    save_cursor() override;
+    virtual void    restore_cursor() override;
+    virtual void    insert_chars(int32 count) override;
+    virtual void    delete_chars(int32 count) override;
+    virtual void    set_attributes(const attributes attr) override;
+    virtual bool    get_nearest_color(attributes& attr) const override;
+    virtual int32   is_line_default_color(int32 line) const override;
+    virtual int32   line_has_color(int32 line, const BYTE* attrs, int32 num_attrs, BYTE mask=0xff) const override;
+    virtual int32   find_line(int32 starting_line, int32 distance, const char* text, find_line_mode mode, const BYTE* attrs=nullptr, int32 num_attrs=0, BYTE mask=0xff) const override;
+
+    void            resize(int32 columns, int32 rows);
+    void            reset();
+    void            set_scroll_region(int32 top, int32 bottom);
+    int32           get_cursor_column() const { return m_x; }
+    int32           get_cursor_row() const { return m_y; }
+    uint16          get_cell_attr(int32 column, int32 row) const;
+    const counters& get_counters() const { return m_counters; }
+    void            reset_counters() { m_counters = counters(); }
+
+private:
+    struct cell
+    {
+        bool        operator == (const cell& rhs) const { return ch == rhs.ch && attr == rhs.attr; }
+        bool        operator != (const cell& rhs) const { return !(*this == rhs); }
+        char32_t    ch;                 // 0 means the right half of a wide char.
+        uint16      attr;
+    };
+
+    void            write_chars(const char* chars, uint32 length);
+    void            write_c0(int32 c0);
+    void            write_c1(const ecma48_code& code);
+    void            put_cell(int32 column, int32 row, cell c);
+    void            fill(int32 row, int32 from, int32 to, cell c);
+    void            line_feed();
+    void            scroll(int32 top, int32 bottom, int32 count);
+    cell*           get_row(int32 row) { return &m_cells[row * m_columns]; }
+    const cell*     get_row(int32 row) const { return &m_cells[row * m_columns]; }
+    cell            blank() const { return { ' ', m_attr }; }
+
+    enum : uint16
+    {
+        attr_mask_fg        = 0x000f,
+        attr_mask_bg        = 0x00f0,
+        attr_mask_bold      = 0x0008,
+        attr_mask_underline = 0x8000,
+        attr_mask_all       = attr_mask_fg|attr_mask_bg|attr_mask_underline,
+    };
+
+    std::vector<cell> m_cells;
+    int32           m_columns = 0;
+    int32           m_rows = 0;
+    int32           m_x = 0;
+    int32           m_y = 0;
+    int32           m_saved_x = -1;
+    int32           m_saved_y = -1;
+    int32           m_top = 0;          // Scroll region, inclusive.
+    int32           m_bottom = 0;
+    bool            m_wrap_pending = false;
+    uint16          m_default_attr = 0x07;
+    uint16          m_attr = 0x07;
+    bool            m_bold = false;
+    bool            m_reverse = false;
+    counters        m_counters;
+    ecma48_state    m_state;
+};
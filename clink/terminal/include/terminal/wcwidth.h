@@ -15,6 +15,7 @@ extern "C" void reset_cached_font();
 bool is_variant_selector(char32_t ucs);
 bool is_possible_unqualified_half_width(char32_t ucs);
 bool is_emoji(char32_t ucs);
+bool verify_wcwidth_tables(char32_t& mismatch);
 
 //------------------------------------------------------------------------------
 class combining_mark_width_scope
@@ -38,6 +39,7 @@ public:
     explicit        wcwidth_iter(const str_impl<char>& s, int32 len=-1);
                     wcwidth_iter(const wcwidth_iter& i);
     char32_t        next();
+    uint32          next_ascii_run();
     void            unnext();
     const char*     character_pointer() const { return m_chr_ptr; }
     uint32          character_length() const { return uint32(m_chr_end - m_chr_ptr); }
@@ -271,6 +271,10 @@ const ecma48_code& ecma48_iter::next()
     bool done = true;
     while (1)
     {
+        // Printable ASCII never ends a run of characters.
+        if (m_state.state == ecma48_state_char)
+            m_iter.skip_printable_ascii();
+
         int32 c = m_iter.peek();
         if (!c)
         {
@@ -525,7 +529,7 @@ bool ecma48_iter::next_unknown(int32 c)
 
 
 //------------------------------------------------------------------------------
-void ecma48_processor(const char* in, str_base* out, uint32* cell_count, ecma48_processor_flags flags)
+void ecma48_processor(const char* in, str_base* out, uint32* cell_count, ecma48_processor_flags flags, str_base* applied_title, bool* visible_osc)
 {
     uint32 cells = 0;
     bool bracket = !!int32(flags & ecma48_processor_flags::bracket);
@@ -533,6 +537,9 @@ void ecma48_processor(const char* in, str_base* out, uint32* cell_count, ecma48_
     bool plaintext = !!int32(flags & ecma48_processor_flags::plaintext);
     bool colorless = !!int32(flags & ecma48_processor_flags::colorless);
 
+    if (visible_osc)
+        *visible_osc = false;
+
     ecma48_state state;
     ecma48_iter iter(in, state);
     while (const ecma48_code& code = iter.next())
@@ -550,6 +557,8 @@ void ecma48_processor(const char* in, str_base* out, uint32* cell_count, ecma48_
                     goto concat_verbatim;
                 if (osc.visible)
                 {
+                    if (visible_osc)
+                        *visible_osc = true;
                     if (out)
                         out->concat(osc.output.c_str(), osc.output.length());
                     if (cell_count)
@@ -558,7 +567,24 @@ void ecma48_processor(const char* in, str_base* out, uint32* cell_count, ecma48_
                 else if (!apply_title)
                     goto concat_verbatim;
                 else if (osc.command >= '0' && osc.command <= '2')
+                {
                     set_console_title(osc.param.c_str());
+                    if (applied_title)
+                        *applied_title = osc.param.c_str();
+                    // The title can include nested OSC codes with output.
+                    if (visible_osc)
+                    {
+                        const char* const end = code.get_pointer() + code.get_length();
+                        for (const char* p = code.get_pointer() + 2; p + 1 < end; ++p)
+                        {
+                            if (p[0] == 0x1b && p[1] == ']')
+                            {
+                                *visible_osc = true;
+                                break;
+                            }
+                        }
+                    }
+                }
                 else
                     goto concat_verbatim;
             }
@@ -261,10 +261,15 @@ void ecma48_terminal_out::write(const char* chars, int32 length)
 void ecma48_terminal_out::set_attributes(const ecma48_code::csi_base& csi)
 {
     reset_pending();
+    m_screen.set_attributes(get_sgr_attributes(csi));
+}
 
+//------------------------------------------------------------------------------
+attributes ecma48_terminal_out::get_sgr_attributes(const ecma48_code::csi_base& csi)
+{
     // Empty parameters to 'CSI SGR' implies 0 (reset).
     if (csi.param_count == 0)
-        return m_screen.set_attributes(attributes::defaults);
+        return attributes::defaults;
 
     // Process each code that is supported.
     attributes attr;
@@ -389,7 +394,7 @@ void ecma48_terminal_out::set_attributes(const ecma48_code::csi_base& csi)
         }
     }
 
-    m_screen.set_attributes(attr);
+    return attr;
 }
 
 //------------------------------------------------------------------------------
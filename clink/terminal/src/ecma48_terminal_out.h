@@ -29,6 +29,7 @@ public:
     virtual int32       line_has_color(int32 line, const BYTE* attrs, int32 num_attrs, BYTE mask=0xff) const override;
     virtual int32       find_line(int32 starting_line, int32 distance, const char* text, find_line_mode mode, const BYTE* attrs=nullptr, int32 num_attrs=0, BYTE mask=0xff) const override;
 
+    static attributes   get_sgr_attributes(const ecma48_code::csi_base& csi);
     static void         init_termcap_intercept();
     bool                do_termcap_intercept(const char* chars);
     void                visible_bell();
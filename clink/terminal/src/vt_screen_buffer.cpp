@@ -0,0 +1,763 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+#include "vt_screen_buffer.h"
+#include "cielab.h"
+#include "ecma48_terminal_out.h"
+#include "find_line.h"
+#include "wcwidth.h"
+
+#include <core/base.h>
+#include <core/str.h>
+#include <core/str_transform.h>
+
+#include <assert.h>
+
+#include <memory>
+#include <regex>
+
+//------------------------------------------------------------------------------
+// The default console color table (Campbell), in console order.
+static const COLORREF c_palette[] =
+{
+    RGB( 12,  12,  12), RGB(  0,  55, 218), RGB( 19, 161,  14), RGB( 58, 150, 221),
+    RGB(197,  15,  31), RGB(136,  23, 152), RGB(193, 156,   0), RGB(204, 204, 204),
+    RGB(118, 118, 118), RGB( 59, 120, 255), RGB( 22, 198,  12), RGB( 97, 214, 214),
+    RGB(231,  72,  86), RGB(180,   0, 158), RGB(249, 241, 165), RGB(242, 242, 242),
+};
+
+//------------------------------------------------------------------------------
+static uint8 get_nearest_color(const uint8 (&rgb)[3])
+{
+    cie::lab target(RGB(rgb[0], rgb[1], rgb[2]));
+    double best_deltaE = 0;
+    int32 best_idx = -1;
+    for (int32 i = sizeof_array(c_palette); i--;)
+    {
+        cie::lab candidate(c_palette[i]);
+        double deltaE = cie::deltaE_2(target, candidate);
+        if (best_idx < 0 || best_deltaE > deltaE)
+        {
+            best_deltaE = deltaE;
+            best_idx = i;
+        }
+    }
+
+    static const int32 dos_to_ansi_order[] = { 0, 4, 2, 6, 1, 5, 3, 7 };
+    return uint8((best_idx & 0x08) + dos_to_ansi_order[best_idx & 0x07]);
+}
+
+//------------------------------------------------------------------------------
+static void append_utf16(wstr_base& out, char32_t c)
+{
+    wchar_t w[2];
+    if (c >= 0x10000)
+    {
+        c -= 0x10000;
+        w[0] = wchar_t(0xd800 + (c >> 10));
+        w[1] = wchar_t(0xdc00 + (c & 0x3ff));
+        out.concat(w, 2);
+    }
+    else
+    {
+        w[0] = wchar_t(c);
+        out.concat(w, 1);
+    }
+}
+
+
+
+//------------------------------------------------------------------------------
+vt_screen_buffer::vt_screen_buffer(int32 columns, int32 rows)
+{
+    resize(columns, rows);
+}
+
+//------------------------------------------------------------------------------
+void vt_screen_buffer::resize(int32 columns, int32 rows)
+{
+    m_columns = max(columns, 1);
+    m_rows = max(rows, 1);
+    reset();
+}
+
+//------------------------------------------------------------------------------
+void vt_screen_buffer::reset()
+{
+    m_cells.clear();
+    m_cells.resize(m_columns * m_rows, { ' ', m_default_attr });
+    m_x = 0;
+    m_y = 0;
+    m_saved_x = -1;
+    m_saved_y = -1;
+    m_top = 0;
+    m_bottom = m_rows - 1;
+    m_wrap_pending = false;
+    m_attr = m_default_attr;
+    m_bold = false;
+    m_reverse = false;
+    m_state.reset();
+    reset_counters();
+}
+
+//------------------------------------------------------------------------------
+void vt_screen_buffer::set_scroll_region(int32 top, int32 bottom)
+{
+    if (top < 0 || bottom >= m_rows || top >= bottom)
+    {
+        top = 0;
+        bottom = m_rows - 1;
+    }
+    m_top = top;
+    m_bottom = bottom;
+}
+
+//------------------------------------------------------------------------------
+uint16 vt_screen_buffer::get_cell_attr(int32 column, int32 row) const
+{
+    if (column < 0 || column >= m_columns || row < 0 || row >= m_rows)
+        return m_default_attr;
+    return get_row(row)[column].attr;
+}
+
+//------------------------------------------------------------------------------
+void vt_screen_buffer::write(const char* data, int32 length)
+{
+    if (length < 0)
+        length = int32(strlen(data));
+
+    m_counters.writes++;
+    m_counters.bytes += length;
+
+    ecma48_iter iter(data, m_state, length);
+    while (const ecma48_code& code = iter.next())
+    {
+        switch (code.get_type())
+        {
+        case ecma48_code::type_chars:
+            write_chars(code.get_pointer(), code.get_length());
+            break;
+
+        case ecma48_code::type_c0:
+            write_c0(code.get_code());
+            break;
+
+        case ecma48_code::type_c1:
+            write_c1(code);
+            break;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+void vt_screen_buffer::write_chars(const char* chars, uint32 length)
+{
+    wcwidth_iter iter(chars, length);
+    while (const char32_t c = iter.next())
+    {
+        int32 width = iter.character_wcwidth_onectrl();
+        if (!width)
+            continue;
+        if (width > m_columns)
+            width = 1;
+
+        if (m_wrap_pending || m_x + width > m_columns)
+        {
+            m_x = 0;
+            line_feed();
+        }
+        m_wrap_pending = false;
+
+        // Overwriting half of a wide character erases the other half.
+        cell* row = get_row(m_y);
+        if (m_x > 0 && !row[m_x].ch)
+            put_cell(m_x - 1, m_y, blank());
+        if (m_x + width < m_columns && !row[m_x + width].ch)
+            put_cell(m_x + width, m_y, blank());
+
+        put_cell(m_x, m_y, { c, m_attr });
+        if (width > 1)
+            put_cell(m_x + 1, m_y, { 0, m_attr });
+
+        m_x += width;
+        if (m_x >= m_columns)
+        {
+            m_x = m_columns - 1;
+            m_wrap_pending = true;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+void vt_screen_buffer::write_c0(int32 c0)
+{
+    switch (c0)
+    {
+    case ecma48_code::c0_bs:
+        move_cursor(-1, 0);
+        break;
+
+    case ecma48_code::c0_cr:
+        m_x = 0;
+        m_wrap_pending = false;
+        break;
+
+    case ecma48_code::c0_ht:
+        m_x = min((m_x / 8 + 1) * 8, m_columns - 1);
+        m_wrap_pending = false;
+        break;
+
+    case ecma48_code::c0_lf:
+    case ecma48_code::c0_vt:
+    case ecma48_code::c0_ff:
+        // The console returns to the first column on LF.
+        m_x = 0;
+        m_wrap_pending = false;
+        line_feed();
+        break;
+    }
+}
+
+//------------------------------------------------------------------------------
+void vt_screen_buffer::write_c1(const ecma48_code& code)
+{
+    if (code.get_code() != ecma48_code::c1_csi)
+        return;
+
+    ecma48_code::csi<32> csi;
+    code.decode_csi(csi);
+    if (csi.private_use)
+        return;
+
+    switch (csi.final)
+    {
+    case '@':   insert_chars(csi.get_param(0, 1)); break;
+    case 'P':   delete_chars(csi.get_param(0, 1)); break;
+    case 'G':   set_horiz_cursor(csi.get_param(0, 1) - 1); break;
+    case 'H':
+    case 'f':   set_cursor(csi.get_param(1, 1) - 1, csi.get_param(0, 1) - 1); break;
+    case 'd':   set_cursor(m_x, csi.get_param(0, 1) - 1); break;
+    case 'm':   set_attributes(ecma48_terminal_out::get_sgr_attributes(csi)); break;
+    case 's':   save_cursor(); break;
+    case 'u':   restore_cursor(); break;
+
+    case 'A':   move_cursor(0, -csi.get_param(0, 1)); break;
+    case 'B':   move_cursor(0,  csi.get_param(0, 1)); break;
+    case 'C':   move_cursor( csi.get_param(0, 1), 0); break;
+    case 'D':   move_cursor(-csi.get_param(0, 1), 0); break;
+
+    case 'J':
+        switch (csi.get_param(0))
+        {
+        case 0: clear(clear_type_after); break;
+        case 1: clear(clear_type_before); break;
+        case 2: clear(clear_type_all); break;
+        }
+        break;
+
+    case 'K':
+        switch (csi.get_param(0))
+        {
+        case 0: clear_line(clear_type_after); break;
+        case 1: clear_line(clear_type_before); break;
+        case 2: clear_line(clear_type_all); break;
+        }
+        break;
+
+    case 'X':
+        fill(m_y, m_x, min(m_x + max(csi.get_param(0, 1), 1), m_columns), blank());
+        break;
+
+    case 'L':
+    case 'M':
+        if (m_y >= m_top && m_y <= m_bottom)
+        {
+            const int32 count = max(csi.get_param(0, 1), 1);
+            scroll(m_y, m_bottom, (csi.final == 'M') ? count : -count);
+            m_x = 0;
+            m_wrap_pending = false;
+        }
+        break;
+
+    case 'S':   scroll(m_top, m_bottom, max(csi.get_param(0, 1), 1)); break;
+    case 'T':   scroll(m_top, m_bottom, -max(csi.get_param(0, 1), 1)); break;
+
+    case 'r':
+        set_scroll_region(csi.get_param(0, 1) - 1, csi.get_param(1, m_rows) - 1);
+        set_cursor(0, 0);
+        break;
+    }
+}
+
+//------------------------------------------------------------------------------
+void vt_screen_buffer::put_cell(int32 column, int32 row, cell c)
+{
+    assert(column >= 0 && column < m_columns);
+    assert(row >= 0 && row < m_rows);
+    cell& dst = get_row(row)[column];
+    if (dst != c)
+    {
+        dst = c;
+        m_counters.cells_changed++;
+    }
+}
+
+//------------------------------------------------------------------------------
+void vt_screen_buffer::fill(int32 row, int32 from, int32 to, cell c)
+{
+    for (int32 x = from; x < to; ++x)
+        put_cell(x, row, c);
+}
+
+//------------------------------------------------------------------------------
+void vt_screen_buffer::line_feed()
+{
+    if (m_y == m_bottom)
+        scroll(m_top, m_bottom, 1);
+    else if (m_y < m_rows - 1)
+        m_y++;
+}
+
+//------------------------------------------------------------------------------
+void vt_screen_buffer::scroll(int32 top, int32 bottom, int32 count)
+{
+    // Positive count scrolls up (content moves toward the top), negative count
+    // scrolls down.  Cells are copied through put_cell() so that only cells
+    // whose contents differ are counted as changed.
+    const int32 height = bottom - top + 1;
+    if (height <= 0 || !count)
+        return;
+
+    const cell fill_cell = blank();
+    if (count > 0)
+    {
+        count = min(count, height);
+        for (int32 y = top; y <= bottom; ++y)
+        {
+            const int32 src = y + count;
+            for (int32 x = 0; x < m_columns; ++x)
+                put_cell(x, y, (src <= bottom) ? get_row(src)[x] : fill_cell);
+        }
+    }
+    else
+    {
+        count = min(-count, height);
+        for (int32 y = bottom; y >= top; --y)
+        {
+            const int32 src = y - count;
+            for (int32 x = 0; x < m_columns; ++x)
+                put_cell(x, y, (src >= top) ? get_row(src)[x] : fill_cell);
+        }
+    }
+
+    m_counters.scrolled += count;
+}
+
+//------------------------------------------------------------------------------
+bool vt_screen_buffer::get_line_text(int32 line, str_base& out) const
+{
+    if (line < 0 || line >= m_rows)
+        return false;
+
+    const cell* row = get_row(line);
+    int32 len = m_columns;
+    while (len > 0 && row[len - 1].ch == ' ')
+        len--;
+
+    wstr<> tmp;
+    for (int32 x = 0; x < len; ++x)
+    {
+        if (row[x].ch)
+            append_utf16(tmp, row[x].ch);
+    }
+
+    out.clear();
+    to_utf8(out, tmp.c_str());
+    return true;
+}
+
+//------------------------------------------------------------------------------
+void vt_screen_buffer::clear(clear_type type)
+{
+    const cell c = blank();
+    switch (type)
+    {
+    case clear_type_all:
+        for (int32 y = 0; y < m_rows; ++y)
+            fill(y, 0, m_columns, c);
+        break;
+
+    case clear_type_before:
+        for (int32 y = 0; y < m_y; ++y)
+            fill(y, 0, m_columns, c);
+        fill(m_y, 0, m_x + 1, c);
+        break;
+
+    case clear_type_after:
+        fill(m_y, m_x, m_columns, c);
+        for (int32 y = m_y + 1; y < m_rows; ++y)
+            fill(y, 0, m_columns, c);
+        break;
+    }
+}
+
+//------------------------------------------------------------------------------
+void vt_screen_buffer::clear_line(clear_type type)
+{
+    const cell c = blank();
+    switch (type)
+    {
+    case clear_type_all:    fill(m_y, 0, m_columns, c); break;
+    case clear_type_before: fill(m_y, 0, m_x + 1, c); break;
+    case clear_type_after:  fill(m_y, m_x, m_columns, c); break;
+    }
+}
+
+//------------------------------------------------------------------------------
+void vt_screen_buffer::set_horiz_cursor(int32 column)
+{
+    m_x = clamp(column, 0, m_columns - 1);
+    m_wrap_pending = false;
+}
+
+//------------------------------------------------------------------------------
+void vt_screen_buffer::set_cursor(int32 column, int32 row)
+{
+    m_x = clamp(column, 0, m_columns - 1);
+    m_y = clamp(row, 0, m_rows - 1);
+    m_wrap_pending = false;
+}
+
+//------------------------------------------------------------------------------
+void vt_screen_buffer::move_cursor(int32 dx, int32 dy)
+{
+    // Callers pass INT_MIN to mean "the first column".
+    m_x = int32(clamp<int64>(int64(m_x) + dx, 0, m_columns - 1));
+    m_y = int32(clamp<int64>(int64(m_y) + dy, 0, m_rows - 1));
+    m_wrap_pending = false;
+}
+
+//------------------------------------------------------------------------------
+void vt_screen_buffer::save_cursor()
+{
+    m_saved_x = m_x;
+    m_saved_y = m_y;
+}
+
+//------------------------------------------------------------------------------
+void vt_screen_buffer::restore_cursor()
+{
+    if (m_saved_x >= 0 && m_saved_y >= 0)
+        set_cursor(m_saved_x, m_saved_y);
+}
+
+//------------------------------------------------------------------------------
+void vt_screen_buffer::insert_chars(int32 count)
+{
+    if (count <= 0)
+        return;
+
+    count = min(count, m_columns - m_x);
+    const cell* row = get_row(m_y);
+    for (int32 x = m_columns; x-- > m_x + count;)
+        put_cell(x, m_y, row[x - count]);
+    fill(m_y, m_x, m_x + count, blank());
+    m_wrap_pending = false;
+}
+
+//------------------------------------------------------------------------------
+void vt_screen_buffer::delete_chars(int32 count)
+{
+    if (count <= 0)
+        return;
+
+    count = min(count, m_columns - m_x);
+    const cell* row = get_row(m_y);
+    for (int32 x = m_x; x < m_columns - count; ++x)
+        put_cell(x, m_y, row[x + count]);
+    fill(m_y, m_columns - count, m_columns, blank());
+    m_wrap_pending = false;
+}
+
+//------------------------------------------------------------------------------
+void vt_screen_buffer::set_attributes(attributes attr)
+{
+    // This mirrors win_screen_buffer::set_attributes(), so the resulting
+    // console attributes are the same.
+    int32 out_attr = m_attr & attr_mask_all;
+
+    // Un-reverse so processing can operate on normalized attributes.
+    if (m_reverse)
+    {
+        int32 fg = (out_attr & ~attr_mask_bg);
+        int32 bg = (out_attr & attr_mask_bg);
+        out_attr = (fg << 4) | (bg >> 4);
+    }
+
+    auto swizzle = [] (int32 rgbi) {
+        int32 b_r_ = ((rgbi & 0x01) << 2) | !!(rgbi & 0x04);
+        return (rgbi & 0x0a) | b_r_;
+    };
+
+    // Map RGB/XTerm256 colors
+    get_nearest_color(attr);
+
+    // Bold
+    bool apply_bold = false;
+    if (auto bold_attr = attr.get_bold())
+    {
+        m_bold = !!(bold_attr.value);
+        apply_bold = true;
+    }
+
+    // Underline
+    if (auto underline = attr.get_underline())
+    {
+        if (underline.value)
+            out_attr |= attr_mask_underline;
+        else
+            out_attr &= ~attr_mask_underline;
+    }
+
+    // Foreground color
+    bool bold = m_bold;
+    if (auto fg = attr.get_fg())
+    {
+        int32 value = fg.is_default ? m_default_attr : swizzle(fg->value);
+        value &= attr_mask_fg;
+        out_attr = (out_attr & ~attr_mask_fg) | value;
+        bold |= (value > 7);
+    }
+    else
+        bold |= (out_attr & attr_mask_bold) != 0;
+
+    if (apply_bold)
+    {
+        if (bold)
+            out_attr |= attr_mask_bold;
+        else
+            out_attr &= ~attr_mask_bold;
+    }
+
+    // Background color
+    if (auto bg = attr.get_bg())
+    {
+        int32 value = bg.is_default ? m_default_attr : (swizzle(bg->value) << 4);
+        out_attr = (out_attr & ~attr_mask_bg) | (value & attr_mask_bg);
+    }
+
+    // Reverse video
+    if (auto rev = attr.get_reverse())
+        m_reverse = rev.value;
+
+    if (m_reverse)
+    {
+        int32 fg = (out_attr & ~attr_mask_bg);
+        int32 bg = (out_attr & attr_mask_bg);
+        out_attr = (fg << 4) | (bg >> 4);
+    }
+
+    m_attr = uint16(out_attr & attr_mask_all);
+}
+
+//------------------------------------------------------------------------------
+bool vt_screen_buffer::get_nearest_color(attributes& attr) const
+{
+    const attributes::color fg = attr.get_fg().value;
+    const attributes::color bg = attr.get_bg().value;
+    if (fg.is_rgb)
+    {
+        uint8 rgb[3];
+        fg.as_888(rgb);
+        attr.set_fg(::get_nearest_color(rgb));
+    }
+    if (bg.is_rgb)
+    {
+        uint8 rgb[3];
+        bg.as_888(rgb);
+        attr.set_bg(::get_nearest_color(rgb));
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+int32 vt_screen_buffer::is_line_default_color(int32 line) const
+{
+    if (line < 0 || line >= m_rows)
+        return -1;
+
+    const cell* row = get_row(line);
+    for (int32 x = 0; x < m_columns; ++x)
+        if (row[x].attr != m_default_attr)
+            return false;
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+int32 vt_screen_buffer::line_has_color(int32 line, const BYTE* attrs, int32 num_attrs, BYTE mask) const
+{
+    if (line < 0 || line >= m_rows)
+        return -1;
+
+    const BYTE* end_attrs = attrs + num_attrs;
+    const cell* row = get_row(line);
+    for (int32 x = 0; x < m_columns; ++x)
+    {
+        for (const BYTE* find_attr = attrs; find_attr < end_attrs; find_attr++)
+            if ((BYTE(row[x].attr) & mask) == (*find_attr & mask))
+                return true;
+    }
+
+    return false;
+}
+
+//------------------------------------------------------------------------------
+int32 vt_screen_buffer::find_line(int32 starting_line, int32 distance, const char* text, find_line_mode mode, const BYTE* attrs, int32 num_attrs, BYTE mask) const
+{
+    // This follows the same logic as ::find_line(), but reads from the cells.
+    wstr_moveable find;
+    wstr_moveable tmp;
+    std::unique_ptr<std::wregex> regex;
+    if (text && *text)
+    {
+        find = text;
+
+        if (mode & find_line_mode::use_regex)
+        {
+            std::regex_constants::syntax_option_type syntax = std::regex_constants::ECMAScript;
+            if (mode & find_line_mode::ignore_case)
+                syntax |= std::regex_constants::icase;
+
+            try
+            {
+                regex = std::make_unique<std::wregex>(find.c_str(), syntax);
+            }
+            catch (std::regex_error ex)
+            {
+                return -1;
+            }
+        }
+        else if (mode & find_line_mode::ignore_case)
+        {
+            str_transform(find.c_str(), find.length(), tmp, transform_mode::lower);
+            find = std::move(tmp);
+        }
+    }
+
+    wstr_moveable line_chars;
+    std::vector<int32> columns;     // Column of each wchar_t in line_chars.
+
+    while (distance != 0)
+    {
+        if (starting_line < 0 || starting_line >= m_rows)
+            return 0;
+
+        const cell* row = get_row(starting_line);
+        int32 start_col = 0;
+        int32 end_col = m_columns;
+
+        bool found_text = true;
+        if (text)
+        {
+            int32 len = m_columns;
+            while (len > 0 && row[len - 1].ch == ' ')
+                len--;
+
+            line_chars.clear();
+            columns.clear();
+            for (int32 x = 0; x < len; ++x)
+            {
+                if (!row[x].ch)
+                    continue;
+                append_utf16(line_chars, row[x].ch);
+                while (columns.size() < line_chars.length())
+                    columns.push_back(x);
+            }
+            columns.push_back(len);
+
+            const wchar_t* line_text = line_chars.c_str();
+            uint32 line_len = line_chars.length();
+            if (!regex && (mode & find_line_mode::ignore_case))
+            {
+                // Presume that str_transform preserves the alignment.
+                str_transform(line_chars.c_str(), line_chars.length(), tmp, transform_mode::lower);
+                line_text = tmp.c_str();
+                line_len = tmp.length();
+            }
+
+            int32 start_found = 0;
+            int32 len_found = 0;
+            if (regex)
+            {
+                std::wcmatch matches;
+                try
+                {
+                    std::regex_search(line_text, line_text + line_len, matches, *regex, std::regex_constants::match_default);
+                }
+                catch (std::regex_error ex)
+                {
+                    return -2;
+                }
+
+                found_text = matches.size() > 0;
+                if (found_text)
+                {
+                    start_found = int32(matches.position(0));
+                    len_found = int32(matches.length(0));
+                }
+            }
+            else
+            {
+                const wchar_t* found = wcsstr(line_text, find.c_str());
+                found_text = !!found;
+                if (found_text)
+                {
+                    start_found = int32(found - line_text);
+                    len_found = find.length();
+                }
+            }
+
+            if (found_text)
+            {
+                const int32 last = int32(columns.size()) - 1;
+                start_col = columns[min(start_found, last)];
+                end_col = columns[min(start_found + len_found, last)];
+            }
+        }
+
+        bool found_attr = true;
+        if (found_text && attrs && num_attrs)
+        {
+            found_attr = false;
+
+            const BYTE* end_attrs = attrs + num_attrs;
+            for (int32 x = start_col; x < end_col && !found_attr; ++x)
+            {
+                for (const BYTE* find_attr = attrs; find_attr < end_attrs; find_attr++)
+                    if ((BYTE(row[x].attr) & mask) == (*find_attr & mask))
+                    {
+                        found_attr = true;
+                        break;
+                    }
+            }
+        }
+
+        if (found_text && found_attr)
+            return starting_line;
+
+        if (distance > 0)
+        {
+            starting_line++;
+            distance--;
+        }
+        else
+        {
+            starting_line--;
+            distance++;
+        }
+    }
+
+    return -1;
+}
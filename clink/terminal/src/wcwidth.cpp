@@ -206,7 +206,7 @@ static const struct interval combining[] = {
  * in ISO 10646.
  */
 
-static int32 mk_wcwidth(char32_t ucs)
+static int32 bisearch_wcwidth(char32_t ucs)
 {
   /* test for 8-bit control characters */
   if (ucs == 0)
@@ -254,7 +254,7 @@ static int32 mk_wcwidth(char32_t ucs)
   return 1;
 }
 
-static int32 mk_wcwidth_ucs2(char32_t ucs)
+static int32 bisearch_wcwidth_ucs2(char32_t ucs)
 {
   static const struct interval ucs2_fullwidth_emoji[] = {
     { 0x231A, 0x231B },     // Watch, hourglass.
@@ -419,21 +419,112 @@ static const struct interval ambiguous[] = {
  * the traditional terminal character-width behaviour. It is not
  * otherwise recommended for general use.
  */
-static int32 mk_wcwidth_cjk(char32_t ucs)
+static int32 bisearch_wcwidth_cjk(char32_t ucs)
 {
   /* binary search in table of ambiguous width chars in CJK codepages */
   if (bisearch(ucs, ambiguous, _countof(ambiguous) - 1))
     return resolve_ambiguous_wcwidth(ucs);
 
-  return mk_wcwidth(ucs);
+  return bisearch_wcwidth(ucs);
 }
 
-static int32 mk_wcwidth_cjk_ucs2(char32_t ucs)
+static int32 bisearch_wcwidth_cjk_ucs2(char32_t ucs)
 {
   /* binary search in table of ambiguous width chars in CJK codepages */
   if (bisearch(ucs, ambiguous, _countof(ambiguous) - 1))
     return resolve_ambiguous_wcwidth(ucs);
 
+  return bisearch_wcwidth_ucs2(ucs);
+}
+
+
+/*
+ * The functions above are the reference implementation.  At runtime, the
+ * two-stage table generated from them by 'premake5 embed' is used instead, so
+ * that any codepoint resolves with two array loads instead of several binary
+ * searches.  The table holds flags rather than widths, since the widths also
+ * depend on runtime state (color emoji, combining mark width, OS version, and
+ * how ambiguous widths are resolved).  verify_wcwidth_tables() checks that
+ * the two agree for every codepoint.
+ */
+
+#include "wcwidth-table.i"
+
+static uint8 get_wcwidth_flags(char32_t ucs)
+{
+  if (ucs >= c_wcwidth_max)
+    return 0;
+  const uint32 block = c_wcwidth_pages[ucs >> c_wcwidth_shift];
+  return c_wcwidth_blocks[(block << c_wcwidth_shift) + (ucs & ((1 << c_wcwidth_shift) - 1))];
+}
+
+static int32 mk_wcwidth(char32_t ucs)
+{
+  /* test for 8-bit control characters */
+  if (ucs == 0)
+    return 0;
+  if (ucs < 32)
+    return -1;
+  if (ucs <= 0x7e)
+    return 1;
+  if (ucs < 0xa0)
+    return -1;
+
+  const uint8 flags = get_wcwidth_flags(ucs);
+
+  /* special processing when color emoji support is enabled */
+  if (g_color_emoji) {
+    if (flags & WCW_UNQUALIFIED)
+      return 1;
+    if (flags & WCW_EMOJI)
+      return 2;
+  }
+
+  if (flags & WCW_COMBINING)
+    return s_combining_mark_width;
+
+  return (flags & WCW_WIDE) ? 2 : 1;
+}
+
+static int32 mk_wcwidth_ucs2(char32_t ucs)
+{
+  /* test for 8-bit control characters */
+  if (ucs == 0)
+    return 0;
+  if (ucs < 32)
+    return -1;
+  if (ucs <= 0x7e)
+    return 1;
+  if (ucs < 0xa0)
+    return -1;
+
+  const uint8 flags = get_wcwidth_flags(ucs);
+
+  if (flags & WCW_COMBINING)
+    return s_combining_mark_width;
+
+  if (s_win10 && (flags & WCW_WIDE_WIN10))
+    return 2;
+  if (s_win11 && (flags & WCW_WIDE_WIN11))
+    return 2;
+  if (ucs >= 0x10000)                       /* UCS2 in legacy console mode. */
+    return 2;
+  return 1;
+}
+
+static int32 mk_wcwidth_cjk(char32_t ucs)
+{
+  if (get_wcwidth_flags(ucs) & WCW_AMBIGUOUS)
+    return resolve_ambiguous_wcwidth(ucs);
+
+  return mk_wcwidth(ucs);
+}
+
+static int32 mk_wcwidth_cjk_ucs2(char32_t ucs)
+{
+  if (get_wcwidth_flags(ucs) & WCW_AMBIGUOUS)
+    return resolve_ambiguous_wcwidth(ucs);
+
   return mk_wcwidth_ucs2(ucs);
 }
 
@@ -524,7 +615,7 @@ bool is_variant_selector(char32_t ucs)
 bool is_possible_unqualified_half_width(char32_t ucs)
 {
     assert(g_color_emoji);
-    return !!bisearch(ucs, possible_unqualified_half_width, _countof(possible_unqualified_half_width) - 1);
+    return !!(get_wcwidth_flags(ucs) & WCW_UNQUALIFIED);
 }
 
 /*
@@ -533,7 +624,7 @@ bool is_possible_unqualified_half_width(char32_t ucs)
 bool is_emoji(char32_t ucs)
 {
     assert(g_color_emoji);
-    return !!bisearch(ucs, emojis, _countof(emojis) - 1);
+    return !!(get_wcwidth_flags(ucs) & WCW_EMOJI);
 }
 
 #include <core/settings.h>
@@ -804,7 +895,7 @@ int32 test_ambiguous_width_char(char32_t ucs, str_iter* iter)
     UINT cp = GetConsoleOutputCP();
     if (is_CJK_codepage(cp))
     {
-        if (bisearch(ucs, ambiguous, _countof(ambiguous) - 1))
+        if (get_wcwidth_flags(ucs) & WCW_AMBIGUOUS)
             return 1; // CJK ambiguous width char.
     }
 
@@ -815,4 +906,48 @@ int32 test_ambiguous_width_char(char32_t ucs, str_iter* iter)
 } // extern "C"
 #endif
 
+//------------------------------------------------------------------------------
+// Checks the generated table against the reference implementation for every
+// codepoint, under each combination of runtime state that affects the result.
+// Returns false and sets mismatch to the first codepoint that differs.
+bool verify_wcwidth_tables(char32_t& mismatch)
+{
+    const bool old_color_emoji = g_color_emoji;
+    const int32 old_combining_mark_width = s_combining_mark_width;
+    const bool old_win10 = s_win10;
+    const bool old_win11 = s_win11;
+
+    // A combining mark width of 0 differs from every other width, so a wrong
+    // combining flag can't go unnoticed.  The CJK variants only add the
+    // ambiguous check, so comparing the ambiguous flag covers them.
+    s_combining_mark_width = 0;
+
+    bool ok = true;
+    for (char32_t ucs = 0; ok && ucs < c_wcwidth_max + 0x100; ++ucs)
+    {
+        const uint8 flags = get_wcwidth_flags(ucs);
+        ok = (!!(flags & WCW_AMBIGUOUS) == !!bisearch(ucs, ambiguous, _countof(ambiguous) - 1) &&
+              !!(flags & WCW_EMOJI) == !!bisearch(ucs, emojis, _countof(emojis) - 1) &&
+              !!(flags & WCW_UNQUALIFIED) == !!bisearch(ucs, possible_unqualified_half_width, _countof(possible_unqualified_half_width) - 1));
+
+        for (int32 state = 0; ok && state < 4; ++state)
+        {
+            g_color_emoji = !!(state & 1);
+            s_win10 = !!(state & 2);
+            s_win11 = (state == 3);
+            ok = (mk_wcwidth(ucs) == bisearch_wcwidth(ucs) &&
+                  mk_wcwidth_ucs2(ucs) == bisearch_wcwidth_ucs2(ucs));
+        }
+
+        if (!ok)
+            mismatch = ucs;
+    }
+
+    g_color_emoji = old_color_emoji;
+    s_combining_mark_width = old_combining_mark_width;
+    s_win10 = old_win10;
+    s_win11 = old_win11;
+    return ok;
+}
+
 // vim: ts=2 expandtab sw=2
@@ -12,8 +12,13 @@ extern "C" uint32 clink_wcswidth(const char* s, uint32 len)
     uint32 count = 0;
 
     wcwidth_iter iter(s, len);
-    while (iter.next())
+    while (true)
+    {
+        count += iter.next_ascii_run();
+        if (!iter.next())
+            break;
         count += iter.character_wcwidth_onectrl();
+    }
 
     return count;
 }
@@ -24,8 +29,13 @@ extern "C" uint32 clink_wcswidth_expandctrl(const char* s, uint32 len)
     uint32 count = 0;
 
     wcwidth_iter iter(s, len);
-    while (iter.next())
+    while (true)
+    {
+        count += iter.next_ascii_run();
+        if (!iter.next())
+            break;
         count += iter.character_wcwidth_twoctrl();
+    }
 
     return count;
 }
@@ -170,6 +180,37 @@ emoji_sequence:
     return c;
 }
 
+//------------------------------------------------------------------------------
+// If the next characters are printable ASCII, this consumes them as a single
+// run and returns how many there were; each is one cell wide.  Otherwise it
+// returns 0 and consumes nothing.
+//
+// The last one before a non-ASCII character is left for next(), since variant
+// selectors and joiners can change its width.
+uint32 wcwidth_iter::next_ascii_run()
+{
+    // m_next starts at m_chr_end; make sure it's a single byte, and not an
+    // overlong encoding.
+    const char* const start = m_chr_end;
+    if (m_next < 0x20 || m_next >= 0x7f || m_iter.get_pointer() != start + 1)
+        return 0;
+
+    m_iter.skip_printable_ascii();
+    const char* end = m_iter.get_pointer();
+    if (m_iter.more() && uint8(*end) >= 0x80)
+        --end;
+    if (end == start)
+        return 0;
+
+    m_iter.reset_pointer(end);
+    m_chr_ptr = start;
+    m_chr_end = end;
+    m_chr_wcwidth = int32(end - start);
+    m_emoji = false;
+    m_next = m_iter.next();
+    return uint32(end - start);
+}
+
 //------------------------------------------------------------------------------
 void wcwidth_iter::consume_emoji_sequence()
 {
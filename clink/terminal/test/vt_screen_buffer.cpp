@@ -0,0 +1,152 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+
+#include <core/base.h>
+#include <core/str.h>
+#include <terminal/find_line.h>
+#include <terminal/terminal.h>
+#include <terminal/terminal_out.h>
+#include <terminal/vt_screen_buffer.h>
+
+//------------------------------------------------------------------------------
+static void require_line(const vt_screen_buffer& screen, int32 line, const char* expected)
+{
+    str<> text;
+    REQUIRE(screen.get_line_text(line, text));
+    REQUIRE(text.equals(expected), [&] () {
+        printf("line %d\nexpected '%s'\nactual   '%s'\n", line, expected, text.c_str());
+    });
+}
+
+
+
+//------------------------------------------------------------------------------
+TEST_CASE("vt_screen_buffer")
+{
+    vt_screen_buffer screen(10, 4);
+
+    SECTION("Text and wrapping")
+    {
+        screen.write("hello", -1);
+        require_line(screen, 0, "hello");
+        REQUIRE(screen.get_cursor_column() == 5);
+
+        // Wrapping is deferred until the next character.
+        screen.write("world", -1);
+        require_line(screen, 0, "helloworld");
+        REQUIRE(screen.get_cursor_row() == 0);
+        screen.write("!", -1);
+        require_line(screen, 1, "!");
+        REQUIRE(screen.get_cursor_row() == 1);
+
+        screen.write("\nab\r\ncd\n", -1);
+        require_line(screen, 0, "!");
+        require_line(screen, 1, "ab");
+        require_line(screen, 2, "cd");
+        require_line(screen, 3, "");
+        REQUIRE(screen.get_counters().scrolled == 1);
+    }
+
+    SECTION("Cursor and editing")
+    {
+        screen.write("abcdef\x1b[3G", -1);
+        REQUIRE(screen.get_cursor_column() == 2);
+
+        screen.write("\x1b[2@XY", -1);
+        require_line(screen, 0, "abXYcdef");
+        screen.write("\x1b[2P", -1);
+        require_line(screen, 0, "abXYef");
+        screen.write("\x1b[K", -1);
+        require_line(screen, 0, "abXY");
+        screen.write("\x1b[3;2H*\x1b[A+\x1b[s\x1b[H-\x1b[u!", -1);
+        require_line(screen, 0, "-bXY");
+        require_line(screen, 1, "  +!");
+        require_line(screen, 2, " *");
+        screen.write("\x1b[2J", -1);
+        for (int32 i = 0; i < screen.get_rows(); ++i)
+            require_line(screen, i, "");
+    }
+
+    SECTION("Scroll region")
+    {
+        screen.write("top\n1\n2\nbottom", -1);
+        screen.write("\x1b[2;3r", -1);
+        REQUIRE(screen.get_cursor_row() == 0);
+        screen.write("\x1b[3;1H\n", -1);
+        require_line(screen, 0, "top");
+        require_line(screen, 1, "2");
+        require_line(screen, 2, "");
+        require_line(screen, 3, "bottom");
+    }
+
+    SECTION("Colors")
+    {
+        static const BYTE c_red[] = { 0x04 };
+        static const BYTE c_bright_green_on_blue[] = { 0x1a };
+
+        screen.write("plain\n\x1b[31mred\x1b[m\n\x1b[1;32;44mgreen\x1b[m", -1);
+        REQUIRE(screen.is_line_default_color(0) == 1);
+        REQUIRE(screen.is_line_default_color(1) == 0);
+        REQUIRE(screen.line_has_color(1, c_red, 1) == 1);
+        REQUIRE(screen.line_has_color(0, c_red, 1) == 0);
+        REQUIRE(screen.line_has_color(2, c_bright_green_on_blue, 1) == 1);
+        REQUIRE(screen.line_has_color(2, c_red, 1, 0x0f) == 0);
+
+        // RGB colors map to the nearest console color.
+        screen.write("\n\x1b[38;2;200;10;30mx", -1);
+        REQUIRE(screen.line_has_color(3, c_red, 1, 0x0f) == 1);
+    }
+
+    SECTION("Find line")
+    {
+        static const BYTE c_red[] = { 0x04 };
+
+        screen.write("alpha\nbeta \x1b[31mred\x1b[m\ngamma\nBeta", -1);
+        REQUIRE(screen.find_line(0, 4, "beta", find_line_mode::none) == 1);
+        REQUIRE(screen.find_line(3, -4, "beta", find_line_mode::none) == 1);
+        REQUIRE(screen.find_line(2, 2, "beta", find_line_mode::ignore_case) == 3);
+        REQUIRE(screen.find_line(0, 4, "g.m+a", find_line_mode::use_regex) == 2);
+        REQUIRE(screen.find_line(0, 4, "zeta", find_line_mode::none) == -1);
+        REQUIRE(screen.find_line(0, 4, "beta", find_line_mode::none, c_red, 1) == -1);
+        REQUIRE(screen.find_line(0, 4, "red", find_line_mode::none, c_red, 1) == 1);
+        REQUIRE(screen.find_line(0, 4, nullptr, find_line_mode::none, c_red, 1) == 1);
+    }
+
+    SECTION("Counters")
+    {
+        screen.write("abc", -1);
+        REQUIRE(screen.get_counters().bytes == 3);
+        REQUIRE(screen.get_counters().cells_changed == 3);
+
+        // Rewriting the same text changes nothing, but still costs bytes.
+        screen.reset_counters();
+        screen.write("\rabc", -1);
+        REQUIRE(screen.get_counters().bytes == 4);
+        REQUIRE(screen.get_counters().cells_changed == 0);
+
+        screen.reset_counters();
+        screen.write("\r\x1b[31mab\x1b[m", -1);
+        REQUIRE(screen.get_counters().writes == 1);
+        REQUIRE(screen.get_counters().bytes == 11);
+        REQUIRE(screen.get_counters().cells_changed == 2);
+
+        screen.reset_counters();
+        screen.write("\x1b[H\x1b[@", -1);
+        REQUIRE(screen.get_counters().cells_changed == 4);
+        require_line(screen, 0, " abc");
+    }
+
+    SECTION("Through terminal_out")
+    {
+        terminal term = terminal_create(&screen);
+        term.out->write("\x1b[32mok\x1b[m", -1);
+        term.out->write("!", 1);
+        terminal_destroy(term);
+
+        require_line(screen, 0, "ok!");
+        REQUIRE(screen.get_counters().bytes == 11);
+        REQUIRE(screen.get_counters().cells_changed == 3);
+    }
+}
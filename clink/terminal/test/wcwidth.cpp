@@ -0,0 +1,129 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+
+#include <core/base.h>
+#include <core/os.h>
+#include <terminal/ecma48_iter.h>
+#include <terminal/wcwidth.h>
+
+#include <string>
+#include <vector>
+
+extern bool g_color_emoji;
+
+//------------------------------------------------------------------------------
+static uint32 wcswidth_by_character(const char* s, uint32 len)
+{
+    uint32 count = 0;
+    wcwidth_iter iter(s, len);
+    while (iter.next())
+        count += iter.character_wcwidth_onectrl();
+    return count;
+}
+
+//------------------------------------------------------------------------------
+TEST_CASE("wcwidth tables")
+{
+    // The generated table must agree with the interval tables it was generated
+    // from, for every codepoint.  If this fails, run 'premake5 embed'.
+    char32_t mismatch = 0;
+    REQUIRE(verify_wcwidth_tables(mismatch), [&] () {
+        printf("mismatch at U+%04X", uint32(mismatch));
+    });
+}
+
+//------------------------------------------------------------------------------
+TEST_CASE("wcwidth ASCII runs")
+{
+    // Consuming printable ASCII in runs must give the same widths as going
+    // one character at a time, including where the following character can
+    // change the width of the preceding one.
+    static const char* const c_strings[] = {
+        "",
+        "plain ascii text that is long enough to be vectorized",
+        "#\xef\xb8\x8f keycap",                     // # VS16
+        "1\xe2\x83\xa3 keycap",                     // 1 combining enclosing keycap
+        "a\xcc\x81 combining",                      // a combining acute
+        "emoji \xf0\x9f\x98\x80 smile",             // grinning face
+        "zwj *\xe2\x80\x8d\xf0\x9f\x98\x80",        // * ZWJ grinning face
+        "wide \xe4\xb8\xad\xe6\x96\x87 text",       // CJK
+        "ctrl\x01x del\x7fy tab\tz",
+        "overlong \xc1\xa1 a",
+    };
+
+    const bool old_color_emoji = g_color_emoji;
+    for (int32 color = 0; color < 2; ++color)
+    {
+        g_color_emoji = !!color;
+        for (const char* s : c_strings)
+        {
+            const uint32 len = uint32(strlen(s));
+            const uint32 expected = wcswidth_by_character(s, len);
+            REQUIRE(clink_wcswidth(s, len) == expected, [&] () {
+                printf("string '%s', color emoji %d, expected %u", s, color, expected);
+            });
+        }
+    }
+    g_color_emoji = old_color_emoji;
+}
+
+//------------------------------------------------------------------------------
+BENCHMARK_CASE("wcwidth ASCII runs")
+{
+    // Match lists and prompts are overwhelmingly ASCII, with escape codes and
+    // the occasional non-ASCII character mixed in.
+    static const char* const c_dirs[] = {
+        "src", "include", "build", "release", "debug", "clink", "readline",
+        "terminal", "docs", "\xe6\x96\x87\xe6\xa1\xa3", "caf\xc3\xa9",
+    };
+    static const char* const c_prompts[] = {
+        "\x1b[1;32muser@host\x1b[m \x1b[1;34mC:\\repos\\clink\x1b[m (\x1b[33mmaster\x1b[m)> ",
+        "\x1b[38;5;240m[12:34:56]\x1b[m \x1b[36mC:\\Users\\someone\\src\\project\x1b[m \xe2\x9d\xaf ",
+        "\x1b]9;9;C:\\repos\\clink\x1b\\C:\\repos\\clink> ",
+    };
+
+    srand(1);
+    std::vector<std::string> matches;
+    for (int32 i = 0; i < 100000; ++i)
+    {
+        std::string match;
+        for (int32 parts = 1 + rand() % 4; parts--;)
+        {
+            match += c_dirs[rand() % sizeof_array(c_dirs)];
+            match += '\\';
+        }
+        char name[32];
+        sprintf_s(name, "file_%u.cpp", rand());
+        match += name;
+        matches.emplace_back(std::move(match));
+    }
+
+    const int32 c_prompt_reps = 20000;
+    uint32 check = 0;
+
+    os::high_resolution_clock clock;
+    for (const auto& match : matches)
+        check += wcswidth_by_character(match.c_str(), uint32(match.length()));
+    const double by_char_ms = clock.elapsed() * 1000;
+
+    clock = os::high_resolution_clock();
+    for (const auto& match : matches)
+        check -= clink_wcswidth(match.c_str(), uint32(match.length()));
+    const double runs_ms = clock.elapsed() * 1000;
+    REQUIRE(check == 0);
+
+    clock = os::high_resolution_clock();
+    for (int32 i = 0; i < c_prompt_reps; ++i)
+        for (const char* prompt : c_prompts)
+            check += cell_count(prompt);
+    const double prompt_ms = clock.elapsed() * 1000;
+
+    printf("\n    matches:   %8zu", matches.size());
+    printf("\n    by char:   %8.3f ms", by_char_ms);
+    printf("\n    runs:      %8.3f ms", runs_ms);
+    printf("\n    prompts:   %8.3f us per cell_count", prompt_ms * 1000 / (c_prompt_reps * sizeof_array(c_prompts)));
+    printf("\n    cells:     %8u", check);
+    puts("");
+}
@@ -80,10 +80,12 @@ struct test
     test*               m_next = nullptr;
     test_func*          m_func;
     const char*         m_name;
+    bool                m_benchmark;
 
-    test(const char* name, test_func* func)
+    test(const char* name, test_func* func, bool benchmark=false)
     : m_func(func)
     , m_name(name)
+    , m_benchmark(benchmark)
     {
         if (get_head() == nullptr)
             get_head() = this;
@@ -110,7 +112,7 @@ inline void list()
 }
 
 //------------------------------------------------------------------------------
-inline bool run(const char* prefix="", bool times=false)
+inline bool run(const char* prefix="", bool times=false, bool benchmarks=false)
 {
     int32 fail_count = 0;
     int32 test_count = 0;
@@ -118,6 +120,10 @@ inline bool run(const char* prefix="", bool times=false)
 
     for (test* test = test::get_head(); test != nullptr; test = test->m_next)
     {
+        // Benchmarks are slow, so they only run when explicitly requested.
+        if (test->m_benchmark != benchmarks)
+            continue;
+
         // Cheap lower-case prefix test.
         const char* a = prefix, *b = test->m_name;
         for (; *a && (*a & ~0x20) == (*b & ~0x20); ++a, ++b);
@@ -217,6 +223,11 @@ void fail(const char* expr, const char* file, int32 line, callback&& cb)
     static clatch::test CLATCH_IDENT(test)(name, CLATCH_IDENT(test_func));\
     static void CLATCH_IDENT(test_func)(clatch::section*& _clatch_tree_iter)
 
+#define BENCHMARK_CASE(name)\
+    static void CLATCH_IDENT(test_func)(clatch::section*&);\
+    static clatch::test CLATCH_IDENT(test)(name, CLATCH_IDENT(test_func), true);\
+    static void CLATCH_IDENT(test_func)(clatch::section*& _clatch_tree_iter)
+
 #define SECTION(name)\
     static clatch::section CLATCH_IDENT(section);\
     if (clatch::section::scope CLATCH_IDENT(scope) = clatch::section::scope(_clatch_tree_iter, CLATCH_IDENT(section), name))
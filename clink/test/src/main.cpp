@@ -3,6 +3,7 @@
 
 #include "pch.h"
 
+#include <core/async_globber.h>
 #include <core/str.h>
 #include <core/settings.h>
 #include <core/os.h>
@@ -84,6 +85,7 @@ int32 main(int32 argc, char** argv)
 
     bool list = false;
     bool times = false;
+    bool benchmarks = false;
     int32 d_flag = 0;
 
     while (argc > 0)
@@ -92,6 +94,7 @@ int32 main(int32 argc, char** argv)
         {
             puts("Options:\n"
                  "  -?        Show this help.\n"
+                 "  -b        Run benchmarks instead of tests.\n"
                  "  -d        Load Lua debugger.\n"
                  "  -dd       Force break on Lua errors.\n"
                  "  -t        Show individual test times.");
@@ -108,6 +111,10 @@ int32 main(int32 argc, char** argv)
             d_flag = 2;
             g_force_break_on_error = true;
         }
+        else if (!strcmp(argv[0], "-b"))
+        {
+            benchmarks = true;
+        }
         else if (!strcmp(argv[0], "-t"))
         {
             times = true;
@@ -142,9 +149,10 @@ int32 main(int32 argc, char** argv)
     clatch::colors::initialize();
 
     const char* prefix = (argc > 0) ? argv[0] : "";
-    int32 result = (clatch::run(prefix, times) != true);
+    int32 result = (clatch::run(prefix, times, benchmarks) != true);
 
     shutdown_recognizer();
+    shutdown_async_globber();
     shutdown_task_manager(true/*final*/);
 
     DWORD elapsed = GetTickCount() - start;
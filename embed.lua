@@ -352,6 +352,187 @@ local function do_emojis()
     print("   " .. #half_width .. " possible unqualified half width emojis")
 end
 
+--------------------------------------------------------------------------------
+local function load_intervals(text, name)
+    local body = text:match("struct interval%s+" .. name .. "%[%]%s*=%s*{(.-)};")
+    if not body then
+        error("Unable to find interval table '" .. name .. "'.")
+    end
+
+    local intervals = {}
+    for first, last in body:gmatch("{%s*0x(%x+),%s*0x(%x+)%s*}") do
+        table.insert(intervals, { tonumber(first, 16), tonumber(last, 16) })
+    end
+    return intervals
+end
+
+--------------------------------------------------------------------------------
+local function do_wcwidth()
+    local out = "clink/terminal/src/wcwidth-table.i"
+
+    print("\n"..out)
+
+    -- The interval tables in wcwidth.cpp and the emoji lists remain the source
+    -- of truth.  The range checks below mirror the ones in bisearch_wcwidth()
+    -- and bisearch_wcwidth_ucs2(), and must be kept in sync with them.  The
+    -- wcwidth tests verify the generated table against those functions.
+    local source = io.open("clink/terminal/src/wcwidth.cpp", "r")
+    local text = source:read("*a")
+    source:close()
+
+    local file = io.open("clink/terminal/src/emoji-test.txt", "r")
+    local filter = io.open("clink/terminal/src/emoji-filter.txt", "r")
+    local fe0f = io.open("clink/terminal/src/emoji-fe0f.txt", "r")
+    local indexed = load_indexed_emoji_table(file)
+    local filtered = load_indexed_emoji_table(filter)
+    local possible_unqualified_half_width = load_indexed_emoji_table(fe0f)
+    file:close()
+    filter:close()
+    fe0f:close()
+
+    local bits = {
+        { "WCW_COMBINING",      0x01 },
+        { "WCW_WIDE",           0x02 },
+        { "WCW_WIDE_WIN10",     0x04 },
+        { "WCW_WIDE_WIN11",     0x08 },
+        { "WCW_EMOJI",          0x10 },
+        { "WCW_UNQUALIFIED",    0x20 },
+        { "WCW_AMBIGUOUS",      0x40 },
+    }
+    local WCW_COMBINING = 0x01
+    local WCW_WIDE = 0x02
+    local WCW_WIDE_WIN10 = 0x04
+    local WCW_WIDE_WIN11 = 0x08
+    local WCW_EMOJI = 0x10
+    local WCW_UNQUALIFIED = 0x20
+    local WCW_AMBIGUOUS = 0x40
+
+    -- Compute the flags for every codepoint.  Index 1 is U+0000.
+    local max_ucs = 0x110000
+    local flags = {}
+    for i = 1, max_ucs do
+        flags[i] = 0
+    end
+
+    local function add(first, last, bit)
+        for d = first, last do
+            flags[d + 1] = flags[d + 1] | bit
+        end
+    end
+
+    local function add_intervals(intervals, bit)
+        for _, r in ipairs(intervals) do
+            add(r[1], r[2], bit)
+        end
+    end
+
+    local function add_indexed(t, bit, except)
+        for d, _ in pairs(t) do
+            if not (except and except[d]) then
+                add(d, d, bit)
+            end
+        end
+    end
+
+    add_intervals(load_intervals(text, "combining"), WCW_COMBINING)
+    add_intervals(load_intervals(text, "ambiguous"), WCW_AMBIGUOUS)
+    add_intervals(load_intervals(text, "ucs2_fullwidth_emoji"), WCW_WIDE_WIN11)
+    add_indexed(indexed, WCW_EMOJI, filtered)
+    add_indexed(possible_unqualified_half_width, WCW_UNQUALIFIED)
+
+    local halfwidth = {}
+    for _, r in ipairs(load_intervals(text, "halfwidth_exceptions")) do
+        for d = r[1], r[2] do
+            halfwidth[d] = true
+        end
+    end
+
+    local function add_wide(first, last, bit)
+        for d = first, last do
+            if not halfwidth[d] then
+                add(d, d, bit)
+            end
+        end
+    end
+
+    local both = WCW_WIDE|WCW_WIDE_WIN10
+    add_wide(0x1100, 0x115f, both)      -- Hangul Jamo init. consonants
+    add_wide(0x2329, 0x232a, both)
+    add_wide(0x2e80, 0xa4cf, both)
+    add_wide(0xac00, 0xd7a3, both)      -- Hangul Syllables
+    add_wide(0xf900, 0xfaff, both)      -- CJK Compatibility Ideographs
+    add_wide(0xfe10, 0xfe19, both)      -- Vertical forms
+    add_wide(0xfe30, 0xfe6f, both)      -- CJK Compatibility Forms
+    add_wide(0xff00, 0xff60, both)      -- Fullwidth Forms
+    add_wide(0xffe0, 0xffe6, both)
+    add_wide(0x20000, 0x2fffd, WCW_WIDE)
+    add_wide(0x30000, 0x3fffd, WCW_WIDE)
+
+    -- Split into blocks and share identical blocks.
+    local shift = 7
+    local block_size = 1 << shift
+    local pages = {}
+    local blocks = {}
+    local block_index = {}
+    for first = 1, max_ucs, block_size do
+        local key = table.concat(flags, ",", first, first + block_size - 1)
+        local index = block_index[key]
+        if not index then
+            index = #blocks
+            block_index[key] = index
+            table.insert(blocks, first)
+        end
+        table.insert(pages, index)
+    end
+
+    if #blocks > 256 then
+        error("\x1b[0;31;1mFAILED: too many wcwidth blocks (" .. #blocks .. ").")
+    end
+
+    -- Write the tables.
+    out = io.open(out, "w")
+    out:write("// Generated from wcwidth.cpp and emoji-test.txt by 'premake5 embed'.\n")
+    out:write("\n")
+    out:write("enum : uint8\n")
+    out:write("{\n")
+    for _, b in ipairs(bits) do
+        out:write(string.format("    %-20s= 0x%02X,\n", b[1], b[2]))
+    end
+    out:write("};\n")
+    out:write("\n")
+    out:write("static const uint32 c_wcwidth_shift = " .. shift .. ";\n")
+    out:write(string.format("static const char32_t c_wcwidth_max = 0x%X;\n", max_ucs))
+    out:write("\n")
+
+    out:write("static const uint8 c_wcwidth_pages[] = {\n")
+    for i = 1, #pages, 16 do
+        local line = {}
+        for j = i, math.min(i + 15, #pages) do
+            table.insert(line, string.format("%d,", pages[j]))
+        end
+        out:write(table.concat(line, " ") .. "\n")
+    end
+    out:write("};\n")
+    out:write("\n")
+
+    out:write("static const uint8 c_wcwidth_blocks[] = {\n")
+    for index, first in ipairs(blocks) do
+        out:write("// " .. (index - 1) .. "\n")
+        for i = first, first + block_size - 1, 16 do
+            local line = {}
+            for j = i, i + 15 do
+                table.insert(line, string.format("0x%02X,", flags[j]))
+            end
+            out:write(table.concat(line, " ") .. "\n")
+        end
+    end
+    out:write("};\n")
+
+    out:close()
+
+    print("   " .. #pages .. " pages; " .. #blocks .. " unique blocks of " .. block_size)
+end
+
 --------------------------------------------------------------------------------
 newaction {
     trigger = "embed",
@@ -360,6 +541,7 @@ newaction {
         do_embed()
         do_wildmatch()
         do_emojis()
+        do_wcwidth()
     end
 }
 
@@ -371,6 +553,7 @@ newaction {
         do_embed(true--[[debug_info]])
         do_wildmatch()
         do_emojis()
+        do_wcwidth()
     end
 }
 
@@ -382,5 +565,6 @@ newaction {
         do_embed(false--[[debug_info]])
         do_wildmatch()
         do_emojis()
+        do_wcwidth()
     end
 }
@@ -28,6 +28,7 @@ void            (*rl_fwrite_function)(FILE*, const char*, int)  = NULL;
 void            (*rl_fflush_function)(FILE*)                    = NULL;
 extern int is_exec_ext(const char* ext);
 extern void clear_suggestion();
+extern void flush_deferred_display();
 extern void end_recognizer();
 extern void end_task_manager();
 extern void uninit_display_readline();
@@ -294,6 +295,7 @@ void end_prompt(int crlf)
     extern void end_prompt_lf();
 
     clear_suggestion();
+    flush_deferred_display();
 
     if (crlf < 0)
     {
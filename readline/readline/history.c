@@ -340,7 +340,12 @@ add_history (const char *string)
 	{
 	  if (history_length == (history_size - 1))
 	    {
-	      history_size += DEFAULT_HISTORY_GROW_SIZE;
+/* begin_clink_change */
+	      /* Grow geometrically so loading a large history doesn't
+		 reallocate the list thousands of times. */
+	      //history_size += DEFAULT_HISTORY_GROW_SIZE;
+	      history_size += (history_size / 2 > DEFAULT_HISTORY_GROW_SIZE) ? history_size / 2 : DEFAULT_HISTORY_GROW_SIZE;
+/* end_clink_change */
 	      the_history = (HIST_ENTRY **)
 		xrealloc (the_history, history_size * sizeof (HIST_ENTRY *));
 	    }